@@ -30,11 +30,15 @@
 
 namespace kaldi {
 
+// min_duration is the number of arcs every emitting transition is repeated,
+// the min number of frames of the phone(3, or less for the low frame rate
+// decoding)
 fst::VectorFst<fst::StdArc> *GetHmmAsFst3(
     std::vector<int32> phone_window,
     const ContextDependencyInterface &ctx_dep,
     const TransitionModel &trans_model,
     const HTransducerConfig &config,    
+    int32 min_duration,
     HmmCacheType *cache) {
   using namespace fst;
 
@@ -98,8 +102,9 @@ fst::VectorFst<fst::StdArc> *GetHmmAsFst3(
 
   std::vector<StateId> state_ids;
   KALDI_ASSERT(entry.size() == 2);
-  //add 2 more states
-  for (size_t i = 0; i < entry.size() + 2; i++)
+  KALDI_ASSERT(min_duration >= 1);
+  //add min_duration - 1 more states
+  for (size_t i = 0; i < entry.size() + min_duration - 1; i++)
     state_ids.push_back(ans->AddState());
   KALDI_ASSERT(state_ids.size() != 0);  // Or empty topology entry.
   ans->SetStart(state_ids[0]);
@@ -144,11 +149,11 @@ fst::VectorFst<fst::StdArc> *GetHmmAsFst3(
       // Will add probability-scale later (we may want to push first).
       ans->AddArc(state_ids[hmm_state],
                   Arc(label, label, Weight(-log_prob), state_ids[dest_state]));
-      //add two more state
-      ans->AddArc(state_ids[dest_state],
-                  Arc(label, label, Weight(-log_prob), state_ids[dest_state+1]));
-      ans->AddArc(state_ids[dest_state+1],
-                  Arc(label, label, Weight(-log_prob), state_ids[dest_state+2]));
+      //add min_duration - 1 more state
+      for (int32 k = 0; k + 1 < min_duration; k++) {
+        ans->AddArc(state_ids[dest_state+k],
+                    Arc(label, label, Weight(-log_prob), state_ids[dest_state+k+1]));
+      }
     }
   }
 
@@ -178,6 +183,7 @@ fst::VectorFst<fst::StdArc> *GetHTransducer3 (const std::vector<std::vector<int3
                                              const ContextDependencyInterface &ctx_dep,
                                              const TransitionModel &trans_model,
                                              const HTransducerConfig &config,
+                                             int32 min_duration,
                                              std::vector<int32> *disambig_syms_left) {
   KALDI_ASSERT(ilabel_info.size() >= 1 && ilabel_info[0].size() == 0);  // make sure that eps == eps.
   HmmCacheType cache;
@@ -224,6 +230,7 @@ fst::VectorFst<fst::StdArc> *GetHTransducer3 (const std::vector<std::vector<int3
                                         ctx_dep,
                                         trans_model,
                                         config,
+                                        min_duration,
                                         &cache);
       fsts[j] = fst;
     }
@@ -252,13 +259,18 @@ int main(int argc, char *argv[]) {
         " without self-loops [use add-self-loops to add them]\n"
         "Usage:   aslp-make-h3-transducer <ilabel-info-file> <tree-file> <transition-gmm/acoustic-model> [<H-fst-out>]\n"
         "e.g.: \n"
-        " aslp-make-h3-transducer ilabel_info  1.tree 1.mdl > H.fst\n";
+        " aslp-make-h3-transducer ilabel_info  1.tree 1.mdl > H.fst\n"
+        "For the low frame rate decoding of every n-th frame(aslp-latgen-faster-rtf\n"
+        "--skip-type=lfr --skip-width=n), build it with --skip-width=n, the min\n"
+        "duration of 3 frames becomes ceil(3 / n) decoded frames\n";
     ParseOptions po(usage);
 
     HTransducerConfig hcfg;
     std::string disambig_out_filename;
     hcfg.Register(&po);
     po.Register("disambig-syms-out", &disambig_out_filename, "List of disambiguation symbols on input of H [to be output from this program]");
+    int32 skip_width = 1;
+    po.Register("skip-width", &skip_width, "Frames per decoded frame of the low frame rate decoding");
 
     po.Read(argc, argv);
 
@@ -289,11 +301,15 @@ int main(int argc, char *argv[]) {
 
     std::vector<int32> disambig_syms_out;
 
+    if (skip_width < 1) KALDI_ERR << "Bad --skip-width " << skip_width;
+    int32 min_duration = (3 + skip_width - 1) / skip_width;
+
     // The work gets done here.
     fst::VectorFst<fst::StdArc> *H = GetHTransducer3 (ilabel_info,
                                                      ctx_dep,
                                                      trans_model,
                                                      hcfg,
+                                                     min_duration,
                                                      &disambig_syms_out);
 #if _MSC_VER
     if (fst_out_filename == "")
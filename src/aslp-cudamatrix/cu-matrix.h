@@ -479,7 +479,7 @@ class CuMatrixBase {
   // The same as adding M but scaling each column M_j by v(j).
   void AddMatDiagVec(const Real alpha,
                      const CuMatrixBase<Real> &M, MatrixTransposeType transM,
-                     CuVectorBase<Real> &v,
+                     const CuVectorBase<Real> &v,
                      Real beta = 1.0);
 
   /// *this = beta * *this + alpha * A .* B (.* element by element multiplication)
@@ -793,6 +793,15 @@ class CuSubMatrix: public CuMatrixBase<Real> {
   inline CuSubMatrix<Real> (const CuSubMatrix &other):
   CuMatrixBase<Real> (other.data_, other.num_rows_, other.num_cols_,
                       other.stride_) {}
+
+  /// A matrix over existing memory, which must be device memory if the GPU
+  /// is in use, host memory otherwise. Use with caution: the data is not
+  /// owned, and it can be written through the matrix although it's const.
+  inline CuSubMatrix(const Real *data,
+                     const MatrixIndexT num_rows,
+                     const MatrixIndexT num_cols,
+                     const MatrixIndexT stride):
+  CuMatrixBase<Real>(const_cast<Real*>(data), num_rows, num_cols, stride) {}
  private:
   /// Disallow assignment.
   CuSubMatrix<Real> &operator = (const CuSubMatrix<Real> &other);
@@ -0,0 +1,122 @@
+// aslp-cudamatrix/cu-optimizer.cu
+
+#include "aslp-cudamatrix/cu-optimizer.h"
+
+const int BLOCK1D = 512;
+// enough blocks to fill the device, the threads stride over the rest
+const int MAX_GRID1D = 4096;
+
+inline int divup(int x, int y) { return (x + y - 1) / y; }
+
+inline int grid1d(int num) {
+    int grid = divup(num, BLOCK1D);
+    return grid < MAX_GRID1D ? grid : MAX_GRID1D;
+}
+
+template<typename Real>
+__global__
+static void cuda_momentum_update_kernel(const Real *grad, Real *mom, Real *param,
+                                        int num, Real lr, Real momentum) {
+    int step = blockDim.x * gridDim.x;
+    for (int i = threadIdx.x + blockIdx.x * blockDim.x; i < num; i += step) {
+        Real m = momentum * mom[i] + lr * grad[i];
+        mom[i] = m;
+        param[i] -= m;
+    }
+}
+
+template<typename Real>
+__global__
+static void cuda_rms_update_kernel(const Real *grad, Real *acc, Real *param,
+                                   int num, Real decay, Real scale, Real lr,
+                                   Real floor) {
+    int step = blockDim.x * gridDim.x;
+    for (int i = threadIdx.x + blockIdx.x * blockDim.x; i < num; i += step) {
+        Real g = grad[i];
+        Real a = decay * acc[i] + scale * g * g;
+        acc[i] = a;
+        param[i] -= lr * g / sqrt(a > floor ? a : floor);
+    }
+}
+
+template<typename Real>
+__global__
+static void cuda_adadelta_update_kernel(const Real *grad, Real *acc_grad,
+                                        Real *acc_delta, Real *param, int num,
+                                        Real gamma, Real floor) {
+    int step = blockDim.x * gridDim.x;
+    for (int i = threadIdx.x + blockIdx.x * blockDim.x; i < num; i += step) {
+        Real g = grad[i];
+        Real a = gamma * acc_grad[i] + (1 - gamma) * g * g;
+        Real d = acc_delta[i];
+        Real delta = sqrt(d > floor ? d : floor) / sqrt(a > floor ? a : floor) * g;
+        acc_grad[i] = a;
+        param[i] -= delta;
+        acc_delta[i] = gamma * d + (1 - gamma) * delta * delta;
+    }
+}
+
+template<typename Real>
+__global__
+static void cuda_adam_update_kernel(const Real *grad, Real *m, Real *v, Real *param,
+                                    int num, Real beta1, Real beta2, Real lr_s1,
+                                    Real s2, Real floor) {
+    int step = blockDim.x * gridDim.x;
+    for (int i = threadIdx.x + blockIdx.x * blockDim.x; i < num; i += step) {
+        Real g = grad[i];
+        Real mi = beta1 * m[i] + (1 - beta1) * g;
+        Real vi = beta2 * v[i] + (1 - beta2) * g * g;
+        Real vs = vi * s2;
+        m[i] = mi;
+        v[i] = vi;
+        param[i] -= lr_s1 * mi / sqrt(vs > floor ? vs : floor);
+    }
+}
+
+void cuda_momentum_update(const float *grad, float *mom, float *param, int num,
+                          float lr, float momentum) {
+    cuda_momentum_update_kernel<<<grid1d(num), BLOCK1D>>>(grad, mom, param, num,
+                                                          lr, momentum);
+}
+
+void cuda_momentum_update(const double *grad, double *mom, double *param, int num,
+                          double lr, double momentum) {
+    cuda_momentum_update_kernel<<<grid1d(num), BLOCK1D>>>(grad, mom, param, num,
+                                                          lr, momentum);
+}
+
+void cuda_rms_update(const float *grad, float *acc, float *param, int num,
+                     float decay, float scale, float lr, float floor) {
+    cuda_rms_update_kernel<<<grid1d(num), BLOCK1D>>>(grad, acc, param, num,
+                                                     decay, scale, lr, floor);
+}
+
+void cuda_rms_update(const double *grad, double *acc, double *param, int num,
+                     double decay, double scale, double lr, double floor) {
+    cuda_rms_update_kernel<<<grid1d(num), BLOCK1D>>>(grad, acc, param, num,
+                                                     decay, scale, lr, floor);
+}
+
+void cuda_adadelta_update(const float *grad, float *acc_grad, float *acc_delta,
+                          float *param, int num, float gamma, float floor) {
+    cuda_adadelta_update_kernel<<<grid1d(num), BLOCK1D>>>(grad, acc_grad, acc_delta,
+                                                          param, num, gamma, floor);
+}
+
+void cuda_adadelta_update(const double *grad, double *acc_grad, double *acc_delta,
+                          double *param, int num, double gamma, double floor) {
+    cuda_adadelta_update_kernel<<<grid1d(num), BLOCK1D>>>(grad, acc_grad, acc_delta,
+                                                          param, num, gamma, floor);
+}
+
+void cuda_adam_update(const float *grad, float *m, float *v, float *param, int num,
+                      float beta1, float beta2, float lr_s1, float s2, float floor) {
+    cuda_adam_update_kernel<<<grid1d(num), BLOCK1D>>>(grad, m, v, param, num,
+                                                      beta1, beta2, lr_s1, s2, floor);
+}
+
+void cuda_adam_update(const double *grad, double *m, double *v, double *param, int num,
+                      double beta1, double beta2, double lr_s1, double s2, double floor) {
+    cuda_adam_update_kernel<<<grid1d(num), BLOCK1D>>>(grad, m, v, param, num,
+                                                      beta1, beta2, lr_s1, s2, floor);
+}
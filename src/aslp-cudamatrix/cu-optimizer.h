@@ -0,0 +1,35 @@
+// aslp-cudamatrix/cu-optimizer.h
+
+// Fused elementwise updates of the aslp-parallel optimizers, one kernel
+// reads the gradient and the state and writes the parameter once.
+// See aslp-parallel/optimizer.cc for the math and the CPU version.
+
+#ifndef KALDI_CUDAMATRIX_CU_OPTIMIZER_H_
+#define KALDI_CUDAMATRIX_CU_OPTIMIZER_H_
+
+// momentum: mom = momentum * mom + lr * grad, param -= mom
+void cuda_momentum_update(const float *grad, float *mom, float *param, int num,
+                          float lr, float momentum);
+void cuda_momentum_update(const double *grad, double *mom, double *param, int num,
+                          double lr, double momentum);
+
+// adagrad/rmsprop: acc = decay * acc + scale * grad^2,
+// param -= lr * grad / sqrt(max(acc, floor))
+void cuda_rms_update(const float *grad, float *acc, float *param, int num,
+                     float decay, float scale, float lr, float floor);
+void cuda_rms_update(const double *grad, double *acc, double *param, int num,
+                     double decay, double scale, double lr, double floor);
+
+// adadelta
+void cuda_adadelta_update(const float *grad, float *acc_grad, float *acc_delta,
+                          float *param, int num, float gamma, float floor);
+void cuda_adadelta_update(const double *grad, double *acc_grad, double *acc_delta,
+                          double *param, int num, double gamma, double floor);
+
+// adam, s1 and s2 are the bias corrections of the step
+void cuda_adam_update(const float *grad, float *m, float *v, float *param, int num,
+                      float beta1, float beta2, float lr_s1, float s2, float floor);
+void cuda_adam_update(const double *grad, double *m, double *v, double *param, int num,
+                      double beta1, double beta2, double lr_s1, double s2, double floor);
+
+#endif // KALDI_CUDAMATRIX_CU_OPTIMIZER_H_
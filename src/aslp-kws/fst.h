@@ -95,6 +95,21 @@ public:
         }
     }
 
+    // Appends a state, its arcs are added before the next state
+    int32_t AddState() {
+        arc_offset_.push_back(arcs_.size());
+        return NumStates() - 1;
+    }
+
+    void AddArc(int32_t id, const Arc &arc) {
+        CHECK(id == NumStates() - 1);
+        arcs_.push_back(arc);
+    }
+
+    void SetFinal(int32_t id, float weight) {
+        finals_[id] = weight;
+    }
+
     void ReadTopo(const SymbolTable &isymbol_table, 
                   const SymbolTable &osymbol_table, 
                   const std::string &topo_file);
@@ -0,0 +1,214 @@
+// aslp-kws/keyword-spot-test.cc
+
+#include <math.h>
+
+#include <set>
+#include <vector>
+
+#include "keyword-spot.h"
+
+namespace kaldi {
+namespace kws {
+
+// The former KeywordSpot::Spot(), which expanded and reset every state of
+// the fst each frame, the reference of the active list version
+class FullScanKeywordSpot {
+public:
+    typedef KeywordSpot::Token Token;
+
+    FullScanKeywordSpot(const Fst &fst, const SymbolTable &filler_table):
+            fst_(fst), filler_table_(filler_table),
+            prev_tokens_(fst.NumStates()), cur_tokens_(fst.NumStates()) {
+        prev_tokens_[0].active = true;
+    }
+
+    bool Spot(const float *am_score, int num, float *confidence,
+              int32_t *keyword_id) {
+        bool spot = false;
+        *confidence = 0.0;
+        *keyword_id = 0;
+        for (int i = 0; i < prev_tokens_.size(); i++) {
+            if (!prev_tokens_[i].active) continue;
+            for (const Arc *arc = fst_.ArcStart(i); arc != fst_.ArcEnd(i); arc++) {
+                CHECK(arc->ilabel <= num);
+                float score = logf(am_score[arc->ilabel - 1]);
+                bool is_filler = filler_table_.HaveId(arc->ilabel);
+                cur_tokens_[arc->next_state].Update(prev_tokens_[i], arc->olabel,
+                    i == arc->next_state, is_filler, score);
+            }
+        }
+        int best_final_state = 0;
+        float best_final_score = 0.0f;
+        bool reach_final = false;
+        for (int i = 1; i < cur_tokens_.size(); i++) {
+            if (cur_tokens_[i].active && fst_.IsFinal(i)) {
+                if (!reach_final || best_final_score < cur_tokens_[i].score) {
+                    best_final_state = i;
+                    best_final_score = cur_tokens_[i].score;
+                    reach_final = true;
+                }
+            }
+        }
+        if (reach_final) {
+            const Token &token = cur_tokens_[best_final_state];
+            *confidence = expf(token.average_max_keyword_score);
+            *keyword_id = token.keyword;
+            spot = token.num_frames_of_current_state >= 5 && *confidence > 0.5;
+        }
+        prev_tokens_.swap(cur_tokens_);
+        for (int i = 0; i < cur_tokens_.size(); i++) {
+            cur_tokens_[i].Reset();
+        }
+        return spot;
+    }
+
+private:
+    const Fst &fst_;
+    const SymbolTable &filler_table_;
+    std::vector<Token> prev_tokens_, cur_tokens_;
+};
+
+static int RandInt(int min, int max) {
+    return min + rand() % (max - min + 1);
+}
+
+// Phones 1 and 2 are the fillers, state 0 loops on them and enters each
+// keyword, a chain of self looped states, the last one final. Every arc of
+// keyword k outputs k + 1, the token keeps the olabel of its last arc only
+static void MakeKeywordFst(int num_keywords, int keyword_length,
+                           int num_phones, Fst *fst,
+                           std::vector<std::vector<int> > *keywords) {
+    keywords->resize(num_keywords);
+    for (int k = 0; k < num_keywords; k++) {
+        (*keywords)[k].clear();
+        for (int j = 0; j < keyword_length; j++) {
+            (*keywords)[k].push_back(RandInt(3, num_phones));
+        }
+    }
+    int32_t start = fst->AddState();
+    fst->AddArc(start, Arc(1, 0, 0.0f, start));
+    fst->AddArc(start, Arc(2, 0, 0.0f, start));
+    for (int k = 0; k < num_keywords; k++) {
+        fst->AddArc(start, Arc((*keywords)[k][0], k + 1, 0.0f,
+                               1 + k * keyword_length));
+    }
+    for (int k = 0; k < num_keywords; k++) {
+        for (int j = 0; j < keyword_length; j++) {
+            int32_t state = fst->AddState();
+            fst->AddArc(state, Arc((*keywords)[k][j], k + 1, 0.0f, state));
+            if (j + 1 < keyword_length) {
+                fst->AddArc(state, Arc((*keywords)[k][j + 1], k + 1, 0.0f,
+                                       state + 1));
+            } else {
+                fst->SetFinal(state, 0.0f);
+            }
+        }
+    }
+}
+
+// Random posteriors with one dominant phone, a keyword every 100 frames
+static void MakePosteriors(const std::vector<std::vector<int> > &keywords,
+                           int num_phones, int num_frames,
+                           std::vector<float> *posteriors) {
+    posteriors->resize(num_frames * num_phones);
+    int t = 0;
+    while (t < num_frames) {
+        std::vector<int> phones;
+        int frames_per_phone = 6;
+        if (t % 100 < 10) {
+            phones = keywords[RandInt(0, keywords.size() - 1)];
+        } else {
+            phones.push_back(RandInt(1, num_phones));
+            frames_per_phone = RandInt(2, 10);
+        }
+        for (int j = 0; j < phones.size(); j++) {
+            for (int f = 0; f < frames_per_phone && t < num_frames; f++, t++) {
+                float *row = &(*posteriors)[t * num_phones];
+                float sum = 0.0;
+                for (int p = 0; p < num_phones; p++) {
+                    row[p] = (rand() + 1.0) / RAND_MAX;
+                    sum += row[p];
+                }
+                for (int p = 0; p < num_phones; p++) row[p] *= 0.4 / sum;
+                row[phones[j] - 1] += 0.6;
+            }
+        }
+    }
+}
+
+// Without a beam the active list version spots as the full scan did
+static void TestFullScanMatch(int num_keywords, int keyword_length,
+                              int num_phones) {
+    Fst fst;
+    std::vector<std::vector<int> > keywords;
+    MakeKeywordFst(num_keywords, keyword_length, num_phones, &fst, &keywords);
+    SymbolTable filler_table;
+    filler_table.AddSymbol("<gbg>", 1);
+    filler_table.AddSymbol("sil", 2);
+    int num_frames = 2000;
+    std::vector<float> posteriors;
+    MakePosteriors(keywords, num_phones, num_frames, &posteriors);
+
+    KeywordSpot spotter(fst, filler_table);
+    FullScanKeywordSpot reference(fst, filler_table);
+    int num_spots = 0;
+    for (int t = 0; t < num_frames; t++) {
+        const float *row = &posteriors[t * num_phones];
+        float confidence, ref_confidence;
+        int32_t keyword_id, ref_keyword_id;
+        bool spot = spotter.Spot(row, num_phones, &confidence, &keyword_id);
+        bool ref_spot = reference.Spot(row, num_phones, &ref_confidence,
+                                       &ref_keyword_id);
+        CHECK(spot == ref_spot);
+        CHECK(confidence == ref_confidence);
+        CHECK(keyword_id == ref_keyword_id);
+        num_spots += spot;
+    }
+    CHECK(num_spots > 0);
+}
+
+// The start state is never pruned, so the search gets out of the final state
+// of a keyword and the other keywords are spotted too
+static void TestBeam() {
+    int num_phones = 30;
+    Fst fst;
+    std::vector<std::vector<int> > keywords;
+    MakeKeywordFst(20, 4, num_phones, &fst, &keywords);
+    SymbolTable filler_table;
+    filler_table.AddSymbol("<gbg>", 1);
+    filler_table.AddSymbol("sil", 2);
+    int num_frames = 2000;
+    std::vector<float> posteriors;
+    MakePosteriors(keywords, num_phones, num_frames, &posteriors);
+
+    KeywordSpot spotter(fst, filler_table);
+    spotter.SetBeam(5.0);
+    std::set<int32_t> keyword_ids;
+    for (int t = 0; t < num_frames; t++) {
+        float confidence;
+        int32_t keyword_id;
+        if (spotter.Spot(&posteriors[t * num_phones], num_phones,
+                         &confidence, &keyword_id)) {
+            keyword_ids.insert(keyword_id);
+        }
+        CHECK(spotter.NumActive() >= 1);
+        CHECK(spotter.NumActive() <= fst.NumStates());
+    }
+    CHECK(keyword_ids.size() > 1);
+}
+
+}
+}
+
+int main() {
+    using namespace kaldi::kws;
+    srand(0);
+    TestFullScanMatch(1, 3, 10);
+    TestFullScanMatch(10, 4, 20);
+    TestFullScanMatch(100, 6, 50);
+    // few states, the active ones are found by the scan of the flags
+    TestFullScanMatch(5, 2, 5);
+    TestBeam();
+    LOG("Test OK.");
+    return 0;
+}
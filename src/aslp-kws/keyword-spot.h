@@ -11,22 +11,44 @@
 #include <float.h>
 #include <math.h>
 
+#include <algorithm>
+#include <vector>
+
 namespace kaldi {
 namespace kws {
 
 const int kMaxTokenPassingFrames = 100 * 60 * 10; // 10 minitue
 
+// Token passing over the states of the keyword fst. Only the active states
+// are expanded and reset each frame, so the cost of a frame grows with the
+// active hypotheses, not with the size of the fst, and the tokens out of
+// the beam of the best one are dropped.
 class KeywordSpot {
 public:
     KeywordSpot(const Fst &fst, const SymbolTable &filler_table):
             fst_(fst),
             filler_table_(filler_table),
             num_frames_(0),
+            max_ilabel_(0),
             spot_threshold_(0.5), 
             min_keyword_frames_(0),
-            min_frames_for_last_state_(5) {
+            min_frames_for_last_state_(5),
+            beam_(FLT_MAX) {
         prev_tokens_.resize(fst_.NumStates(), Token());  
         cur_tokens_.resize(fst_.NumStates(), Token());  
+        // filler and final flags once here, not a table lookup per arc
+        is_final_.resize(fst_.NumStates(), 0);
+        arc_is_filler_.resize(fst_.NumArcs(), 0);
+        for (int i = 0; i < fst_.NumStates(); i++) {
+            is_final_[i] = fst_.IsFinal(i);
+            for (const Arc *arc = fst_.ArcStart(i); arc != fst_.ArcEnd(i); arc++) {
+                CHECK(arc->next_state >= 0);
+                CHECK(arc->next_state < fst_.NumStates());
+                CHECK(arc->ilabel > 0); // no <eps>, its score is am_score[-1]
+                max_ilabel_ = std::max(max_ilabel_, arc->ilabel);
+                arc_is_filler_[arc - fst_.ArcStart(0)] = IsFillerPhone(arc->ilabel);
+            }
+        }
         Reset();
     }
 
@@ -38,62 +60,99 @@ public:
         min_keyword_frames_ = frames;
     }
 
+    // Log score below the best token, FLT_MAX(default) keeps all of them.
+    // The start state is never pruned
+    void SetBeam(float beam) {
+        CHECK(beam > 0.0f);
+        beam_ = beam;
+    }
+
+    int NumActive() const {
+        return prev_active_.size();
+    }
+
     void Reset() {
-        for (int i = 0; i < prev_tokens_.size(); i++) {
-            prev_tokens_[i].Reset();
-        }
-        for (int i = 0; i < cur_tokens_.size(); i++) {
-            cur_tokens_[i].Reset();
+        for (int i = 0; i < prev_active_.size(); i++) {
+            prev_tokens_[prev_active_[i]].Reset();
         }
+        prev_active_.clear();
         prev_tokens_[0].active = true;
+        prev_active_.push_back(0);
         num_frames_ = 0;
     }
 
     // 0 garbage, 1 silence now
-    bool IsFillerPhone(int phone) {
+    bool IsFillerPhone(int phone) const {
         return filler_table_.HaveId(phone);
     }
 
+    // am_score are the posteriors of the num phones
     bool Spot(const float *am_score, int num, float *confidence, 
               int32_t *keyword_id) {
+        log_am_score_.resize(num);
+        for (int i = 0; i < num; i++) {
+            log_am_score_[i] = logf(am_score[i]);
+        }
+        return SpotLog(log_am_score_.data(), num, confidence, keyword_id);
+    }
+
+    // As Spot(), of the log posteriors
+    bool SpotLog(const float *log_am_score, int num, float *confidence, 
+                 int32_t *keyword_id) {
         bool spot = false;
         *confidence = 0.0;
         *keyword_id = 0;
+        CHECK(max_ilabel_ <= num);
 
-        for (int i = 0; i < prev_tokens_.size(); i++) {
-            if (prev_tokens_[i].active) {
-                for (const Arc *arc = fst_.ArcStart(i); arc != fst_.ArcEnd(i); arc++) {
-                    CHECK(arc->next_state >= 0);
-                    CHECK(arc->next_state < cur_tokens_.size());
-                    CHECK(arc->ilabel <= num);
-                    float score = logf(am_score[arc->ilabel - 1]); // 0 for <eps>
-                    bool is_filler = IsFillerPhone(arc->ilabel);
-                    bool is_self_arc = (i == arc->next_state);
-                    int32_t olabel = arc->olabel;
-                    cur_tokens_[arc->next_state].Update(prev_tokens_[i], olabel,
-                        is_self_arc, is_filler, score);
-                }
+        // in the order of the states, the ties of Token::Update() go to the
+        // first state as the full scan did. A scan of the flags is cheaper
+        // than the sort once many states are active
+        if (prev_active_.size() * 16 > prev_tokens_.size()) {
+            prev_active_.clear();
+            for (int i = 0; i < prev_tokens_.size(); i++) {
+                if (prev_tokens_[i].active) prev_active_.push_back(i);
+            }
+        } else {
+            std::sort(prev_active_.begin(), prev_active_.end());
+        }
+        const Arc *arc_base = fst_.ArcStart(0);
+        for (int k = 0; k < prev_active_.size(); k++) {
+            int i = prev_active_[k];
+            const Token &prev = prev_tokens_[i];
+            for (const Arc *arc = fst_.ArcStart(i); arc != fst_.ArcEnd(i); arc++) {
+                float score = log_am_score[arc->ilabel - 1]; // 0 for <eps>
+                bool is_filler = arc_is_filler_[arc - arc_base];
+                bool is_self_arc = (i == arc->next_state);
+                Token &cur = cur_tokens_[arc->next_state];
+                if (!cur.active) cur_active_.push_back(arc->next_state);
+                cur.Update(prev, arc->olabel, is_self_arc, is_filler, score);
             }
         }
         
-        // find best final score
+        // find best final score, the ties to the first state as before
         int best_state = 0, best_final_state = 0;
         float best_score = cur_tokens_[0].score, best_final_score = 0.0f;
+        float best_active_score = -FLT_MAX;
         bool reach_final = false;
-        for (int i = 1; i < cur_tokens_.size(); i++) {
-            if (cur_tokens_[i].active && best_score < cur_tokens_[i].score) {
-                best_score = cur_tokens_[i].score;
+        for (int k = 0; k < cur_active_.size(); k++) {
+            int i = cur_active_[k];
+            float score = cur_tokens_[i].score;
+            best_active_score = std::max(best_active_score, score);
+            if (i == 0) continue;
+            if (best_score < score || (best_score == score && i < best_state)) {
+                best_score = score;
                 best_state = i;
             }
 
-            if (cur_tokens_[i].active && fst_.IsFinal(i)) {
+            if (is_final_[i]) {
                 if (!reach_final) {
                     best_final_state = i;
-                    best_final_score = cur_tokens_[i].score;
+                    best_final_score = score;
                     reach_final = true;
-                } else if (best_final_score < cur_tokens_[i].score) {
+                } else if (best_final_score < score || 
+                           (best_final_score == score && i < best_final_state)) {
                     best_final_state = i;
-                    best_final_score = cur_tokens_[i].score;
+                    best_final_score = score;
                 }
             }
         }
@@ -109,18 +168,30 @@ public:
             }
         }
 
+        // the tokens of the last frame are free, the ones out of the beam
+        // are dropped but the start one, the filler loop, so the search
+        // starts again after a keyword
+        for (int k = 0; k < prev_active_.size(); k++) {
+            prev_tokens_[prev_active_[k]].Reset();
+        }
         prev_tokens_.swap(cur_tokens_);
-        for (int i = 0; i < cur_tokens_.size(); i++) {
-            cur_tokens_[i].Reset();
+        prev_active_.clear();
+        for (int k = 0; k < cur_active_.size(); k++) {
+            int i = cur_active_[k];
+            if (i != 0 && prev_tokens_[i].score < best_active_score - beam_) {
+                prev_tokens_[i].Reset();
+            } else {
+                prev_active_.push_back(i);
+            }
         }
+        cur_active_.clear();
 
         num_frames_++;
-        // Reset state to avoid number overflow, and it's not in a keyword state
+        // Reset state to avoid number overflow, and it's not in a keyword
+        // state, from the start state again
         if (num_frames_ > kMaxTokenPassingFrames 
                 && (prev_tokens_[best_state].is_filler)) {
-            for (int i = 0; i < cur_tokens_.size(); i++) {
-                prev_tokens_[i].Reset();
-            }
+            Reset();
         }
         return spot;
     }
@@ -209,10 +280,18 @@ private:
     // Make tokens the same size as number states of Fst
     std::vector<Token> prev_tokens_; 
     std::vector<Token> cur_tokens_;
+    // the states of the active tokens, only these are not Reset()
+    std::vector<int> prev_active_;
+    std::vector<int> cur_active_;
+    std::vector<char> is_final_;
+    std::vector<char> arc_is_filler_; // by arc index
+    int32_t max_ilabel_;
+    std::vector<float> log_am_score_;
 
     float spot_threshold_;
     int min_keyword_frames_;
     int min_frames_for_last_state_;
+    float beam_;
 };
 
 }
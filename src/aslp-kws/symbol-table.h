@@ -20,6 +20,8 @@ const int kEpsilon = 0;
 
 class SymbolTable {
 public:
+    SymbolTable() {}
+
     SymbolTable(const std::string &symbol_file) {
         ReadSymbolFile(symbol_file);
     }
@@ -41,6 +43,11 @@ public:
         return -1;
     }
 
+    void AddSymbol(const std::string &symbol, int32_t id) {
+        CHECK(id >= 0);
+        symbol_tabel_[id] = symbol;
+    }
+
     bool HaveId (int32_t id) const {
         return (symbol_tabel_.find(id) != symbol_tabel_.end());
     }
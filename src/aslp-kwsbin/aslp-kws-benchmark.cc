@@ -0,0 +1,165 @@
+// aslp-kwsbin/aslp-kws-benchmark.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <float.h>
+
+#include "base/kaldi-common.h"
+#include "util/common-utils.h"
+#include "base/timer.h"
+
+#include "aslp-kws/keyword-spot.h"
+
+namespace kaldi {
+namespace kws {
+
+// Phone 1 is <gbg>, 2 is sil, the keyword phones are from 3
+const int kNumFillers = 2;
+
+// State 0 loops on the fillers and enters each keyword, a keyword is a chain
+// of keyword_length states of self loops, the last one final
+static void MakeKeywordFst(const std::vector<std::vector<int> > &keywords,
+                           Fst *fst) {
+    int keyword_length = keywords[0].size();
+    int32_t start = fst->AddState();
+    for (int p = 1; p <= kNumFillers; p++) {
+        fst->AddArc(start, Arc(p, 0, 0.0f, start));
+    }
+    for (int k = 0; k < keywords.size(); k++) {
+        fst->AddArc(start, Arc(keywords[k][0], k + 1, 0.0f, 1 + k * keyword_length));
+    }
+    for (int k = 0; k < keywords.size(); k++) {
+        for (int j = 0; j < keyword_length; j++) {
+            int32_t state = fst->AddState();
+            fst->AddArc(state, Arc(keywords[k][j], 0, 0.0f, state));
+            if (j + 1 < keyword_length) {
+                fst->AddArc(state, Arc(keywords[k][j + 1], 0, 0.0f, state + 1));
+            } else {
+                fst->SetFinal(state, 0.0f);
+            }
+        }
+    }
+}
+
+// Segments of 5 to 15 frames of one dominant phone, a filler half the time,
+// and every 200 frames one of the keywords, 8 frames a phone
+static void MakePosteriors(const std::vector<std::vector<int> > &keywords,
+                           int num_phones, int num_frames,
+                           Matrix<BaseFloat> *posteriors) {
+    posteriors->Resize(num_frames, num_phones);
+    int t = 0;
+    while (t < num_frames) {
+        std::vector<int> phones;
+        int frames_per_phone;
+        if (t % 200 < 10) {
+            phones = keywords[RandInt(0, keywords.size() - 1)];
+            frames_per_phone = 8;
+        } else {
+            phones.push_back(RandInt(0, 1) ? RandInt(1, kNumFillers) :
+                             RandInt(kNumFillers + 1, num_phones));
+            frames_per_phone = RandInt(5, 15);
+        }
+        for (int j = 0; j < phones.size(); j++) {
+            for (int f = 0; f < frames_per_phone && t < num_frames; f++, t++) {
+                SubVector<BaseFloat> row(*posteriors, t);
+                for (int p = 0; p < num_phones; p++) {
+                    row(p) = RandUniform() + 0.01;
+                }
+                row.Scale(0.4 / row.Sum());
+                row(phones[j] - 1) += 0.6;
+            }
+        }
+    }
+}
+
+static void Run(const Fst &fst, const SymbolTable &filler_table,
+                const Matrix<BaseFloat> &posteriors, float beam) {
+    KeywordSpot keyword_spotter(fst, filler_table);
+    if (beam < FLT_MAX) keyword_spotter.SetBeam(beam);
+    float confidence = 0.0;
+    int32_t keyword_id = 0;
+    int64 num_active = 0;
+    int num_spots = 0;
+    Timer timer;
+    for (int t = 0; t < posteriors.NumRows(); t++) {
+        num_spots += keyword_spotter.Spot(posteriors.RowData(t),
+                                          posteriors.NumCols(),
+                                          &confidence, &keyword_id);
+        num_active += keyword_spotter.NumActive();
+    }
+    double elapsed = timer.Elapsed();
+    KALDI_LOG << "beam " << beam << ": "
+              << posteriors.NumRows() / elapsed << " frames per second, "
+              << static_cast<double>(num_active) / posteriors.NumRows()
+              << " active states per frame, "
+              << num_spots << " frames spotted";
+}
+
+}
+}
+
+int main(int argc, char *argv[]) {
+    using namespace kaldi;
+    using namespace kaldi::kws;
+    try {
+        const char *usage =
+            "Benchmark the keyword spotter on a random keyword fst and posteriors,\n"
+            "frames per second of one stream without and with the beam\n"
+            "Usage: aslp-kws-benchmark [options]\n"
+            "eg: aslp-kws-benchmark --num-keywords=5000 --beam=10\n";
+
+        ParseOptions po(usage);
+        int num_keywords = 1000, keyword_length = 6, num_phones = 100,
+            num_frames = 6000;
+        float beam = 10.0;
+        po.Register("num-keywords", &num_keywords, "Number of keywords");
+        po.Register("keyword-length", &keyword_length, "Phones per keyword");
+        po.Register("num-phones", &num_phones, "Number of phones, the 2 fillers too");
+        po.Register("num-frames", &num_frames, "Number of frames");
+        po.Register("beam", &beam, "Beam of the pruned run");
+        po.Read(argc, argv);
+
+        if (po.NumArgs() != 0) {
+            po.PrintUsage();
+            exit(1);
+        }
+        KALDI_ASSERT(num_keywords > 0 && keyword_length > 0 &&
+                     num_phones > kNumFillers && num_frames > 0 && beam > 0.0);
+
+        std::vector<std::vector<int> > keywords(num_keywords);
+        for (int k = 0; k < num_keywords; k++) {
+            for (int j = 0; j < keyword_length; j++) {
+                keywords[k].push_back(RandInt(kNumFillers + 1, num_phones));
+            }
+        }
+        Fst fst;
+        MakeKeywordFst(keywords, &fst);
+        SymbolTable filler_table;
+        filler_table.AddSymbol("<gbg>", 1);
+        filler_table.AddSymbol("sil", 2);
+        Matrix<BaseFloat> posteriors;
+        MakePosteriors(keywords, num_phones, num_frames, &posteriors);
+
+        KALDI_LOG << num_keywords << " keywords, " << fst.NumStates()
+                  << " states, " << fst.NumArcs() << " arcs";
+        Run(fst, filler_table, posteriors, FLT_MAX);
+        Run(fst, filler_table, posteriors, beam);
+        return 0;
+    } catch(const std::exception &e) {
+        std::cerr << e.what();
+        return -1;
+    }
+}
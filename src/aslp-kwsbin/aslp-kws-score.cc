@@ -49,6 +49,9 @@ int main(int argc, char *argv[]) {
 
     std::string use_gpu="no";
     po.Register("use-gpu", &use_gpu, "yes|no|optional, only has effect if compiled with CUDA"); 
+    BaseFloat beam = 0.0;
+    po.Register("beam", &beam, "Prune the tokens this far below the best one, "
+                "0 keeps all of them");
 
     po.Read(argc, argv);
 
@@ -77,6 +80,7 @@ int main(int argc, char *argv[]) {
     Fst fst;
     fst.Read(fst_filename.c_str());
     KeywordSpot keyword_spotter(fst, filler_table);
+    if (beam > 0.0) keyword_spotter.SetBeam(beam);
 
     kaldi::int64 tot_t = 0;
 
@@ -0,0 +1,154 @@
+// aslp-nnet/data-prefetcher.h
+
+#ifndef ASLP_NNET_DATA_PREFETCHER_H_
+#define ASLP_NNET_DATA_PREFETCHER_H_
+
+#include <pthread.h>
+
+#include <deque>
+#include <exception>
+#include <string>
+
+#include "base/kaldi-common.h"
+#include "base/timer.h"
+
+namespace kaldi {
+namespace aslp_nnet {
+
+/// Makes the items of a DataPrefetcher, Produce() runs in its thread
+template<class Item>
+class DataProducer {
+public:
+    /// Fills the next item, returns false at the end of the data
+    virtual bool Produce(Item *item) = 0;
+    virtual ~DataProducer() {}
+};
+
+/// Runs the producer in a background thread, which keeps up to queue_size
+/// items ready in a bounded queue, so the reading and parsing of the
+/// archives overlaps the nnet computation of the training thread. The items
+/// come out in the order they are produced, so the training result does not
+/// change. With queue_size 0 there is no thread, Get() produces the item
+/// itself.
+template<class Item>
+class DataPrefetcher {
+public:
+    /// The producer is not owned, it must outlive the prefetcher
+    DataPrefetcher(DataProducer<Item> *producer, int32 queue_size):
+            producer_(producer), queue_size_(queue_size),
+            stop_(false), finished_(false), stall_time_(0.0) {
+        KALDI_ASSERT(queue_size_ >= 0);
+        if (queue_size_ == 0) return;
+        pthread_mutex_init(&mutex_, NULL);
+        pthread_cond_init(&not_full_, NULL);
+        pthread_cond_init(&not_empty_, NULL);
+        if (pthread_create(&thread_, NULL, DataPrefetcher::Run, this) != 0) {
+            KALDI_ERR << "Could not create the data prefetch thread";
+        }
+    }
+
+    /// Stops the thread, the items not taken are dropped
+    ~DataPrefetcher() {
+        if (queue_size_ > 0) {
+            pthread_mutex_lock(&mutex_);
+            stop_ = true;
+            pthread_mutex_unlock(&mutex_);
+            pthread_cond_signal(&not_full_);
+            pthread_join(thread_, NULL);
+            for (size_t i = 0; i < queue_.size(); i++) delete queue_[i];
+            pthread_mutex_destroy(&mutex_);
+            pthread_cond_destroy(&not_full_);
+            pthread_cond_destroy(&not_empty_);
+        }
+    }
+
+    /// The next item, owned by the caller, or NULL at the end of the data.
+    /// An error of the producer is raised here, in the order of the items.
+    Item *Get() {
+        if (finished_) return NULL;
+        Item *item = NULL;
+        if (queue_size_ == 0) {
+            item = new Item;
+            if (!producer_->Produce(item)) {
+                delete item;
+                item = NULL;
+            }
+        } else {
+            pthread_mutex_lock(&mutex_);
+            if (queue_.empty()) {
+                Timer timer;
+                while (queue_.empty()) pthread_cond_wait(&not_empty_, &mutex_);
+                stall_time_ += timer.Elapsed();
+            }
+            item = queue_.front();
+            queue_.pop_front();
+            pthread_mutex_unlock(&mutex_);
+            pthread_cond_signal(&not_full_);
+        }
+        if (item == NULL) {
+            finished_ = true;
+            if (error_ != "") {
+                KALDI_ERR << "Data prefetch thread failed: " << error_;
+            }
+        }
+        return item;
+    }
+
+    /// Seconds Get() waited for the thread, the data reading which is not
+    /// hidden behind the training
+    double StallTime() const { return stall_time_; }
+
+private:
+    static void *Run(void *arg) {
+        DataPrefetcher *prefetcher = static_cast<DataPrefetcher *>(arg);
+        prefetcher->Loop();
+        return NULL;
+    }
+
+    void Loop() {
+        while (true) {
+            pthread_mutex_lock(&mutex_);
+            while (!stop_ && static_cast<int32>(queue_.size()) >= queue_size_)
+                pthread_cond_wait(&not_full_, &mutex_);
+            bool stop = stop_;
+            pthread_mutex_unlock(&mutex_);
+            if (stop) return;
+
+            Item *item = new Item;
+            try {
+                if (!producer_->Produce(item)) {
+                    delete item;
+                    item = NULL;
+                }
+            } catch (const std::exception &e) {
+                delete item;
+                item = NULL;
+                error_ = e.what();  // read by Get() after it takes the NULL
+            }
+            // NULL marks the end
+            pthread_mutex_lock(&mutex_);
+            queue_.push_back(item);
+            pthread_mutex_unlock(&mutex_);
+            pthread_cond_signal(&not_empty_);
+            if (item == NULL) return;
+        }
+    }
+
+    DataProducer<Item> *producer_;
+    int32 queue_size_;
+    pthread_t thread_;
+    pthread_mutex_t mutex_;
+    pthread_cond_t not_full_, not_empty_;
+    std::deque<Item *> queue_;
+    bool stop_;
+    std::string error_;
+    bool finished_;
+    double stall_time_;
+
+    KALDI_DISALLOW_COPY_AND_ASSIGN(DataPrefetcher);
+};
+
+} // namespace aslp_nnet
+} // namespace kaldi
+
+#endif
@@ -12,10 +12,12 @@ namespace aslp_nnet {
 FrameDataReader::FrameDataReader(
                     const std::vector<std::string> &feature_rspecifiers,
                     const std::vector<std::string> &targets_rspecifiers,
-                    const NnetDataRandomizerOptions &rand_opts): 
+                    const NnetDataRandomizerOptions &rand_opts,
+                    const DataShard &shard): 
         num_input_(feature_rspecifiers.size()), 
         num_output_(targets_rspecifiers.size()),
-        rand_opts_(rand_opts), read_done_(false) {
+        rand_opts_(rand_opts), read_done_(false),
+        shard_(shard), num_keys_(0), position_(shard.skip) {
     feature_readers_.resize(num_input_);
     feature_randomizers_.resize(num_input_);
     for (int i = 0; i < num_input_; i++) {
@@ -29,19 +31,24 @@ FrameDataReader::FrameDataReader(
         targets_randomizers_[i] = new PosteriorRandomizer(rand_opts_);
     }
     randomizer_mask_.Init(rand_opts_);
+    // After the readers, it starts reading at once
+    prefetcher_ = new DataPrefetcher<FrameDataUtt>(this, rand_opts_.prefetch_utts);
 }
 
 FrameDataReader::FrameDataReader(const std::string &feature_rspecifier, 
                                  const std::string &targets_rspecifier,
-                                 const NnetDataRandomizerOptions &rand_opts): rand_opts_(rand_opts) {
+                                 const NnetDataRandomizerOptions &rand_opts,
+                                 const DataShard &shard): rand_opts_(rand_opts) {
     std::vector<std::string> feature_rspecifiers;
     feature_rspecifiers.push_back(feature_rspecifier);
     std::vector<std::string> targets_rspecifiers;
     targets_rspecifiers.push_back(targets_rspecifier);
-    new (this) FrameDataReader(feature_rspecifiers, targets_rspecifiers, rand_opts);
+    new (this) FrameDataReader(feature_rspecifiers, targets_rspecifiers, rand_opts, shard);
 }
 
 FrameDataReader::~FrameDataReader() {
+    // Stop the thread before the readers are gone
+    delete prefetcher_;
     for (int i = 0; i < feature_readers_.size(); i++) {
         delete feature_readers_[i];
     }
@@ -61,58 +68,101 @@ bool FrameDataReader::Done() {
     return (read_done_ && feature_randomizers_[0]->Done());
 }
 
-void FrameDataReader::FillRandomizer() {
+int64 FrameDataReader::Position() {
+    // the prefetch thread is done with num_keys_ once read_done_
+    if (Done()) return num_keys_;
+    return position_;
+}
+
+bool FrameDataReader::Produce(FrameDataUtt *utt) {
     KALDI_ASSERT(feature_readers_.size() > 0);
     KALDI_ASSERT(targets_readers_.size() > 0);
-    //for (; !feature_readers_[0].Done(); feature_readers_[0].Next()) {
     while (true) {
-        if (feature_randomizers_[0]->IsFull()) break;
         if (feature_readers_[0]->Done()) {
             for (int i = 1; i < feature_readers_.size(); i++)
                 KALDI_ASSERT(feature_readers_[i]->Done());
-            read_done_ = true;
-            break;
+            return false;
         }
-        std::string utt = feature_readers_[0]->Key();
-        KALDI_VLOG(3) << "Reading " << utt;
+        std::string key = feature_readers_[0]->Key();
+        int64 index = num_keys_++;
+        // not in this shard, only the scp line is read
+        if (index < shard_.skip ||
+            (index - shard_.skip) % shard_.num_shards != shard_.shard) {
+            for (int i = 0; i < feature_readers_.size(); i++) {
+                feature_readers_[i]->Next();
+            }
+            continue;
+        }
+        KALDI_VLOG(3) << "Reading " << key;
         // Check all key of feature must be equal
         for (int i = 1; i < feature_readers_.size(); i++) {
-            if (utt != feature_readers_[i]->Key()) {
+            if (key != feature_readers_[i]->Key()) {
                 KALDI_ERR << "all feature not in the same order"
-                          << "[0] " << utt
+                          << "[0] " << key
                           << "[" << i << "] " << feature_readers_[i]->Key();
             }
         }
         bool all_have_target = true;
         for (int i = 0; i < targets_readers_.size(); i++) {
-            if (!targets_readers_[i]->HasKey(utt)) {
-                KALDI_WARN << utt << ", missing targets";
+            if (!targets_readers_[i]->HasKey(key)) {
+                KALDI_WARN << key << ", missing targets";
                 all_have_target = false;
             }
         }
-        // Add to randomizer, check dim
+        // Check dim
         if (all_have_target) {
+            utt->index = index;
             int num_frame = 0;
+            utt->feats.resize(feature_readers_.size());
             for (int i = 0; i < feature_readers_.size(); i++) {
-                Matrix<BaseFloat> mat = feature_readers_[i]->Value();
-                if (0 == i) num_frame = mat.NumRows();
-                else if (mat.NumRows() != num_frame) {
+                utt->feats[i] = feature_readers_[i]->Value();
+                if (0 == i) num_frame = utt->feats[i].NumRows();
+                else if (utt->feats[i].NumRows() != num_frame) {
                     KALDI_ERR << "all feature dim not equal";
                 }
-                feature_randomizers_[i]->AddData(CuMatrix<BaseFloat>(mat));
             }
+            utt->targets.resize(targets_readers_.size());
             for (int i = 0; i < targets_readers_.size(); i++) {
-                Posterior targets = targets_readers_[i]->Value(utt);
-                if (targets.size() != num_frame) {
+                utt->targets[i] = targets_readers_[i]->Value(key);
+                if (utt->targets[i].size() != num_frame) {
                     KALDI_ERR << "feature and target dim must match";
                 }
-                targets_randomizers_[i]->AddData(targets);
             }
         }
         // Add Iter
         for (int i = 0; i < feature_readers_.size(); i++) {
             feature_readers_[i]->Next();
         }
+        if (all_have_target) return true;
+    }
+}
+
+void FrameDataReader::FillRandomizer() {
+    // the utterances before this fill are trained, but for less than one
+    // minibatch of frames which stay in the randomizer
+    bool first = true;
+    while (true) {
+        if (feature_randomizers_[0]->IsFull()) break;
+        FrameDataUtt *utt = prefetcher_->Get();
+        if (utt == NULL) {
+            read_done_ = true;
+            if (first) {
+                // nothing new, the randomizer keeps less than one minibatch
+                position_ = num_keys_;
+                return;
+            }
+            break;
+        }
+        if (first) position_ = utt->index;
+        first = false;
+        // Add to randomizer
+        for (int i = 0; i < feature_randomizers_.size(); i++) {
+            feature_randomizers_[i]->AddData(CuMatrix<BaseFloat>(utt->feats[i]));
+        }
+        for (int i = 0; i < targets_randomizers_.size(); i++) {
+            targets_randomizers_[i]->AddData(utt->targets[i]);
+        }
+        delete utt;
     }
     // Randomize
     const std::vector<int32>& mask = randomizer_mask_.Generate(feature_randomizers_[0]->NumFrames());
@@ -188,24 +238,44 @@ SequenceDataReader::SequenceDataReader(
 	keys_.resize(read_opts_.num_stream);
 	feats_.resize(read_opts_.num_stream);
 	targets_.resize(read_opts_.num_stream);
+	done_ = false;
+	num_valid_frames_ = 0;
+	num_computed_frames_ = 0;
+	// After the readers, it starts reading at once
+	prefetcher_ = new DataPrefetcher<SequenceBatch>(this, read_opts_.prefetch_batches);
+}
 
+SequenceDataReader::~SequenceDataReader(){
+	// Stop the thread before the readers are gone
+	delete prefetcher_;
+	delete feature_reader_;
+	delete target_reader_;
 }
 
-SequenceDataReader::~SequenceDataReader(){}
+bool SequenceDataReader::Done() {
+	return done_;
+}
 
-inline bool SequenceDataReader::Done() {
-	return (read_done_ && feature_reader_->Done());
+bool SequenceDataReader::Produce(SequenceBatch *batch) {
+	// The batch after the one which is done is never asked
+	if (read_done_ && feature_reader_->Done()) return false;
+	AddNewUtt(&batch->new_utt_flags); // add new utterance to multi-streams
+	// fill batch buffer for bptt
+	FillBatchBuff(batch);
+	batch->done = (read_done_ && feature_reader_->Done());
+	return true;
 }
 
-void SequenceDataReader::AddNewUtt() {
+void SequenceDataReader::AddNewUtt(std::vector<int> *new_utt_flags) {
 	
 	int32 num_stream = read_opts_.num_stream;
+	new_utt_flags->resize(num_stream);
 	// loop over all streams, check if any stream reaches the end of its utterance
 	// if any, feed the exhhausted steam with a new utterance, update book-keeping infos
 	for (int s = 0; s < num_stream; s++) {
 		// this stream still has valid frames
 		if (curt_[s] < lent_[s]) {
-			new_utt_flags_[s] = 0;
+			(*new_utt_flags)[s] = 0;
 			continue;
 		}
 		// else, this stream exhausted, need new utterance
@@ -236,43 +306,34 @@ void SequenceDataReader::AddNewUtt() {
 				continue;
 			}
 
-			// Use skip
+			// Use skip, on the host, it runs in the prefetch thread
 			int32 skip_width =  read_opts_.skip_width;
-			CuMatrix<BaseFloat> cu_mat(mat.NumRows(), mat.NumCols());
-			cu_mat.CopyFromMat(mat);
 			if (skip_width > 1) {
-				int skip_len = (cu_mat.NumRows() - 1) / skip_width + 1;
-				CuMatrix<BaseFloat> skip_feat(skip_len, cu_mat.NumCols());
+				int skip_len = (mat.NumRows() - 1) / skip_width + 1;
+				feats_[s].Resize(skip_len, mat.NumCols(), kUndefined);
 				Posterior skip_target(skip_len);
 				for (int i = 0; i < skip_len; i++) {
-					skip_feat.Row(i).CopyFromVec(cu_mat.Row(i * skip_width));
+					feats_[s].Row(i).CopyFromVec(mat.Row(i * skip_width));
 					skip_target[i] = target[i * skip_width];
 				}
-				feats_[s].Resize(skip_feat.NumRows(), skip_feat.NumCols());
-				skip_feat.CopyToMat(&feats_[s]);
 				targets_[s] = skip_target;
 			} else {
-				feats_[s].Resize(cu_mat.NumRows(), cu_mat.NumCols());
-				cu_mat.CopyToMat(&feats_[s]);
+				feats_[s] = mat;
 				targets_[s] = target;
 			}
 			// checks ok, put the data in the buffers,
 			keys_[s] = key;
 			curt_[s] = 0;
 			lent_[s] = feats_[s].NumRows();
-			new_utt_flags_[s] = 1; // a new utterance feeded to this stream
+			(*new_utt_flags)[s] = 1; // a new utterance feeded to this stream
 			feature_reader_->Next();
 			break;
 		}
 	}
 }
 
-void SequenceDataReader::FillBatchBuff(CuMatrix<BaseFloat> *feat,
-									   Posterior *target, 
-									   Vector<BaseFloat> *frame_mask) {
-	KALDI_ASSERT(feat != NULL);
-	KALDI_ASSERT(target != NULL);
-	KALDI_ASSERT(frame_mask != NULL);
+void SequenceDataReader::FillBatchBuff(SequenceBatch *batch) {
+	KALDI_ASSERT(batch != NULL);
 	
 	int32 num_stream = read_opts_.num_stream;
 	int32 batch_size = read_opts_.batch_size;
@@ -293,11 +354,13 @@ void SequenceDataReader::FillBatchBuff(CuMatrix<BaseFloat> *feat,
 	// * target: padded to batch_size
 	// *feat: first shifted to achieve targets delay; then padded to batch_size
 	int32 feat_dim = feats_[0].NumCols();
-	Matrix<BaseFloat> feats(batch_size * num_stream, feat_dim, kSetZero);
-	Posterior &targets = *target;
+	Matrix<BaseFloat> &feats = batch->feat;
+	feats.Resize(batch_size * num_stream, feat_dim, kSetZero);
+	Posterior &targets = batch->target;
 	targets.resize(batch_size * num_stream);
-	Vector<BaseFloat>& mask = *frame_mask;
+	Vector<BaseFloat>& mask = batch->frame_mask;
 	mask.Resize(batch_size * num_stream, kSetZero);
+	batch->has_feat = !read_done_;
 
 	if (!read_done_) {
 		for ( int t = 0; t < batch_size; t++) {
@@ -318,8 +381,6 @@ void SequenceDataReader::FillBatchBuff(CuMatrix<BaseFloat> *feat,
 				curt_[s]++;
 			}
 		}
-	feat->Resize(batch_size * num_stream, feat_dim, kSetZero);
-	feat->CopyFromMat(feats);
 	}
 }
 
@@ -332,11 +393,240 @@ void SequenceDataReader::ReadData(CuMatrix<BaseFloat> *feat,
 
 	if (Done())
 		KALDI_ERR << "Already read done!";
-	else {
-		AddNewUtt(); // add new utterance to multi-streams
-		// fill batch buffer for bptt
-		FillBatchBuff(feat, target, frame_mask);
+	SequenceBatch *batch = prefetcher_->Get();
+	KALDI_ASSERT(batch != NULL);
+	// the device buffer is reused, it keeps its size
+	if (batch->has_feat) {
+		feat->Resize(batch->feat.NumRows(), batch->feat.NumCols(), kUndefined);
+		feat->CopyFromMat(batch->feat);
+		target->swap(batch->target);
+		num_valid_frames_ += batch->frame_mask.Sum();
+		num_computed_frames_ += batch->frame_mask.Dim();
+	} else {
+		// the last batch only clears the mask, as it always did
+		target->resize(batch->target.size());
+	}
+	frame_mask->Swap(&batch->frame_mask);
+	new_utt_flags_.swap(batch->new_utt_flags);
+	done_ = batch->done;
+	delete batch;
+}
+
+BucketDataReader::BucketDataReader(
+							const std::string &feature_rspecifier,
+							const std::string &targets_rspecifier,
+							const SequenceDataReaderOptions &read_opts,
+							const std::string &weights_rspecifier):
+		num_valid_frames_(0), num_computed_frames_(0), weights_reader_(NULL),
+		read_opts_(read_opts), next_group_(0), num_no_target_(0),
+		num_other_error_(0) {
+	feature_reader_ = new SequentialBaseFloatMatrixReader(feature_rspecifier);
+	target_reader_ = new RandomAccessPosteriorReader(targets_rspecifier);
+	if (weights_rspecifier != "") {
+		weights_reader_ = new RandomAccessBaseFloatVectorReader(weights_rspecifier);
+	}
+	// fixed, the batch order is the same in every run
+	rand_state_.seed = 777;
+	// After the readers, it starts reading at once
+	prefetcher_ = new DataPrefetcher<SequenceUttBatch>(this, read_opts_.prefetch_batches);
+}
+
+BucketDataReader::~BucketDataReader() {
+	// Stop the thread before the readers are gone
+	delete prefetcher_;
+	delete feature_reader_;
+	delete target_reader_;
+	delete weights_reader_;
+}
+
+void BucketDataReader::FillBucket() {
+	// the utterances of the unfinished last batch go to the new bucket
+	std::vector<std::string> keys(carry_.size());
+	std::vector<Matrix<BaseFloat> > feats(carry_.size());
+	std::vector<Posterior> targets(carry_.size());
+	std::vector<Vector<BaseFloat> > weights(carry_.size());
+	for (int i = 0; i < carry_.size(); i++) {
+		keys[i] = bucket_keys_[carry_[i]];
+		feats[i].Swap(&bucket_feats_[carry_[i]]);
+		targets[i].swap(bucket_targets_[carry_[i]]);
+		weights[i].Swap(&bucket_weights_[carry_[i]]);
 	}
+	bucket_keys_.swap(keys);
+	bucket_feats_.swap(feats);
+	bucket_targets_.swap(targets);
+	bucket_weights_.swap(weights);
+	carry_.clear();
+
+	int32 bucket_size = std::max(read_opts_.bucket_size, read_opts_.num_stream);
+	for (; bucket_keys_.size() < bucket_size && !feature_reader_->Done(); feature_reader_->Next()) {
+		std::string key = feature_reader_->Key();
+		if (!target_reader_->HasKey(key)) {
+			KALDI_WARN << key << ", missing targets";
+			num_no_target_++;
+			continue;
+		}
+		const Matrix<BaseFloat> &raw_mat = feature_reader_->Value();
+		if (read_opts_.drop_len > 0 && raw_mat.NumRows() > read_opts_.drop_len) {
+			KALDI_WARN << key << ", too long, droped";
+			continue;
+		}
+		const Posterior &raw_target = target_reader_->Value(key);
+		Matrix<BaseFloat> mat;
+		Posterior target;
+		int32 skip_width = read_opts_.skip_width;
+		if (skip_width > 1) {
+			int skip_len = (raw_mat.NumRows() + skip_width - 1) / skip_width;
+			mat.Resize(skip_len, raw_mat.NumCols(), kUndefined);
+			for (int i = 0; i < skip_len; i++) {
+				mat.Row(i).CopyFromVec(raw_mat.Row(i * skip_width));
+			}
+			target.resize((raw_target.size() + skip_width - 1) / skip_width);
+			for (int i = 0; i < target.size(); i++) {
+				target[i] = raw_target[i * skip_width];
+			}
+		} else {
+			mat = raw_mat;
+			target = raw_target;
+		}
+		// the weights are not skipped, as the trainer always did; a missing
+		// key is an error(Value())
+		Vector<BaseFloat> weight;
+		if (weights_reader_ != NULL) {
+			weight = weights_reader_->Value(key);
+		}
+		// correct small length mismatch ... or drop sentence
+		int32 min_len = std::min<int32>(mat.NumRows(), target.size()),
+			  max_len = std::max<int32>(mat.NumRows(), target.size());
+		if (weights_reader_ != NULL) {
+			min_len = std::min(min_len, weight.Dim());
+			max_len = std::max(max_len, weight.Dim());
+		}
+		if (max_len - min_len >= read_opts_.length_tolerance) {
+			KALDI_WARN << key << ", length mismatch of targets " << target.size()
+					   << " and features " << mat.NumRows();
+			num_other_error_++;
+			continue;
+		}
+		if (mat.NumRows() != min_len) mat.Resize(min_len, mat.NumCols(), kCopyData);
+		if (target.size() != min_len) target.resize(min_len);
+		if (weights_reader_ != NULL && weight.Dim() != min_len) {
+			weight.Resize(min_len, kCopyData);
+		}
+		if (min_len == 0) {
+			KALDI_WARN << key << ", empty, skip";
+			num_other_error_++;
+			continue;
+		}
+		bucket_keys_.push_back(key);
+		bucket_feats_.push_back(Matrix<BaseFloat>());
+		bucket_feats_.back().Swap(&mat);
+		bucket_targets_.push_back(Posterior());
+		bucket_targets_.back().swap(target);
+		bucket_weights_.push_back(Vector<BaseFloat>());
+		bucket_weights_.back().Swap(&weight);
+	}
+
+	// sorted by length, the equal ones stay in archive order
+	int32 num_utt = bucket_keys_.size();
+	std::vector<std::pair<int32, int32> > order(num_utt);
+	for (int i = 0; i < num_utt; i++) {
+		order[i].first = (read_opts_.bucket_size > 1) ? bucket_feats_[i].NumRows() : 0;
+		order[i].second = i;
+	}
+	std::sort(order.begin(), order.end());
+
+	// pack the streams like the whole utterance trainers always did, up to
+	// num_stream utterances or frame_limit frames with the padding
+	groups_.clear();
+	next_group_ = 0;
+	std::vector<int32> group;
+	int32 max_frame_num = 0;
+	for (int i = 0; i < num_utt; i++) {
+		int32 u = order[i].second;
+		group.push_back(u);
+		max_frame_num = std::max(max_frame_num, bucket_feats_[u].NumRows());
+		if (group.size() == read_opts_.num_stream ||
+			group.size() * max_frame_num > read_opts_.frame_limit) {
+			groups_.push_back(group);
+			group.clear();
+			max_frame_num = 0;
+		}
+	}
+	if (feature_reader_->Done()) {
+		if (!group.empty()) groups_.push_back(group);
+	} else {
+		carry_ = group;
+	}
+
+	if (read_opts_.bucket_size > 1) {
+		for (int i = groups_.size() - 1; i > 0; i--) {
+			std::swap(groups_[i], groups_[RandInt(0, i, &rand_state_)]);
+		}
+	}
+}
+
+bool BucketDataReader::Produce(SequenceUttBatch *batch) {
+	while (next_group_ == groups_.size()) {
+		if (feature_reader_->Done() && carry_.empty()) return false;
+		FillBucket();
+	}
+	const std::vector<int32> &group = groups_[next_group_++];
+	int32 num_seq = group.size(), max_frame_num = 0;
+	for (int s = 0; s < num_seq; s++) {
+		max_frame_num = std::max(max_frame_num, bucket_feats_[group[s]].NumRows());
+	}
+	int32 feat_dim = bucket_feats_[group[0]].NumCols();
+	// Every utterance is padded to the longest, frame t of stream s is
+	// row t * num_seq + s
+	batch->feat.Resize(num_seq * max_frame_num, feat_dim, kSetZero);
+	batch->target.clear();
+	batch->target.resize(num_seq * max_frame_num);
+	batch->frame_mask.Resize(num_seq * max_frame_num, kSetZero);
+	batch->lengths.resize(num_seq);
+	batch->keys.resize(num_seq);
+	for (int s = 0; s < num_seq; s++) {
+		int32 u = group[s];
+		const Matrix<BaseFloat> &mat = bucket_feats_[u];
+		if (mat.NumCols() != feat_dim) {
+			KALDI_ERR << bucket_keys_[u] << ", feature dim " << mat.NumCols()
+					  << " differs from " << feat_dim;
+		}
+		for (int t = 0; t < mat.NumRows(); t++) {
+			batch->feat.Row(t * num_seq + s).CopyFromVec(mat.Row(t));
+			batch->target[t * num_seq + s].swap(bucket_targets_[u][t]);
+			batch->frame_mask(t * num_seq + s) =
+				(weights_reader_ != NULL) ? bucket_weights_[u](t) : 1;
+		}
+		batch->lengths[s] = mat.NumRows();
+		batch->keys[s] = bucket_keys_[u];
+		// the utterance is used up
+		bucket_feats_[u].Resize(0, 0);
+		Posterior().swap(bucket_targets_[u]);
+		bucket_weights_[u].Resize(0);
+	}
+	return true;
+}
+
+bool BucketDataReader::ReadData(CuMatrix<BaseFloat> *feat,
+								Posterior *target,
+								Vector<BaseFloat> *frame_mask) {
+	KALDI_ASSERT(feat != NULL);
+	KALDI_ASSERT(target != NULL);
+	KALDI_ASSERT(frame_mask != NULL);
+	SequenceUttBatch *batch = prefetcher_->Get();
+	if (batch == NULL) return false;
+	// the device buffer is reused, it keeps its size
+	feat->Resize(batch->feat.NumRows(), batch->feat.NumCols(), kUndefined);
+	feat->CopyFromMat(batch->feat);
+	target->swap(batch->target);
+	frame_mask->Swap(&batch->frame_mask);
+	lengths_.swap(batch->lengths);
+	keys_.swap(batch->keys);
+	// not the mask sum, it holds the frame weights
+	for (int s = 0; s < lengths_.size(); s++) num_valid_frames_ += lengths_[s];
+	num_computed_frames_ += frame_mask->Dim();
+	delete batch;
+	return true;
 }
 
 } // namespace aslp_nnet
@@ -17,25 +17,59 @@
 
 #include "aslp-nnet/nnet-trnopts.h"
 #include "aslp-nnet/nnet-randomizer.h"
+#include "aslp-nnet/data-prefetcher.h"
 
 namespace kaldi {
 namespace aslp_nnet {
 
-class FrameDataReader {
+// The features and targets of one utterance, read in the background
+struct FrameDataUtt {
+    std::vector<Matrix<BaseFloat> > feats;
+    std::vector<Posterior> targets;
+    int64 index; // in the feature list
+};
+
+/// The part of the feature list one of the parallel workers trains on: the
+/// first skip utterances are skipped(already trained before a restart), then
+/// the worker takes every num_shards-th utterance from shard on
+struct DataShard {
+    int shard, num_shards;
+    int64 skip;
+    DataShard(): shard(0), num_shards(1), skip(0) {}
+    DataShard(int s, int n, int64 k): shard(s), num_shards(n), skip(k) {
+        KALDI_ASSERT(n >= 1 && s >= 0 && s < n && k >= 0);
+    }
+};
+
+/// The archives are read by a background thread(--prefetch-utts
+/// utterances ahead), the training thread only fills the randomizers
+class FrameDataReader: private DataProducer<FrameDataUtt> {
 public:
     FrameDataReader(const std::vector<std::string> &feature_rspecifiers,
                     const std::vector<std::string> &targets_rspecifiers,
-                    const NnetDataRandomizerOptions &rand_opts);
+                    const NnetDataRandomizerOptions &rand_opts,
+                    const DataShard &shard = DataShard());
     FrameDataReader(const std::string &feature_rspecifier, 
                     const std::string &targets_rspecifier,
-                    const NnetDataRandomizerOptions &rand_opts);
+                    const NnetDataRandomizerOptions &rand_opts,
+                    const DataShard &shard = DataShard());
     ~FrameDataReader();
     bool ReadData(const CuMatrixBase<BaseFloat> **feat, const Posterior **targets); 
     void ReadData(std::vector<const CuMatrixBase<BaseFloat > *> *input, 
                   std::vector<const Posterior *> *output); 
     bool Done();
+    /// Seconds the training waited for the data
+    double StallTime() const { return prefetcher_->StallTime(); }
+    /// Index in the feature list of the first utterance which is not fully
+    /// trained yet, the ones of the randomizer being trained on and after,
+    /// all of the list once Done(). For the checkpoints, a restart skips
+    /// them(DataShard::skip).
+    int64 Position();
 private:
     void FillRandomizer(); 
+    /// Reads the next utterance with all the targets, in the prefetch thread
+    virtual bool Produce(FrameDataUtt *utt);
+    DataPrefetcher<FrameDataUtt> *prefetcher_;
     std::vector<SequentialBaseFloatMatrixReader *> feature_readers_;
     std::vector<RandomAccessPosteriorReader *> targets_readers_;
     RandomizerMask randomizer_mask_;
@@ -44,6 +78,9 @@ private:
     int num_input_, num_output_;
     const NnetDataRandomizerOptions &rand_opts_;
     bool read_done_;
+    DataShard shard_;
+    int64 num_keys_; // keys passed in the feature list, in the prefetch thread
+    int64 position_;
 };
 
 struct SequenceDataReaderOptions {
@@ -54,10 +91,12 @@ struct SequenceDataReaderOptions {
 	int32 targets_delay; // --LSTM-- BPTT targets delay
 	int32 length_tolerance; // Allowed length difference of features/targets (frames), for the whole utterance training
 	double frame_limit; // Max number of frames to be processed for whole utterance training
+	int32 prefetch_batches; // Batches made ahead by the background thread
+	int32 bucket_size; // Utterances sorted by length together, for the whole utterance training
 
     SequenceDataReaderOptions(): batch_size(20), num_stream(100), drop_len(0),
 								 skip_width(1), targets_delay(5), length_tolerance(5),
-								 frame_limit(100000){}
+								 frame_limit(100000), prefetch_batches(4), bucket_size(1){}
     void Register(OptionsItf *opts) {
 		opts->Register("batch-size", &batch_size, "--LSTM-- BPTT batch_size");
 		opts->Register("num-stream", &num_stream, "--LSTM-- BPTT multistream training");
@@ -68,10 +107,27 @@ struct SequenceDataReaderOptions {
 		opts->Register("length-tolerance", &length_tolerance, "Allowed length difference of features/targets (frames),"
 															  "for the whole utterance training");
 		opts->Register("frame-limit", &frame_limit, "Max number of frames to be processed for whole utterance training");
+		opts->Register("prefetch-batches", &prefetch_batches, "Number of batches the background thread reads and "
+															  "makes ahead of the training(0, read in the training thread)");
+		opts->Register("bucket-size", &bucket_size, "Number of utterances sorted by length and packed into the streams "
+												    "together, for the whole utterance training(1, archive order), e.g. 200");
     }
 };
 
-class SequenceDataReader {
+// One multi-stream batch made in the background
+struct SequenceBatch {
+	Matrix<BaseFloat> feat;
+	bool has_feat;  // false for the last, empty batch
+	Posterior target;
+	Vector<BaseFloat> frame_mask;
+	std::vector<int> new_utt_flags;
+	bool done;  // Done() after this batch
+};
+
+/// The utterances are read and the batches are made by a background
+/// thread(--prefetch-batches ahead), the training thread only copies them to
+/// the reused device buffer
+class SequenceDataReader: private DataProducer<SequenceBatch> {
 public:
     SequenceDataReader(const std::string &feature_rspecifier, 
                        const std::string &targets_rspecifier,
@@ -82,12 +138,25 @@ public:
 	const std::vector<int>& GetNewUttFlags () const {
 		return new_utt_flags_;
 	}
+	/// Seconds the training waited for the data
+	double StallTime() const { return prefetcher_->StallTime(); }
+	/// Valid frames / computed frames of the batches taken
+	double PaddingEfficiency() const {
+		return num_computed_frames_ > 0 ? num_valid_frames_ / num_computed_frames_ : 1.0;
+	}
 
 private:
-	void AddNewUtt();
-	void FillBatchBuff(CuMatrix<BaseFloat> *feat, Posterior *target, Vector<BaseFloat> *frame_mask);
+	// These run in the prefetch thread
+	virtual bool Produce(SequenceBatch *batch);
+	void AddNewUtt(std::vector<int> *new_utt_flags);
+	void FillBatchBuff(SequenceBatch *batch);
 
 private:
+	DataPrefetcher<SequenceBatch> *prefetcher_;
+	bool done_;  // of the batches taken
+	std::vector<int> new_utt_flags_;  // of the last batch taken
+	double num_valid_frames_, num_computed_frames_;
+	// The reading state, only used by the prefetch thread
     SequentialBaseFloatMatrixReader *feature_reader_;
     RandomAccessPosteriorReader *target_reader_;
     const SequenceDataReaderOptions &read_opts_;
@@ -97,7 +166,70 @@ private:
 	std::vector<Posterior> targets_;
 	std::vector<int> curt_;
 	std::vector<int> lent_;
-	std::vector<int> new_utt_flags_;
+};
+
+// A batch of whole utterances, each in one stream
+struct SequenceUttBatch {
+    Matrix<BaseFloat> feat;  // frame interleaved, padded to the longest
+    Posterior target;
+    Vector<BaseFloat> frame_mask;
+    std::vector<int32> lengths;
+    std::vector<std::string> keys;
+};
+
+/// Whole utterance multi-stream batches for the BLSTM training. It reads
+/// --bucket-size utterances at a time, sorts them by length and packs the
+/// utterances of similar length into a batch(--num-stream, --frame-limit),
+/// so few padded frames are computed. The order of the batches of a bucket
+/// is shuffled, the short utterances do not all come first. The frame mask
+/// holds the per-frame weights if weights_rspecifier is not empty, they are
+/// checked and cut to length with the targets, a missing key is an error.
+class BucketDataReader: private DataProducer<SequenceUttBatch> {
+public:
+    BucketDataReader(const std::string &feature_rspecifier,
+                     const std::string &targets_rspecifier,
+                     const SequenceDataReaderOptions &read_opts,
+                     const std::string &weights_rspecifier = "");
+    ~BucketDataReader();
+    /// The next batch, false at the end of the data
+    bool ReadData(CuMatrix<BaseFloat> *feat, Posterior *target, Vector<BaseFloat> *frame_mask);
+    /// Of the last batch, per stream
+    const std::vector<int32>& GetSeqLengths() const { return lengths_; }
+    const std::vector<std::string>& GetKeys() const { return keys_; }
+    /// Seconds the training waited for the data
+    double StallTime() const { return prefetcher_->StallTime(); }
+    /// Valid frames / computed frames of the batches taken
+    double PaddingEfficiency() const {
+        return num_computed_frames_ > 0 ? num_valid_frames_ / num_computed_frames_ : 1.0;
+    }
+    /// Utterances skipped, valid after the end of the data
+    int32 NumNoTarget() const { return num_no_target_; }
+    int32 NumOtherError() const { return num_other_error_; }
+
+private:
+    // These run in the prefetch thread
+    virtual bool Produce(SequenceUttBatch *batch);
+    void FillBucket();
+
+private:
+    DataPrefetcher<SequenceUttBatch> *prefetcher_;
+    std::vector<int32> lengths_;  // of the last batch taken
+    std::vector<std::string> keys_;
+    double num_valid_frames_, num_computed_frames_;
+    // The reading state, only used by the prefetch thread
+    SequentialBaseFloatMatrixReader *feature_reader_;
+    RandomAccessPosteriorReader *target_reader_;
+    RandomAccessBaseFloatVectorReader *weights_reader_;  // NULL for weight 1
+    const SequenceDataReaderOptions &read_opts_;
+    std::vector<std::string> bucket_keys_;
+    std::vector<Matrix<BaseFloat> > bucket_feats_;
+    std::vector<Posterior> bucket_targets_;
+    std::vector<Vector<BaseFloat> > bucket_weights_;
+    std::vector<std::vector<int32> > groups_;  // utterances of the batches, in the bucket
+    int32 next_group_;
+    std::vector<int32> carry_;  // of the unfinished last batch
+    RandomState rand_state_;
+    int32 num_no_target_, num_other_error_;
 };
 
 } // namespace aslp_nnet
@@ -28,6 +28,7 @@
 
 #include "aslp-nnet/nnet-component.h"
 #include "aslp-nnet/nnet-utils.h"
+#include "aslp-nnet/nnet-approx-activation.h"
 
 namespace kaldi {
 namespace aslp_nnet {
@@ -163,7 +164,8 @@ class Sigmoid : public Component {
 
   void PropagateFnc(const CuMatrixBase<BaseFloat> &in, CuMatrixBase<BaseFloat> *out) {
     // y = 1/(1+e^-x)
-    out->Sigmoid(in);
+    if (approx_activation_) ApproxSigmoid(in, out);
+    else out->Sigmoid(in);
   }
 
   void BackpropagateFnc(const CuMatrixBase<BaseFloat> &in, const CuMatrixBase<BaseFloat> &out,
@@ -188,7 +190,8 @@ class Tanh : public Component {
 
   void PropagateFnc(const CuMatrixBase<BaseFloat> &in, CuMatrixBase<BaseFloat> *out) {
     // y = (e^x - e^(-x)) / (e^x + e^(-x))
-    out->Tanh(in);
+    if (approx_activation_) ApproxTanh(in, out);
+    else out->Tanh(in);
   }
 
   void BackpropagateFnc(const CuMatrixBase<BaseFloat> &in, const CuMatrixBase<BaseFloat> &out,
@@ -27,6 +27,7 @@
 
 #include "aslp-nnet/nnet-component.h"
 #include "aslp-nnet/nnet-utils.h"
+#include "aslp-nnet/nnet-quantize.h"
 
 namespace kaldi {
 namespace aslp_nnet {
@@ -127,18 +128,33 @@ class AffineTransform : public UpdatableComponent {
       ExpectToken(is, binary, "<MaxNorm>");
       ReadBasicType(is, binary, &max_norm_);
     }
-    // for compartible with some version
+    // for compartible with some version, or int8 weights
+    bool quantized = false;
     if ('<' == Peek(is, binary)) {
-      float tmp;
-      ExpectToken(is, binary, "<ClipGradient>");
-      ReadBasicType(is, binary, &tmp);
+      std::string token;
+      ReadToken(is, binary, &token);
+      if (token == "<ClipGradient>") {
+        float tmp;
+        ReadBasicType(is, binary, &tmp);
+      } else if (token == "<Quantized>") {
+        quantized = true;
+      } else {
+        KALDI_ERR << "Unknown token " << token << " (ClipGradient|Quantized)";
+      }
     }
     // weights
-    linearity_.Read(is, binary);
+    if (quantized) {
+      linearity_int8_.Read(is, binary);
+      linearity_.Resize(0, 0);
+      linearity_corr_.Resize(0, 0);
+      bias_corr_.Resize(0);
+    } else {
+      linearity_.Read(is, binary);
+    }
     bias_.Read(is, binary);
 
-    KALDI_ASSERT(linearity_.NumRows() == output_dim_);
-    KALDI_ASSERT(linearity_.NumCols() == input_dim_);
+    KALDI_ASSERT(LinearityRows() == output_dim_);
+    KALDI_ASSERT(LinearityCols() == input_dim_);
     KALDI_ASSERT(bias_.Dim() == output_dim_);
   }
 
@@ -150,26 +166,49 @@ class AffineTransform : public UpdatableComponent {
     WriteToken(os, binary, "<MaxNorm>");
     WriteBasicType(os, binary, max_norm_);
     // weights
-    linearity_.Write(os, binary);
+    if (IsQuantized()) {
+      WriteToken(os, binary, "<Quantized>");
+      linearity_int8_.Write(os, binary);
+    } else {
+      linearity_.Write(os, binary);
+    }
     bias_.Write(os, binary);
   }
 
-  int32 NumParams() const { return linearity_.NumRows()*linearity_.NumCols() + bias_.Dim(); }
+  int32 NumParams() const { return LinearityRows()*LinearityCols() + bias_.Dim(); }
+
+  int64 ParamBytes() const {
+    if (!IsQuantized()) return UpdatableComponent::ParamBytes();
+    return linearity_int8_.SizeInBytes() + bias_.Dim() * sizeof(BaseFloat);
+  }
   
   void GetParams(Vector<BaseFloat>* wei_copy) const {
     wei_copy->Resize(NumParams());
-    int32 linearity_num_elem = linearity_.NumRows() * linearity_.NumCols(); 
-    wei_copy->Range(0,linearity_num_elem).CopyRowsFromMat(Matrix<BaseFloat>(linearity_));
+    int32 linearity_num_elem = LinearityRows() * LinearityCols(); 
+    if (IsQuantized()) {
+      Matrix<BaseFloat> mat;
+      linearity_int8_.Dequantize(&mat);
+      wei_copy->Range(0,linearity_num_elem).CopyRowsFromMat(mat);
+    } else {
+      wei_copy->Range(0,linearity_num_elem).CopyRowsFromMat(Matrix<BaseFloat>(linearity_));
+    }
     wei_copy->Range(linearity_num_elem, bias_.Dim()).CopyFromVec(Vector<BaseFloat>(bias_));
   }
 
   void GetGpuParams(std::vector<std::pair<BaseFloat *, int> > *params) {
+    CheckNotQuantized();
     params->clear();
     params->push_back(std::make_pair(linearity_.Data(), linearity_.NumRows() * linearity_.Stride()));
     params->push_back(std::make_pair(bias_.Data(), bias_.Dim()));
   }
   
   std::string Info() const {
+    if (IsQuantized()) {
+      Matrix<BaseFloat> mat;
+      linearity_int8_.Dequantize(&mat);
+      return std::string("\n  linearity(int8)") + MomentStatistics(CuMatrix<BaseFloat>(mat)) +
+             "\n  bias" + MomentStatistics(bias_);
+    }
     return std::string("\n  linearity") + MomentStatistics(linearity_) +
            "\n  bias" + MomentStatistics(bias_);
   }
@@ -187,17 +226,23 @@ class AffineTransform : public UpdatableComponent {
     // precopy bias
     out->AddVecToRows(1.0, bias_, 0.0);
     // multiply by weights^t
-    out->AddMatMat(1.0, in, kNoTrans, linearity_, kTrans, 1.0);
+    if (IsQuantized()) {
+      AddMatQuantizedMat(1.0, in, linearity_int8_, 1.0, out);
+    } else {
+      out->AddMatMat(1.0, in, kNoTrans, linearity_, kTrans, 1.0);
+    }
   }
 
   void BackpropagateFnc(const CuMatrixBase<BaseFloat> &in, const CuMatrixBase<BaseFloat> &out,
                         const CuMatrixBase<BaseFloat> &out_diff, CuMatrixBase<BaseFloat> *in_diff) {
+    CheckNotQuantized();
     // multiply error derivative by weights
     in_diff->AddMatMat(1.0, out_diff, kNoTrans, linearity_, kNoTrans, 0.0);
   }
 
 
   void Update(const CuMatrixBase<BaseFloat> &input, const CuMatrixBase<BaseFloat> &diff) {
+    CheckNotQuantized();
     // we use following hyperparameters from the option class
     const BaseFloat lr = opts_.learn_rate * learn_rate_coef_;
     const BaseFloat lr_bias = opts_.learn_rate * bias_learn_rate_coef_;
@@ -255,10 +300,12 @@ class AffineTransform : public UpdatableComponent {
   }
 
   const CuMatrixBase<BaseFloat>& GetLinearity() const {
+    CheckNotQuantized();
     return linearity_;
   }
 
   void SetLinearity(const CuMatrixBase<BaseFloat>& linearity) {
+    CheckNotQuantized();
     KALDI_ASSERT(linearity.NumRows() == linearity_.NumRows());
     KALDI_ASSERT(linearity.NumCols() == linearity_.NumCols());
     linearity_.CopyFromMat(linearity);
@@ -272,10 +319,34 @@ class AffineTransform : public UpdatableComponent {
     return linearity_corr_;
   }
 
+  /// Switch the weights to int8(see nnet-quantize.h), for inference only,
+  /// the float weights and the training buffers are freed
+  void Quantize() {
+    if (IsQuantized()) return;
+    linearity_int8_.Quantize(linearity_);
+    linearity_.Resize(0, 0);
+    linearity_corr_.Resize(0, 0);
+    bias_corr_.Resize(0);
+  }
+
+  bool IsQuantized() const { return linearity_int8_.NumRows() > 0; }
+
 
  private:
+  int32 LinearityRows() const {
+    return IsQuantized() ? linearity_int8_.NumRows() : linearity_.NumRows();
+  }
+  int32 LinearityCols() const {
+    return IsQuantized() ? linearity_int8_.NumCols() : linearity_.NumCols();
+  }
+  void CheckNotQuantized() const {
+    if (IsQuantized()) KALDI_ERR << "The int8 AffineTransform is for inference only";
+  }
+
   CuMatrix<BaseFloat> linearity_;
   CuVector<BaseFloat> bias_;
+  // int8 weights replacing linearity_ once quantized
+  QuantizedMatrix linearity_int8_;
 
   CuMatrix<BaseFloat> linearity_corr_;
   CuVector<BaseFloat> bias_corr_;
@@ -0,0 +1,70 @@
+// aslp-nnet/nnet-approx-activation.cc
+
+#include "aslp-nnet/nnet-approx-activation.h"
+#include "aslp-nnet/nnet-simd-math.h"
+
+namespace kaldi {
+namespace aslp_nnet {
+
+template<bool kSigmoid, typename Real>
+static void ApproxRowScalar(int32 begin, int32 end, const Real *in, Real *out) {
+    for (int32 j = begin; j < end; j++) {
+        out[j] = kSigmoid ? ScalarFastSigmoid(in[j]) : ScalarFastTanh(in[j]);
+    }
+}
+
+#ifdef ASLP_NNET_HAVE_AVX2
+template<bool kSigmoid>
+ASLP_TARGET_AVX2
+static void ApproxRowAvx2(int32 dim, const float *in, float *out) {
+    int32 j = 0;
+    for (; j + 8 <= dim; j += 8) {
+        __m256 x = _mm256_loadu_ps(in + j);
+        _mm256_storeu_ps(out + j, kSigmoid ? FastSigmoid256(x) : FastTanh256(x));
+    }
+    ApproxRowScalar<kSigmoid>(j, dim, in, out);
+}
+#endif
+
+template<bool kSigmoid>
+static inline void ApproxRow(int32 dim, const float *in, float *out) {
+#ifdef ASLP_NNET_HAVE_AVX2
+    if (CpuHasAvx2()) {
+        ApproxRowAvx2<kSigmoid>(dim, in, out);
+        return;
+    }
+#endif
+    ApproxRowScalar<kSigmoid>(0, dim, in, out);
+}
+
+template<bool kSigmoid>
+static inline void ApproxRow(int32 dim, const double *in, double *out) {
+    ApproxRowScalar<kSigmoid>(0, dim, in, out);
+}
+
+template<bool kSigmoid>
+static void ApproxActivation(const CuMatrixBase<BaseFloat> &in,
+                             CuMatrixBase<BaseFloat> *out) {
+    KALDI_ASSERT(SameDim(in, *out));
+#if HAVE_CUDA == 1
+    if (CuDevice::Instantiate().Enabled()) {
+        if (kSigmoid) out->Sigmoid(in);
+        else out->Tanh(in);
+        return;
+    }
+#endif
+    for (int32 r = 0; r < in.NumRows(); r++) {
+        ApproxRow<kSigmoid>(in.NumCols(), in.RowData(r), out->RowData(r));
+    }
+}
+
+void ApproxSigmoid(const CuMatrixBase<BaseFloat> &in, CuMatrixBase<BaseFloat> *out) {
+    ApproxActivation<true>(in, out);
+}
+
+void ApproxTanh(const CuMatrixBase<BaseFloat> &in, CuMatrixBase<BaseFloat> *out) {
+    ApproxActivation<false>(in, out);
+}
+
+} // namespace aslp_nnet
+} // namespace kaldi
@@ -0,0 +1,41 @@
+// aslp-nnet/nnet-approx-activation.h
+
+/* Fast approximate sigmoid/tanh for CPU inference
+ *
+ * The exact CuMatrixBase::Sigmoid()/Tanh() call exp() per element on CPU,
+ * which dominates the forward time of the lstm models. ApproxSigmoid() and
+ * ApproxTanh() use a rational approximation of tanh(no exp, AVX2 when the
+ * cpu supports it), with the max absolute error on the whole float range
+ * 4e-7 for tanh and 2.5e-7 for sigmoid(the exact float ops are within
+ * 1e-7), which is far below what changes the decoding result, but they are not
+ * bit exact, so the mode is opt-in(Nnet::SetApproxActivation(), or
+ * --approx-activation of aslp-nnet-forward) and only for the forward pass.
+ * Use aslp-nnet-approx-check to check the posterior divergence and speed
+ * on real data. On GPU they are the exact ops.
+ */
+
+#ifndef ASLP_NNET_NNET_APPROX_ACTIVATION_H_
+#define ASLP_NNET_NNET_APPROX_ACTIVATION_H_
+
+#include "aslp-cudamatrix/cu-device.h"
+#include "aslp-cudamatrix/cu-matrix.h"
+
+namespace kaldi {
+namespace aslp_nnet {
+
+// Measured against the double precision functions over [-20, 20] with
+// step 1e-4, beyond which both saturate: AVX2 2.6e-7(tanh) 1.5e-7(sigmoid),
+// scalar 3.7e-7 2.0e-7
+const BaseFloat kApproxTanhMaxError = 4e-7;
+const BaseFloat kApproxSigmoidMaxError = 2.5e-7;
+
+// out = sigmoid(in), out may be the same matrix as in
+void ApproxSigmoid(const CuMatrixBase<BaseFloat> &in, CuMatrixBase<BaseFloat> *out);
+
+// out = tanh(in), out may be the same matrix as in
+void ApproxTanh(const CuMatrixBase<BaseFloat> &in, CuMatrixBase<BaseFloat> *out);
+
+} // namespace aslp_nnet
+} // namespace kaldi
+
+#endif
@@ -37,7 +37,10 @@ class CompactFsmn : public UpdatableComponent {
 	  : UpdatableComponent(dim_in, dim_out),
 	    max_frames_(3000),
 		learn_rate_coef_(1.0),
-		clip_gradient_(0.0)
+		clip_gradient_(0.0),
+		streaming_(false),
+		upstream_delay_(0),
+		num_streams_(0)
 	  { }
 	~CompactFsmn()
 	{ }
@@ -128,6 +131,57 @@ class CompactFsmn : public UpdatableComponent {
 		max_frames_ = max_len;
 	}
 
+	/// Streaming inference for online decoding. Instead of zero padding every
+	/// chunk, the last past_context + future_context + 1 input frames of every
+	/// stream are kept in a ring buffer, so the memory crosses the chunks and
+	/// does not grow with them. Output row i of a stream is the output of
+	/// frame i - future_context - upstream_delay, upstream_delay being the
+	/// latency of the streaming FSMN layers before this one(see
+	/// Nnet::SetFsmnStreaming()), the rows before frame 0 are zero. Once the
+	/// end of the stream is set(SetStreamEnd()), the following input rows are
+	/// taken as the zero padding, so feeding the delay more rows flushes the
+	/// last frames and the output is the same as the whole utterance forward.
+	/// The streams are interleaved like in LstmProjectedStreams(row t * S + s),
+	/// CPU only, no backprop.
+	void SetStreaming(bool streaming, int32 upstream_delay) {
+		streaming_ = streaming;
+		upstream_delay_ = upstream_delay;
+		num_streams_ = 0;
+	}
+
+	bool IsStreaming() const { return streaming_; }
+
+	int32 FutureContext() const { return future_context_; }
+
+	/// Clear the memory of the streams with stream_reset_flag[s] == 1, all of
+	/// them when the number of streams changes
+	void ResetStreams(const std::vector<int32> &stream_reset_flag) {
+		if (!streaming_) return;
+		int32 C = vec_coef_.NumRows();
+		if (num_streams_ != static_cast<int32>(stream_reset_flag.size())) {
+			num_streams_ = stream_reset_flag.size();
+			history_.Resize(num_streams_ * C, input_dim_);
+			num_received_.assign(num_streams_, 0);
+			end_frame_.assign(num_streams_, -1);
+			return;
+		}
+		for (int32 s = 0; s < num_streams_; s++) {
+			if (stream_reset_flag[s] == 1) {
+				history_.RowRange(s * C, C).SetZero();
+				num_received_[s] = 0;
+				end_frame_[s] = -1;
+			}
+		}
+	}
+
+	/// Number of frames of every stream, -1 for the streams still going on
+	void SetStreamEnd(const std::vector<int32> &num_frames) {
+		KALDI_ASSERT(streaming_);
+		if (num_streams_ == 0) ResetStreams(std::vector<int32>(num_frames.size(), 1));
+		KALDI_ASSERT(static_cast<int32>(num_frames.size()) == num_streams_);
+		end_frame_ = num_frames;
+	}
+
 	void GetParams(Vector<BaseFloat>* wei_copy) const {
 		wei_copy->Resize(NumParams());
 		wei_copy->CopyRowsFromMat(Matrix<BaseFloat>(vec_coef_));
@@ -166,7 +220,52 @@ class CompactFsmn : public UpdatableComponent {
 		real_data.CopyFromMat(mat);
 	}
 
+	// out[t] = in[t] + sum_c vec_coef[c] .* in[t - past_context + c], a direct
+	// sliding dot product over the ring buffer, no T * C temporary
+	void PropagateStreaming(const CuMatrixBase<BaseFloat> &in, CuMatrixBase<BaseFloat> *out) {
+#if HAVE_CUDA == 1
+		if (CuDevice::Instantiate().Enabled()) {
+			KALDI_ERR << "Streaming CompactFsmn is CPU only";
+		}
+#endif
+		// one stream by default, as LstmProjectedStreams does
+		if (num_streams_ == 0) ResetStreams(std::vector<int32>(1, 1));
+		int32 S = num_streams_, D = input_dim_, C = vec_coef_.NumRows();
+		KALDI_ASSERT(in.NumRows() % S == 0);
+		const MatrixBase<BaseFloat> &coef = vec_coef_.Mat();
+		for (int32 r = 0; r < in.NumRows(); r++) {
+			int32 s = r % S, i = num_received_[s]++;
+			// the newest frame of the window, zero outside the utterance
+			int32 t = i - upstream_delay_;
+			BaseFloat *slot = history_.RowData(s * C + i % C);
+			if (t < 0 || (end_frame_[s] >= 0 && t >= end_frame_[s])) {
+				std::fill(slot, slot + D, 0.0);
+			} else {
+				std::copy(in.RowData(r), in.RowData(r) + D, slot);
+			}
+			BaseFloat *y = out->RowData(r);
+			if (t < future_context_) {
+				std::fill(y, y + D, 0.0);
+				continue;
+			}
+			// the ring holds rows i - C + 1 .. i, the window of the output frame
+			const BaseFloat *center = history_.RowData(s * C + (i - future_context_) % C);
+			std::copy(center, center + D, y);
+			for (int32 c = 0; c < C; c++) {
+				const BaseFloat *x = history_.RowData(s * C + (i + 1 + c) % C),
+				                *w = coef.RowData(c);
+				for (int32 d = 0; d < D; d++) {
+					y[d] += w[d] * x[d];
+				}
+			}
+		}
+	}
+
 	void PropagateFnc(const CuMatrixBase<BaseFloat> &in, CuMatrixBase<BaseFloat> *out) {
+		if (streaming_) {
+			PropagateStreaming(in, out);
+			return;
+		}
 		int32 T = in.NumRows();
 		int32 D = in.NumCols();
 		int32 C = vec_coef_.NumRows();
@@ -199,6 +298,7 @@ class CompactFsmn : public UpdatableComponent {
 
 	void BackpropagateFnc(const CuMatrixBase<BaseFloat> &in, const CuMatrixBase<BaseFloat> &out,
 						  const CuMatrixBase<BaseFloat> &out_diff, CuMatrixBase<BaseFloat> *in_diff) {
+		if (streaming_) KALDI_ERR << "No backprop in the streaming mode";
 		int32 T = in.NumRows();
 		//int32 D = in.NumCols();
 		int32 C = vec_coef_.NumRows();
@@ -278,6 +378,18 @@ class CompactFsmn : public UpdatableComponent {
 	int32 past_context_;
 	int32 future_context_;
 	BaseFloat clip_gradient_;
+
+	// streaming inference, see SetStreaming()
+	bool streaming_;
+	int32 upstream_delay_;
+	int32 num_streams_;
+	// the last C input frames of stream s in rows [s * C, (s + 1) * C), frame
+	// i in row s * C + i % C
+	Matrix<BaseFloat> history_;
+	// input rows received by every stream since its reset
+	std::vector<int32> num_received_;
+	// number of frames of every stream, -1 before its end
+	std::vector<int32> end_frame_;
 };
 
 }// namespace aslp_nnet
@@ -28,6 +28,14 @@
 #include "aslp-nnet/nnet-nnet.h"
 #include "aslp-nnet/nnet-convolutional-component.h"
 #include "aslp-nnet/nnet-max-pooling-component.h"
+#include "aslp-nnet/nnet-lstm-kernel.h"
+#include "aslp-nnet/nnet-approx-activation.h"
+#include "aslp-nnet/nnet-activation.h"
+#include "aslp-nnet/nnet-affine-transform.h"
+#include "aslp-nnet/nnet-lstm-projected-streams.h"
+#include "aslp-nnet/nnet-quantize.h"
+#include "aslp-nnet/nnet-io.h"
+#include "aslp-nnet/nnet-cfsmn-component.h"
 
 namespace kaldi {
 namespace aslp_nnet {
@@ -205,6 +213,204 @@ namespace aslp_nnet {
     delete c;
   }
 
+
+  void UnitTestLstmCellForward(bool cifg) {
+    // S streams, ncell not a multiple of the simd width
+    int32 S = 3, ncell = 37, ngate = cifg ? 6 : 7;
+    // g, (i), f, o, c, h, m in one buffer, as the lstm components
+    CuMatrix<BaseFloat> buf(S, ngate * ncell), prev_c(S, ncell);
+    buf.SetRandn();
+    buf.Scale(4.0);
+    prev_c.SetRandn();
+    prev_c.Scale(40.0); // some cells get clipped
+    CuVector<BaseFloat> peephole_i_c(ncell), peephole_f_c(ncell), peephole_o_c(ncell);
+    peephole_i_c.SetRandn();
+    peephole_f_c.SetRandn();
+    peephole_o_c.SetRandn();
+    CuMatrix<BaseFloat> ref_buf(buf);
+
+    std::vector<CuSubMatrix<BaseFloat>* > fused, ref;
+    for (int32 k = 0; k < ngate; k++) {
+      fused.push_back(new CuSubMatrix<BaseFloat>(buf.ColRange(k * ncell, ncell)));
+      ref.push_back(new CuSubMatrix<BaseFloat>(ref_buf.ColRange(k * ncell, ncell)));
+    }
+    // lstm: g i f o c h m, cifg: g f o c h m
+    int32 i = 1, f = cifg ? 1 : 2, o = f + 1;
+    LstmCellForward(prev_c, cifg ? NULL : &peephole_i_c, peephole_f_c, peephole_o_c,
+                    fused[0], cifg ? NULL : fused[i], fused[f], fused[o],
+                    fused[o + 1], fused[o + 2], fused[o + 3]);
+    LstmCellForwardUnfused(prev_c, cifg ? NULL : &peephole_i_c, peephole_f_c, peephole_o_c,
+                           ref[0], cifg ? NULL : ref[i], ref[f], ref[o],
+                           ref[o + 1], ref[o + 2], ref[o + 3]);
+    for (int32 k = 0; k < ngate; k++) {
+      AssertEqual(*fused[k], *ref[k], 1e-5);
+      delete fused[k];
+      delete ref[k];
+    }
+  }
+
+
+  void UnitTestApproxActivation() {
+    CuMatrix<BaseFloat> in(5, 101), exact(5, 101), approx(5, 101);
+    in.SetRandn();
+    in.Scale(8.0);
+    // the exact float ops have their own error, about 1e-7
+    exact.Sigmoid(in);
+    ApproxSigmoid(in, &approx);
+    approx.AddMat(-1.0, exact);
+    KALDI_ASSERT(approx.Max() <= kApproxSigmoidMaxError + 1e-7);
+    KALDI_ASSERT(approx.Min() >= -kApproxSigmoidMaxError - 1e-7);
+    exact.Tanh(in);
+    ApproxTanh(in, &approx);
+    approx.AddMat(-1.0, exact);
+    KALDI_ASSERT(approx.Max() <= kApproxTanhMaxError + 1e-7);
+    KALDI_ASSERT(approx.Min() >= -kApproxTanhMaxError - 1e-7);
+    // in place, through the component
+    Sigmoid c(101, 101);
+    c.SetApproxActivation(true);
+    CuMatrix<BaseFloat> out;
+    c.Propagate(in, &out);
+    ApproxSigmoid(in, &in);
+    AssertEqual(out, in);
+  }
+
+  // ||a - b|| / ||b||
+  static BaseFloat RelativeDiff(const CuMatrixBase<BaseFloat> &a,
+                                const CuMatrixBase<BaseFloat> &b) {
+    CuMatrix<BaseFloat> diff(a);
+    diff.AddMat(-1.0, b);
+    return diff.FrobeniusNorm() / b.FrobeniusNorm();
+  }
+
+  // Propagate through a Write/Read copy of c
+  static void PropagateCopy(const Component &c, bool binary,
+                            const CuMatrixBase<BaseFloat> &in,
+                            CuMatrix<BaseFloat> *out) {
+    std::ostringstream os;
+    c.Write(os, binary);
+    std::istringstream is(os.str());
+    Component *copy = Component::Read(is, binary);
+    copy->Propagate(in, out);
+    delete copy;
+  }
+
+  void UnitTestQuantize() {
+    // weights and input already on the int8 grid(scale 1), so the int8 gemm
+    // must be exact, 70 cols to test the zero padding to 96
+    Matrix<BaseFloat> w_mat(45, 70), in_mat(7, 70);
+    for (int32 r = 0; r < w_mat.NumRows(); r++) {
+      for (int32 c = 0; c < w_mat.NumCols(); c++) w_mat(r, c) = RandInt(-127, 127);
+      w_mat(r, r) = 127;
+    }
+    for (int32 r = 0; r < in_mat.NumRows(); r++) {
+      for (int32 c = 0; c < in_mat.NumCols(); c++) in_mat(r, c) = RandInt(-127, 127);
+      in_mat(r, 3 * r) = -127;
+    }
+    CuMatrix<BaseFloat> w(w_mat), in(in_mat);
+    QuantizedMatrix q;
+    q.Quantize(w);
+    CuMatrix<BaseFloat> exact(7, 45), approx(7, 45);
+    exact.AddMatMat(1.0, in, kNoTrans, w, kTrans, 0.0);
+    AddMatQuantizedMat(1.0, in, q, 0.0, &approx);
+    AssertEqual(exact, approx);
+    // alpha and beta
+    exact.AddMatMat(0.5, in, kNoTrans, w, kTrans, 2.0);
+    AddMatQuantizedMat(0.5, in, q, 2.0, &approx);
+    AssertEqual(exact, approx);
+    // read/write
+    for (int32 binary = 0; binary < 2; binary++) {
+      std::ostringstream os;
+      q.Write(os, binary == 1);
+      std::istringstream is(os.str());
+      QuantizedMatrix q2;
+      q2.Read(is, binary == 1);
+      Matrix<BaseFloat> m, m2;
+      q.Dequantize(&m);
+      q2.Dequantize(&m2);
+      AssertEqual(m, w_mat);
+      AssertEqual(m, m2);
+    }
+
+    // random gaussian weights, the int8 rounding error is about 1%
+    AffineTransform affine(70, 45);
+    w.SetRandn();
+    affine.SetLinearity(w);
+    CuMatrix<BaseFloat> out_float, out_int8, out_read;
+    in.SetRandn();
+    affine.Propagate(in, &out_float);
+    KALDI_ASSERT(affine.ParamBytes() == affine.NumParams() * sizeof(BaseFloat));
+    affine.Quantize();
+    // 1 byte a weight(rows padded to 32), a float scale a row, the bias
+    KALDI_ASSERT(affine.ParamBytes() == 45 * 96 + 45 * sizeof(BaseFloat) * 2);
+    affine.Propagate(in, &out_int8);
+    KALDI_ASSERT(RelativeDiff(out_int8, out_float) < 0.03);
+    for (int32 binary = 0; binary < 2; binary++) {
+      PropagateCopy(affine, binary == 1, in, &out_read);
+      AssertEqual(out_read, out_int8);
+    }
+
+    Component *lstm = Component::Init("<LstmProjectedStreams> <InputDim> 70 "
+                                      "<OutputDim> 24 <CellDim> 40 <ParamScale> 0.3");
+    in.Resize(20, 70);
+    in.SetRandn();
+    lstm->Propagate(in, &out_float);
+    dynamic_cast<LstmProjectedStreams*>(lstm)->Quantize();
+    // the 3 int8 weights(rows padded to 96, 32, 64) with a float scale a
+    // row, the bias and the 3 peepholes
+    KALDI_ASSERT(dynamic_cast<LstmProjectedStreams*>(lstm)->ParamBytes() ==
+                 160 * 96 + 160 * 32 + 24 * 64 +
+                 (160 + 160 + 24 + 160 + 3 * 40) * sizeof(BaseFloat));
+    lstm->Propagate(in, &out_int8);
+    KALDI_ASSERT(RelativeDiff(out_int8, out_float) < 0.03);
+    for (int32 binary = 0; binary < 2; binary++) {
+      PropagateCopy(*lstm, binary == 1, in, &out_read);
+      AssertEqual(out_read, out_int8);
+    }
+    delete lstm;
+  }
+
+  void UnitTestFsmnStreaming() {
+#if HAVE_CUDA == 1
+    if (CuDevice::Instantiate().Enabled()) return;  // CPU only
+#endif
+    // two FSMN with a frame-wise layer between, delay 2 + 4
+    Nnet nnet;
+    nnet.AppendComponent(new InputLayer(8, 8));
+    nnet.AppendComponent(Component::Init("<CompactFsmn> <InputDim> 8 <OutputDim> 8 "
+                                         "<PastContext> 3 <FutureContext> 2"));
+    nnet.AppendComponent(new Sigmoid(8, 8));
+    nnet.AppendComponent(Component::Init("<CompactFsmn> <InputDim> 8 <OutputDim> 8 "
+                                         "<PastContext> 5 <FutureContext> 4"));
+    nnet.AppendComponent(new OutputLayer(8, 8));
+    CuMatrix<BaseFloat> in(37, 8), out_offline;
+    in.SetRandn();
+    nnet.Feedforward(in, &out_offline);
+
+    nnet.SetFsmnStreaming(true);
+    int32 delay = nnet.FsmnStreamingDelay();
+    KALDI_ASSERT(delay == 6);
+    // twice, the second time after the reset
+    for (int32 n = 0; n < 2; n++) {
+      nnet.ResetLstmStreams(std::vector<int32>(1, 1));
+      int32 chunk[] = { 5, 11, 1, 20 };
+      CuMatrix<BaseFloat> out_streaming(37 + delay, 8), out;
+      int32 t = 0;
+      for (int32 i = 0; i < 4; i++) {
+        nnet.Feedforward(in.RowRange(t, chunk[i]), &out);
+        out_streaming.RowRange(t, chunk[i]).CopyFromMat(out);
+        t += chunk[i];
+      }
+      // flush with any rows, they are taken as padding after the end
+      nnet.SetFsmnStreamEnd(std::vector<int32>(1, 37));
+      CuMatrix<BaseFloat> flush(delay, 8);
+      flush.SetRandn();
+      nnet.Feedforward(flush, &out);
+      out_streaming.RowRange(37, delay).CopyFromMat(out);
+      AssertEqual(out_streaming.RowRange(0, delay), CuMatrix<BaseFloat>(delay, 8));
+      AssertEqual(out_streaming.RowRange(delay, 37), out_offline);
+    }
+  }
+
 } // namespace aslp_nnet
 } // namespace kaldi
 
@@ -220,6 +426,11 @@ int main() {
       CuDevice::Instantiate().SelectGpuId("optional"); // use GPU when available
 #endif
     // unit-tests :
+    UnitTestLstmCellForward(false);
+    UnitTestLstmCellForward(true);
+    UnitTestApproxActivation();
+    UnitTestQuantize();
+    UnitTestFsmnStreaming();
     UnitTestLengthNorm();
     UnitTestConvolutionalComponentUnity();
     UnitTestConvolutionalComponent3x3();
@@ -116,7 +116,8 @@ class Component {
  /// General interface of a component  
  public:
   Component(int32 input_dim, int32 output_dim) 
-      : input_dim_(input_dim), output_dim_(output_dim), id_(-1) { }
+      : input_dim_(input_dim), output_dim_(output_dim), id_(-1),
+        approx_activation_(false) { }
   virtual ~Component() { }
 
   /// Copy component (deep copy).
@@ -176,6 +177,14 @@ class Component {
   void SetOffset(const std::vector<int32> &offset) {
     offset_ = offset;
   }
+  /// Use the fast approximate sigmoid/tanh in the forward pass on CPU,
+  /// inference only, see nnet-approx-activation.h
+  void SetApproxActivation(bool approx) {
+    approx_activation_ = approx;
+  }
+  bool ApproxActivation() const {
+    return approx_activation_;
+  }
   /// Perform feed forward pass
   virtual void Feedforward(const CuMatrixBase<BaseFloat> &in, 
                          CuMatrix<BaseFloat> *out); 
@@ -232,6 +241,7 @@ class Component {
   std::string name_;
   std::vector<std::string> input_name_;
   std::vector<int32> input_, offset_;
+  bool approx_activation_;
 
  private:
   /// Create new intance of component
@@ -260,6 +270,11 @@ class UpdatableComponent : public Component {
 
   /// Number of trainable parameters
   virtual int32 NumParams() const = 0;
+  /// Memory of the parameters in bytes, the int8 quantized components
+  /// override it
+  virtual int64 ParamBytes() const {
+    return static_cast<int64>(NumParams()) * sizeof(BaseFloat);
+  }
   virtual void GetParams(Vector<BaseFloat> *params) const = 0;
   virtual void GetGpuParams(std::vector<std::pair<BaseFloat *, int> > *params) = 0;
 
@@ -1,5 +1,6 @@
 // aslp-nnet/nnet-decodable.cc
 
+#include "base/timer.h"
 #include "aslp-nnet/nnet-decodable.h"
 
 namespace kaldi {
@@ -11,64 +12,234 @@ NnetDecodableBase::NnetDecodableBase(
         const TransitionModel &trans_model,
         const NnetDecodableOptions &opts):
     nnet_(nnet),
+    forward_(NULL),
     log_priors_(log_priors),
+    host_log_priors_(log_priors),
     trans_model_(trans_model),
     opts_(opts),
     num_pdfs_(nnet_->OutputDim()),
-    begin_frame_(-1) {
+    frame_step_(1),
+    nnet_time_(0.0),
+    begin_frame_(-1),
+    begin_row_(0),
+    delay_(0),
+    num_frames_fed_(0),
+    num_frames_out_(0) {
         KALDI_ASSERT(opts_.max_nnet_batch_size > 0);
         KALDI_ASSERT(log_priors_.Dim() == trans_model_.NumPdfs() &&
                 "Priors in neural network not set up (or mismatch "
                 "with transition model).");
+        loglikes_.resize(num_pdfs_);
+        pdf_frame_.resize(num_pdfs_, -1);
         if (nnet_->NumOutput() != 1) {
             KALDI_ERR << "Num output must equal 1";
         }
+        if (opts_.fsmn_streaming) {
+            nnet_->SetFsmnStreaming(true);
+            delay_ = nnet_->FsmnStreamingDelay();
+        }
         std::vector<int> flags(1, 1);
         nnet_->ResetLstmStreams(flags);
+        if (delay_ > 0 && opts_.skip_width > 1) {
+            KALDI_ERR << "Frame skipping is not supported by the streaming FSMN";
+        }
+        if (opts_.skip_width > 1 && opts_.skip_type == "lfr") {
+            frame_step_ = opts_.skip_width;
+        }
+}
+
+NnetDecodableBase::NnetDecodableBase(
+        NnetForwardInterface *forward,
+        const CuVector<BaseFloat> &log_priors,
+        const TransitionModel &trans_model,
+        const NnetDecodableOptions &opts):
+    nnet_(NULL),
+    forward_(forward),
+    log_priors_(log_priors),
+    host_log_priors_(log_priors),
+    trans_model_(trans_model),
+    opts_(opts),
+    num_pdfs_(forward_->OutputDim()),
+    frame_step_(1),
+    nnet_time_(0.0),
+    begin_frame_(-1),
+    begin_row_(0),
+    delay_(0),
+    num_frames_fed_(0),
+    num_frames_out_(0) {
+        KALDI_ASSERT(opts_.max_nnet_batch_size > 0);
+        KALDI_ASSERT(log_priors_.Dim() == trans_model_.NumPdfs() &&
+                "Priors in neural network not set up (or mismatch "
+                "with transition model).");
+        loglikes_.resize(num_pdfs_);
+        pdf_frame_.resize(num_pdfs_, -1);
+        delay_ = forward_->StreamingDelay();
+        if (delay_ > 0 && opts_.skip_width > 1) {
+            KALDI_ERR << "Frame skipping is not supported by the streaming FSMN";
+        }
+        if (opts_.skip_width > 1 && opts_.skip_type == "lfr") {
+            frame_step_ = opts_.skip_width;
+        }
+}
+
+bool NnetDecodableBase::IsLastFrame(int32 frame) const {
+    if (frame_step_ == 1) return IsLastFeatureFrame(frame);
+    // the frame of the last feature frame
+    int32 features_ready = NumFeatureFramesReady();
+    return features_ready > 0 && IsLastFeatureFrame(features_ready - 1) &&
+           frame == (features_ready - 1) / frame_step_;
+}
+
+int32 NnetDecodableBase::NumFramesReady() const {
+    int32 features_ready = NumFeatureFramesReady();
+    // frame t is feature frame t * frame_step_
+    if (frame_step_ > 1) return (features_ready + frame_step_ - 1) / frame_step_;
+    if (delay_ == 0 ||
+        (features_ready > 0 && IsLastFeatureFrame(features_ready - 1))) {
+        return features_ready;
+    }
+    // the last delay_ frames wait for their future context
+    return std::max(0, features_ready - delay_);
+}
+
+void NnetDecodableBase::Reset() {
+    begin_frame_ = -1;
+    begin_row_ = 0;
+    posteriors_.Resize(0, 0);
+    // the frames count from 0 again
+    std::fill(pdf_frame_.begin(), pdf_frame_.end(), -1);
+    num_frames_fed_ = 0;
+    num_frames_out_ = 0;
+    if (delay_ > 0) {
+        if (forward_ != NULL) {
+            forward_->ResetStream();
+        } else {
+            std::vector<int32> flags(1, 1);
+            nnet_->ResetLstmStreams(flags);
+        }
+    }
+}
+
+void NnetDecodableBase::Feedforward(const CuMatrixBase<BaseFloat> &in,
+                                    CuMatrix<BaseFloat> *out) {
+    Timer timer;
+    if (forward_ != NULL) {
+        forward_->Feedforward(in, out);
+    } else {
+        nnet_->Feedforward(in, out);
+    }
+    nnet_time_ += timer.Elapsed();
 }
 
 BaseFloat NnetDecodableBase::LogLikelihood(int32 frame, int32 index) {
-    ComputeForFrame(frame);
     int32 pdf_id = trans_model_.TransitionIdToPdf(index);
+    if (pdf_frame_[pdf_id] == frame) return loglikes_[pdf_id];
+    ComputeForFrame(frame);
     KALDI_ASSERT(frame >= begin_frame_ &&
-            frame < begin_frame_ + scaled_loglikes_.NumRows());
-    return scaled_loglikes_(frame - begin_frame_, pdf_id);
+            frame < begin_frame_ + NumCachedFrames());
+    // Avoid log of zero which leads to NaN, divide by the prior and scale
+    BaseFloat p = posteriors_(frame - begin_frame_ + begin_row_, pdf_id);
+    BaseFloat loglike = opts_.acoustic_scale *
+        (Log(std::max(p, static_cast<BaseFloat>(1.0e-20))) -
+         host_log_priors_(pdf_id));
+    loglikes_[pdf_id] = loglike;
+    pdf_frame_[pdf_id] = frame;
+    return loglike;
+}
+
+CuSubMatrix<BaseFloat> NnetDecodableBase::GetFeatures(int32 begin, int32 end,
+                                                      int32 step, int32 num_pad) {
+    int32 num_frames = (end - begin + step - 1) / step,
+          num_rows = num_frames + num_pad, dim = FeatDim();
+    const MatrixBase<BaseFloat> *feats = FeatureMatrix();
+    const BaseFloat *data;
+    MatrixIndexT stride;
+    if (feats != NULL && num_pad == 0) {
+        // every step-th row is a matrix with step times the stride
+        data = feats->RowData(begin - FeatureMatrixOffset());
+        stride = feats->Stride() * step;
+    } else {
+        // sized for the largest batch, the batches use the first rows
+        if (feat_buf_.NumRows() < num_rows || feat_buf_.NumCols() != dim) {
+            feat_buf_.Resize(std::max(num_rows, opts_.max_nnet_batch_size + delay_),
+                             dim, kUndefined);
+        }
+        for (int32 i = 0; i < num_frames; i++) {
+            SubVector<BaseFloat> row(feat_buf_, i);
+            GetFrame(begin + i * step, &row);
+        }
+        if (num_pad > 0) feat_buf_.RowRange(num_frames, num_pad).SetZero();
+        data = feat_buf_.Data();
+        stride = feat_buf_.Stride();
+    }
+#if HAVE_CUDA == 1
+    if (CuDevice::Instantiate().Enabled()) {
+        if (cu_feat_buf_.NumRows() < num_rows || cu_feat_buf_.NumCols() != dim) {
+            cu_feat_buf_.Resize(std::max(num_rows, opts_.max_nnet_batch_size + delay_),
+                                dim, kUndefined);
+        }
+        SubMatrix<BaseFloat> host(const_cast<BaseFloat *>(data), num_rows, dim, stride);
+        CuSubMatrix<BaseFloat> cu_feats(cu_feat_buf_.RowRange(0, num_rows));
+        cu_feats.CopyFromMat(host);
+        return cu_feats;
+    }
+#endif
+    // On CPU the nnet reads them where they are
+    return CuSubMatrix<BaseFloat>(data, num_rows, dim, stride);
+}
+
+void NnetDecodableBase::CachePosteriors(int32 begin_frame, int32 begin_row) {
+#if HAVE_CUDA == 1
+    if (CuDevice::Instantiate().Enabled()) {
+        // Transfer the output to the CPU for faster access by the decoding process.
+        posteriors_.Resize(nnet_out_.NumRows(), nnet_out_.NumCols(), kUndefined);
+        nnet_out_.CopyToMat(&posteriors_);
+        begin_frame_ = begin_frame;
+        begin_row_ = begin_row;
+        return;
+    }
+#endif
+    // Exchange the storage, both buffers are reused in the next batches
+    nnet_out_.Swap(&posteriors_);
+    begin_frame_ = begin_frame;
+    begin_row_ = begin_row;
 }
 
 void NnetDecodableBase::ComputeForFrame(int32 frame) {
-    int32 features_ready = NumFramesReady();
-    //bool input_finished = features_->IsLastFrame(features_ready - 1);  
     KALDI_ASSERT(frame >= 0);
     if (frame >= begin_frame_ &&
-            frame < begin_frame_ + scaled_loglikes_.NumRows())
+            frame < begin_frame_ + NumCachedFrames())
         return;
     KALDI_ASSERT(frame < NumFramesReady());
+    if (delay_ > 0) {
+        ComputeForFrameStreaming(frame);
+        return;
+    }
+    int32 features_ready = NumFeatureFramesReady();
 
-    int32 input_frame_begin = frame;
-    int32 max_possible_input_frame_end = features_ready;
+    int32 frame_end = std::min<int32>(NumFramesReady(),
+            frame + opts_.max_nnet_batch_size);
+    KALDI_ASSERT(frame_end > frame);
 
-    int32 input_frame_end = std::min<int32>(max_possible_input_frame_end,
-            input_frame_begin + opts_.max_nnet_batch_size);
+    // the feature frames of [frame, frame_end), all of them but in lfr mode
+    int32 input_frame_begin = frame * frame_step_;
+    // the frames are decoded in order, the features before are done
+    DiscardFeatureFrames(input_frame_begin);
+    int32 input_frame_end = std::min<int32>(features_ready,
+            frame_end * frame_step_);
 
-    KALDI_ASSERT(input_frame_end > input_frame_begin);
-    Matrix<BaseFloat> features(input_frame_end - input_frame_begin,
-            FeatDim());
-    for (int32 t = input_frame_begin; t < input_frame_end; t++) {
-        SubVector<BaseFloat> row(features, t - input_frame_begin);
-        GetFrame(t, &row);
-    }
-    CuMatrix<BaseFloat> cu_features; 
-    // This function is perfect, avoid copy and duplicate matrix using 
-    // constructor like CuMatrix<BaseFloat> cu_features(features)
-    cu_features.Swap(&features);  // Copy to GPU, if we're using one.
+    CuSubMatrix<BaseFloat> cu_features(GetFeatures(input_frame_begin,
+                                                   input_frame_end,
+                                                   frame_step_, 0));
 
-    int32 num_frames_out = input_frame_end - input_frame_begin;
-    CuMatrix<BaseFloat> cu_posteriors(num_frames_out, num_pdfs_);
+    int32 num_frames_out = frame_end - frame;
+    CuMatrix<BaseFloat> &cu_posteriors = nnet_out_;
 
     // Feedforward.
     // TODO: add more details about feature
     int skip_width = opts_.skip_width;
-    if (skip_width > 1) {
+    if (skip_width > 1 && frame_step_ == 1) {
+        cu_posteriors.Resize(num_frames_out, num_pdfs_, kUndefined);
         // Decode copy
         if (opts_.skip_type == "copy") {
             int skip_len = (cu_features.NumRows() - 1) / skip_width + 1;
@@ -76,7 +247,7 @@ void NnetDecodableBase::ComputeForFrame(int32 frame) {
             for (int i = 0; i < skip_len; i++) {
                 skip_feat.Row(i).CopyFromVec(cu_features.Row(i * skip_width));
             }
-            nnet_->Feedforward(skip_feat, &skip_out);
+            Feedforward(skip_feat, &skip_out);
             for (int i = 0; i < skip_len; i++) {
                 for (int j = 0; j < skip_width; j++) {
                     int idx = i * skip_width + j;
@@ -95,7 +266,7 @@ void NnetDecodableBase::ComputeForFrame(int32 frame) {
                 for (int i = 0; i < skip_len; i++) {
                     skip_feat.Row(i).CopyFromVec(cu_features.Row(i * skip_width + skip_offset));
                 }
-                nnet_->Feedforward(skip_feat, &skip_out);
+                Feedforward(skip_feat, &skip_out);
                 for (int i = 0; i < skip_len; i++) {
                     cu_posteriors.Row(i * skip_width + skip_offset).CopyFromVec(skip_out.Row(i));
                 }
@@ -106,22 +277,46 @@ void NnetDecodableBase::ComputeForFrame(int32 frame) {
         }
     }
     else {
-        nnet_->Feedforward(cu_features, &cu_posteriors);
+        Feedforward(cu_features, &cu_posteriors);
     }
 
-    cu_posteriors.ApplyFloor(1.0e-20); // Avoid log of zero which leads to NaN.
-    cu_posteriors.ApplyLog();
+    CachePosteriors(frame, 0);
+}
 
-    // subtract log-prior (divide by prior)
-    cu_posteriors.AddVecToRows(-1.0, log_priors_);
-    // apply probability scale.
-    cu_posteriors.Scale(opts_.acoustic_scale);
+void NnetDecodableBase::ComputeForFrameStreaming(int32 frame) {
+    // the frames are decoded in order, so the outputs are computed in order
+    KALDI_ASSERT(frame >= num_frames_out_);
+    int32 features_ready = NumFeatureFramesReady();
+    bool input_finished = IsLastFeatureFrame(features_ready - 1);
+    // output frame t comes with input frame t + delay_
+    int32 input_frame_end = std::min<int32>(features_ready,
+            std::max(num_frames_fed_ + opts_.max_nnet_batch_size,
+                     frame + delay_ + 1));
+    int32 num_flush = 0;
+    if (input_finished && input_frame_end == features_ready) {
+        // the zero rows flushing the last delay_ outputs
+        num_flush = delay_;
+        if (forward_ != NULL) {
+            forward_->SetStreamEnd(features_ready);
+        } else {
+            nnet_->SetFsmnStreamEnd(std::vector<int32>(1, features_ready));
+        }
+    }
+    DiscardFeatureFrames(num_frames_fed_);
+    Feedforward(GetFeatures(num_frames_fed_, input_frame_end, 1, num_flush),
+                &nnet_out_);
 
-    // Transfer the scores the CPU for faster access by the decoding process.
-    scaled_loglikes_.Resize(0, 0);
-    cu_posteriors.Swap(&scaled_loglikes_);
+    // row r is the output of frame num_frames_fed_ + r - delay_, the rows
+    // before frame 0 are dropped
+    int32 skip = num_frames_out_ - (num_frames_fed_ - delay_);
+    int32 num_frames_out = nnet_out_.NumRows() - skip;
+    KALDI_ASSERT(skip >= 0 && num_frames_out > 0);
+    int32 begin_frame = num_frames_out_;
+    num_frames_fed_ = input_frame_end;
+    num_frames_out_ += num_frames_out;
+    KALDI_ASSERT(frame < num_frames_out_);
 
-    begin_frame_ = frame;
+    CachePosteriors(begin_frame, skip);
 }
 
 } // namespace aslp_nnet
@@ -32,12 +32,14 @@ struct NnetDecodableOptions {
     int skip_width;
     std::string skip_type;
     int32 max_nnet_batch_size;
+    bool fsmn_streaming;
 
     NnetDecodableOptions():
         acoustic_scale(0.1),
         skip_width(0),
         skip_type("copy"),
-        max_nnet_batch_size(256) { }
+        max_nnet_batch_size(256),
+        fsmn_streaming(false) { }
 
     void Register(OptionsItf *opts) {
         opts->Register("acoustic-scale", &acoustic_scale,
@@ -45,16 +47,58 @@ struct NnetDecodableOptions {
         opts->Register("skip-width", &skip_width, 
                  "num of frame for one skip(default 0, not use skip)");
         opts->Register("skip-type", &skip_type, 
-                 "decode type using skip, copy or split");
+                 "decode type using skip, copy, split or lfr(low frame rate, "
+                 "the decoder only sees every skip-width-th frame, the graph "
+                 "must be built for it, see aslp-make-h3-transducer --skip-width)");
         opts->Register("max-nnet-batch-size", &max_nnet_batch_size,
                 "Maximum batch size we use in neural-network decodable object, "
                 "in cases where we are not constrained by currently available "
                 "frames (this will rarely make a difference)");
+        opts->Register("fsmn-streaming", &fsmn_streaming,
+                "Stream the CompactFsmn layers, their memory crosses the nnet "
+                "batches instead of being zero padded in every batch, the "
+                "output comes the sum of the future contexts later");
 
     }
 };
 
+/// Abstract forward computation of the acoustic model. By default the
+/// decodable runs its own Nnet, with this interface the nnet computation of
+/// one stream can be delegated to other object, eg. the batched forward of
+/// the online server (aslp-online/nnet-batch-scheduler.h), which keeps the
+/// recurrent state of every stream itself.
+class NnetForwardInterface {
+public:
+    virtual int32 OutputDim() const = 0;
+    /// Feed forward the next in.NumRows() frames of this stream
+    virtual void Feedforward(const CuMatrixBase<BaseFloat> &in,
+                             CuMatrix<BaseFloat> *out) = 0;
+    /// Frames the output lags behind the input, see Nnet::SetFsmnStreaming()
+    virtual int32 StreamingDelay() const { return 0; }
+    /// The stream has num_frames frames, the frames fed after are padding
+    virtual void SetStreamEnd(int32 num_frames) { }
+    /// Start a new utterance of the streaming nnet
+    virtual void ResetStream() { }
+    virtual ~NnetForwardInterface() {}
+};
+
+/// Online features kept in one matrix(eg. aslp_online::OnlineFeaturePool),
+/// which the decodable reads in place instead of frame by frame
+class OnlineMatrixFeatureInterface: public OnlineFeatureInterface {
+public:
+    /// Row r is frame FeatureMatrixOffset() + r up to NumFramesReady(), the
+    /// matrix may be reallocated or its rows moved when frames are added
+    virtual const MatrixBase<BaseFloat> &FeatureMatrix() const = 0;
+    virtual int32 FeatureMatrixOffset() const { return 0; }
+    /// The frames before frame won't be read again, they may be dropped
+    virtual void DiscardFrames(int32 frame) { }
+};
 
+/// The nnet output of a batch of frames is kept as it is, and only the
+/// pdfs the decoder asks for are converted to the scaled log likelihood
+/// acoustic_scale * (log(p) - log(prior)), once per frame, so there is no
+/// pass over all the pdfs for every frame. The feature, output and
+/// likelihood buffers are reused across the batches.
 class NnetDecodableBase: public DecodableInterface {
 public:
     NnetDecodableBase(Nnet *nnet,
@@ -62,42 +106,105 @@ public:
                       const TransitionModel &trans_model,
                       const NnetDecodableOptions &opts);
 
+    /// The nnet computation is done by forward, which is not owned here
+    NnetDecodableBase(NnetForwardInterface *forward,
+                      const CuVector<BaseFloat> &log_priors,
+                      const TransitionModel &trans_model,
+                      const NnetDecodableOptions &opts);
+
     /// Returns the scaled log likelihood
     virtual BaseFloat LogLikelihood(int32 frame, int32 index);
 
-    virtual bool IsLastFrame(int32 frame) const = 0;
-    virtual int32 NumFramesReady() const = 0;  
+    /// The frames are the feature frames, or every skip_width-th of them in
+    /// the lfr mode
+    virtual bool IsLastFrame(int32 frame) const;
+    /// Frames of the nnet output ready, the streaming delay less than the
+    /// features until the input is finished
+    virtual int32 NumFramesReady() const;
+    virtual bool IsLastFeatureFrame(int32 frame) const = 0;
+    virtual int32 NumFeatureFramesReady() const = 0;
     virtual int32 FeatDim() const = 0;
     virtual void GetFrame(int t, VectorBase<BaseFloat> *feat) const = 0;
+    /// The features if they are kept in one matrix, then they are fed to the
+    /// nnet in place(on CPU), else NULL and they are copied by GetFrame()
+    virtual const MatrixBase<BaseFloat> *FeatureMatrix() const { return NULL; }
+    /// The feature frame of row 0 of FeatureMatrix()
+    virtual int32 FeatureMatrixOffset() const { return 0; }
+    /// The nnet has been fed the feature frames before frame, a bounded
+    /// feature store may drop them
+    virtual void DiscardFeatureFrames(int32 frame) { }
 
     /// Indices are one-based!  This is for compatibility with OpenFst.
     virtual int32 NumIndices() const { return trans_model_.NumTransitionIds(); }
 
+    /// Seconds spent in the nnet forward, the rest of the decoding is search
+    double NnetTime() const { return nnet_time_; }
+
 protected:
 
     /// If the neural-network outputs for this frame are not cached, it computes
     /// them (and possibly for some succeeding frames)
     void ComputeForFrame(int32 frame);
 
+    /// ComputeForFrame() of the streaming nnet, every feature frame is fed
+    /// once in order, the delayed outputs are flushed after the last one
+    void ComputeForFrameStreaming(int32 frame);
+
+    /// Features begin, begin + step, ... before end, followed by num_pad zero
+    /// rows, as the nnet input, in place or in the reused buffers
+    CuSubMatrix<BaseFloat> GetFeatures(int32 begin, int32 end, int32 step,
+                                       int32 num_pad);
+
+    /// Keep nnet_out_ on the host, row begin_row is frame begin_frame
+    void CachePosteriors(int32 begin_frame, int32 begin_row);
+
+    /// Frames of the cached posteriors
+    int32 NumCachedFrames() const { return posteriors_.NumRows() - begin_row_; }
+
+    /// Clear the cache and the streaming state for a new utterance
+    void Reset();
+
+    /// Forward through nnet_, or forward_ if it is provided
+    void Feedforward(const CuMatrixBase<BaseFloat> &in, CuMatrix<BaseFloat> *out);
+
     Nnet *nnet_;
+    NnetForwardInterface *forward_;
     const CuVector<BaseFloat> &log_priors_;  // log-priors taken from the model.
+    Vector<BaseFloat> host_log_priors_;  // copy on the host
     const TransitionModel &trans_model_;
     NnetDecodableOptions opts_;
     int32 num_pdfs_;  // Number of pdfs, equals output-dim of the network (cached
     // here)
+    int32 frame_step_;  // Feature frames per frame, skip_width in the lfr mode
+    double nnet_time_;
 
-    int32 begin_frame_;  // First frame for which scaled_loglikes_ is valid
+    int32 begin_frame_;  // First frame for which posteriors_ is valid
     // (i.e. the first frame of the batch of frames for
     // which we've computed the output).
+    int32 begin_row_;  // Row of begin_frame_ in posteriors_
 
-    // scaled_loglikes_ contains the neural network pseudo-likelihoods: the log of
-    // (prob divided by the prior), scaled by opts.acoustic_scale).  We may
-    // compute this using the GPU, but we transfer it back to the system memory
-    // when we store it here.  These scores are only kept for a subset of frames,
-    // starting at begin_frame_, whose length depends how many frames were ready
-    // at the time we called LogLikelihood(), and will never exceed
-    // opts_.max_nnet_batch_size.
-    Matrix<BaseFloat> scaled_loglikes_;
+    // posteriors_ contains the neural network output of the last batch, on
+    // the host, the frames before begin_row_ are not valid(the streaming
+    // delay).  These are only kept for a subset of frames, starting at
+    // begin_frame_, whose length depends how many frames were ready at the
+    // time we called LogLikelihood().
+    Matrix<BaseFloat> posteriors_;
+
+    // Scaled log likelihood of every pdf, valid if pdf_frame_[pdf] is the
+    // frame asked, the decoder asks the same pdf many times in a frame
+    std::vector<BaseFloat> loglikes_;
+    std::vector<int32> pdf_frame_;
+
+    // Reused buffers of the nnet input and output
+    Matrix<BaseFloat> feat_buf_;
+    CuMatrix<BaseFloat> cu_feat_buf_;
+    CuMatrix<BaseFloat> nnet_out_;
+
+    // Streaming delay of the nnet(opts.fsmn_streaming), the feature frames fed
+    // and the output frames computed so far
+    int32 delay_;
+    int32 num_frames_fed_;
+    int32 num_frames_out_;
 };
 
 class NnetDecodable: public NnetDecodableBase {
@@ -110,11 +217,11 @@ public:
         NnetDecodableBase(nnet, log_priors, trans_model, opts),
         features_(feats) {}
 
-    virtual bool IsLastFrame(int32 frame) const {
+    virtual bool IsLastFeatureFrame(int32 frame) const {
         return (frame == features_.NumRows()-1);
     }
     
-    virtual int32 NumFramesReady() const {
+    virtual int32 NumFeatureFramesReady() const {
         return features_.NumRows();
     }
 
@@ -125,6 +232,10 @@ public:
     virtual void GetFrame(int t, VectorBase<BaseFloat> *feat) const {
         feat->CopyFromVec(features_.Row(t));
     }
+
+    virtual const MatrixBase<BaseFloat> *FeatureMatrix() const {
+        return &features_;
+    }
 private:
     const MatrixBase<BaseFloat> &features_;
     KALDI_DISALLOW_COPY_AND_ASSIGN(NnetDecodable);
@@ -138,13 +249,25 @@ public:
                         const NnetDecodableOptions &opts,
                         OnlineFeatureInterface *input_feats):
         NnetDecodableBase(nnet, log_priors, trans_model, opts),
-        features_(input_feats) {}
+        features_(input_feats),
+        matrix_features_(
+            dynamic_cast<OnlineMatrixFeatureInterface *>(input_feats)) {}
+
+    NnetDecodableOnline(NnetForwardInterface *forward,
+                        const CuVector<BaseFloat> &log_priors,
+                        const TransitionModel &trans_model,
+                        const NnetDecodableOptions &opts,
+                        OnlineFeatureInterface *input_feats):
+        NnetDecodableBase(forward, log_priors, trans_model, opts),
+        features_(input_feats),
+        matrix_features_(
+            dynamic_cast<OnlineMatrixFeatureInterface *>(input_feats)) {}
 
-    virtual bool IsLastFrame(int32 frame) const {
+    virtual bool IsLastFeatureFrame(int32 frame) const {
         return features_->IsLastFrame(frame);
     }
     
-    virtual int32 NumFramesReady() const {
+    virtual int32 NumFeatureFramesReady() const {
         return features_->NumFramesReady();
     }
 
@@ -156,12 +279,28 @@ public:
         features_->GetFrame(t, feat);
     }
 
+    virtual const MatrixBase<BaseFloat> *FeatureMatrix() const {
+        return matrix_features_ != NULL ? &matrix_features_->FeatureMatrix() : NULL;
+    }
+
+    virtual int32 FeatureMatrixOffset() const {
+        return matrix_features_ != NULL ? matrix_features_->FeatureMatrixOffset() : 0;
+    }
+
+    virtual void DiscardFeatureFrames(int32 frame) {
+        if (matrix_features_ != NULL) matrix_features_->DiscardFrames(frame);
+    }
+
     void ResetFeature(OnlineFeatureInterface *feat) {
         features_ = feat;
+        matrix_features_ = dynamic_cast<OnlineMatrixFeatureInterface *>(feat);
+        Reset();
     }
 
 private:
     OnlineFeatureInterface *features_;
+    // features_ if it keeps the features in a matrix, else NULL
+    OnlineMatrixFeatureInterface *matrix_features_;
     KALDI_DISALLOW_COPY_AND_ASSIGN(NnetDecodableOnline);
 };
 
@@ -21,6 +21,7 @@
 
 #include "aslp-nnet/nnet-component.h"
 #include "aslp-nnet/nnet-utils.h"
+#include "aslp-nnet/nnet-approx-activation.h"
 #include "aslp-cudamatrix/cu-math.h"
 
 
@@ -235,9 +236,18 @@ public:
 		}
 	}
 
+	// Per-stream recurrent state (one row per stream)
+	int32 StreamStateDim() const { return 5 * output_dim_; }
+	void GetLstmStreamState(CuMatrix<BaseFloat> *state) const {
+		*state = prev_nnet_state_;
+	}
+	void SetLstmStreamState(const CuMatrixBase<BaseFloat> &state) {
+		KALDI_ASSERT(state.NumCols() == StreamStateDim());
+		nstream_ = state.NumRows();
+		prev_nnet_state_ = state;
+	}
+
 	void PropagateFnc(const CuMatrixBase<BaseFloat> &in, CuMatrixBase<BaseFloat> *out) {
-		int DEBUG = 0;
-		
 		static bool do_stream_reset = false;
 		if (nstream_ == 0) {
 			do_stream_reset = true;
@@ -247,24 +257,38 @@ public:
 		}
 		if (do_stream_reset) prev_nnet_state_.SetZero();
 		KALDI_ASSERT(nstream_ > 0);
+		KALDI_ASSERT(prev_nnet_state_.NumRows() == nstream_);
+		PropagateState(in, out, &prev_nnet_state_, &propagate_buf_);
+	}
 
-		KALDI_ASSERT(in.NumRows() % nstream_ == 0);
-		int32 T = in.NumRows() / nstream_;
-		int32 S = nstream_;
+	// Forward with external recurrent state(one row per stream) and
+	// activation buffer, the parameters are only read, so one component
+	// can be shared by several decoding threads holding their own state
+	void PropagateState(const CuMatrixBase<BaseFloat> &in, CuMatrixBase<BaseFloat> *out,
+	                    CuMatrix<BaseFloat> *prev_state,
+	                    CuMatrix<BaseFloat> *buf) const {
+		int DEBUG = 0;
+		CuMatrix<BaseFloat> &prev_nnet_state = *prev_state;
+		CuMatrix<BaseFloat> &propagate_buf = *buf;
+
+		int32 S = prev_state->NumRows();
+		KALDI_ASSERT(S > 0);
+		KALDI_ASSERT(in.NumRows() % S == 0);
+		int32 T = in.NumRows() / S;
 
 		// 0:forward pass history, [1, T]:current sequence, T+1:dummy
-		propagate_buf_.Resize((T+2)*S, 5 * output_dim_, kSetZero);
-		propagate_buf_.RowRange(0*S,S).CopyFromMat(prev_nnet_state_);
+		propagate_buf.Resize((T+2)*S, 5 * output_dim_, kSetZero);
+		propagate_buf.RowRange(0*S,S).CopyFromMat(prev_nnet_state);
 
 		// disassemble entire neuron activation buffer in different neurons
-		CuSubMatrix<BaseFloat> YZ(propagate_buf_.ColRange(0*output_dim_, output_dim_));
-		CuSubMatrix<BaseFloat> YR(propagate_buf_.ColRange(1*output_dim_, output_dim_));
-		CuSubMatrix<BaseFloat> YM(propagate_buf_.ColRange(2*output_dim_, output_dim_));
-		CuSubMatrix<BaseFloat> YG(propagate_buf_.ColRange(3*output_dim_, output_dim_));
-		CuSubMatrix<BaseFloat> YH(propagate_buf_.ColRange(4*output_dim_, output_dim_));
+		CuSubMatrix<BaseFloat> YZ(propagate_buf.ColRange(0*output_dim_, output_dim_));
+		CuSubMatrix<BaseFloat> YR(propagate_buf.ColRange(1*output_dim_, output_dim_));
+		CuSubMatrix<BaseFloat> YM(propagate_buf.ColRange(2*output_dim_, output_dim_));
+		CuSubMatrix<BaseFloat> YG(propagate_buf.ColRange(3*output_dim_, output_dim_));
+		CuSubMatrix<BaseFloat> YH(propagate_buf.ColRange(4*output_dim_, output_dim_));
 
-		CuSubMatrix<BaseFloat> YZRM(propagate_buf_.ColRange(0, 3*output_dim_));
-		CuSubMatrix<BaseFloat> YZR(propagate_buf_.ColRange(0, 2*output_dim_));
+		CuSubMatrix<BaseFloat> YZRM(propagate_buf.ColRange(0, 3*output_dim_));
+		CuSubMatrix<BaseFloat> YZR(propagate_buf.ColRange(0, 2*output_dim_));
 
 		// x->z, r, m, not recurrent, do it all in once
 		YZRM.RowRange(1*S, T*S).AddMatMat(1.0, in, kNoTrans, w_zrm_x_, kTrans, 0.0);
@@ -286,7 +310,8 @@ public:
 			y_zr.AddMatMat(1.0, YH.RowRange((t-1)*S, S), kNoTrans, w_zr_h_, kTrans, 1.0);
 
 			// z, r sigmoid squashing
-			y_zr.Sigmoid(y_zr);
+			if (approx_activation_) ApproxSigmoid(y_zr, &y_zr);
+			else y_zr.Sigmoid(y_zr);
 
 			// r(t) * h(t-1) -> g(t)
 			y_g.AddMatMatElements(1.0, y_r, YH.RowRange((t-1)*S, S), 0.0);
@@ -295,7 +320,8 @@ public:
 			y_m.AddMatMat(1.0, y_g, kNoTrans, w_m_g_, kTrans, 1.0);
 
 			// m tanh squashing
-			y_m.Tanh(y_m);
+			if (approx_activation_) ApproxTanh(y_m, &y_m);
+			else y_m.Tanh(y_m);
 
 			// h(t-1) z(t) m(t) -> h(t)
 			y_h.AddMat(1.0, YH.RowRange((t-1)*S, S));
@@ -316,7 +342,7 @@ public:
 		out->CopyFromMat(YH.RowRange(1*S, T*S));
 
 		// now the last frame state becomes previous network state for next batch
-		prev_nnet_state_.CopyFromMat(propagate_buf_.RowRange(T*S, S));
+		prev_nnet_state.CopyFromMat(propagate_buf.RowRange(T*S, S));
 	}
 
 	void BackpropagateFnc( const CuMatrixBase<BaseFloat> &in, const CuMatrixBase<BaseFloat> &out,
@@ -26,6 +26,7 @@
 
 #include "aslp-nnet/nnet-component.h"
 #include "aslp-nnet/nnet-utils.h"
+#include "aslp-nnet/nnet-lstm-kernel.h"
 #include "cudamatrix/cu-math.h"
 
 // Lstm with coupled input gate and forget gate
@@ -295,11 +296,20 @@ class LstmCifgProjectedStreams : public UpdatableComponent {
     prev_nnet_state_.Resize(nstream_, 6*ncell_ + 1*nrecur_, kSetZero);
   }
 
+  // Per-stream recurrent state (one row per stream)
+  int32 StreamStateDim() const { return 6*ncell_ + 1*nrecur_; }
+  void GetLstmStreamState(CuMatrix<BaseFloat> *state) const {
+    *state = prev_nnet_state_;
+  }
+  void SetLstmStreamState(const CuMatrixBase<BaseFloat> &state) {
+    KALDI_ASSERT(state.NumCols() == StreamStateDim());
+    nstream_ = state.NumRows();
+    prev_nnet_state_ = state;
+  }
 
 
-  void PropagateFnc(const CuMatrixBase<BaseFloat> &in, CuMatrixBase<BaseFloat> *out) {
-    int DEBUG = 0;
 
+  void PropagateFnc(const CuMatrixBase<BaseFloat> &in, CuMatrixBase<BaseFloat> *out) {
     static bool do_stream_reset = false;
     if (nstream_ == 0) {
       do_stream_reset = true;
@@ -309,25 +319,39 @@ class LstmCifgProjectedStreams : public UpdatableComponent {
     }
     if (do_stream_reset) prev_nnet_state_.SetZero();
     KALDI_ASSERT(nstream_ > 0);
+    KALDI_ASSERT(prev_nnet_state_.NumRows() == nstream_);
+    PropagateState(in, out, &prev_nnet_state_, &propagate_buf_);
+  }
 
-    KALDI_ASSERT(in.NumRows() % nstream_ == 0);
-    int32 T = in.NumRows() / nstream_;
-    int32 S = nstream_;
+  // Forward with external recurrent state(one row per stream) and
+  // activation buffer, the parameters are only read, so one component
+  // can be shared by several decoding threads holding their own state
+  void PropagateState(const CuMatrixBase<BaseFloat> &in, CuMatrixBase<BaseFloat> *out,
+                      CuMatrix<BaseFloat> *prev_state,
+                      CuMatrix<BaseFloat> *buf) const {
+    int DEBUG = 0;
+    CuMatrix<BaseFloat> &prev_nnet_state = *prev_state;
+    CuMatrix<BaseFloat> &propagate_buf = *buf;
+
+    int32 S = prev_state->NumRows();
+    KALDI_ASSERT(S > 0);
+    KALDI_ASSERT(in.NumRows() % S == 0);
+    int32 T = in.NumRows() / S;
 
     // 0:forward pass history, [1, T]:current sequence, T+1:dummy
-    propagate_buf_.Resize((T+2)*S, 6 * ncell_ + nrecur_, kSetZero);
-    propagate_buf_.RowRange(0*S,S).CopyFromMat(prev_nnet_state_);
+    propagate_buf.Resize((T+2)*S, 6 * ncell_ + nrecur_, kSetZero);
+    propagate_buf.RowRange(0*S,S).CopyFromMat(prev_nnet_state);
 
     // disassemble entire neuron activation buffer into different neurons
-    CuSubMatrix<BaseFloat> YG(propagate_buf_.ColRange(0*ncell_, ncell_));
-    CuSubMatrix<BaseFloat> YF(propagate_buf_.ColRange(1*ncell_, ncell_));
-    CuSubMatrix<BaseFloat> YO(propagate_buf_.ColRange(2*ncell_, ncell_));
-    CuSubMatrix<BaseFloat> YC(propagate_buf_.ColRange(3*ncell_, ncell_));
-    CuSubMatrix<BaseFloat> YH(propagate_buf_.ColRange(4*ncell_, ncell_));
-    CuSubMatrix<BaseFloat> YM(propagate_buf_.ColRange(5*ncell_, ncell_));
-    CuSubMatrix<BaseFloat> YR(propagate_buf_.ColRange(6*ncell_, nrecur_));
+    CuSubMatrix<BaseFloat> YG(propagate_buf.ColRange(0*ncell_, ncell_));
+    CuSubMatrix<BaseFloat> YF(propagate_buf.ColRange(1*ncell_, ncell_));
+    CuSubMatrix<BaseFloat> YO(propagate_buf.ColRange(2*ncell_, ncell_));
+    CuSubMatrix<BaseFloat> YC(propagate_buf.ColRange(3*ncell_, ncell_));
+    CuSubMatrix<BaseFloat> YH(propagate_buf.ColRange(4*ncell_, ncell_));
+    CuSubMatrix<BaseFloat> YM(propagate_buf.ColRange(5*ncell_, ncell_));
+    CuSubMatrix<BaseFloat> YR(propagate_buf.ColRange(6*ncell_, nrecur_));
 
-    CuSubMatrix<BaseFloat> YGFO(propagate_buf_.ColRange(0, 3*ncell_));
+    CuSubMatrix<BaseFloat> YGFO(propagate_buf.ColRange(0, 3*ncell_));
 
     // x -> g, f, o, not recurrent, do it all in once
     YGFO.RowRange(1*S,T*S).AddMatMat(1.0, in, kNoTrans, w_gfo_x_, kTrans, 0.0);
@@ -360,37 +384,11 @@ class LstmCifgProjectedStreams : public UpdatableComponent {
       // r(t-1) -> g, f, o
       y_gfo.AddMatMat(1.0, YR.RowRange((t-1)*S,S), kNoTrans, w_gfo_r_, kTrans,  1.0);
 
-      // c(t-1) -> f(t) via peephole
-      y_f.AddMatDiagVec(1.0, YC.RowRange((t-1)*S,S), kNoTrans, peephole_f_c_, 1.0);
-
-      // f sigmoid squashing
-      y_f.Sigmoid(y_f);
-
-      // g tanh squashing
-      y_g.Tanh(y_g);
-
-      // g -> c, for traditional lstm, y_c.AddMatMatElements(1.0, y_g, y_i, 0.0);
-      //but for coupled input and forget gate, y_i = 1 - y_f
-      y_c.AddMatMatElements(-1.0, y_g, y_f, 0.0);
-      y_c.AddMat(1.0, y_g);
-
-      // c(t-1) -> c(t) via forget-gate
-      y_c.AddMatMatElements(1.0, YC.RowRange((t-1)*S,S), y_f, 1.0);
-
-      y_c.ApplyFloor(-50);   // optional clipping of cell activation
-      y_c.ApplyCeiling(50);  // google paper Interspeech2014: LSTM for LVCSR
-
-      // h tanh squashing
-      y_h.Tanh(y_c);
-
-      // c(t) -> o(t) via peephole (non-recurrent) & o squashing
-      y_o.AddMatDiagVec(1.0, y_c, kNoTrans, peephole_o_c_, 1.0);
-
-      // o sigmoid squashing
-      y_o.Sigmoid(y_o);
-
-      // h -> m via output gate
-      y_m.AddMatMatElements(1.0, y_h, y_o, 0.0);
+      // peepholes, squashing, c(t-1) -> c(t) and h -> m via output gate,
+      // fused into one pass on CPU, see nnet-lstm-kernel.h
+      LstmCellForward(YC.RowRange((t-1)*S,S), NULL, peephole_f_c_, peephole_o_c_,
+                      &y_g, NULL, &y_f, &y_o, &y_c, &y_h, &y_m,
+                      approx_activation_);
 
       // m -> r
       y_r.AddMatMat(1.0, y_m, kNoTrans, w_r_m_, kTrans, 0.0);
@@ -411,7 +409,7 @@ class LstmCifgProjectedStreams : public UpdatableComponent {
     out->CopyFromMat(YR.RowRange(1*S,T*S));
 
     // now the last frame state becomes previous network state for next batch
-    prev_nnet_state_.CopyFromMat(propagate_buf_.RowRange(T*S,S));
+    prev_nnet_state.CopyFromMat(propagate_buf.RowRange(T*S,S));
   }
 
   void BackpropagateFnc(const CuMatrixBase<BaseFloat> &in, const CuMatrixBase<BaseFloat> &out,
@@ -0,0 +1,244 @@
+// aslp-nnet/nnet-lstm-kernel.cc
+
+#include "aslp-nnet/nnet-lstm-kernel.h"
+
+#include "aslp-nnet/nnet-simd-math.h"
+
+namespace kaldi {
+namespace aslp_nnet {
+
+// optional clipping of cell activation,
+// google paper Interspeech2014: LSTM for LVCSR
+static const BaseFloat kCellClip = 50.0;
+
+template<bool kApprox, typename Real>
+static inline Real CellSigmoid(Real x) {
+    return kApprox ? ScalarFastSigmoid(x) : ScalarSigmoid(x);
+}
+
+template<bool kApprox, typename Real>
+static inline Real CellTanh(Real x) {
+    return kApprox ? ScalarFastTanh(x) : ScalarTanh(x);
+}
+
+// One row(stream) from column begin to end, pic and yi are NULL for cifg
+template<bool kApprox, typename Real>
+static void LstmCellRowScalar(int32 begin, int32 end, const Real *cp,
+                              const Real *pic, const Real *pfc, const Real *poc,
+                              Real *yg, Real *yi, Real *yf, Real *yo,
+                              Real *yc, Real *yh, Real *ym) {
+    for (int32 j = begin; j < end; j++) {
+        Real f = CellSigmoid<kApprox>(yf[j] + cp[j] * pfc[j]);
+        Real g = CellTanh<kApprox>(yg[j]);
+        Real c;
+        if (yi != NULL) {
+            Real i = CellSigmoid<kApprox>(yi[j] + cp[j] * pic[j]);
+            c = g * i + cp[j] * f;
+            yi[j] = i;
+        } else {
+            c = g - g * f + cp[j] * f;
+        }
+        if (c < -kCellClip) c = -kCellClip;
+        if (c > kCellClip) c = kCellClip;
+        Real h = CellTanh<kApprox>(c);
+        Real o = CellSigmoid<kApprox>(yo[j] + c * poc[j]);
+        yg[j] = g; yf[j] = f; yo[j] = o;
+        yc[j] = c; yh[j] = h; ym[j] = h * o;
+    }
+}
+
+#ifdef ASLP_NNET_HAVE_AVX2
+template<bool kApprox>
+ASLP_INLINE_AVX2
+static inline __m256 CellSigmoid256(__m256 x) {
+    return kApprox ? FastSigmoid256(x) : Sigmoid256(x);
+}
+
+template<bool kApprox>
+ASLP_INLINE_AVX2
+static inline __m256 CellTanh256(__m256 x) {
+    return kApprox ? FastTanh256(x) : Tanh256(x);
+}
+
+template<bool kApprox>
+ASLP_TARGET_AVX2
+static void LstmCellRowAvx2(int32 dim, const float *cp,
+                            const float *pic, const float *pfc, const float *poc,
+                            float *yg, float *yi, float *yf, float *yo,
+                            float *yc, float *yh, float *ym) {
+    const __m256 clip_max = _mm256_set1_ps(kCellClip),
+                 clip_min = _mm256_set1_ps(-kCellClip);
+    int32 j = 0;
+    for (; j + 8 <= dim; j += 8) {
+        __m256 c_prev = _mm256_loadu_ps(cp + j);
+        __m256 f = CellSigmoid256<kApprox>(_mm256_fmadd_ps(
+                c_prev, _mm256_loadu_ps(pfc + j), _mm256_loadu_ps(yf + j)));
+        __m256 g = CellTanh256<kApprox>(_mm256_loadu_ps(yg + j));
+        __m256 c;
+        if (yi != NULL) {
+            __m256 i = CellSigmoid256<kApprox>(_mm256_fmadd_ps(
+                    c_prev, _mm256_loadu_ps(pic + j), _mm256_loadu_ps(yi + j)));
+            c = _mm256_fmadd_ps(c_prev, f, _mm256_mul_ps(g, i));
+            _mm256_storeu_ps(yi + j, i);
+        } else {
+            c = _mm256_fmadd_ps(c_prev, f, _mm256_fnmadd_ps(g, f, g));
+        }
+        c = _mm256_min_ps(_mm256_max_ps(c, clip_min), clip_max);
+        __m256 h = CellTanh256<kApprox>(c);
+        __m256 o = CellSigmoid256<kApprox>(_mm256_fmadd_ps(
+                c, _mm256_loadu_ps(poc + j), _mm256_loadu_ps(yo + j)));
+        _mm256_storeu_ps(yg + j, g);
+        _mm256_storeu_ps(yf + j, f);
+        _mm256_storeu_ps(yo + j, o);
+        _mm256_storeu_ps(yc + j, c);
+        _mm256_storeu_ps(yh + j, h);
+        _mm256_storeu_ps(ym + j, _mm256_mul_ps(h, o));
+    }
+    LstmCellRowScalar<kApprox>(j, dim, cp, pic, pfc, poc,
+                               yg, yi, yf, yo, yc, yh, ym);
+}
+#endif
+
+template<bool kApprox>
+static inline void LstmCellRow(int32 dim, const float *cp,
+                               const float *pic, const float *pfc, const float *poc,
+                               float *yg, float *yi, float *yf, float *yo,
+                               float *yc, float *yh, float *ym) {
+#ifdef ASLP_NNET_HAVE_AVX2
+    if (CpuHasAvx2()) {
+        LstmCellRowAvx2<kApprox>(dim, cp, pic, pfc, poc,
+                                 yg, yi, yf, yo, yc, yh, ym);
+        return;
+    }
+#endif
+    LstmCellRowScalar<kApprox>(0, dim, cp, pic, pfc, poc,
+                               yg, yi, yf, yo, yc, yh, ym);
+}
+
+template<bool kApprox>
+static inline void LstmCellRow(int32 dim, const double *cp,
+                               const double *pic, const double *pfc, const double *poc,
+                               double *yg, double *yi, double *yf, double *yo,
+                               double *yc, double *yh, double *ym) {
+    LstmCellRowScalar<kApprox>(0, dim, cp, pic, pfc, poc,
+                               yg, yi, yf, yo, yc, yh, ym);
+}
+
+static void CheckCellDims(const CuMatrixBase<BaseFloat> &prev_c,
+                          const CuVectorBase<BaseFloat> *peephole_i_c,
+                          const CuVectorBase<BaseFloat> &peephole_f_c,
+                          const CuVectorBase<BaseFloat> &peephole_o_c,
+                          const CuMatrixBase<BaseFloat> *y_g,
+                          const CuMatrixBase<BaseFloat> *y_i,
+                          const CuMatrixBase<BaseFloat> *y_f,
+                          const CuMatrixBase<BaseFloat> *y_o,
+                          const CuMatrixBase<BaseFloat> *y_c,
+                          const CuMatrixBase<BaseFloat> *y_h,
+                          const CuMatrixBase<BaseFloat> *y_m) {
+    KALDI_ASSERT((y_i == NULL) == (peephole_i_c == NULL));
+    KALDI_ASSERT(SameDim(prev_c, *y_g) && SameDim(prev_c, *y_f) &&
+                 SameDim(prev_c, *y_o) && SameDim(prev_c, *y_c) &&
+                 SameDim(prev_c, *y_h) && SameDim(prev_c, *y_m));
+    KALDI_ASSERT(y_i == NULL || SameDim(prev_c, *y_i));
+    int32 ncell = prev_c.NumCols();
+    KALDI_ASSERT(peephole_f_c.Dim() == ncell && peephole_o_c.Dim() == ncell);
+    KALDI_ASSERT(peephole_i_c == NULL || peephole_i_c->Dim() == ncell);
+}
+
+void LstmCellForward(const CuMatrixBase<BaseFloat> &prev_c,
+                     const CuVectorBase<BaseFloat> *peephole_i_c,
+                     const CuVectorBase<BaseFloat> &peephole_f_c,
+                     const CuVectorBase<BaseFloat> &peephole_o_c,
+                     CuMatrixBase<BaseFloat> *y_g,
+                     CuMatrixBase<BaseFloat> *y_i,
+                     CuMatrixBase<BaseFloat> *y_f,
+                     CuMatrixBase<BaseFloat> *y_o,
+                     CuMatrixBase<BaseFloat> *y_c,
+                     CuMatrixBase<BaseFloat> *y_h,
+                     CuMatrixBase<BaseFloat> *y_m,
+                     bool approx) {
+#if HAVE_CUDA == 1
+    if (CuDevice::Instantiate().Enabled()) {
+        LstmCellForwardUnfused(prev_c, peephole_i_c, peephole_f_c, peephole_o_c,
+                               y_g, y_i, y_f, y_o, y_c, y_h, y_m);
+        return;
+    }
+#endif
+    CheckCellDims(prev_c, peephole_i_c, peephole_f_c, peephole_o_c,
+                  y_g, y_i, y_f, y_o, y_c, y_h, y_m);
+    int32 S = prev_c.NumRows(), ncell = prev_c.NumCols();
+    const BaseFloat *pic = peephole_i_c != NULL ? peephole_i_c->Data() : NULL,
+                    *pfc = peephole_f_c.Data(), *poc = peephole_o_c.Data();
+    for (int32 s = 0; s < S; s++) {
+        BaseFloat *yi = y_i != NULL ? y_i->RowData(s) : NULL;
+        if (approx) {
+            LstmCellRow<true>(ncell, prev_c.RowData(s), pic, pfc, poc,
+                              y_g->RowData(s), yi, y_f->RowData(s),
+                              y_o->RowData(s), y_c->RowData(s),
+                              y_h->RowData(s), y_m->RowData(s));
+        } else {
+            LstmCellRow<false>(ncell, prev_c.RowData(s), pic, pfc, poc,
+                               y_g->RowData(s), yi, y_f->RowData(s),
+                               y_o->RowData(s), y_c->RowData(s),
+                               y_h->RowData(s), y_m->RowData(s));
+        }
+    }
+}
+
+void LstmCellForwardUnfused(const CuMatrixBase<BaseFloat> &prev_c,
+                            const CuVectorBase<BaseFloat> *peephole_i_c,
+                            const CuVectorBase<BaseFloat> &peephole_f_c,
+                            const CuVectorBase<BaseFloat> &peephole_o_c,
+                            CuMatrixBase<BaseFloat> *y_g,
+                            CuMatrixBase<BaseFloat> *y_i,
+                            CuMatrixBase<BaseFloat> *y_f,
+                            CuMatrixBase<BaseFloat> *y_o,
+                            CuMatrixBase<BaseFloat> *y_c,
+                            CuMatrixBase<BaseFloat> *y_h,
+                            CuMatrixBase<BaseFloat> *y_m) {
+    CheckCellDims(prev_c, peephole_i_c, peephole_f_c, peephole_o_c,
+                  y_g, y_i, y_f, y_o, y_c, y_h, y_m);
+    if (y_i != NULL) {
+        // c(t-1) -> i(t) via peephole
+        y_i->AddMatDiagVec(1.0, prev_c, kNoTrans, *peephole_i_c, 1.0);
+    }
+    // c(t-1) -> f(t) via peephole
+    y_f->AddMatDiagVec(1.0, prev_c, kNoTrans, peephole_f_c, 1.0);
+
+    // i, f sigmoid squashing
+    if (y_i != NULL) y_i->Sigmoid(*y_i);
+    y_f->Sigmoid(*y_f);
+
+    // g tanh squashing
+    y_g->Tanh(*y_g);
+
+    if (y_i != NULL) {
+        // g -> c
+        y_c->AddMatMatElements(1.0, *y_g, *y_i, 0.0);
+    } else {
+        // for coupled input and forget gate, y_i = 1 - y_f
+        y_c->AddMatMatElements(-1.0, *y_g, *y_f, 0.0);
+        y_c->AddMat(1.0, *y_g);
+    }
+
+    // c(t-1) -> c(t) via forget-gate
+    y_c->AddMatMatElements(1.0, prev_c, *y_f, 1.0);
+
+    y_c->ApplyFloor(-kCellClip);
+    y_c->ApplyCeiling(kCellClip);
+
+    // h tanh squashing
+    y_h->Tanh(*y_c);
+
+    // c(t) -> o(t) via peephole (non-recurrent) & o squashing
+    y_o->AddMatDiagVec(1.0, *y_c, kNoTrans, peephole_o_c, 1.0);
+
+    // o sigmoid squashing
+    y_o->Sigmoid(*y_o);
+
+    // h -> m via output gate
+    y_m->AddMatMatElements(1.0, *y_h, *y_o, 0.0);
+}
+
+} // namespace aslp_nnet
+} // namespace kaldi
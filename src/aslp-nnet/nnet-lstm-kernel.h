@@ -0,0 +1,64 @@
+// aslp-nnet/nnet-lstm-kernel.h
+
+/* Fused lstm cell kernel
+ *
+ * Once the x(t) and r(t-1) contribution are added to the g, i, f, o gates,
+ * the rest of the time step(peepholes, squashing, clipping and the cell
+ * update) is a dozen of elementwise CuMatrix ops, every one of which is a
+ * memory pass over the gate buffers. On CPU LstmCellForward() does them all
+ * in one pass over every row, with AVX2 when the cpu supports it. On GPU it
+ * runs the original CuMatrix ops(LstmCellForwardUnfused()).
+ *
+ * It's shared by LstmProjectedStreams, BLstmProjectedStreams,
+ * BLstmProjectedStreamsLC, LstmCifgProjectedStreams, Lstm and BLstm.
+ */
+
+#ifndef ASLP_NNET_NNET_LSTM_KERNEL_H_
+#define ASLP_NNET_NNET_LSTM_KERNEL_H_
+
+#include "aslp-cudamatrix/cu-device.h"
+#include "aslp-cudamatrix/cu-matrix.h"
+#include "aslp-cudamatrix/cu-vector.h"
+
+namespace kaldi {
+namespace aslp_nnet {
+
+// One time step of S streams, every matrix is S x ncell.
+// prev_c: c of the previous time step(t-1, or t+1 for the backward direction)
+// y_g, y_i, y_f, y_o: in gate activations before squashing, out after.
+// y_c, y_h, y_m: out.
+// For the coupled input and forget gate lstm, y_i and peephole_i_c are NULL,
+// and the input gate is 1 - f.
+// approx: use the fast approximate sigmoid/tanh on CPU(see
+// nnet-approx-activation.h), for inference only.
+void LstmCellForward(const CuMatrixBase<BaseFloat> &prev_c,
+                     const CuVectorBase<BaseFloat> *peephole_i_c,
+                     const CuVectorBase<BaseFloat> &peephole_f_c,
+                     const CuVectorBase<BaseFloat> &peephole_o_c,
+                     CuMatrixBase<BaseFloat> *y_g,
+                     CuMatrixBase<BaseFloat> *y_i,
+                     CuMatrixBase<BaseFloat> *y_f,
+                     CuMatrixBase<BaseFloat> *y_o,
+                     CuMatrixBase<BaseFloat> *y_c,
+                     CuMatrixBase<BaseFloat> *y_h,
+                     CuMatrixBase<BaseFloat> *y_m,
+                     bool approx = false);
+
+// The same computation in separate CuMatrix ops, as the components did
+// before, it's used on GPU and as the reference in nnet-component-test
+void LstmCellForwardUnfused(const CuMatrixBase<BaseFloat> &prev_c,
+                            const CuVectorBase<BaseFloat> *peephole_i_c,
+                            const CuVectorBase<BaseFloat> &peephole_f_c,
+                            const CuVectorBase<BaseFloat> &peephole_o_c,
+                            CuMatrixBase<BaseFloat> *y_g,
+                            CuMatrixBase<BaseFloat> *y_i,
+                            CuMatrixBase<BaseFloat> *y_f,
+                            CuMatrixBase<BaseFloat> *y_o,
+                            CuMatrixBase<BaseFloat> *y_c,
+                            CuMatrixBase<BaseFloat> *y_h,
+                            CuMatrixBase<BaseFloat> *y_m);
+
+} // namespace aslp_nnet
+} // namespace kaldi
+
+#endif
@@ -25,6 +25,8 @@
 
 #include "aslp-nnet/nnet-component.h"
 #include "aslp-nnet/nnet-utils.h"
+#include "aslp-nnet/nnet-lstm-kernel.h"
+#include "aslp-nnet/nnet-quantize.h"
 #include "aslp-cudamatrix/cu-math.h"
 
 /*************************************
@@ -136,14 +138,31 @@ class LstmProjectedStreams : public UpdatableComponent {
     //ExpectToken(is, binary, "<DropoutRate>");
     //ReadBasicType(is, binary, &dropout_rate_);
 
-    w_gifo_x_.Read(is, binary);
-    w_gifo_r_.Read(is, binary);
+    // optional int8 weights, inference only
+    bool quantized = false;
+    if ('<' == Peek(is, binary)) {
+      ExpectToken(is, binary, "<Quantized>");
+      quantized = true;
+    }
+
+    if (quantized) {
+      w_gifo_x_int8_.Read(is, binary);
+      w_gifo_r_int8_.Read(is, binary);
+    } else {
+      w_gifo_x_.Read(is, binary);
+      w_gifo_r_.Read(is, binary);
+    }
     bias_.Read(is, binary);
 
     peephole_i_c_.Read(is, binary);
     peephole_f_c_.Read(is, binary);
     peephole_o_c_.Read(is, binary);
 
+    if (quantized) {
+      w_r_m_int8_.Read(is, binary);
+      // no training, so no delta buffers
+      return;
+    }
     w_r_m_.Read(is, binary);
 
     // init delta buffers
@@ -166,37 +185,58 @@ class LstmProjectedStreams : public UpdatableComponent {
     //WriteToken(os, binary, "<DropoutRate>");
     //WriteBasicType(os, binary, dropout_rate_);
 
-    w_gifo_x_.Write(os, binary);
-    w_gifo_r_.Write(os, binary);
+    if (IsQuantized()) {
+      WriteToken(os, binary, "<Quantized>");
+      w_gifo_x_int8_.Write(os, binary);
+      w_gifo_r_int8_.Write(os, binary);
+    } else {
+      w_gifo_x_.Write(os, binary);
+      w_gifo_r_.Write(os, binary);
+    }
     bias_.Write(os, binary);
 
     peephole_i_c_.Write(os, binary);
     peephole_f_c_.Write(os, binary);
     peephole_o_c_.Write(os, binary);
 
-    w_r_m_.Write(os, binary);
+    if (IsQuantized()) {
+      w_r_m_int8_.Write(os, binary);
+    } else {
+      w_r_m_.Write(os, binary);
+    }
   }
 
   int32 NumParams() const {
-    return ( w_gifo_x_.NumRows() * w_gifo_x_.NumCols() +
-         w_gifo_r_.NumRows() * w_gifo_r_.NumCols() +
+    // the dims don't depend on the weight format
+    return ( 4*ncell_ * input_dim_ +
+         4*ncell_ * nrecur_ +
          bias_.Dim() +
          peephole_i_c_.Dim() +
          peephole_f_c_.Dim() +
          peephole_o_c_.Dim() +
-         w_r_m_.NumRows() * w_r_m_.NumCols() );
+         nrecur_ * ncell_ );
+  }
+
+  int64 ParamBytes() const {
+    if (!IsQuantized()) return UpdatableComponent::ParamBytes();
+    return w_gifo_x_int8_.SizeInBytes() + w_gifo_r_int8_.SizeInBytes() +
+        w_r_m_int8_.SizeInBytes() +
+        (bias_.Dim() + peephole_i_c_.Dim() + peephole_f_c_.Dim() +
+         peephole_o_c_.Dim()) * sizeof(BaseFloat);
   }
 
   void GetParams(Vector<BaseFloat>* wei_copy) const {
     wei_copy->Resize(NumParams());
 
     int32 offset, len;
+    Matrix<BaseFloat> w_gifo_x, w_gifo_r, w_r_m;
+    GetFloatWeights(&w_gifo_x, &w_gifo_r, &w_r_m);
 
-    offset = 0;  len = w_gifo_x_.NumRows() * w_gifo_x_.NumCols();
-    wei_copy->Range(offset, len).CopyRowsFromMat(w_gifo_x_);
+    offset = 0;  len = w_gifo_x.NumRows() * w_gifo_x.NumCols();
+    wei_copy->Range(offset, len).CopyRowsFromMat(w_gifo_x);
 
-    offset += len; len = w_gifo_r_.NumRows() * w_gifo_r_.NumCols();
-    wei_copy->Range(offset, len).CopyRowsFromMat(w_gifo_r_);
+    offset += len; len = w_gifo_r.NumRows() * w_gifo_r.NumCols();
+    wei_copy->Range(offset, len).CopyRowsFromMat(w_gifo_r);
 
     offset += len; len = bias_.Dim();
     wei_copy->Range(offset, len).CopyFromVec(bias_);
@@ -210,13 +250,14 @@ class LstmProjectedStreams : public UpdatableComponent {
     offset += len; len = peephole_o_c_.Dim();
     wei_copy->Range(offset, len).CopyFromVec(peephole_o_c_);
 
-    offset += len; len = w_r_m_.NumRows() * w_r_m_.NumCols();
-    wei_copy->Range(offset, len).CopyRowsFromMat(w_r_m_);
+    offset += len; len = w_r_m.NumRows() * w_r_m.NumCols();
+    wei_copy->Range(offset, len).CopyRowsFromMat(w_r_m);
 
     return;
   }
 
   void GetGpuParams(std::vector<std::pair<BaseFloat *, int> > *params) {
+    CheckNotQuantized();
     params->clear();
     params->push_back(std::make_pair(w_gifo_x_.Data(), w_gifo_x_.NumRows() * w_gifo_x_.Stride()));
     params->push_back(std::make_pair(w_gifo_r_.Data(), w_gifo_r_.NumRows() * w_gifo_r_.Stride()));
@@ -228,14 +269,16 @@ class LstmProjectedStreams : public UpdatableComponent {
   }
 
   std::string Info() const {
-    return std::string("  ") +
-      "\n  w_gifo_x_  "   + MomentStatistics(w_gifo_x_) +
-      "\n  w_gifo_r_  "   + MomentStatistics(w_gifo_r_) +
+    Matrix<BaseFloat> w_gifo_x, w_gifo_r, w_r_m;
+    GetFloatWeights(&w_gifo_x, &w_gifo_r, &w_r_m);
+    return std::string("  ") + (IsQuantized() ? "int8 weights" : "") +
+      "\n  w_gifo_x_  "   + MomentStatistics(w_gifo_x) +
+      "\n  w_gifo_r_  "   + MomentStatistics(w_gifo_r) +
       "\n  bias_  "     + MomentStatistics(bias_) +
       "\n  peephole_i_c_  " + MomentStatistics(peephole_i_c_) +
       "\n  peephole_f_c_  " + MomentStatistics(peephole_f_c_) +
       "\n  peephole_o_c_  " + MomentStatistics(peephole_o_c_) +
-      "\n  w_r_m_  "    + MomentStatistics(w_r_m_);
+      "\n  w_r_m_  "    + MomentStatistics(w_r_m);
   }
 
   std::string InfoGradient() const {
@@ -310,9 +353,19 @@ class LstmProjectedStreams : public UpdatableComponent {
     prev_nnet_state_.Resize(nstream_, 7*ncell_ + 1*nrecur_, kSetZero);
   }
 
-  void PropagateFnc(const CuMatrixBase<BaseFloat> &in, CuMatrixBase<BaseFloat> *out) {
-    int DEBUG = 0;
+  // Per-stream recurrent state (one row per stream), used to swap the
+  // histories of different decoding streams in and out of a shared component
+  int32 StreamStateDim() const { return 7*ncell_ + 1*nrecur_; }
+  void GetLstmStreamState(CuMatrix<BaseFloat> *state) const {
+    *state = prev_nnet_state_;
+  }
+  void SetLstmStreamState(const CuMatrixBase<BaseFloat> &state) {
+    KALDI_ASSERT(state.NumCols() == StreamStateDim());
+    nstream_ = state.NumRows();
+    prev_nnet_state_ = state;
+  }
 
+  void PropagateFnc(const CuMatrixBase<BaseFloat> &in, CuMatrixBase<BaseFloat> *out) {
     static bool do_stream_reset = false;
     if (nstream_ == 0) {
       do_stream_reset = true;
@@ -322,29 +375,48 @@ class LstmProjectedStreams : public UpdatableComponent {
     }
     if (do_stream_reset) prev_nnet_state_.SetZero();
     KALDI_ASSERT(nstream_ > 0);
+    KALDI_ASSERT(prev_nnet_state_.NumRows() == nstream_);
+    PropagateState(in, out, &prev_nnet_state_, &propagate_buf_);
+  }
 
-    KALDI_ASSERT(in.NumRows() % nstream_ == 0);
-    int32 T = in.NumRows() / nstream_;
-    int32 S = nstream_;
+  // Forward with external recurrent state(one row per stream) and
+  // activation buffer, the parameters are only read, so one component
+  // can be shared by several decoding threads holding their own state
+  void PropagateState(const CuMatrixBase<BaseFloat> &in, CuMatrixBase<BaseFloat> *out,
+                      CuMatrix<BaseFloat> *prev_state,
+                      CuMatrix<BaseFloat> *buf) const {
+    int DEBUG = 0;
+    CuMatrix<BaseFloat> &prev_nnet_state = *prev_state;
+    CuMatrix<BaseFloat> &propagate_buf = *buf;
+
+    int32 S = prev_state->NumRows();
+    KALDI_ASSERT(S > 0);
+    KALDI_ASSERT(in.NumRows() % S == 0);
+    int32 T = in.NumRows() / S;
 
     // 0:forward pass history, [1, T]:current sequence, T+1:dummy
-    propagate_buf_.Resize((T+2)*S, 7 * ncell_ + nrecur_, kSetZero);
-    propagate_buf_.RowRange(0*S,S).CopyFromMat(prev_nnet_state_);
+    propagate_buf.Resize((T+2)*S, 7 * ncell_ + nrecur_, kSetZero);
+    propagate_buf.RowRange(0*S,S).CopyFromMat(prev_nnet_state);
 
     // disassemble entire neuron activation buffer into different neurons
-    CuSubMatrix<BaseFloat> YG(propagate_buf_.ColRange(0*ncell_, ncell_));
-    CuSubMatrix<BaseFloat> YI(propagate_buf_.ColRange(1*ncell_, ncell_));
-    CuSubMatrix<BaseFloat> YF(propagate_buf_.ColRange(2*ncell_, ncell_));
-    CuSubMatrix<BaseFloat> YO(propagate_buf_.ColRange(3*ncell_, ncell_));
-    CuSubMatrix<BaseFloat> YC(propagate_buf_.ColRange(4*ncell_, ncell_));
-    CuSubMatrix<BaseFloat> YH(propagate_buf_.ColRange(5*ncell_, ncell_));
-    CuSubMatrix<BaseFloat> YM(propagate_buf_.ColRange(6*ncell_, ncell_));
-    CuSubMatrix<BaseFloat> YR(propagate_buf_.ColRange(7*ncell_, nrecur_));
+    CuSubMatrix<BaseFloat> YG(propagate_buf.ColRange(0*ncell_, ncell_));
+    CuSubMatrix<BaseFloat> YI(propagate_buf.ColRange(1*ncell_, ncell_));
+    CuSubMatrix<BaseFloat> YF(propagate_buf.ColRange(2*ncell_, ncell_));
+    CuSubMatrix<BaseFloat> YO(propagate_buf.ColRange(3*ncell_, ncell_));
+    CuSubMatrix<BaseFloat> YC(propagate_buf.ColRange(4*ncell_, ncell_));
+    CuSubMatrix<BaseFloat> YH(propagate_buf.ColRange(5*ncell_, ncell_));
+    CuSubMatrix<BaseFloat> YM(propagate_buf.ColRange(6*ncell_, ncell_));
+    CuSubMatrix<BaseFloat> YR(propagate_buf.ColRange(7*ncell_, nrecur_));
 
-    CuSubMatrix<BaseFloat> YGIFO(propagate_buf_.ColRange(0, 4*ncell_));
+    CuSubMatrix<BaseFloat> YGIFO(propagate_buf.ColRange(0, 4*ncell_));
 
     // x -> g, i, f, o, not recurrent, do it all in once
-    YGIFO.RowRange(1*S,T*S).AddMatMat(1.0, in, kNoTrans, w_gifo_x_, kTrans, 0.0);
+    if (IsQuantized()) {
+      CuSubMatrix<BaseFloat> y_gifo_x(YGIFO.RowRange(1*S,T*S));
+      AddMatQuantizedMat(1.0, in, w_gifo_x_int8_, 0.0, &y_gifo_x);
+    } else {
+      YGIFO.RowRange(1*S,T*S).AddMatMat(1.0, in, kNoTrans, w_gifo_x_, kTrans, 0.0);
+    }
     //// LSTM forward dropout
     //// Google paper 2014: Recurrent Neural Network Regularization
     //// by Wojciech Zaremba, Ilya Sutskever, Oriol Vinyals
@@ -373,44 +445,24 @@ class LstmProjectedStreams : public UpdatableComponent {
       CuSubMatrix<BaseFloat> y_gifo(YGIFO.RowRange(t*S,S));
 
       // r(t-1) -> g, i, f, o
-      y_gifo.AddMatMat(1.0, YR.RowRange((t-1)*S,S), kNoTrans, w_gifo_r_, kTrans,  1.0);
-
-      // c(t-1) -> i(t) via peephole
-      y_i.AddMatDiagVec(1.0, YC.RowRange((t-1)*S,S), kNoTrans, peephole_i_c_, 1.0);
-
-      // c(t-1) -> f(t) via peephole
-      y_f.AddMatDiagVec(1.0, YC.RowRange((t-1)*S,S), kNoTrans, peephole_f_c_, 1.0);
-
-      // i, f sigmoid squashing
-      y_i.Sigmoid(y_i);
-      y_f.Sigmoid(y_f);
-
-      // g tanh squashing
-      y_g.Tanh(y_g);
-
-      // g -> c
-      y_c.AddMatMatElements(1.0, y_g, y_i, 0.0);
-
-      // c(t-1) -> c(t) via forget-gate
-      y_c.AddMatMatElements(1.0, YC.RowRange((t-1)*S,S), y_f, 1.0);
-
-      y_c.ApplyFloor(-50);   // optional clipping of cell activation
-      y_c.ApplyCeiling(50);  // google paper Interspeech2014: LSTM for LVCSR
-
-      // h tanh squashing
-      y_h.Tanh(y_c);
-
-      // c(t) -> o(t) via peephole (non-recurrent) & o squashing
-      y_o.AddMatDiagVec(1.0, y_c, kNoTrans, peephole_o_c_, 1.0);
-
-      // o sigmoid squashing
-      y_o.Sigmoid(y_o);
+      if (IsQuantized()) {
+        AddMatQuantizedMat(1.0, YR.RowRange((t-1)*S,S), w_gifo_r_int8_, 1.0, &y_gifo);
+      } else {
+        y_gifo.AddMatMat(1.0, YR.RowRange((t-1)*S,S), kNoTrans, w_gifo_r_, kTrans,  1.0);
+      }
 
-      // h -> m via output gate
-      y_m.AddMatMatElements(1.0, y_h, y_o, 0.0);
+      // peepholes, squashing, c(t-1) -> c(t) and h -> m via output gate,
+      // fused into one pass on CPU, see nnet-lstm-kernel.h
+      LstmCellForward(YC.RowRange((t-1)*S,S), &peephole_i_c_, peephole_f_c_, peephole_o_c_,
+                      &y_g, &y_i, &y_f, &y_o, &y_c, &y_h, &y_m,
+                      approx_activation_);
 
       // m -> r
-      y_r.AddMatMat(1.0, y_m, kNoTrans, w_r_m_, kTrans, 0.0);
+      if (IsQuantized()) {
+        AddMatQuantizedMat(1.0, y_m, w_r_m_int8_, 0.0, &y_r);
+      } else {
+        y_r.AddMatMat(1.0, y_m, kNoTrans, w_r_m_, kTrans, 0.0);
+      }
 
       if (DEBUG) {
         std::cerr << "forward-pass frame " << t << "\n";
@@ -429,11 +481,12 @@ class LstmProjectedStreams : public UpdatableComponent {
     out->CopyFromMat(YR.RowRange(1*S,T*S));
 
     // now the last frame state becomes previous network state for next batch
-    prev_nnet_state_.CopyFromMat(propagate_buf_.RowRange(T*S,S));
+    prev_nnet_state.CopyFromMat(propagate_buf.RowRange(T*S,S));
   }
 
   void BackpropagateFnc(const CuMatrixBase<BaseFloat> &in, const CuMatrixBase<BaseFloat> &out,
               const CuMatrixBase<BaseFloat> &out_diff, CuMatrixBase<BaseFloat> *in_diff) {
+    CheckNotQuantized();
 
     int DEBUG = 0;
 
@@ -617,6 +670,7 @@ class LstmProjectedStreams : public UpdatableComponent {
   }
 
   void Update(const CuMatrixBase<BaseFloat> &input, const CuMatrixBase<BaseFloat> &diff) {
+    CheckNotQuantized();
     const BaseFloat lr  = opts_.learn_rate;
 
     w_gifo_x_.AddMat(-lr, w_gifo_x_corr_);
@@ -692,7 +746,45 @@ class LstmProjectedStreams : public UpdatableComponent {
 //
   }
 
+  /// Switch w_gifo_x_, w_gifo_r_ and w_r_m_ to int8(see nnet-quantize.h),
+  /// for inference only, the float weights and the training buffers are freed
+  void Quantize() {
+    if (IsQuantized()) return;
+    w_gifo_x_int8_.Quantize(w_gifo_x_);
+    w_gifo_r_int8_.Quantize(w_gifo_r_);
+    w_r_m_int8_.Quantize(w_r_m_);
+    w_gifo_x_.Resize(0, 0); w_gifo_x_corr_.Resize(0, 0);
+    w_gifo_r_.Resize(0, 0); w_gifo_r_corr_.Resize(0, 0);
+    w_r_m_.Resize(0, 0); w_r_m_corr_.Resize(0, 0);
+    bias_corr_.Resize(0);
+    peephole_i_c_corr_.Resize(0);
+    peephole_f_c_corr_.Resize(0);
+    peephole_o_c_corr_.Resize(0);
+  }
+
+  bool IsQuantized() const { return w_gifo_x_int8_.NumRows() > 0; }
+
  private:
+  void CheckNotQuantized() const {
+    if (IsQuantized()) KALDI_ERR << "The int8 LstmProjectedStreams is for inference only";
+  }
+
+  void GetFloatWeights(Matrix<BaseFloat> *w_gifo_x, Matrix<BaseFloat> *w_gifo_r,
+                       Matrix<BaseFloat> *w_r_m) const {
+    if (IsQuantized()) {
+      w_gifo_x_int8_.Dequantize(w_gifo_x);
+      w_gifo_r_int8_.Dequantize(w_gifo_r);
+      w_r_m_int8_.Dequantize(w_r_m);
+    } else {
+      w_gifo_x->Resize(w_gifo_x_.NumRows(), w_gifo_x_.NumCols());
+      w_gifo_x_.CopyToMat(w_gifo_x);
+      w_gifo_r->Resize(w_gifo_r_.NumRows(), w_gifo_r_.NumCols());
+      w_gifo_r_.CopyToMat(w_gifo_r);
+      w_r_m->Resize(w_r_m_.NumRows(), w_r_m_.NumCols());
+      w_r_m_.CopyToMat(w_r_m);
+    }
+  }
+
   // dims
   int32 ncell_;
   int32 nrecur_;  ///< recurrent projection layer dim
@@ -733,6 +825,11 @@ class LstmProjectedStreams : public UpdatableComponent {
   CuMatrix<BaseFloat> w_r_m_;
   CuMatrix<BaseFloat> w_r_m_corr_;
 
+  // int8 w_gifo_x_, w_gifo_r_ and w_r_m_ once quantized
+  QuantizedMatrix w_gifo_x_int8_;
+  QuantizedMatrix w_gifo_r_int8_;
+  QuantizedMatrix w_r_m_int8_;
+
   // propagate buffer: output of [g, i, f, o, c, h, m, r]
   CuMatrix<BaseFloat> propagate_buf_;
 
@@ -464,6 +464,82 @@ void Nnet::SetDropoutRetention(BaseFloat r)  {
 }
 
 
+void Nnet::SetApproxActivation(bool approx) {
+  for (int32 c = 0; c < NumComponents(); c++) {
+    GetComponent(c).SetApproxActivation(approx);
+  }
+}
+
+void Nnet::Quantize() {
+  for (int32 c = 0; c < NumComponents(); c++) {
+    switch (GetComponent(c).GetType()) {
+      case Component::kAffineTransform:
+        dynamic_cast<AffineTransform&>(GetComponent(c)).Quantize();
+        break;
+      case Component::kLstmProjectedStreams:
+        dynamic_cast<LstmProjectedStreams&>(GetComponent(c)).Quantize();
+        break;
+      default:
+        break;
+    }
+  }
+}
+
+// Frames the input of component c lags behind the nnet input, given the
+// output delays of the components before it, all its inputs must agree
+static int32 InputStreamingDelay(const Component &comp,
+                                 const std::vector<int32> &out_delay) {
+  int32 delay = 0;
+  if (comp.GetType() == Component::kInputLayer) return delay;
+  const std::vector<int32> &input_idx = comp.GetInput();
+  for (size_t j = 0; j < input_idx.size(); j++) {
+    if (j > 0 && out_delay[input_idx[j]] != delay) {
+      KALDI_ERR << "Inputs of component " << comp.GetName()
+                << " have different streaming delays " << delay << " and "
+                << out_delay[input_idx[j]] << ", can't stream the FSMN";
+    }
+    delay = out_delay[input_idx[j]];
+  }
+  return delay;
+}
+
+void Nnet::SetFsmnStreaming(bool streaming) {
+  std::vector<int32> out_delay(NumComponents(), 0);
+  for (int32 c = 0; c < NumComponents(); c++) {
+    int32 delay = InputStreamingDelay(GetComponent(c), out_delay);
+    if (GetComponent(c).GetType() == Component::kCompactFsmn) {
+      CompactFsmn& comp = dynamic_cast<CompactFsmn&>(GetComponent(c));
+      comp.SetStreaming(streaming, delay);
+      if (streaming) delay += comp.FutureContext();
+    }
+    out_delay[c] = delay;
+  }
+}
+
+int32 Nnet::FsmnStreamingDelay() const {
+  if (NumComponents() == 0) return 0;
+  std::vector<int32> out_delay(NumComponents(), 0);
+  for (int32 c = 0; c < NumComponents(); c++) {
+    int32 delay = InputStreamingDelay(GetComponent(c), out_delay);
+    if (GetComponent(c).GetType() == Component::kCompactFsmn) {
+      const CompactFsmn& comp = dynamic_cast<const CompactFsmn&>(GetComponent(c));
+      if (comp.IsStreaming()) delay += comp.FutureContext();
+    }
+    out_delay[c] = delay;
+  }
+  KALDI_ASSERT(output_.size() == 1);
+  return out_delay[output_[0]];
+}
+
+void Nnet::SetFsmnStreamEnd(const std::vector<int32> &num_frames) {
+  for (int32 c = 0; c < NumComponents(); c++) {
+    if (GetComponent(c).GetType() == Component::kCompactFsmn) {
+      CompactFsmn& comp = dynamic_cast<CompactFsmn&>(GetComponent(c));
+      if (comp.IsStreaming()) comp.SetStreamEnd(num_frames);
+    }
+  }
+}
+
 void Nnet::ResetLstmStreams(const std::vector<int32> &stream_reset_flag) {
   for (int32 c=0; c < NumComponents(); c++) {
     if (GetComponent(c).GetType() == Component::kLstmProjectedStreams) {
@@ -486,7 +562,91 @@ void Nnet::ResetLstmStreams(const std::vector<int32> &stream_reset_flag) {
       LstmCifgProjectedStreams& comp = dynamic_cast<LstmCifgProjectedStreams&>(GetComponent(c));
       comp.ResetLstmStreams(stream_reset_flag);
     }
+    else if (GetComponent(c).GetType() == Component::kCompactFsmn) {
+      CompactFsmn& comp = dynamic_cast<CompactFsmn&>(GetComponent(c));
+      comp.ResetStreams(stream_reset_flag);
+    }
+  }
+}
+
+void Nnet::LstmStreamStateDims(std::vector<int32> *dims) const {
+  KALDI_ASSERT(dims != NULL);
+  dims->clear();
+  for (int32 c=0; c < NumComponents(); c++) {
+    const Component &comp = GetComponent(c);
+    switch (comp.GetType()) {
+      case Component::kLstmProjectedStreams:
+        dims->push_back(dynamic_cast<const LstmProjectedStreams&>(comp).StreamStateDim());
+        break;
+      case Component::kLstm:
+        dims->push_back(dynamic_cast<const Lstm&>(comp).StreamStateDim());
+        break;
+      case Component::kGruStreams:
+        dims->push_back(dynamic_cast<const GruStreams&>(comp).StreamStateDim());
+        break;
+      case Component::kLstmCifgProjectedStreams:
+        dims->push_back(dynamic_cast<const LstmCifgProjectedStreams&>(comp).StreamStateDim());
+        break;
+      default:
+        break;
+    }
+  }
+}
+
+void Nnet::GetLstmStreamState(std::vector<CuMatrix<BaseFloat> > *state) const {
+  KALDI_ASSERT(state != NULL);
+  std::vector<int32> dims;
+  LstmStreamStateDims(&dims);
+  state->resize(dims.size());
+  int32 k = 0;
+  for (int32 c=0; c < NumComponents(); c++) {
+    const Component &comp = GetComponent(c);
+    switch (comp.GetType()) {
+      case Component::kLstmProjectedStreams:
+        dynamic_cast<const LstmProjectedStreams&>(comp).GetLstmStreamState(&(*state)[k++]);
+        break;
+      case Component::kLstm:
+        dynamic_cast<const Lstm&>(comp).GetLstmStreamState(&(*state)[k++]);
+        break;
+      case Component::kGruStreams:
+        dynamic_cast<const GruStreams&>(comp).GetLstmStreamState(&(*state)[k++]);
+        break;
+      case Component::kLstmCifgProjectedStreams:
+        dynamic_cast<const LstmCifgProjectedStreams&>(comp).GetLstmStreamState(&(*state)[k++]);
+        break;
+      default:
+        break;
+    }
+  }
+  KALDI_ASSERT(k == dims.size());
+}
+
+void Nnet::SetLstmStreamState(const std::vector<CuMatrix<BaseFloat> > &state) {
+  int32 k = 0;
+  for (int32 c=0; c < NumComponents(); c++) {
+    Component &comp = GetComponent(c);
+    switch (comp.GetType()) {
+      case Component::kLstmProjectedStreams:
+        KALDI_ASSERT(k < state.size());
+        dynamic_cast<LstmProjectedStreams&>(comp).SetLstmStreamState(state[k++]);
+        break;
+      case Component::kLstm:
+        KALDI_ASSERT(k < state.size());
+        dynamic_cast<Lstm&>(comp).SetLstmStreamState(state[k++]);
+        break;
+      case Component::kGruStreams:
+        KALDI_ASSERT(k < state.size());
+        dynamic_cast<GruStreams&>(comp).SetLstmStreamState(state[k++]);
+        break;
+      case Component::kLstmCifgProjectedStreams:
+        KALDI_ASSERT(k < state.size());
+        dynamic_cast<LstmCifgProjectedStreams&>(comp).SetLstmStreamState(state[k++]);
+        break;
+      default:
+        break;
+    }
   }
+  KALDI_ASSERT(k == state.size());
 }
 
 void Nnet::SetSeqLengths(const std::vector<int32> &sequence_lengths) {
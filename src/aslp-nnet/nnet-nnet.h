@@ -74,6 +74,10 @@ class Nnet {
     return output_.size();
   }
 
+  /// Component index of the i-th input(InputLayer) and the i-th output
+  int32 InputIndex(int32 i) const { return input_[i]; }
+  int32 OutputIndex(int32 i) const { return output_[i]; }
+
   /// Returns number of components-- think of this as similar to # of layers, but
   /// e.g. the nonlinearity and the linear part count as separate components,
   /// so the number of components will be more than the number of layers.
@@ -123,8 +127,33 @@ class Nnet {
 
   /// Set the dropout rate
   void SetDropoutRetention(BaseFloat r);
+  /// Use the fast approximate sigmoid/tanh in all the components(CPU
+  /// inference only, see nnet-approx-activation.h)
+  void SetApproxActivation(bool approx);
+  /// Switch the weights of AffineTransform and LstmProjectedStreams to int8
+  /// (inference only, see nnet-quantize.h)
+  void Quantize();
+  /// Streaming CompactFsmn inference(CPU only, see CompactFsmn::SetStreaming()),
+  /// the FSMN memory crosses the chunks fed to Feedforward() and the output
+  /// lags FsmnStreamingDelay() frames behind the input, the sum of the
+  /// future contexts along the path. The layers between the FSMNs must be
+  /// frame-wise, recurrent layers after an FSMN would see the leading zero
+  /// frames of the delay.
+  void SetFsmnStreaming(bool streaming);
+  /// Frames the output lags behind the input, 0 if not streaming
+  int32 FsmnStreamingDelay() const;
+  /// Number of frames of every stream, -1 for the streams not ended, see
+  /// CompactFsmn::SetStreamEnd()
+  void SetFsmnStreamEnd(const std::vector<int32> &num_frames);
   /// Reset streams in LSTM multi-stream training,
   void ResetLstmStreams(const std::vector<int32> &stream_reset_flag);
+  /// Dims of the per-stream state of each streaming recurrent component
+  /// (Lstm, LstmProjectedStreams, GruStreams...), empty for feedforward nets
+  void LstmStreamStateDims(std::vector<int32> *dims) const;
+  /// Get the per-stream state, one (nstream x dim) matrix per recurrent component
+  void GetLstmStreamState(std::vector<CuMatrix<BaseFloat> > *state) const;
+  /// Set the per-stream state, also sets the number of streams
+  void SetLstmStreamState(const std::vector<CuMatrix<BaseFloat> > &state);
 
   /// set sequence length in LSTM multi-stream training
   void SetSeqLengths(const std::vector<int32> &sequence_lengths);
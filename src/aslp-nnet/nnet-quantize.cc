@@ -0,0 +1,207 @@
+// aslp-nnet/nnet-quantize.cc
+
+#include <algorithm>
+
+#include "aslp-nnet/nnet-quantize.h"
+#include "aslp-nnet/nnet-simd-math.h"
+
+namespace kaldi {
+namespace aslp_nnet {
+
+// q = round(x / scale) with scale = max(|x|) / 127, an all zero row gets
+// scale 0, returns the scale
+static BaseFloat QuantizeRow(const BaseFloat *x, int32 dim, int8_t *q) {
+    BaseFloat max_abs = 0.0;
+    for (int32 j = 0; j < dim; j++) {
+        max_abs = std::max(max_abs, std::abs(x[j]));
+    }
+    if (max_abs == 0.0) {
+        std::fill(q, q + dim, 0);
+        return 0.0;
+    }
+    BaseFloat inv_scale = 127.0 / max_abs;
+    for (int32 j = 0; j < dim; j++) {
+        int32 v = static_cast<int32>(floor(x[j] * inv_scale + 0.5));
+        q[j] = static_cast<int8_t>(std::min(127, std::max(-127, v)));
+    }
+    return max_abs / 127.0;
+}
+
+void QuantizedMatrix::Resize(int32 num_rows, int32 num_cols) {
+    num_rows_ = num_rows;
+    num_cols_ = num_cols;
+    stride_ = (num_cols + 31) / 32 * 32;
+    data_.assign(static_cast<size_t>(num_rows) * stride_, 0);
+    scale_.assign(num_rows, 0.0);
+}
+
+void QuantizedMatrix::Quantize(const CuMatrixBase<BaseFloat> &mat) {
+    Matrix<BaseFloat> host(mat);
+    Resize(host.NumRows(), host.NumCols());
+    for (int32 r = 0; r < num_rows_; r++) {
+        scale_[r] = QuantizeRow(host.RowData(r), num_cols_, &data_[r * stride_]);
+    }
+}
+
+void QuantizedMatrix::Dequantize(Matrix<BaseFloat> *mat) const {
+    mat->Resize(num_rows_, num_cols_, kUndefined);
+    for (int32 r = 0; r < num_rows_; r++) {
+        const int8_t *q = RowData(r);
+        BaseFloat *w = mat->RowData(r);
+        for (int32 c = 0; c < num_cols_; c++) {
+            w[c] = scale_[r] * q[c];
+        }
+    }
+}
+
+void QuantizedMatrix::Read(std::istream &is, bool binary) {
+    int32 num_rows, num_cols;
+    ExpectToken(is, binary, "<QuantizedMatrix>");
+    ReadBasicType(is, binary, &num_rows);
+    ReadBasicType(is, binary, &num_cols);
+    Vector<BaseFloat> scale;
+    scale.Read(is, binary);
+    std::vector<int8_t> data;
+    ReadIntegerVector(is, binary, &data);
+    if (scale.Dim() != num_rows ||
+        data.size() != static_cast<size_t>(num_rows) * num_cols) {
+        KALDI_ERR << "Corrupted QuantizedMatrix, " << num_rows << " x "
+                  << num_cols << " with " << scale.Dim() << " scales and "
+                  << data.size() << " weights";
+    }
+    Resize(num_rows, num_cols);
+    for (int32 r = 0; r < num_rows_; r++) {
+        scale_[r] = scale(r);
+        std::copy(data.begin() + r * num_cols_, data.begin() + (r + 1) * num_cols_,
+                  data_.begin() + r * stride_);
+    }
+}
+
+void QuantizedMatrix::Write(std::ostream &os, bool binary) const {
+    WriteToken(os, binary, "<QuantizedMatrix>");
+    WriteBasicType(os, binary, num_rows_);
+    WriteBasicType(os, binary, num_cols_);
+    Vector<BaseFloat> scale(num_rows_);
+    std::vector<int8_t> data(static_cast<size_t>(num_rows_) * num_cols_);
+    for (int32 r = 0; r < num_rows_; r++) {
+        scale(r) = scale_[r];
+        std::copy(RowData(r), RowData(r) + num_cols_, data.begin() + r * num_cols_);
+    }
+    scale.Write(os, binary);
+    WriteIntegerVector(os, binary, data);
+}
+
+// Rows of the input quantized together, every weight row is loaded once per block
+static const int32 kRowBlock = 4;
+
+// acc(i, c) = x(i, :) . w(c, :) for the kRowBlock rows of x
+static void DotRowsScalar(const int8_t *x, const QuantizedMatrix &w, int32 *acc) {
+    int32 num_out = w.NumRows(), stride = w.Stride();
+    for (int32 i = 0; i < kRowBlock; i++) {
+        const int8_t *xi = x + i * stride;
+        for (int32 c = 0; c < num_out; c++) {
+            const int8_t *wc = w.RowData(c);
+            int32 sum = 0;
+            for (int32 j = 0; j < stride; j++) {
+                sum += static_cast<int32>(xi[j]) * wc[j];
+            }
+            acc[i * num_out + c] = sum;
+        }
+    }
+}
+
+#ifdef ASLP_NNET_HAVE_AVX2
+// maddubs multiplies unsigned by signed bytes, so multiply |w| by x with
+// the sign of w, the pair sums are at most 2 * 127 * 127 and fit in int16
+ASLP_INLINE_AVX2
+static inline __m256i DotStep(__m256i acc, __m256i w_abs, __m256i w, __m256i x) {
+    __m256i p = _mm256_maddubs_epi16(w_abs, _mm256_sign_epi8(x, w));
+    return _mm256_add_epi32(acc, _mm256_madd_epi16(p, _mm256_set1_epi16(1)));
+}
+
+ASLP_INLINE_AVX2
+static inline int32 HorizontalSum(__m256i v) {
+    __m128i s = _mm_add_epi32(_mm256_castsi256_si128(v),
+                              _mm256_extracti128_si256(v, 1));
+    s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0x4e));
+    s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0xb1));
+    return _mm_cvtsi128_si32(s);
+}
+
+ASLP_TARGET_AVX2
+static void DotRowsAvx2(const int8_t *x, const QuantizedMatrix &w, int32 *acc) {
+    int32 num_out = w.NumRows(), stride = w.Stride();
+    const int8_t *x0 = x, *x1 = x + stride, *x2 = x + 2 * stride, *x3 = x + 3 * stride;
+    for (int32 c = 0; c < num_out; c++) {
+        const int8_t *wc = w.RowData(c);
+        __m256i a0 = _mm256_setzero_si256(), a1 = a0, a2 = a0, a3 = a0;
+        for (int32 j = 0; j < stride; j += 32) {
+            __m256i wv = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(wc + j));
+            __m256i wa = _mm256_sign_epi8(wv, wv);
+            a0 = DotStep(a0, wa, wv, _mm256_loadu_si256(reinterpret_cast<const __m256i *>(x0 + j)));
+            a1 = DotStep(a1, wa, wv, _mm256_loadu_si256(reinterpret_cast<const __m256i *>(x1 + j)));
+            a2 = DotStep(a2, wa, wv, _mm256_loadu_si256(reinterpret_cast<const __m256i *>(x2 + j)));
+            a3 = DotStep(a3, wa, wv, _mm256_loadu_si256(reinterpret_cast<const __m256i *>(x3 + j)));
+        }
+        acc[c] = HorizontalSum(a0);
+        acc[num_out + c] = HorizontalSum(a1);
+        acc[2 * num_out + c] = HorizontalSum(a2);
+        acc[3 * num_out + c] = HorizontalSum(a3);
+    }
+}
+#endif
+
+static inline void DotRows(const int8_t *x, const QuantizedMatrix &w, int32 *acc) {
+#ifdef ASLP_NNET_HAVE_AVX2
+    if (CpuHasAvx2()) {
+        DotRowsAvx2(x, w, acc);
+        return;
+    }
+#endif
+    DotRowsScalar(x, w, acc);
+}
+
+void AddMatQuantizedMat(BaseFloat alpha, const CuMatrixBase<BaseFloat> &in,
+                        const QuantizedMatrix &w, BaseFloat beta,
+                        CuMatrixBase<BaseFloat> *out) {
+    KALDI_ASSERT(in.NumCols() == w.NumCols());
+    KALDI_ASSERT(out->NumRows() == in.NumRows() && out->NumCols() == w.NumRows());
+#if HAVE_CUDA == 1
+    if (CuDevice::Instantiate().Enabled()) {
+        Matrix<BaseFloat> mat;
+        w.Dequantize(&mat);
+        CuMatrix<BaseFloat> cu_mat(mat);
+        out->AddMatMat(alpha, in, kNoTrans, cu_mat, kTrans, beta);
+        return;
+    }
+#endif
+    int32 num_rows = in.NumRows(), num_cols = in.NumCols(),
+          num_out = w.NumRows(), stride = w.Stride();
+    // local buffers, the components call it from shared const forward passes
+    std::vector<int8_t> x(kRowBlock * stride, 0);
+    std::vector<int32> acc(kRowBlock * num_out);
+    BaseFloat x_scale[kRowBlock];
+    for (int32 r = 0; r < num_rows; r += kRowBlock) {
+        int32 n = std::min(kRowBlock, num_rows - r);
+        for (int32 i = 0; i < kRowBlock; i++) {
+            if (i < n) {
+                x_scale[i] = QuantizeRow(in.RowData(r + i), num_cols, &x[i * stride]);
+            } else {
+                std::fill(x.begin() + i * stride, x.begin() + (i + 1) * stride, 0);
+            }
+        }
+        DotRows(&x[0], w, &acc[0]);
+        for (int32 i = 0; i < n; i++) {
+            BaseFloat *y = out->RowData(r + i);
+            const int32 *a = &acc[i * num_out];
+            BaseFloat row_scale = alpha * x_scale[i];
+            for (int32 c = 0; c < num_out; c++) {
+                BaseFloat v = row_scale * w.Scale(c) * a[c];
+                y[c] = (beta == 0.0 ? v : v + beta * y[c]);
+            }
+        }
+    }
+}
+
+} // namespace aslp_nnet
+} // namespace kaldi
@@ -0,0 +1,70 @@
+// aslp-nnet/nnet-quantize.h
+
+/* Int8 weight matrices for CPU inference
+ *
+ * QuantizedMatrix keeps a weight matrix W(rows x cols) as int8 with one
+ * scale per row, w(r, c) ~= scale(r) * q(r, c) with q in [-127, 127], which
+ * is about 4x less memory than float. AddMatQuantizedMat() computes
+ * out = alpha * in * W^T + beta * out the same way: every row of in is
+ * quantized on the fly with its own scale, the dot products are accumulated
+ * in int32(AVX2 when the cpu supports it) and scaled back to float.
+ *
+ * AffineTransform and LstmProjectedStreams switch their weights to it with
+ * Quantize()(Nnet::Quantize(), or the aslp-nnet-quantize converter), a
+ * quantized component can only do the forward pass. On GPU the weights
+ * are dequantized for every call, the format is meant for CPU servers.
+ */
+
+#ifndef ASLP_NNET_NNET_QUANTIZE_H_
+#define ASLP_NNET_NNET_QUANTIZE_H_
+
+#include <stdint.h>
+#include <vector>
+
+#include "aslp-cudamatrix/cu-device.h"
+#include "aslp-cudamatrix/cu-matrix.h"
+
+namespace kaldi {
+namespace aslp_nnet {
+
+class QuantizedMatrix {
+ public:
+  QuantizedMatrix(): num_rows_(0), num_cols_(0), stride_(0) { }
+
+  // Quantize with the per row scale max(|w(r, :)|) / 127
+  void Quantize(const CuMatrixBase<BaseFloat> &mat);
+  void Dequantize(Matrix<BaseFloat> *mat) const;
+
+  int32 NumRows() const { return num_rows_; }
+  int32 NumCols() const { return num_cols_; }
+  // Row r, zero padded to Stride()
+  const int8_t *RowData(int32 r) const { return &data_[r * stride_]; }
+  int32 Stride() const { return stride_; }
+  BaseFloat Scale(int32 r) const { return scale_[r]; }
+  // Memory of the weights and the scales
+  size_t SizeInBytes() const {
+    return data_.size() * sizeof(int8_t) + scale_.size() * sizeof(BaseFloat);
+  }
+
+  void Read(std::istream &is, bool binary);
+  void Write(std::ostream &os, bool binary) const;
+
+ private:
+  void Resize(int32 num_rows, int32 num_cols);
+
+  int32 num_rows_, num_cols_;
+  // num_cols_ rounded up to 32(one AVX2 register), so the kernel has no tail
+  int32 stride_;
+  std::vector<int8_t> data_;
+  std::vector<BaseFloat> scale_;
+};
+
+// out = alpha * in * W^T + beta * out, W is the quantized matrix
+void AddMatQuantizedMat(BaseFloat alpha, const CuMatrixBase<BaseFloat> &in,
+                        const QuantizedMatrix &w, BaseFloat beta,
+                        CuMatrixBase<BaseFloat> *out);
+
+} // namespace aslp_nnet
+} // namespace kaldi
+
+#endif
@@ -35,15 +35,18 @@ struct NnetDataRandomizerOptions {
   int32 randomizer_size; // Maximum number of samples we want to have in memory at once.
   int32 randomizer_seed;
   int32 minibatch_size;  // Size of a single mini-batch.
+  int32 prefetch_utts;  // Utterances read ahead by FrameDataReader's thread.
 
   NnetDataRandomizerOptions()
-   : randomizer_size(32768), randomizer_seed(777), minibatch_size(256) 
+   : randomizer_size(32768), randomizer_seed(777), minibatch_size(256),
+     prefetch_utts(64)
   { }
 
   void Register(OptionsItf *opts) {
     opts->Register("randomizer-size", &randomizer_size, "Capacity of randomizer, length of concatenated utterances which are used for frame-level shuffling (in frames, affects memory consumption, max 8000000).");
     opts->Register("randomizer-seed", &randomizer_seed, "Seed value for srand, sets fixed order of frame-level shuffling");
     opts->Register("minibatch-size", &minibatch_size, "Size of a minibatch.");
+    opts->Register("prefetch-utts", &prefetch_utts, "Number of utterances the background thread of the frame data reader reads ahead of the training (0, read in the training thread).");
   }
 };
 ///
@@ -4,6 +4,7 @@
 // Created on 2016-03-23
 
 #include "aslp-nnet/nnet-recurrent-component.h"
+#include "aslp-nnet/nnet-lstm-kernel.h"
 
 
 namespace kaldi {
@@ -232,6 +233,16 @@ void Lstm::SetSeqLengths(const std::vector<int32> &sequence_lengths) {
     prev_nnet_state_.Resize(nstream_, 7*ncell_, kSetZero);
 }
 
+void Lstm::GetLstmStreamState(CuMatrix<BaseFloat> *state) const {
+    *state = prev_nnet_state_;
+}
+
+void Lstm::SetLstmStreamState(const CuMatrixBase<BaseFloat> &state) {
+    KALDI_ASSERT(state.NumCols() == StreamStateDim());
+    nstream_ = state.NumRows();
+    prev_nnet_state_ = state;
+}
+
 void Lstm::PropagateFnc(const CuMatrixBase<BaseFloat> &in, CuMatrixBase<BaseFloat> *out) {
     static bool do_stream_reset = false;
     if (nstream_ == 0) {
@@ -242,25 +253,35 @@ void Lstm::PropagateFnc(const CuMatrixBase<BaseFloat> &in, CuMatrixBase<BaseFloa
     }
     if (do_stream_reset) prev_nnet_state_.SetZero();
     KALDI_ASSERT(nstream_ > 0);
+    KALDI_ASSERT(prev_nnet_state_.NumRows() == nstream_);
+    PropagateState(in, out, &prev_nnet_state_, &propagate_buf_);
+}
 
-    KALDI_ASSERT(in.NumRows() % nstream_ == 0);
-    int32 T = in.NumRows() / nstream_;
-    int32 S = nstream_;
+void Lstm::PropagateState(const CuMatrixBase<BaseFloat> &in, CuMatrixBase<BaseFloat> *out,
+                          CuMatrix<BaseFloat> *prev_state,
+                          CuMatrix<BaseFloat> *buf) const {
+    CuMatrix<BaseFloat> &prev_nnet_state = *prev_state;
+    CuMatrix<BaseFloat> &propagate_buf = *buf;
+
+    int32 S = prev_state->NumRows();
+    KALDI_ASSERT(S > 0);
+    KALDI_ASSERT(in.NumRows() % S == 0);
+    int32 T = in.NumRows() / S;
 
     // 0:forward pass history, [1, T]:current sequence, T+1:dummy
-    propagate_buf_.Resize((T+2)*S, 7 * ncell_, kSetZero);
-    propagate_buf_.RowRange(0*S,S).CopyFromMat(prev_nnet_state_);
+    propagate_buf.Resize((T+2)*S, 7 * ncell_, kSetZero);
+    propagate_buf.RowRange(0*S,S).CopyFromMat(prev_nnet_state);
 
     // disassemble entire neuron activation buffer into different neurons
-    CuSubMatrix<BaseFloat> YG(propagate_buf_.ColRange(0*ncell_, ncell_));
-    CuSubMatrix<BaseFloat> YI(propagate_buf_.ColRange(1*ncell_, ncell_));
-    CuSubMatrix<BaseFloat> YF(propagate_buf_.ColRange(2*ncell_, ncell_));
-    CuSubMatrix<BaseFloat> YO(propagate_buf_.ColRange(3*ncell_, ncell_));
-    CuSubMatrix<BaseFloat> YC(propagate_buf_.ColRange(4*ncell_, ncell_));
-    CuSubMatrix<BaseFloat> YH(propagate_buf_.ColRange(5*ncell_, ncell_));
-    CuSubMatrix<BaseFloat> YM(propagate_buf_.ColRange(6*ncell_, ncell_));
+    CuSubMatrix<BaseFloat> YG(propagate_buf.ColRange(0*ncell_, ncell_));
+    CuSubMatrix<BaseFloat> YI(propagate_buf.ColRange(1*ncell_, ncell_));
+    CuSubMatrix<BaseFloat> YF(propagate_buf.ColRange(2*ncell_, ncell_));
+    CuSubMatrix<BaseFloat> YO(propagate_buf.ColRange(3*ncell_, ncell_));
+    CuSubMatrix<BaseFloat> YC(propagate_buf.ColRange(4*ncell_, ncell_));
+    CuSubMatrix<BaseFloat> YH(propagate_buf.ColRange(5*ncell_, ncell_));
+    CuSubMatrix<BaseFloat> YM(propagate_buf.ColRange(6*ncell_, ncell_));
 
-    CuSubMatrix<BaseFloat> YGIFO(propagate_buf_.ColRange(0, 4*ncell_));
+    CuSubMatrix<BaseFloat> YGIFO(propagate_buf.ColRange(0, 4*ncell_));
 
     // x -> g, i, f, o, not recurrent, do it all in once
     YGIFO.RowRange(1*S,T*S).AddMatMat(1.0, in, kNoTrans, w_gifo_x_, kTrans, 0.0);
@@ -293,45 +314,17 @@ void Lstm::PropagateFnc(const CuMatrixBase<BaseFloat> &in, CuMatrixBase<BaseFloa
         // r(t-1) -> g, i, f, o
         y_gifo.AddMatMat(1.0, YM.RowRange((t-1)*S,S), kNoTrans, w_gifo_r_, kTrans,  1.0);
 
-        // c(t-1) -> i(t) via peephole
-        y_i.AddMatDiagVec(1.0, YC.RowRange((t-1)*S,S), kNoTrans, peephole_i_c_, 1.0);
-
-        // c(t-1) -> f(t) via peephole
-        y_f.AddMatDiagVec(1.0, YC.RowRange((t-1)*S,S), kNoTrans, peephole_f_c_, 1.0);
-
-        // i, f sigmoid squashing
-        y_i.Sigmoid(y_i);
-        y_f.Sigmoid(y_f);
-
-        // g tanh squashing
-        y_g.Tanh(y_g);
-
-        // g -> c
-        y_c.AddMatMatElements(1.0, y_g, y_i, 0.0);
-
-        // c(t-1) -> c(t) via forget-gate
-        y_c.AddMatMatElements(1.0, YC.RowRange((t-1)*S,S), y_f, 1.0);
-
-        y_c.ApplyFloor(-50);   // optional clipping of cell activation
-        y_c.ApplyCeiling(50);  // google paper Interspeech2014: LSTM for LVCSR
-
-        // h tanh squashing
-        y_h.Tanh(y_c);
-
-        // c(t) -> o(t) via peephole (non-recurrent) & o squashing
-        y_o.AddMatDiagVec(1.0, y_c, kNoTrans, peephole_o_c_, 1.0);
-
-        // o sigmoid squashing
-        y_o.Sigmoid(y_o);
-
-        // h -> m via output gate
-        y_m.AddMatMatElements(1.0, y_h, y_o, 0.0);
+        // peepholes, squashing, c(t-1) -> c(t) and h -> m via output gate,
+        // fused into one pass on CPU, see nnet-lstm-kernel.h
+        LstmCellForward(YC.RowRange((t-1)*S,S), &peephole_i_c_, peephole_f_c_, peephole_o_c_,
+                        &y_g, &y_i, &y_f, &y_o, &y_c, &y_h, &y_m,
+                        approx_activation_);
     }
 
     out->CopyFromMat(YM.RowRange(1*S,T*S));
 
     // now the last frame state becomes previous network state for next batch
-    prev_nnet_state_.CopyFromMat(propagate_buf_.RowRange(T*S,S));
+    prev_nnet_state.CopyFromMat(propagate_buf.RowRange(T*S,S));
 }
 
 void Lstm::BackpropagateFnc(const CuMatrixBase<BaseFloat> &in, const CuMatrixBase<BaseFloat> &out,
@@ -967,39 +960,11 @@ void BLstm::PropagateFnc(const CuMatrixBase<BaseFloat> &in,
         // r(t-1) -> g, i, f, o
         y_gifo.AddMatMat(1.0, F_YM.RowRange((t-1)*S, S), kNoTrans, f_w_gifo_r_, kTrans, 1.0);
 
-        // c(t-1) -> i(t) via peephole
-        y_i.AddMatDiagVec(1.0, F_YC.RowRange((t-1)*S, S), kNoTrans, f_peephole_i_c_, 1.0);
-
-        // c(t-1) -> f(t) via peephole
-        y_f.AddMatDiagVec(1.0, F_YC.RowRange((t-1)*S, S), kNoTrans, f_peephole_f_c_, 1.0);
-
-        // i, f sigmoid squashing
-        y_i.Sigmoid(y_i);
-        y_f.Sigmoid(y_f);
-
-        // g tanh squashing
-        y_g.Tanh(y_g);
-
-        // g -> c
-        y_c.AddMatMatElements(1.0, y_g, y_i, 0.0);
-
-        // c(t-1) -> c(t) via forget-gate
-        y_c.AddMatMatElements(1.0, F_YC.RowRange((t-1)*S, S), y_f, 1.0);
-
-        y_c.ApplyFloor(-50);   // optional clipping of cell activation
-        y_c.ApplyCeiling(50);  // google paper Interspeech2014: LSTM for LVCSR
-
-        // h tanh squashing
-        y_h.Tanh(y_c);
-
-        // c(t) -> o(t) via peephole (non-recurrent) & o squashing
-        y_o.AddMatDiagVec(1.0, y_c, kNoTrans, f_peephole_o_c_, 1.0);
-
-        // o sigmoid squashing
-        y_o.Sigmoid(y_o);
-
-        // h -> m via output gate
-        y_m.AddMatMatElements(1.0, y_h, y_o, 0.0);
+        // peepholes, squashing, c(t-1) -> c(t) and h -> m via output gate,
+        // fused into one pass on CPU, see nnet-lstm-kernel.h
+        LstmCellForward(F_YC.RowRange((t-1)*S, S), &f_peephole_i_c_, f_peephole_f_c_, f_peephole_o_c_,
+                        &y_g, &y_i, &y_f, &y_o, &y_c, &y_h, &y_m,
+                        approx_activation_);
 
         // set zeros
         // for (int s = 0; s < S; s++) {
@@ -1040,39 +1005,11 @@ void BLstm::PropagateFnc(const CuMatrixBase<BaseFloat> &in,
         // r(t+1) -> g, i, f, o
         y_gifo.AddMatMat(1.0, B_YM.RowRange((t+1)*S, S), kNoTrans, b_w_gifo_r_, kTrans, 1.0);
 
-        // c(t+1) -> i(t) via peephole
-        y_i.AddMatDiagVec(1.0, B_YC.RowRange((t+1)*S, S), kNoTrans, b_peephole_i_c_, 1.0);
-
-        // c(t+1) -> f(t) via peephole
-        y_f.AddMatDiagVec(1.0, B_YC.RowRange((t+1)*S, S), kNoTrans, b_peephole_f_c_, 1.0);
-
-        // i, f sigmoid squashing
-        y_i.Sigmoid(y_i);
-        y_f.Sigmoid(y_f);
-
-        // g tanh squashing
-        y_g.Tanh(y_g);
-
-        // g -> c
-        y_c.AddMatMatElements(1.0, y_g, y_i, 0.0);
-
-        // c(t+1) -> c(t) via forget-gate
-        y_c.AddMatMatElements(1.0, B_YC.RowRange((t+1)*S, S), y_f, 1.0);
-
-        y_c.ApplyFloor(-50);   // optional clipping of cell activation
-        y_c.ApplyCeiling(50);  // google paper Interspeech2014: LSTM for LVCSR
-
-        // h tanh squashing
-        y_h.Tanh(y_c);
-
-        // c(t) -> o(t) via peephole (non-recurrent) & o squashing
-        y_o.AddMatDiagVec(1.0, y_c, kNoTrans, b_peephole_o_c_, 1.0);
-
-        // o sigmoid squashing
-        y_o.Sigmoid(y_o);
-
-        // h -> m via output gate
-        y_m.AddMatMatElements(1.0, y_h, y_o, 0.0);
+        // peepholes, squashing, c(t+1) -> c(t) and h -> m via output gate,
+        // fused into one pass on CPU, see nnet-lstm-kernel.h
+        LstmCellForward(B_YC.RowRange((t+1)*S, S), &b_peephole_i_c_, b_peephole_f_c_, b_peephole_o_c_,
+                        &y_g, &y_i, &y_f, &y_o, &y_c, &y_h, &y_m,
+                        approx_activation_);
 
         for (int s = 0; s < S; s++) {
             if (t > sequence_lengths_[s])
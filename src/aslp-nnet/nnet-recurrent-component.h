@@ -51,8 +51,19 @@ public:
     void ResetLstmStreams(const std::vector<int32> &stream_reset_flag); 
     // For compatible with whole sentence train(like ctc train or lstm who sentence train
     void SetSeqLengths(const std::vector<int32> &sequence_lengths); 
+    // Per-stream recurrent state (one row per stream)
+    int32 StreamStateDim() const { return 7*ncell_; }
+    void GetLstmStreamState(CuMatrix<BaseFloat> *state) const;
+    void SetLstmStreamState(const CuMatrixBase<BaseFloat> &state);
     void PropagateFnc(const CuMatrixBase<BaseFloat> &in, 
                       CuMatrixBase<BaseFloat> *out); 
+    // Forward with external recurrent state(one row per stream) and
+    // activation buffer, the parameters are only read, so one component
+    // can be shared by several decoding threads holding their own state
+    void PropagateState(const CuMatrixBase<BaseFloat> &in,
+                        CuMatrixBase<BaseFloat> *out,
+                        CuMatrix<BaseFloat> *prev_state,
+                        CuMatrix<BaseFloat> *buf) const;
     void BackpropagateFnc(const CuMatrixBase<BaseFloat> &in, 
                           const CuMatrixBase<BaseFloat> &out,
                           const CuMatrixBase<BaseFloat> &out_diff, 
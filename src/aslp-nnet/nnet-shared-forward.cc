@@ -0,0 +1,199 @@
+// aslp-nnet/nnet-shared-forward.cc
+
+#include "aslp-nnet/nnet-shared-forward.h"
+#include "aslp-nnet/nnet-lstm-projected-streams.h"
+#include "aslp-nnet/nnet-lstm-couple-if-projected-streams.h"
+#include "aslp-nnet/nnet-gru-streams.h"
+#include "aslp-nnet/nnet-recurrent-component.h"
+#include "aslp-nnet/nnet-cfsmn-component.h"
+
+namespace kaldi {
+namespace aslp_nnet {
+
+static int32 StreamStateDim(const Component &comp) {
+  switch (comp.GetType()) {
+    case Component::kLstmProjectedStreams:
+      return dynamic_cast<const LstmProjectedStreams &>(comp).StreamStateDim();
+    case Component::kLstm:
+      return dynamic_cast<const Lstm &>(comp).StreamStateDim();
+    case Component::kGruStreams:
+      return dynamic_cast<const GruStreams &>(comp).StreamStateDim();
+    case Component::kLstmCifgProjectedStreams:
+      return dynamic_cast<const LstmCifgProjectedStreams &>(comp).StreamStateDim();
+    default:
+      KALDI_ERR << "Not a recurrent component "
+                << Component::TypeToMarker(comp.GetType());
+  }
+  return 0;
+}
+
+static int64 ParamBytes(const Component &comp) {
+  if (!comp.IsUpdatable()) return 0;
+  return dynamic_cast<const UpdatableComponent &>(comp).ParamBytes();
+}
+
+NnetSharedForward::NnetSharedForward(const Nnet &nnet): nnet_(nnet) {
+  if (nnet_.NumInput() != 1 || nnet_.NumOutput() != 1) {
+    KALDI_ERR << "Shared forward only supports nnet with one input "
+              << "and one output";
+  }
+  int32 num_comp = nnet_.NumComponents();
+  private_.resize(num_comp, NULL);
+  input_buf_.resize(num_comp);
+  output_buf_.resize(num_comp);
+  prev_state_.resize(num_comp);
+  propagate_buf_.resize(num_comp);
+  for (int32 c = 0; c < num_comp; c++) {
+    const Component &comp = nnet_.GetComponent(c);
+    if (IsRecurrent(comp)) {
+      prev_state_[c].Resize(1, StreamStateDim(comp), kSetZero);
+    } else if (!IsShareable(comp)) {
+      private_[c] = comp.Copy();
+    }
+  }
+}
+
+NnetSharedForward::~NnetSharedForward() {
+  for (int32 c = 0; c < private_.size(); c++) {
+    delete private_[c];
+  }
+}
+
+bool NnetSharedForward::IsShareable(const Component &comp) {
+  switch (comp.GetType()) {
+    case Component::kAffineTransform:
+    case Component::kLinearTransform:
+    case Component::kSoftmax:
+    case Component::kBlockSoftmax:
+    case Component::kSigmoid:
+    case Component::kTanh:
+    case Component::kReLU:
+    case Component::kSplice:
+    case Component::kCopy:
+    case Component::kAddShift:
+    case Component::kRescale:
+    case Component::kInputLayer:
+    case Component::kOutputLayer:
+    case Component::kScaleLayer:
+      return true;
+    default:
+      return IsRecurrent(comp);
+  }
+}
+
+bool NnetSharedForward::IsRecurrent(const Component &comp) {
+  switch (comp.GetType()) {
+    case Component::kLstmProjectedStreams:
+    case Component::kLstm:
+    case Component::kGruStreams:
+    case Component::kLstmCifgProjectedStreams:
+      return true;
+    default:
+      return false;
+  }
+}
+
+void NnetSharedForward::ResetState() {
+  for (int32 c = 0; c < prev_state_.size(); c++) {
+    prev_state_[c].SetZero();
+  }
+  // the CompactFsmn are never shared, the memory is in the private copies
+  for (int32 c = 0; c < private_.size(); c++) {
+    if (private_[c] != NULL && private_[c]->GetType() == Component::kCompactFsmn) {
+      dynamic_cast<CompactFsmn *>(private_[c])->ResetStreams(std::vector<int32>(1, 1));
+    }
+  }
+}
+
+void NnetSharedForward::SetStreamEnd(int32 num_frames) {
+  for (int32 c = 0; c < private_.size(); c++) {
+    if (private_[c] != NULL && private_[c]->GetType() == Component::kCompactFsmn) {
+      CompactFsmn *fsmn = dynamic_cast<CompactFsmn *>(private_[c]);
+      if (fsmn->IsStreaming()) {
+        fsmn->SetStreamEnd(std::vector<int32>(1, num_frames));
+      }
+    }
+  }
+}
+
+int64 NnetSharedForward::SharedParamBytes() const {
+  int64 bytes = 0;
+  for (int32 c = 0; c < private_.size(); c++) {
+    if (private_[c] == NULL) bytes += ParamBytes(nnet_.GetComponent(c));
+  }
+  return bytes;
+}
+
+int64 NnetSharedForward::PrivateParamBytes() const {
+  int64 bytes = 0;
+  for (int32 c = 0; c < private_.size(); c++) {
+    if (private_[c] != NULL) bytes += ParamBytes(*private_[c]);
+  }
+  return bytes;
+}
+
+void NnetSharedForward::PropagateRecurrent(int32 c,
+    const CuMatrixBase<BaseFloat> &in, CuMatrixBase<BaseFloat> *out) {
+  const Component &comp = nnet_.GetComponent(c);
+  CuMatrix<BaseFloat> *state = &prev_state_[c], *buf = &propagate_buf_[c];
+  switch (comp.GetType()) {
+    case Component::kLstmProjectedStreams:
+      dynamic_cast<const LstmProjectedStreams &>(comp).PropagateState(in, out, state, buf);
+      break;
+    case Component::kLstm:
+      dynamic_cast<const Lstm &>(comp).PropagateState(in, out, state, buf);
+      break;
+    case Component::kGruStreams:
+      dynamic_cast<const GruStreams &>(comp).PropagateState(in, out, state, buf);
+      break;
+    case Component::kLstmCifgProjectedStreams:
+      dynamic_cast<const LstmCifgProjectedStreams &>(comp).PropagateState(in, out, state, buf);
+      break;
+    default:
+      KALDI_ERR << "Not a recurrent component "
+                << Component::TypeToMarker(comp.GetType());
+  }
+}
+
+void NnetSharedForward::Feedforward(const CuMatrixBase<BaseFloat> &in,
+                                    CuMatrix<BaseFloat> *out) {
+  KALDI_ASSERT(NULL != out);
+  int32 num_comp = nnet_.NumComponents();
+  if (num_comp == 0) {
+    out->Resize(in.NumRows(), in.NumCols());
+    out->CopyFromMat(in);
+    return;
+  }
+  // Same as Nnet::Feedforward, but with the buffers here
+  int32 num_frame = in.NumRows();
+  for (int32 i = 0; i < num_comp; i++) {
+    input_buf_[i].Resize(num_frame, nnet_.GetComponent(i).InputDim(), kSetZero);
+  }
+  input_buf_[nnet_.InputIndex(0)].CopyFromMat(in);
+  for (int32 i = 0; i < num_comp; i++) {
+    const Component &comp = nnet_.GetComponent(i);
+    if (comp.GetType() != Component::kInputLayer) {
+      const std::vector<int32> &input_idx = comp.GetInput();
+      const std::vector<int32> &offset = comp.GetOffset();
+      KALDI_ASSERT(input_idx.size() == offset.size());
+      for (int j = 0; j < input_idx.size(); j++) {
+        int out_len = nnet_.GetComponent(input_idx[j]).OutputDim();
+        input_buf_[i].ColRange(offset[j], out_len).AddMat(1.0,
+            output_buf_[input_idx[j]]);
+      }
+    }
+    if (private_[i] != NULL) {
+      private_[i]->Feedforward(input_buf_[i], &output_buf_[i]);
+    } else if (IsRecurrent(comp)) {
+      output_buf_[i].Resize(num_frame, comp.OutputDim(), kSetZero);
+      PropagateRecurrent(i, input_buf_[i], &output_buf_[i]);
+    } else {
+      // The shareable components only read their parameters in forward
+      const_cast<Component &>(comp).Feedforward(input_buf_[i], &output_buf_[i]);
+    }
+  }
+  *out = output_buf_[nnet_.OutputIndex(0)];
+}
+
+} // namespace aslp_nnet
+} // namespace kaldi
@@ -0,0 +1,78 @@
+// aslp-nnet/nnet-shared-forward.h
+
+/* Forward of a nnet whose parameters are shared by several instances
+ *
+ * The online server used to make a deep copy of the am Nnet for every
+ * thread, because the Nnet and the components keep activation buffers and
+ * recurrent states, though the parameters are never changed in decoding.
+ * NnetSharedForward only references the components of one const Nnet and
+ * keeps all the per-stream things itself: the input/output buffers of every
+ * component, and the prev_nnet_state_/propagate_buf_ of the recurrent ones
+ * (forwarded by their PropagateState()). Components which modify their
+ * members in forward (eg. Dropout, BatchNormalization) are still copied.
+ */
+
+#ifndef ASLP_NNET_NNET_SHARED_FORWARD_H_
+#define ASLP_NNET_NNET_SHARED_FORWARD_H_
+
+#include <vector>
+
+#include "aslp-nnet/nnet-nnet.h"
+#include "aslp-nnet/nnet-decodable.h"
+
+namespace kaldi {
+namespace aslp_nnet {
+
+class NnetSharedForward : public NnetForwardInterface {
+ public:
+  /// The nnet is not copied, it must not be changed or deleted while the
+  /// object is alive, many objects can be created from one nnet
+  explicit NnetSharedForward(const Nnet &nnet);
+  ~NnetSharedForward();
+
+  virtual int32 OutputDim() const { return nnet_.OutputDim(); }
+
+  /// Forward one stream, the recurrent state is kept between calls
+  virtual void Feedforward(const CuMatrixBase<BaseFloat> &in,
+                           CuMatrix<BaseFloat> *out);
+
+  /// Zero the recurrent state and the streaming FSMN memory, call it when
+  /// a new utterance starts
+  void ResetState();
+
+  /// Streaming delay of the shared nnet, Nnet::SetFsmnStreaming() must be
+  /// called before the objects are created
+  virtual int32 StreamingDelay() const { return nnet_.FsmnStreamingDelay(); }
+  virtual void SetStreamEnd(int32 num_frames);
+  virtual void ResetStream() { ResetState(); }
+
+  /// Bytes of the parameters referenced from the shared nnet
+  int64 SharedParamBytes() const;
+  /// Bytes of the parameters of the private component copies
+  int64 PrivateParamBytes() const;
+
+  /// Return true if the component only reads its members in forward,
+  /// so it can be called by several threads at the same time
+  static bool IsShareable(const Component &comp);
+  /// Recurrent components forwarded by PropagateState() with the state here
+  static bool IsRecurrent(const Component &comp);
+
+ private:
+  void PropagateRecurrent(int32 c, const CuMatrixBase<BaseFloat> &in,
+                          CuMatrixBase<BaseFloat> *out);
+
+  const Nnet &nnet_;
+  /// Private copy of the component, NULL if shared
+  std::vector<Component *> private_;
+  /// Per component activation buffers
+  std::vector<CuMatrix<BaseFloat> > input_buf_, output_buf_;
+  /// Recurrent state(one row) and propagate buffer of recurrent components
+  std::vector<CuMatrix<BaseFloat> > prev_state_, propagate_buf_;
+
+  KALDI_DISALLOW_COPY_AND_ASSIGN(NnetSharedForward);
+};
+
+} // namespace aslp_nnet
+} // namespace kaldi
+
+#endif
@@ -0,0 +1,164 @@
+// aslp-nnet/nnet-simd-math.h
+
+/* Elementwise sigmoid/tanh for the CPU kernels(nnet-lstm-kernel.cc,
+ * nnet-approx-activation.cc), internal to aslp-nnet.
+ *
+ * ScalarSigmoid()/ScalarTanh() use the same formulas as VectorBase::Sigmoid()
+ * and VectorBase::Tanh(), Sigmoid256()/Tanh256() the same with a Cephes
+ * polynomial exp(about 1 ulp), so they agree with the CuMatrix ops within
+ * float rounding.
+ *
+ * The Fast versions are for the approximate activation mode: tanh is the
+ * [13/6] rational function on [-7.9, 7.9] Eigen uses, no exp at all, and
+ * sigmoid(x) = 0.5 + 0.5 * tanh(x / 2). See nnet-approx-activation.h for
+ * the max error.
+ *
+ * The AVX2 dispatch(target macros and CpuHasAvx2()) is in base/kaldi-simd.h,
+ * the ASLP_ names below are kept for the aslp-nnet code.
+ */
+
+#ifndef ASLP_NNET_NNET_SIMD_MATH_H_
+#define ASLP_NNET_NNET_SIMD_MATH_H_
+
+#include "base/kaldi-math.h"
+#include "base/kaldi-simd.h"
+
+#ifdef KALDI_HAVE_AVX2
+#define ASLP_NNET_HAVE_AVX2 1
+#endif
+
+namespace kaldi {
+namespace aslp_nnet {
+
+template<typename Real>
+static inline Real ScalarSigmoid(Real x) {
+    if (x > 0.0) {
+        return 1.0 / (1.0 + Exp(-x));
+    } else {
+        Real ex = Exp(x);
+        return ex / (ex + 1.0);
+    }
+}
+
+template<typename Real>
+static inline Real ScalarTanh(Real x) {
+    if (x > 0.0) {
+        Real inv_expx = Exp(-x);
+        return -1.0 + 2.0 / (1.0 + inv_expx * inv_expx);
+    } else {
+        Real inv_expx = Exp(x);
+        return 1.0 - 2.0 / (1.0 + inv_expx * inv_expx);
+    }
+}
+
+// tanh(7.9) is 1 in float precision
+static const float kFastTanhClamp = 7.90531110763549805f;
+
+template<typename Real>
+static inline Real ScalarFastTanh(Real x) {
+    if (x > kFastTanhClamp) x = kFastTanhClamp;
+    if (x < -kFastTanhClamp) x = -kFastTanhClamp;
+    Real x2 = x * x;
+    Real p = -2.76076847742355e-16f;
+    p = p * x2 + 2.00018790482477e-13f;
+    p = p * x2 + -8.60467152213735e-11f;
+    p = p * x2 + 5.12229709037114e-08f;
+    p = p * x2 + 1.48572235717979e-05f;
+    p = p * x2 + 6.37261928875436e-04f;
+    p = p * x2 + 4.89352455891786e-03f;
+    p = p * x;
+    Real q = 1.19825839466702e-06f;
+    q = q * x2 + 1.18534705686654e-04f;
+    q = q * x2 + 2.26843463243900e-03f;
+    q = q * x2 + 4.89352518554385e-03f;
+    return p / q;
+}
+
+template<typename Real>
+static inline Real ScalarFastSigmoid(Real x) {
+    return 0.5 + 0.5 * ScalarFastTanh<Real>(0.5 * x);
+}
+
+#ifdef ASLP_NNET_HAVE_AVX2
+#define ASLP_TARGET_AVX2 KALDI_TARGET_AVX2
+#define ASLP_INLINE_AVX2 KALDI_INLINE_AVX2
+
+// Cephes expf, about 1 ulp on [-88, 88]
+ASLP_INLINE_AVX2
+static inline __m256 Exp256(__m256 x) {
+    x = _mm256_min_ps(x, _mm256_set1_ps(88.3762626647949f));
+    x = _mm256_max_ps(x, _mm256_set1_ps(-88.3762626647949f));
+    __m256 fx = _mm256_fmadd_ps(x, _mm256_set1_ps(1.44269504088896341f),
+                                _mm256_set1_ps(0.5f));
+    fx = _mm256_floor_ps(fx);
+    x = _mm256_fnmadd_ps(fx, _mm256_set1_ps(0.693359375f), x);
+    x = _mm256_fnmadd_ps(fx, _mm256_set1_ps(-2.12194440e-4f), x);
+    __m256 z = _mm256_mul_ps(x, x);
+    __m256 y = _mm256_set1_ps(1.9875691500e-4f);
+    y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(1.3981999507e-3f));
+    y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(8.3334519073e-3f));
+    y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(4.1665795894e-2f));
+    y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(1.6666665459e-1f));
+    y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(5.0000001201e-1f));
+    y = _mm256_fmadd_ps(y, z, _mm256_add_ps(x, _mm256_set1_ps(1.0f)));
+    __m256i n = _mm256_add_epi32(_mm256_cvttps_epi32(fx), _mm256_set1_epi32(127));
+    n = _mm256_slli_epi32(n, 23);
+    return _mm256_mul_ps(y, _mm256_castsi256_ps(n));
+}
+
+// Both only exponentiate -|x| like the scalar version to avoid overflow
+ASLP_INLINE_AVX2
+static inline __m256 Sigmoid256(__m256 x) {
+    const __m256 sign_mask = _mm256_set1_ps(-0.0f);
+    const __m256 one = _mm256_set1_ps(1.0f);
+    __m256 e = Exp256(_mm256_or_ps(x, sign_mask)); // exp(-|x|)
+    __m256 pos = _mm256_div_ps(one, _mm256_add_ps(one, e));
+    __m256 neg = _mm256_div_ps(e, _mm256_add_ps(e, one));
+    return _mm256_blendv_ps(neg, pos,
+                            _mm256_cmp_ps(x, _mm256_setzero_ps(), _CMP_GT_OQ));
+}
+
+ASLP_INLINE_AVX2
+static inline __m256 Tanh256(__m256 x) {
+    const __m256 sign_mask = _mm256_set1_ps(-0.0f);
+    const __m256 one = _mm256_set1_ps(1.0f);
+    __m256 e = Exp256(_mm256_or_ps(x, sign_mask)); // exp(-|x|)
+    // tanh(|x|) = -1 + 2 / (1 + exp(-|x|)^2)
+    __m256 t = _mm256_sub_ps(_mm256_div_ps(_mm256_set1_ps(2.0f),
+                                           _mm256_fmadd_ps(e, e, one)), one);
+    return _mm256_or_ps(t, _mm256_and_ps(x, sign_mask));
+}
+
+ASLP_INLINE_AVX2
+static inline __m256 FastTanh256(__m256 x) {
+    x = _mm256_min_ps(x, _mm256_set1_ps(kFastTanhClamp));
+    x = _mm256_max_ps(x, _mm256_set1_ps(-kFastTanhClamp));
+    __m256 x2 = _mm256_mul_ps(x, x);
+    __m256 p = _mm256_set1_ps(-2.76076847742355e-16f);
+    p = _mm256_fmadd_ps(p, x2, _mm256_set1_ps(2.00018790482477e-13f));
+    p = _mm256_fmadd_ps(p, x2, _mm256_set1_ps(-8.60467152213735e-11f));
+    p = _mm256_fmadd_ps(p, x2, _mm256_set1_ps(5.12229709037114e-08f));
+    p = _mm256_fmadd_ps(p, x2, _mm256_set1_ps(1.48572235717979e-05f));
+    p = _mm256_fmadd_ps(p, x2, _mm256_set1_ps(6.37261928875436e-04f));
+    p = _mm256_fmadd_ps(p, x2, _mm256_set1_ps(4.89352455891786e-03f));
+    p = _mm256_mul_ps(p, x);
+    __m256 q = _mm256_set1_ps(1.19825839466702e-06f);
+    q = _mm256_fmadd_ps(q, x2, _mm256_set1_ps(1.18534705686654e-04f));
+    q = _mm256_fmadd_ps(q, x2, _mm256_set1_ps(2.26843463243900e-03f));
+    q = _mm256_fmadd_ps(q, x2, _mm256_set1_ps(4.89352518554385e-03f));
+    return _mm256_div_ps(p, q);
+}
+
+ASLP_INLINE_AVX2
+static inline __m256 FastSigmoid256(__m256 x) {
+    const __m256 half = _mm256_set1_ps(0.5f);
+    return _mm256_fmadd_ps(half, FastTanh256(_mm256_mul_ps(half, x)), half);
+}
+
+using kaldi::CpuHasAvx2;
+#endif
+
+} // namespace aslp_nnet
+} // namespace kaldi
+
+#endif
@@ -0,0 +1,203 @@
+// aslp-nnetbin/aslp-nnet-approx-check.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "base/kaldi-common.h"
+#include "util/common-utils.h"
+#include "base/timer.h"
+
+#include "aslp-nnet/nnet-nnet.h"
+#include "aslp-nnet/nnet-approx-activation.h"
+#include "aslp-nnet/nnet-lstm-kernel.h"
+
+namespace kaldi {
+namespace aslp_nnet {
+
+// Time the exact and approximate version of every activation type on a
+// rows x dim random matrix
+static void BenchmarkActivations(int32 rows, int32 dim, int32 iters) {
+  CuMatrix<BaseFloat> in(rows, dim), out(rows, dim);
+  in.SetRandn();
+  in.Scale(4.0);
+  // lstm cell step, rows streams of dim cells, 3 sigmoid + 2 tanh per cell
+  CuMatrix<BaseFloat> buf(rows, 7 * dim);
+  CuSubMatrix<BaseFloat> g(buf.ColRange(0, dim)), i(buf.ColRange(dim, dim)),
+      f(buf.ColRange(2 * dim, dim)), o(buf.ColRange(3 * dim, dim)),
+      c(buf.ColRange(4 * dim, dim)), h(buf.ColRange(5 * dim, dim)),
+      m(buf.ColRange(6 * dim, dim));
+  CuVector<BaseFloat> peephole(dim);
+  peephole.Set(0.1);
+  double elements = static_cast<double>(rows) * dim * iters;
+  for (int32 type = 0; type < 3; type++) {
+    double seconds[2];
+    for (int32 approx = 0; approx < 2; approx++) {
+      Timer timer;
+      for (int32 n = 0; n < iters; n++) {
+        if (type == 0) {
+          if (approx) ApproxSigmoid(in, &out);
+          else out.Sigmoid(in);
+        } else if (type == 1) {
+          if (approx) ApproxTanh(in, &out);
+          else out.Tanh(in);
+        } else {
+          // the gates are overwritten, start from the same input every time
+          g.CopyFromMat(in);
+          i.CopyFromMat(in);
+          f.CopyFromMat(in);
+          o.CopyFromMat(in);
+          LstmCellForward(in, &peephole, peephole, peephole,
+                          &g, &i, &f, &o, &c, &h, &m, approx == 1);
+        }
+      }
+      seconds[approx] = timer.Elapsed();
+    }
+    const char *name[] = { "sigmoid", "tanh", "lstm-cell" };
+    KALDI_LOG << "Benchmark " << name[type] << ": exact "
+              << elements / seconds[0] / 1e6 << " M/s, approx "
+              << elements / seconds[1] / 1e6 << " M/s, speedup "
+              << seconds[0] / seconds[1];
+  }
+}
+
+} // namespace aslp_nnet
+} // namespace kaldi
+
+int main(int argc, char *argv[]) {
+  using namespace kaldi;
+  using namespace kaldi::aslp_nnet;
+  typedef kaldi::int32 int32;
+  try {
+    const char *usage =
+        "Check the fast approximate sigmoid/tanh mode (--approx-activation of\n"
+        "aslp-nnet-forward) against the exact forward pass: max abs difference,\n"
+        "KL divergence and frame argmax agreement of the nnet output, forward\n"
+        "speed of both, and a speed benchmark of every activation type.\n"
+        "For WER, decode the output of aslp-nnet-forward with and without\n"
+        "--approx-activation.\n"
+        "\n"
+        "Usage:  aslp-nnet-approx-check [options] <model-in> <feature-rspecifier>\n"
+        "e.g.: \n"
+        " aslp-nnet-approx-check final.nnet ark:features.ark\n";
+
+    ParseOptions po(usage);
+
+    std::string feature_transform;
+    po.Register("feature-transform", &feature_transform, "Feature transform in front of main network (in nnet format)");
+    int32 benchmark_rows = 16, benchmark_dim = 1024, benchmark_iters = 1000;
+    po.Register("benchmark-rows", &benchmark_rows, "Rows (streams x frames) of the activation benchmark, 0 to skip it");
+    po.Register("benchmark-dim", &benchmark_dim, "Dim of the activation benchmark");
+    po.Register("benchmark-iters", &benchmark_iters, "Iterations of the activation benchmark");
+
+    po.Read(argc, argv);
+
+    if (po.NumArgs() != 2) {
+      po.PrintUsage();
+      exit(1);
+    }
+
+    std::string model_filename = po.GetArg(1),
+        feature_rspecifier = po.GetArg(2);
+
+    if (benchmark_rows > 0) {
+      BenchmarkActivations(benchmark_rows, benchmark_dim, benchmark_iters);
+    }
+
+    Nnet nnet_transf;
+    if (feature_transform != "") {
+      nnet_transf.Read(feature_transform);
+    }
+    nnet_transf.SetDropoutRetention(1.0);
+
+    Nnet nnet_exact, nnet_approx;
+    nnet_exact.Read(model_filename);
+    nnet_exact.SetDropoutRetention(1.0);
+    nnet_approx = nnet_exact;
+    nnet_approx.SetApproxActivation(true);
+
+    SequentialBaseFloatMatrixReader feature_reader(feature_rspecifier);
+
+    CuMatrix<BaseFloat> feats, feats_transf, out_exact, out_approx;
+    double time_exact = 0.0, time_approx = 0.0;
+    double tot_kl = 0.0, max_diff = 0.0;
+    int64 tot_frames = 0, num_argmax_diff = 0;
+    bool is_posterior = true;
+    int32 num_done = 0;
+    for (; !feature_reader.Done(); feature_reader.Next()) {
+      std::string utt = feature_reader.Key();
+      feats = feature_reader.Value();
+      nnet_transf.Feedforward(feats, &feats_transf);
+      std::vector<int32> frame_num_utt(1, feats_transf.NumRows());
+
+      Timer timer;
+      nnet_exact.SetSeqLengths(frame_num_utt);
+      nnet_exact.Feedforward(feats_transf, &out_exact);
+      time_exact += timer.Elapsed();
+
+      timer.Reset();
+      nnet_approx.SetSeqLengths(frame_num_utt);
+      nnet_approx.Feedforward(feats_transf, &out_approx);
+      time_approx += timer.Elapsed();
+
+      Matrix<BaseFloat> exact(out_exact), approx(out_approx);
+      // KL(exact || approx) only makes sense for posteriors
+      if (is_posterior && !(exact.Min() >= 0.0 && exact.Max() <= 1.0)) {
+        is_posterior = false;
+      }
+      double utt_diff = 0.0, utt_kl = 0.0;
+      int32 utt_argmax_diff = 0;
+      for (int32 r = 0; r < exact.NumRows(); r++) {
+        MatrixIndexT argmax_exact = 0, argmax_approx = 0;
+        exact.Row(r).Max(&argmax_exact);
+        approx.Row(r).Max(&argmax_approx);
+        if (argmax_exact != argmax_approx) utt_argmax_diff++;
+        for (int32 c = 0; c < exact.NumCols(); c++) {
+          double p = exact(r, c), q = approx(r, c);
+          utt_diff = std::max(utt_diff, std::abs(p - q));
+          if (is_posterior && p > 0.0) {
+            utt_kl += p * (Log(p) - Log(std::max(q, 1e-20)));
+          }
+        }
+      }
+      KALDI_VLOG(1) << utt << " " << exact.NumRows() << " frames, max abs diff "
+                    << utt_diff << ", argmax diff " << utt_argmax_diff << " frames";
+      max_diff = std::max(max_diff, utt_diff);
+      tot_kl += utt_kl;
+      num_argmax_diff += utt_argmax_diff;
+      tot_frames += exact.NumRows();
+      num_done++;
+    }
+
+    if (num_done == 0) {
+      KALDI_WARN << "No utterance checked";
+      return 1;
+    }
+    KALDI_LOG << "Checked " << num_done << " utterances, " << tot_frames
+              << " frames, max abs diff " << max_diff;
+    if (is_posterior) {
+      KALDI_LOG << "Average per frame KL(exact || approx) "
+                << tot_kl / tot_frames;
+    }
+    KALDI_LOG << "Frame argmax agreement "
+              << 100.0 * (tot_frames - num_argmax_diff) / tot_frames << " %";
+    KALDI_LOG << "Forward speed: exact " << tot_frames / time_exact
+              << " fps, approx " << tot_frames / time_approx
+              << " fps, speedup " << time_exact / time_approx;
+    return 0;
+  } catch(const std::exception &e) {
+    std::cerr << e.what();
+    return -1;
+  }
+}
@@ -66,6 +66,8 @@ int main(int argc, char *argv[]) {
     po.Register("scale-blank", &scale_blank, "scale the blank posterior for CTC decoding"); 
     int skip_width = 0;
     po.Register("skip-width", &skip_width, "num of frame for one skip(default 0, not use skip)");
+    bool approx_activation = false;
+    po.Register("approx-activation", &approx_activation, "Use fast approximate sigmoid/tanh on CPU (max abs error < 4e-7, check with aslp-nnet-approx-check)");
 
     po.Read(argc, argv);
 
@@ -113,6 +115,11 @@ int main(int argc, char *argv[]) {
     nnet_transf.SetDropoutRetention(1.0);
     nnet.SetDropoutRetention(1.0);
 
+    if (approx_activation) {
+      nnet_transf.SetApproxActivation(true);
+      nnet.SetApproxActivation(true);
+    }
+
     kaldi::int64 tot_t = 0;
 
     SequentialBaseFloatMatrixReader feature_reader(feature_rspecifier);
@@ -0,0 +1,77 @@
+// aslp-nnetbin/aslp-nnet-quantize.cc
+
+#include <sstream>
+
+#include "base/kaldi-common.h"
+#include "util/common-utils.h"
+#include "aslp-nnet/nnet-nnet.h"
+
+int main(int argc, char *argv[]) {
+  try {
+    using namespace kaldi;
+    using namespace kaldi::aslp_nnet;
+    typedef kaldi::int32 int32;
+
+    const char *usage =
+        "Convert the AffineTransform and LstmProjectedStreams weights to int8 with\n"
+        "per-row scales for CPU inference (aslp_nnet). The output nnet is used as\n"
+        "any other by aslp-nnet-forward, aslp-latgen-faster-rtf and the online\n"
+        "servers, but can't be trained any more.\n"
+        "Usage:  aslp-nnet-quantize [options] <nnet-in> <nnet-out>\n"
+        "e.g.:\n"
+        " aslp-nnet-quantize final.nnet final.int8.nnet\n";
+
+    SetVerboseLevel(1); // be verbose by default
+
+    ParseOptions po(usage);
+    bool binary_write = true;
+    po.Register("binary", &binary_write, "Write output in binary mode");
+
+    po.Read(argc, argv);
+
+    if (po.NumArgs() != 2) {
+      po.PrintUsage();
+      exit(1);
+    }
+
+    std::string nnet_in_filename = po.GetArg(1),
+        nnet_out_filename = po.GetArg(2);
+
+    Nnet nnet;
+    {
+      bool binary_read;
+      Input ki(nnet_in_filename, &binary_read);
+      nnet.Read(ki.Stream(), binary_read);
+    }
+
+    int32 num_quantized = 0;
+    for (int32 c = 0; c < nnet.NumComponents(); c++) {
+      Component::ComponentType type = nnet.GetComponent(c).GetType();
+      if (type == Component::kAffineTransform ||
+          type == Component::kLstmProjectedStreams) {
+        num_quantized++;
+      }
+    }
+    if (num_quantized == 0) {
+      KALDI_WARN << "No AffineTransform or LstmProjectedStreams in "
+                 << nnet_in_filename << ", nothing to quantize";
+    }
+
+    std::ostringstream float_model, int8_model;
+    nnet.Write(float_model, true);
+    nnet.Quantize();
+    nnet.Write(int8_model, true);
+    KALDI_LOG << "Quantized " << num_quantized << " components, binary model size "
+              << float_model.str().size() << " -> " << int8_model.str().size()
+              << " bytes";
+
+    Output ko(nnet_out_filename, binary_write);
+    nnet.Write(ko.Stream(), binary_write);
+
+    KALDI_LOG << "Written model to " << nnet_out_filename;
+    return 0;
+  } catch(const std::exception &e) {
+    std::cerr << e.what() << '\n';
+    return -1;
+  }
+}
@@ -22,6 +22,7 @@
 #include "aslp-nnet/nnet-nnet.h"
 #include "aslp-nnet/nnet-loss.h"
 #include "aslp-nnet/nnet-randomizer.h"
+#include "aslp-nnet/data-reader.h"
 #include "base/kaldi-common.h"
 #include "util/common-utils.h"
 #include "base/timer.h"
@@ -54,20 +55,22 @@ int main(int argc, char *argv[]) {
     std::string feature_transform;
     po.Register("feature-transform", &feature_transform, "Feature transform in Nnet format");
 
-    int32 length_tolerance = 5;
-    po.Register("length-tolerance", &length_tolerance, "Allowed length difference of features/targets (frames)");
-
     std::string frame_weights;
     po.Register("frame-weights", &frame_weights, "Per-frame weights to scale gradients (frame selection/weighting).");
 
     std::string objective_function = "xent";
     po.Register("objective-function", &objective_function, "Objective function : xent|mse");
 
-    int32 num_stream = 4;
-    po.Register("num-stream", &num_stream, "Number of sequences processed in parallel");
-
-    double frame_limit = 100000;
-    po.Register("frame-limit", &frame_limit, "Max number of frames to be processed");
+    SequenceDataReaderOptions read_opts;
+    read_opts.num_stream = 4;
+    po.Register("length-tolerance", &read_opts.length_tolerance, "Allowed length difference of features/targets (frames)");
+    po.Register("num-stream", &read_opts.num_stream, "Number of sequences processed in parallel");
+    po.Register("frame-limit", &read_opts.frame_limit, "Max number of frames to be processed");
+    po.Register("drop-len", &read_opts.drop_len, "if Sentence frame length greater than drop_len,"
+            "then drop it, default(0, no drop)");
+    po.Register("skip-width", &read_opts.skip_width, "num of frame for one skip(default 1, not use skip)");
+    po.Register("bucket-size", &read_opts.bucket_size, "Number of utterances sorted by length and packed into the streams "
+            "together(1, archive order), e.g. 200");
 
     std::string use_gpu = "yes";
     po.Register("use-gpu", &use_gpu, "yes|no|optional, only has effect if compiled with CUDA");
@@ -80,11 +83,6 @@ int main(int argc, char *argv[]) {
     //
     int report_period = 200; // 200 sentence with one report 
     po.Register("report-period", &report_period, "Number of sentence for one report log, default(200)");
-    int drop_len = 0;
-    po.Register("drop-len", &drop_len, "if Sentence frame length greater than drop_len,"
-            "then drop it, default(0, no drop)");
-    int skip_width = 0;
-    po.Register("skip-width", &skip_width, "num of frame for one skip(default 0, not use skip)");
 
     po.Read(argc, argv);
 
@@ -102,7 +100,6 @@ int main(int argc, char *argv[]) {
       target_model_filename = po.GetArg(4);
     }
 
-    Vector<BaseFloat> weights;
     // Select the GPU
 #if HAVE_CUDA == 1
     CuDevice::Instantiate().SelectGpuId(use_gpu);
@@ -121,142 +118,35 @@ int main(int argc, char *argv[]) {
     kaldi::int64 total_frames = 0;
 
     // Initialize feature ans labels readers
-    SequentialBaseFloatMatrixReader feature_reader(feature_rspecifier);
-    RandomAccessPosteriorReader targets_reader(targets_rspecifier);
-    RandomAccessBaseFloatVectorReader weights_reader;
-    if (frame_weights != "") {
-      weights_reader.Open(frame_weights);
-    }
+    BucketDataReader reader(feature_rspecifier, targets_rspecifier, read_opts,
+                            frame_weights);
 
     Xent xent;
     Mse mse;
 
     CuMatrix<BaseFloat> feats, feats_transf, nnet_out, obj_diff;
+    Posterior target_host;
+    Vector<BaseFloat> weight_host;
 
     Timer time;
     KALDI_LOG << (crossvalidate?"CROSS-VALIDATION":"TRAINING") << " STARTED";
-    // Feature matrix of every utterance
-    std::vector< Matrix<BaseFloat> > feats_utt(num_stream);
-    // Label vector of every utterance
-    std::vector< Posterior > labels_utt(num_stream);
-    std::vector< Vector<BaseFloat> > weights_utt(num_stream);
-
-    int32 feat_dim = nnet.InputDim();
 
-    int32 num_done = 0, num_no_tgt_mat = 0, num_other_error = 0;
+    int32 num_done = 0;
     int32 num_sentence = 0;
 
-    while (1) {
-
-      std::vector<int32> frame_num_utt;
-      int32 sequence_index = 0, max_frame_num = 0;
-
-      for ( ; !feature_reader.Done(); feature_reader.Next()) {
-        std::string utt = feature_reader.Key();
-        // Check that we have targets
-        if (!targets_reader.HasKey(utt)) {
-          KALDI_WARN << utt << ", missing targets";
-          num_no_tgt_mat++;
-          continue;
-        }
-        // Get feature / target pair
-        Matrix<BaseFloat> raw_mat = feature_reader.Value();
-        if (drop_len > 0 && raw_mat.NumRows() > drop_len) {
-            KALDI_WARN << utt << ", too long, droped";
-            feature_reader.Next();
-            continue;
-        }
-        Posterior raw_targets = targets_reader.Value(utt);
-
-        Matrix<BaseFloat> mat; 
-        Posterior targets;
-        if (skip_width > 1) {
-            int skip_len = (raw_mat.NumRows() - 1) / skip_width + 1;
-            mat.Resize(skip_len, raw_mat.NumCols());
-            targets.resize(skip_len);
-            for (int i = 0; i < skip_len; i++) {
-                mat.Row(i).CopyFromVec(raw_mat.Row(i * skip_width));
-                targets[i] = raw_targets[i * skip_width];
-            }
-        } else {
-            mat = raw_mat;
-            targets = raw_targets;
-        }
-
-        if (frame_weights != "") {
-          weights = weights_reader.Value(utt);
-        } else {  // all per-frame weights are 1.0
-          weights.Resize(mat.NumRows());
-          weights.Set(1.0);
-        }
-        // correct small length mismatch ... or drop sentence
-        {
-          // add lengths to vector
-          std::vector<int32> lenght;
-          lenght.push_back(mat.NumRows());
-          lenght.push_back(targets.size());
-          lenght.push_back(weights.Dim());
-          // find min, max
-          int32 min = *std::min_element(lenght.begin(), lenght.end());
-          int32 max = *std::max_element(lenght.begin(), lenght.end());
-          // fix or drop ?
-          if (max - min < length_tolerance) {
-            if (mat.NumRows() != min) mat.Resize(min, mat.NumCols(), kCopyData);
-            if (targets.size() != min) targets.resize(min);
-            if (weights.Dim() != min) weights.Resize(min, kCopyData);
-          } else {
-            KALDI_WARN << utt << ", length mismatch of targets " << targets.size()
-                       << " and features " << mat.NumRows();
-            num_other_error++;
-            continue;
-          }
-        }
-
-        if (max_frame_num < mat.NumRows()) max_frame_num = mat.NumRows();
-        feats_utt[sequence_index] = mat;
-        labels_utt[sequence_index] = targets;
-        weights_utt[sequence_index] = weights;
-
-        frame_num_utt.push_back(mat.NumRows());
-        sequence_index++;
-        // If the total number of frames reaches frame_limit, then stop adding more sequences, regardless of whether
-        // the number of utterances reaches num_sequence or not.
-        if (frame_num_utt.size() == num_stream || frame_num_utt.size() * max_frame_num > frame_limit) {
-            feature_reader.Next(); break;
-        }
-      }
+    // Every utterance of a batch is padded to the max length within the batch,
+    // the padded frames have 0 weight, the others their --frame-weights (or 1)
+    while (reader.ReadData(&feats, &target_host, &weight_host)) {
+      const std::vector<int32> &frame_num_utt = reader.GetSeqLengths();
       int32 cur_sequence_num = frame_num_utt.size();
 
-      // Create the final feature matrix. Every utterance is padded to the max length within this group of utterances
-      Matrix<BaseFloat> feat_mat_host(cur_sequence_num * max_frame_num, feat_dim, kSetZero);
-      Posterior target_host;
-      Vector<BaseFloat> weight_host;
-
-      target_host.resize(cur_sequence_num * max_frame_num);
-      weight_host.Resize(cur_sequence_num * max_frame_num, kSetZero);
-
       int32 num_valid_frame = 0;
       for (int s = 0; s < cur_sequence_num; s++) {
-        Matrix<BaseFloat> mat_tmp = feats_utt[s];
-        for (int r = 0; r < frame_num_utt[s]; r++) {
-          feat_mat_host.Row(r*cur_sequence_num + s).CopyFromVec(mat_tmp.Row(r));
-        }
         num_valid_frame += frame_num_utt[s];
       }
 
-      for (int s = 0; s < cur_sequence_num; s++) {
-        Posterior target_tmp = labels_utt[s];
-        for (int r = 0; r < frame_num_utt[s]; r++) {
-          target_host[r*cur_sequence_num+s] = target_tmp[r];
-        }
-        Vector<BaseFloat> weight_tmp = weights_utt[s];
-        for (int r = 0; r < frame_num_utt[s]; r++) {
-          weight_host(r*cur_sequence_num+s) = weight_tmp(r);
-        }
-      }
-
       // transform feature
-      nnet_transf.Feedforward(CuMatrix<BaseFloat>(feat_mat_host), &feats_transf);
+      nnet_transf.Feedforward(feats, &feats_transf);
 
       // Set the original lengths of utterances before padding
       nnet.SetSeqLengths(frame_num_utt);
@@ -308,8 +198,6 @@ int main(int argc, char *argv[]) {
           }
           num_sentence -= report_period;
       }
-
-      if (feature_reader.Done()) break;  // end loop of while(1)
     }
 
     // Check network parameters and gradients when training finishes
@@ -326,12 +214,15 @@ int main(int argc, char *argv[]) {
       nnet.Write(target_model_filename, binary);
     }
 
-    KALDI_LOG << "Done " << num_done << " files, " << num_no_tgt_mat
-              << " with no tgt_mats, " << num_other_error
+    KALDI_LOG << "Done " << num_done << " files, " << reader.NumNoTarget()
+              << " with no tgt_mats, " << reader.NumOtherError()
               << " with other errors. "
               << "[" << (crossvalidate?"CROSS-VALIDATION":"TRAINING")
               << ", " << time.Elapsed()/60 << " min, fps" << total_frames/time.Elapsed()
               << "]";
+    KALDI_LOG << "Padding efficiency " << reader.PaddingEfficiency()
+              << " (valid frames / computed frames), data reader stalled "
+              << reader.StallTime() << " s";
     if (objective_function == "xent") {
         KALDI_LOG << xent.Report();
     } else if (objective_function == "mse") {
@@ -174,6 +174,8 @@ int main(int argc, char *argv[]) {
             << ", " << (randomize?"RANDOMIZED":"NOT-RANDOMIZED") 
             << ", " << time.Elapsed()/60 << " min, fps" << total_frames/time.Elapsed()
             << "]";  
+        KALDI_LOG << "Data reader stalled " << reader.StallTime()
+                  << " s, the reading not hidden behind the training";
         for (int i = 0; i < losses.size(); i++) {
             KALDI_LOG << "Obj " << "[" << i << "] " << sub_string[i];
             KALDI_LOG << losses[i]->Report();
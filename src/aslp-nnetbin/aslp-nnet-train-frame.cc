@@ -138,6 +138,8 @@ int main(int argc, char *argv[]) {
             << ", " << (randomize?"RANDOMIZED":"NOT-RANDOMIZED") 
             << ", " << time.Elapsed()/60 << " min, fps" << total_frames/time.Elapsed()
             << "]";  
+        KALDI_LOG << "Data reader stalled " << reader.StallTime()
+                  << " s, the reading not hidden behind the training";
 
         KALDI_LOG << loss->Report();
         if (loss != NULL) delete loss;
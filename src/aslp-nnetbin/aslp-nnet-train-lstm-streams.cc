@@ -218,6 +218,10 @@ int main(int argc, char *argv[]) {
               << ", " << (randomize?"RANDOMIZED":"NOT-RANDOMIZED") 
               << ", " << time.Elapsed()/60 << " min, fps" << total_frames/time.Elapsed()
               << "]";  
+    KALDI_LOG << "Data reader stalled " << reader.StallTime()
+              << " s, the reading not hidden behind the training";
+    KALDI_LOG << "Padding efficiency " << reader.PaddingEfficiency()
+              << " (valid frames / computed frames)";
 	loss->Report();
 	if (loss != NULL) delete loss;
 /*
@@ -159,28 +159,68 @@ static void AddVadFeatureToFeaturePool(int num_frames,
     //KALDI_LOG << "Add " << num_voice_frames << " frames to the feature pool";
 }
 
+// A new vad pipeline for the next utterance, scored by vad_stream if the vad
+// nnet forward is batched, whose recurrent state starts over too, else by
+// vad_forward over the shared vad nnet, reset for every chunk
+static OnlineVadFeaturePipeline *NewVadPipeline(const aslp_nnet::Nnet &vad_nnet,
+                const OnlineNnetVadOptions &vad_config,
+                const OnlineFeaturePipelineConfig &feature_info,
+                NnetBatchStream *vad_stream,
+                aslp_nnet::NnetSharedForward *vad_forward) {
+    if (vad_stream != NULL) {
+        vad_stream->ResetState();
+        return new OnlineVadFeaturePipeline(vad_nnet, vad_config,
+                                            feature_info, vad_stream);
+    }
+    KALDI_ASSERT(vad_forward != NULL);
+    return new OnlineVadFeaturePipeline(vad_nnet, vad_config, feature_info,
+                                        vad_forward, true);
+}
+
 void NnetVadDecodeThread::operator() (void *resource) {
     try {
         NnetVadDecodeThreadResource *nnet_vad_resource = 
             static_cast<NnetVadDecodeThreadResource *>(resource);
         aslp_nnet::Nnet *am_nnet = nnet_vad_resource->am_nnet;
-        aslp_nnet::Nnet *vad_nnet = nnet_vad_resource->vad_nnet;
+        const aslp_nnet::Nnet *vad_nnet = nnet_vad_resource->vad_nnet;
+        aslp_nnet::NnetSharedForward *am_forward = nnet_vad_resource->am_forward;
+        aslp_nnet::NnetSharedForward *vad_forward =
+            nnet_vad_resource->vad_forward;
         double tot_like = 0.0;
         int64 num_frames = 0;
 
         // This object receives raw wave data and sends the recognition results
         // to the client. The client_socket is closed by this object.
         WavProvider wav_provider(client_socket_);
+        NnetBatchStream *vad_stream = NULL;
+        if (vad_scheduler_ != NULL) {
+            vad_stream = new NnetBatchStream(vad_scheduler_);
+        }
         OnlineVadFeaturePipeline *vad_pipeline = 
-            new OnlineVadFeaturePipeline(*vad_nnet, vad_config_, feature_info_);
+            NewVadPipeline(*vad_nnet, vad_config_, feature_info_, vad_stream,
+                           vad_forward);
         OnlineFeaturePool *feature_pool = 
             new OnlineFeaturePool(vad_pipeline->Dim());
-        MultiUtteranceNnetDecoder decoder(nnet_decoding_config_,
-                trans_model_,
-                am_nnet,
-                log_prior_,
-                decode_fst_,
-                feature_pool);
+        NnetBatchStream *am_stream = NULL;
+        MultiUtteranceNnetDecoder *decoder_ptr = NULL;
+        if (am_scheduler_ != NULL) {
+            am_stream = new NnetBatchStream(am_scheduler_);
+            decoder_ptr = new MultiUtteranceNnetDecoder(nnet_decoding_config_,
+                    trans_model_, am_stream, log_prior_, decode_fst_,
+                    feature_pool);
+        } else if (am_forward != NULL) {
+            // The resource is reused by the following connections
+            am_forward->ResetState();
+            decoder_ptr = new MultiUtteranceNnetDecoder(nnet_decoding_config_,
+                    trans_model_, am_forward, log_prior_, decode_fst_,
+                    feature_pool);
+        } else {
+            KALDI_ASSERT(am_nnet != NULL);
+            decoder_ptr = new MultiUtteranceNnetDecoder(nnet_decoding_config_,
+                    trans_model_, am_nnet, log_prior_, decode_fst_,
+                    feature_pool);
+        }
+        MultiUtteranceNnetDecoder &decoder = *decoder_ptr;
 
         double get_partial_result_progress = 0.0;
         std::vector<BaseFloat> data;
@@ -245,8 +285,8 @@ void NnetVadDecodeThread::operator() (void *resource) {
                 }
                 delete vad_pipeline;
                 delete feature_pool;
-                vad_pipeline = new OnlineVadFeaturePipeline(*vad_nnet, 
-                        vad_config_, feature_info_);
+                vad_pipeline = NewVadPipeline(*vad_nnet, vad_config_,
+                        feature_info_, vad_stream, vad_forward);
                 feature_pool = new OnlineFeaturePool(vad_pipeline->Dim());
                 decoder.ResetDecoder(feature_pool);
             }
@@ -282,13 +322,170 @@ void NnetVadDecodeThread::operator() (void *resource) {
         }
         wav_provider.WriteEOS();
 
+        delete decoder_ptr;
+        delete am_stream;
         delete feature_pool;
         delete vad_pipeline;
+        delete vad_stream;
     } catch (const std::exception &e) {
         std::cerr << e.what();
     }
 
 }
 
+SessionHandler *NnetVadDecodeSessionFactory::NewHandler() {
+    return new NnetVadDecodeSession(*this);
+}
+
+NnetVadDecodeSession::NnetVadDecodeSession(
+        const NnetVadDecodeSessionFactory &info):
+        info_(info), vad_pipeline_(NULL), feature_pool_(NULL),
+        am_forward_(NULL), vad_stream_(NULL), decoder_(NULL),
+        get_partial_result_progress_(0.0) {
+}
+
+NnetVadDecodeSession::~NnetVadDecodeSession() {
+    delete decoder_;
+    delete am_forward_;
+    delete feature_pool_;
+    delete vad_pipeline_;
+    delete vad_stream_;
+}
+
+void NnetVadDecodeSession::Init(
+        const NnetVadDecodeThreadResource &resource) {
+    if (info_.vad_scheduler_ != NULL) {
+        vad_stream_ = new NnetBatchStream(info_.vad_scheduler_);
+    }
+    vad_pipeline_ = NewVadPipeline(*resource.vad_nnet, info_.vad_config_,
+                                   info_.feature_info_, vad_stream_,
+                                   resource.vad_forward);
+    feature_pool_ = new OnlineFeaturePool(vad_pipeline_->Dim());
+    if (info_.am_scheduler_ != NULL) {
+        am_forward_ = new NnetBatchStream(info_.am_scheduler_);
+    } else {
+        am_forward_ = new aslp_nnet::NnetSharedForward(*info_.am_nnet_);
+    }
+    decoder_ = new MultiUtteranceNnetDecoder(info_.nnet_decoding_config_,
+            info_.trans_model_, am_forward_, info_.log_prior_,
+            info_.decode_fst_, feature_pool_);
+}
+
+void NnetVadDecodeSession::Process(OnlineSession *session,
+                                   std::vector<BaseFloat> *audio,
+                                   bool finished, void *resource) {
+    NnetVadDecodeThreadResource *nnet_vad_resource = 
+        static_cast<NnetVadDecodeThreadResource *>(resource);
+    KALDI_ASSERT(nnet_vad_resource->vad_nnet != NULL);
+    if (vad_pipeline_ == NULL) Init(*nnet_vad_resource);
+    // The vad forward of the last worker thread may be in use by another
+    // session
+    if (vad_stream_ == NULL) {
+        vad_pipeline_->SetVadForward(nnet_vad_resource->vad_forward, true);
+    }
+
+    // Feed the audio by chunk, decode when forward_batch speech frames
+    // are ready or endpoint detected, as NnetVadDecodeThread does
+    for (int offset = 0; offset < audio->size(); offset += info_.chunk_length_) {
+        int num_read = std::min(static_cast<int>(audio->size()) - offset,
+                                info_.chunk_length_);
+        SubVector<BaseFloat> wave_part(audio->data() + offset, num_read);
+        vad_pipeline_->AcceptWaveform(info_.samp_freq_, wave_part);
+        if (vad_pipeline_->EndpointDetected()) {
+            DecodeStep(session, *nnet_vad_resource);
+        }
+        while (vad_pipeline_->NumSpeechFramesReady() >= info_.forward_batch_) {
+            DecodeStep(session, *nnet_vad_resource);
+        }
+    }
+
+    if (finished) {
+        DecodeStep(session, *nnet_vad_resource);
+        Finish(session);
+    }
+}
+
+void NnetVadDecodeSession::DecodeStep(OnlineSession *session,
+        const NnetVadDecodeThreadResource &resource) {
+    MultiUtteranceNnetDecoder &decoder = *decoder_;
+    // Get voiced frames to feature pool 
+    AddVadFeatureToFeaturePool(info_.forward_batch_, vad_pipeline_, feature_pool_);
+
+    // Advance decoding
+    decoder.AdvanceDecoding();
+
+    int partial_progress = 
+        vad_pipeline_->AudioReceived() - get_partial_result_progress_;
+    // Print partial results
+    if (decoder.NumFramesDecoded() > 0 && 
+            !vad_pipeline_->EndpointDetected() && 
+            partial_progress >= 0.7) {
+        get_partial_result_progress_ = vad_pipeline_->AudioReceived();
+        std::string result;
+        decoder.GetPartialResult(info_.word_syms_table_, &result);
+        if (result != "") {
+            session->WritePacket(WavProvider::kPartialResult, result);
+        }
+        KALDI_VLOG(1) << "Partial: " << result;
+    } // if NumFramesDecoded > 0
+
+    if (vad_pipeline_->EndpointDetected() && 
+            decoder.NumFramesDecoded() > 0) {
+        vad_pipeline_->InputFinished();
+        AddVadFeatureToFeaturePool(info_.forward_batch_, vad_pipeline_, feature_pool_);
+        feature_pool_->InputFinished();
+        decoder.AdvanceDecoding();
+
+        std::string result;
+        decoder.GetPartialResult(info_.word_syms_table_, &result);
+        KALDI_VLOG(1) << "-Final: " << result;
+        if (result != "") {
+            session->WritePacket(WavProvider::kFinalResult, result);
+            all_result_ += result;
+        }
+        delete vad_pipeline_;
+        delete feature_pool_;
+        vad_pipeline_ = NewVadPipeline(*resource.vad_nnet, info_.vad_config_,
+                info_.feature_info_, vad_stream_, resource.vad_forward);
+        feature_pool_ = new OnlineFeaturePool(vad_pipeline_->Dim());
+        decoder.ResetDecoder(feature_pool_);
+    }
+}
+
+void NnetVadDecodeSession::Finish(OnlineSession *session) {
+    MultiUtteranceNnetDecoder &decoder = *decoder_;
+    double tot_like = 0.0;
+    int64 num_frames = 0;
+
+    vad_pipeline_->InputFinished();
+    AddVadFeatureToFeaturePool(info_.forward_batch_, vad_pipeline_, feature_pool_);
+    feature_pool_->InputFinished();
+
+    decoder.FinalizeDecoding();
+
+    std::string recog_result;
+    CompactLattice clat;
+    if (decoder.NumFramesDecoded() > 0) {
+        bool end_of_utterance = true;
+        decoder.GetLattice(end_of_utterance, &clat);
+        GetDiagnosticsAndPrintOutput("+Final: ", info_.word_syms_table_, clat,
+                &num_frames, &tot_like, &recog_result);
+    } else {
+        KALDI_LOG << "no frames decoded";
+    }
+    if (recog_result != "") {
+        session->WritePacket(WavProvider::kFinalResult, recog_result);
+        all_result_ += recog_result;
+    }
+    if (all_result_.size() > 0) {
+        std::string punc_result;
+        info_.punctuation_processor_.Process(all_result_, &punc_result);
+        KALDI_LOG << "All Result: " << all_result_;
+        KALDI_LOG << "Final Punctuation Result: " << punc_result;
+        session->WritePacket(WavProvider::kPunctuationResult, punc_result);
+    }
+    session->WritePacket(WavProvider::kEOS);
+}
+
 } // namespace aslp_online
 } // namespace kaldi
@@ -20,6 +20,9 @@
 #include "aslp-online/thread-pool.h"
 #include "aslp-online/online-feature-pool.h"
 #include "aslp-online/online-vad-feature-pipeline.h"
+#include "aslp-online/nnet-batch-scheduler.h"
+#include "aslp-nnet/nnet-shared-forward.h"
+#include "aslp-online/epoll-server.h"
 
 
 namespace kaldi {
@@ -80,10 +83,18 @@ private:
 
 struct NnetVadDecodeThreadResource {
     NnetVadDecodeThreadResource(aslp_nnet::Nnet *am_nnet,
-                                aslp_nnet::Nnet *vad_nnet):
-        am_nnet(am_nnet), vad_nnet(vad_nnet) {}
-    aslp_nnet::Nnet *am_nnet; // acoustic nnet model 
-    aslp_nnet::Nnet *vad_nnet; // vad nnet model
+                                const aslp_nnet::Nnet *vad_nnet,
+                                aslp_nnet::NnetSharedForward *am_forward,
+                                aslp_nnet::NnetSharedForward *vad_forward):
+        am_nnet(am_nnet), vad_nnet(vad_nnet), am_forward(am_forward),
+        vad_forward(vad_forward) {}
+    aslp_nnet::Nnet *am_nnet; // acoustic nnet model, NULL if shared or batched
+    const aslp_nnet::Nnet *vad_nnet; // vad nnet model, shared by all threads
+    // per thread buffers and states over the shared am nnet, or NULL
+    aslp_nnet::NnetSharedForward *am_forward;
+    // per thread buffers and states over the shared vad nnet, NULL if the
+    // vad nnet forward is batched
+    aslp_nnet::NnetSharedForward *vad_forward;
 };
 
 class NnetVadDecodeThread : public Threadable {
@@ -100,7 +111,9 @@ public:
                         const CuVector<BaseFloat> &log_prior,
                         const fst::Fst<fst::StdArc> &decode_fst,
                         const PunctuationProcessor &punctuation_processor,
-                        const fst::SymbolTable *word_syms_table):
+                        const fst::SymbolTable *word_syms_table,
+                        NnetBatchScheduler *am_scheduler = NULL,
+                        NnetBatchScheduler *vad_scheduler = NULL):
             client_socket_(client_socket),
             chunk_length_(chunk_length), 
             forward_batch_(forward_batch),
@@ -113,9 +126,11 @@ public:
             log_prior_(log_prior),
             decode_fst_(decode_fst), 
             punctuation_processor_(punctuation_processor),
-            word_syms_table_(word_syms_table) {
+            word_syms_table_(word_syms_table),
+            am_scheduler_(am_scheduler),
+            vad_scheduler_(vad_scheduler) {
     }
-    // Here resource is a pointer to a Nnet ojbect
+    // Here resource is a pointer to a NnetVadDecodeThreadResource ojbect
     virtual void operator() (void *resource);
 private:
     int client_socket_;
@@ -131,6 +146,98 @@ private:
     const fst::Fst<fst::StdArc> &decode_fst_;
     const PunctuationProcessor &punctuation_processor_;
     const fst::SymbolTable *word_syms_table_;
+    // If not NULL, am nnet forward is batched with other threads by it
+    NnetBatchScheduler *am_scheduler_;
+    // If not NULL, so is the vad nnet forward
+    NnetBatchScheduler *vad_scheduler_;
+};
+
+class NnetVadDecodeSession;
+
+// Shared configs and models of the NnetVadDecodeSession of the EpollServer,
+// the am nnet forward is either batched by am_scheduler or done by a
+// NnetSharedForward of every session over am_nnet, for there is no thread
+// bound to a session to keep the am nnet copy of the thread
+class NnetVadDecodeSessionFactory : public SessionHandlerFactory {
+public:
+    NnetVadDecodeSessionFactory(int chunk_length,
+                                int forward_batch,
+                                BaseFloat samp_freq,
+                                const OnlineFeaturePipelineConfig &feature_info,
+                                const OnlineNnetDecodingConfig &nnet_decoding_config,
+                                const OnlineNnetVadOptions & vad_config,
+                                const TransitionModel &trans_model,
+                                const CuVector<BaseFloat> &log_prior,
+                                const fst::Fst<fst::StdArc> &decode_fst,
+                                const PunctuationProcessor &punctuation_processor,
+                                const fst::SymbolTable *word_syms_table,
+                                const aslp_nnet::Nnet *am_nnet,
+                                NnetBatchScheduler *am_scheduler,
+                                NnetBatchScheduler *vad_scheduler = NULL):
+            chunk_length_(chunk_length), 
+            forward_batch_(forward_batch),
+            samp_freq_(samp_freq), 
+            feature_info_(feature_info),
+            nnet_decoding_config_(nnet_decoding_config), 
+            vad_config_(vad_config), 
+            trans_model_(trans_model), 
+            log_prior_(log_prior),
+            decode_fst_(decode_fst), 
+            punctuation_processor_(punctuation_processor),
+            word_syms_table_(word_syms_table),
+            am_nnet_(am_nnet),
+            am_scheduler_(am_scheduler),
+            vad_scheduler_(vad_scheduler) {
+        KALDI_ASSERT((am_nnet_ == NULL) != (am_scheduler_ == NULL));
+    }
+    virtual SessionHandler *NewHandler();
+private:
+    friend class NnetVadDecodeSession;
+    int chunk_length_;
+    int forward_batch_;
+    BaseFloat samp_freq_;
+    const OnlineFeaturePipelineConfig &feature_info_;
+    const OnlineNnetDecodingConfig &nnet_decoding_config_;
+    const OnlineNnetVadOptions &vad_config_;
+    const TransitionModel &trans_model_;
+    const CuVector<BaseFloat> &log_prior_;
+    const fst::Fst<fst::StdArc> &decode_fst_;
+    const PunctuationProcessor &punctuation_processor_;
+    const fst::SymbolTable *word_syms_table_;
+    const aslp_nnet::Nnet *am_nnet_;
+    NnetBatchScheduler *am_scheduler_;
+    // if not NULL, the vad nnet forward of the sessions is batched by it
+    NnetBatchScheduler *vad_scheduler_;
+};
+
+// The decoding of NnetVadDecodeThread driven by the arrived audio instead of
+// a blocking read loop, the resource of the worker thread is also a
+// NnetVadDecodeThreadResource, only its vad_nnet and vad_forward are used
+class NnetVadDecodeSession : public SessionHandler {
+public:
+    explicit NnetVadDecodeSession(const NnetVadDecodeSessionFactory &info);
+    ~NnetVadDecodeSession();
+    virtual void Process(OnlineSession *session,
+                         std::vector<BaseFloat> *audio,
+                         bool finished, void *resource);
+private:
+    // Lazy init in the worker thread
+    void Init(const NnetVadDecodeThreadResource &resource);
+    // Decode the ready speech frames, the body of the read loop of
+    // NnetVadDecodeThread
+    void DecodeStep(OnlineSession *session,
+                    const NnetVadDecodeThreadResource &resource);
+    void Finish(OnlineSession *session);
+
+    const NnetVadDecodeSessionFactory &info_;
+    OnlineVadFeaturePipeline *vad_pipeline_;
+    OnlineFeaturePool *feature_pool_;
+    aslp_nnet::NnetForwardInterface *am_forward_;
+    NnetBatchStream *vad_stream_;
+    MultiUtteranceNnetDecoder *decoder_;
+    double get_partial_result_progress_;
+    std::string all_result_;
+    KALDI_DISALLOW_COPY_AND_ASSIGN(NnetVadDecodeSession);
 };
 
 } // namespace aslp_online
@@ -0,0 +1,274 @@
+// aslp-online/epoll-server.cc
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/epoll.h>
+
+#include <algorithm>
+
+#include "aslp-online/epoll-server.h"
+
+namespace kaldi {
+namespace aslp_online {
+
+// Max packet size, larger one is regarded as a broken client
+static const int32 kMaxPacketSize = 16 * 1024 * 1024;
+
+static bool SetNonBlocking(int fd) {
+    int flags = fcntl(fd, F_GETFL, 0);
+    if (flags == -1) return false;
+    return fcntl(fd, F_SETFL, flags | O_NONBLOCK) != -1;
+}
+
+OnlineSession::OnlineSession(int fd, SessionHandler *handler):
+        fd_(fd), handler_(handler), finished_(false), scheduled_(false) {
+    KALDI_ASSERT(handler_ != NULL);
+    if (pthread_mutex_init(&mutex_, NULL) != 0) {
+        KALDI_ERR << "mutex init error";
+    }
+}
+
+OnlineSession::~OnlineSession() {
+    delete handler_;
+    if (fd_ != -1) close(fd_);
+    pthread_mutex_destroy(&mutex_);
+}
+
+bool OnlineSession::WritePacket(char cmd, const std::string &data) {
+    std::string packet(5 + data.size(), '\0');
+    int32 len = htonl(1 + data.size());
+    memcpy(&packet[0], &len, 4);
+    packet[4] = cmd;
+    std::copy(data.begin(), data.end(), packet.begin() + 5);
+    // The socket is non-blocking, wait until it is writable if it is full
+    const char *buf = packet.data();
+    int to_send = packet.size();
+    while (to_send > 0) {
+        int ret = send(fd_, buf, to_send, MSG_NOSIGNAL);
+        if (ret < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            struct pollfd pfd;
+            pfd.fd = fd_;
+            pfd.events = POLLOUT;
+            if (poll(&pfd, 1, 1000) <= 0) return false;
+            continue;
+        }
+        if (ret < 0 && errno == EINTR) continue;
+        if (ret <= 0) return false;
+        to_send -= ret;
+        buf += ret;
+    }
+    return true;
+}
+
+/* packet format 
+ * len [4 bytes] + cmd [1 byte] + data[N byte]
+ * cmd: 0x00 audio data + short * N
+ *    : 0x01 finish signal
+ */
+bool OnlineSession::ReadPackets(std::vector<BaseFloat> *audio, bool *done) {
+    char buf[65536];
+    bool connected = true;
+    for (;;) {
+        int ret = read(fd_, buf, sizeof(buf));
+        if (ret > 0) {
+            read_buf_.insert(read_buf_.end(), buf, buf + ret);
+        } else if (ret < 0 && errno == EINTR) {
+            continue;
+        } else {
+            // 0: closed by the client, EAGAIN: no more data now
+            if (ret == 0 || (errno != EAGAIN && errno != EWOULDBLOCK))
+                connected = false;
+            break;
+        }
+    }
+
+    size_t cur = 0;
+    while (read_buf_.size() - cur >= 4) {
+        int32 len;
+        memcpy(&len, &read_buf_[cur], 4);
+        len = ntohl(len); //convert netword to host
+        if (len <= 0 || len > kMaxPacketSize) {
+            KALDI_WARN << "Invalid packet size " << len << ", close connection";
+            return false;
+        }
+        if (read_buf_.size() - cur - 4 < len) break; // not complete yet
+        const char *data = &read_buf_[cur + 4];
+        switch (data[0]) {
+            case 0x00: {
+                if ((len - 1) % sizeof(short) != 0) { //2 byte
+                    KALDI_WARN << "Invalid audio packet, close connection";
+                    return false;
+                }
+                int num_samples = (len - 1) / sizeof(short);
+                for (int i = 0; i < num_samples; i++) {
+                    short value;
+                    memcpy(&value, data + 1 + i * sizeof(short), sizeof(short));
+                    audio->push_back(static_cast<BaseFloat>(value));
+                }
+                break;
+            }
+            case 0x01:
+                *done = true;
+                break;
+        }
+        cur += 4 + len;
+    }
+    read_buf_.erase(read_buf_.begin(), read_buf_.begin() + cur);
+    return connected;
+}
+
+EpollServer::EpollServer(SessionHandlerFactory *factory,
+                         ThreadPool *thread_pool,
+                         int min_samples):
+        factory_(factory), thread_pool_(thread_pool),
+        min_samples_(min_samples), num_sessions_(0) {
+    KALDI_ASSERT(factory_ != NULL && thread_pool_ != NULL);
+    epoll_fd_ = epoll_create(1024);
+    if (epoll_fd_ == -1) {
+        KALDI_ERR << "epoll create error";
+    }
+    if (pthread_mutex_init(&mutex_, NULL) != 0) {
+        KALDI_ERR << "mutex init error";
+    }
+}
+
+EpollServer::~EpollServer() {
+    close(epoll_fd_);
+    pthread_mutex_destroy(&mutex_);
+}
+
+int EpollServer::NumSessions() const {
+    pthread_mutex_lock(&mutex_);
+    int num_sessions = num_sessions_;
+    pthread_mutex_unlock(&mutex_);
+    return num_sessions;
+}
+
+void EpollServer::Run(const TcpServer &tcp_server) {
+    int listen_fd = tcp_server.Descriptor();
+    KALDI_ASSERT(listen_fd != -1);
+    if (!SetNonBlocking(listen_fd)) {
+        KALDI_ERR << "Cannot set the listening socket non-blocking";
+    }
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.ptr = NULL; // NULL for the listening socket
+    if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, listen_fd, &ev) == -1) {
+        KALDI_ERR << "epoll add listening socket error";
+    }
+
+    const int max_events = 256;
+    struct epoll_event events[max_events];
+    for (;;) {
+        int n = epoll_wait(epoll_fd_, events, max_events, -1);
+        if (n == -1) {
+            if (errno == EINTR) continue;
+            KALDI_ERR << "epoll wait error";
+        }
+        for (int i = 0; i < n; i++) {
+            if (events[i].data.ptr == NULL) {
+                AcceptAll(listen_fd);
+            } else {
+                ReadSession(static_cast<OnlineSession *>(events[i].data.ptr));
+            }
+        }
+    }
+}
+
+void EpollServer::AcceptAll(int listen_fd) {
+    for (;;) {
+        int fd = accept(listen_fd, NULL, NULL);
+        if (fd == -1) {
+            if (errno == EINTR) continue;
+            // EAGAIN: no more pending connection,
+            // others(eg. EMFILE): try again in the next round
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                KALDI_WARN << "accept error " << strerror(errno);
+            }
+            break;
+        }
+        if (!SetNonBlocking(fd)) {
+            KALDI_WARN << "Cannot set the client socket non-blocking";
+            close(fd);
+            continue;
+        }
+        OnlineSession *session = new OnlineSession(fd, factory_->NewHandler());
+        struct epoll_event ev;
+        ev.events = EPOLLIN | EPOLLRDHUP;
+        ev.data.ptr = session;
+        if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &ev) == -1) {
+            KALDI_WARN << "epoll add client socket error";
+            delete session;
+            continue;
+        }
+        pthread_mutex_lock(&mutex_);
+        int num_sessions = ++num_sessions_;
+        pthread_mutex_unlock(&mutex_);
+        KALDI_VLOG(1) << "New connection, " << num_sessions << " sessions";
+    }
+}
+
+void EpollServer::ReadSession(OnlineSession *session) {
+    std::vector<BaseFloat> audio;
+    bool done = false;
+    bool connected = session->ReadPackets(&audio, &done);
+    bool finished = done || !connected;
+    // No more input, the io thread never touches the session after here,
+    // it is deleted by the worker thread after the final result is sent
+    if (finished) {
+        epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, session->fd_, NULL);
+    }
+
+    bool schedule = false;
+    pthread_mutex_lock(&session->mutex_);
+    session->audio_.insert(session->audio_.end(), audio.begin(), audio.end());
+    if (finished) session->finished_ = true;
+    if (!session->scheduled_ &&
+        (session->finished_ || session->audio_.size() >= min_samples_)) {
+        session->scheduled_ = true;
+        schedule = true;
+    }
+    pthread_mutex_unlock(&session->mutex_);
+
+    if (schedule) thread_pool_->AddTask(new SessionTask(this, session));
+}
+
+void EpollServer::RunSession(OnlineSession *session, void *resource) {
+    std::vector<BaseFloat> audio;
+    for (;;) {
+        audio.clear();
+        pthread_mutex_lock(&session->mutex_);
+        audio.swap(session->audio_);
+        bool finished = session->finished_;
+        pthread_mutex_unlock(&session->mutex_);
+
+        try {
+            session->handler_->Process(session, &audio, finished, resource);
+        } catch (const std::exception &e) {
+            std::cerr << e.what();
+        }
+
+        if (finished) {
+            delete session;
+            pthread_mutex_lock(&mutex_);
+            int num_sessions = --num_sessions_;
+            pthread_mutex_unlock(&mutex_);
+            KALDI_VLOG(1) << "Connection closed, " << num_sessions << " sessions";
+            return;
+        }
+
+        // Go on with this session if enough new audio arrived meanwhile
+        pthread_mutex_lock(&session->mutex_);
+        if (!session->finished_ && session->audio_.size() < min_samples_) {
+            session->scheduled_ = false;
+            pthread_mutex_unlock(&session->mutex_);
+            return;
+        }
+        pthread_mutex_unlock(&session->mutex_);
+    }
+}
+
+} // namespace aslp_online
+} // namespace kaldi
@@ -0,0 +1,136 @@
+// aslp-online/epoll-server.h
+
+/* Event driven front end of the decoding server
+ *
+ * TcpServer::Accept() + ThreadPool::AddTask() binds a pool thread to a
+ * socket for the whole connection, and WavProvider::ReadAudio() blocks in
+ * ReadFull(), so idle or slow clients hold the decoding threads and the pool
+ * size is the limit of concurrent connections.
+ *
+ * EpollServer reads all the sockets in one thread by non-blocking epoll,
+ * parses the packets of the WavProvider protocol into the audio queue of the
+ * OnlineSession, and only adds a task to the thread pool when the session
+ * has enough new audio, or its audio is finished. At most one task of a
+ * session runs at a time, the decoding state is kept in the SessionHandler
+ * of the session between tasks, so the worker threads only serve the
+ * sessions which have work to do.
+ */
+
+#ifndef ASLP_ONLINE_EPOLL_SERVER_H_
+#define ASLP_ONLINE_EPOLL_SERVER_H_
+
+#include <pthread.h>
+
+#include <string>
+#include <vector>
+
+#include "base/kaldi-common.h"
+
+#include "aslp-online/tcp-server.h"
+#include "aslp-online/thread-pool.h"
+
+namespace kaldi {
+namespace aslp_online {
+
+class OnlineSession;
+
+// Decoding state of one connection, it is run by one worker thread at a time
+class SessionHandler {
+public:
+    // Consume the new audio of the session(it may be changed),
+    // @finished: no more audio will come(finish packet received or the
+    //            connection is broken), the final result must be sent now
+    // @resource: the resource of the worker thread which runs it
+    virtual void Process(OnlineSession *session,
+                         std::vector<BaseFloat> *audio,
+                         bool finished, void *resource) = 0;
+    virtual ~SessionHandler() {}
+};
+
+class SessionHandlerFactory {
+public:
+    // Called in the io thread for every new connection, keep it cheap
+    virtual SessionHandler *NewHandler() = 0;
+    virtual ~SessionHandlerFactory() {}
+};
+
+class OnlineSession {
+public:
+    OnlineSession(int fd, SessionHandler *handler);
+    // Close the socket and delete the handler
+    ~OnlineSession();
+
+    /* write packet to client, the same format as WavProvider
+     * len [4 bytes] + cmd [1 byte] + data[N byte]
+     * cmd: WavProvider::kPartialResult, kFinalResult, kEOS...
+     */
+    bool WritePacket(char cmd, const std::string &data = "");
+
+private:
+    friend class EpollServer;
+    // Read the available data of the socket(io thread only) and parse the
+    // complete packets, the audio is appended to audio, done is set if the
+    // finish packet is received. Return false if the connection is broken.
+    bool ReadPackets(std::vector<BaseFloat> *audio, bool *done);
+
+    int fd_;
+    SessionHandler *handler_;
+    std::vector<char> read_buf_; // incomplete packet, io thread only
+
+    // guarded by mutex_
+    pthread_mutex_t mutex_;
+    std::vector<BaseFloat> audio_; // audio not processed yet
+    bool finished_; // no more audio
+    bool scheduled_; // a task of the session is in the pool
+
+    KALDI_DISALLOW_COPY_AND_ASSIGN(OnlineSession);
+};
+
+class EpollServer {
+public:
+    // @min_samples: a session is scheduled when it has min_samples new audio
+    EpollServer(SessionHandlerFactory *factory,
+                ThreadPool *thread_pool,
+                int min_samples);
+    ~EpollServer();
+
+    // Serve the clients of the listening tcp_server, never return
+    void Run(const TcpServer &tcp_server);
+
+    // Number of sessions alive
+    int NumSessions() const;
+
+private:
+    class SessionTask : public Threadable {
+    public:
+        SessionTask(EpollServer *server, OnlineSession *session):
+            server_(server), session_(session) {}
+        virtual void operator() (void *resource) {
+            server_->RunSession(session_, resource);
+        }
+    private:
+        EpollServer *server_;
+        OnlineSession *session_;
+    };
+
+    void AcceptAll(int listen_fd);
+    void ReadSession(OnlineSession *session);
+    // Run in the worker thread until the session has not enough new audio,
+    // the session is deleted here when it is finished
+    void RunSession(OnlineSession *session, void *resource);
+
+    SessionHandlerFactory *factory_;
+    ThreadPool *thread_pool_;
+    int min_samples_;
+    int epoll_fd_;
+
+    mutable pthread_mutex_t mutex_;
+    int num_sessions_;
+
+    KALDI_DISALLOW_COPY_AND_ASSIGN(EpollServer);
+};
+
+} // namespace aslp_online
+} // namespace kaldi
+
+#endif
@@ -0,0 +1,88 @@
+// aslp-online/mapped-fst-test.cc
+
+#include <stddef.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include "fstext/rand-fst.h"
+#include "aslp-online/mapped-fst.h"
+
+namespace kaldi {
+namespace aslp_online {
+
+static void AssertSameFst(const fst::ExpandedFst<fst::StdArc> &a,
+                          const fst::Fst<fst::StdArc> &b) {
+    typedef fst::StdArc Arc;
+    KALDI_ASSERT(a.Start() == b.Start());
+    KALDI_ASSERT(a.NumStates() == fst::CountStates(b));
+    for (fst::StateIterator<fst::Fst<Arc> > siter(b); !siter.Done();
+         siter.Next()) {
+        Arc::StateId s = siter.Value();
+        KALDI_ASSERT(a.Final(s) == b.Final(s));
+        KALDI_ASSERT(a.NumArcs(s) == b.NumArcs(s));
+        KALDI_ASSERT(a.NumInputEpsilons(s) == b.NumInputEpsilons(s));
+        KALDI_ASSERT(a.NumOutputEpsilons(s) == b.NumOutputEpsilons(s));
+        fst::ArcIterator<fst::ExpandedFst<Arc> > aiter(a, s);
+        fst::ArcIterator<fst::Fst<Arc> > biter(b, s);
+        for (; !aiter.Done(); aiter.Next(), biter.Next()) {
+            KALDI_ASSERT(!biter.Done());
+            const Arc &x = aiter.Value(), &y = biter.Value();
+            KALDI_ASSERT(x.ilabel == y.ilabel && x.olabel == y.olabel &&
+                         x.weight == y.weight && x.nextstate == y.nextstate);
+        }
+        KALDI_ASSERT(biter.Done());
+    }
+    uint64 props = fst::kAcceptor | fst::kNotAcceptor | fst::kEpsilons |
+                   fst::kNoEpsilons | fst::kCyclic | fst::kAcyclic;
+    KALDI_ASSERT(a.Properties(props, true) == b.Properties(props, false));
+    KALDI_ASSERT(b.Properties(fst::kExpanded, false) == fst::kExpanded);
+}
+
+static void TestMappedFst() {
+    std::string filename = "tmp.mapped.fst";
+    for (int32 i = 0; i < 10; i++) {
+        fst::VectorFst<fst::StdArc> *vector_fst = fst::RandFst<fst::StdArc>();
+        WriteMappedFst(*vector_fst, filename);
+        KALDI_ASSERT(MappedFst::IsMappedFile(filename));
+        fst::Fst<fst::StdArc> *mapped_fst = ReadDecodeFst(filename);
+        AssertSameFst(*vector_fst, *mapped_fst);
+        // the copy shares the mapping and outlives the original
+        fst::Fst<fst::StdArc> *copy = mapped_fst->Copy();
+        delete mapped_fst;
+        AssertSameFst(*vector_fst, *copy);
+        delete copy;
+        delete vector_fst;
+    }
+
+    // corrupt the header
+    FILE *fp = fopen(filename.c_str(), "r+b");
+    KALDI_ASSERT(fp != NULL);
+    fseek(fp, offsetof(MappedFstHeader, start), SEEK_SET);
+    int64 start = 12345;
+    fwrite(&start, sizeof(start), 1, fp);
+    fclose(fp);
+    bool error = false;
+    try {
+        delete MappedFst::Map(filename);
+    } catch (const std::exception &e) {
+        error = true;
+    }
+    KALDI_ASSERT(error);
+    unlink(filename.c_str());
+
+    // not a mapped fst
+    fst::VectorFst<fst::StdArc> *vector_fst = fst::RandFst<fst::StdArc>();
+    vector_fst->Write(filename);
+    KALDI_ASSERT(!MappedFst::IsMappedFile(filename));
+    delete vector_fst;
+    unlink(filename.c_str());
+}
+
+} // namespace aslp_online
+} // namespace kaldi
+
+int main() {
+    kaldi::aslp_online::TestMappedFst();
+    std::cout << "Test OK.\n";
+    return 0;
+}
@@ -0,0 +1,200 @@
+// aslp-online/mapped-fst.cc
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stddef.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <fstream>
+#include <vector>
+
+#include "aslp-online/mapped-fst.h"
+
+namespace kaldi {
+namespace aslp_online {
+
+static const char kMappedFstMagic[8] = {'A', 'S', 'L', 'P', 'M', 'F', 'S', 'T'};
+static const int32 kMappedFstVersion = 1;
+static const int64 kMappedFstPageSize = 4096;
+
+static int64 PageAlign(int64 offset) {
+    return (offset + kMappedFstPageSize - 1) /
+        kMappedFstPageSize * kMappedFstPageSize;
+}
+
+// FNV-1a of the header fields before the checksum
+static uint64 HeaderChecksum(const MappedFstHeader &header) {
+    const unsigned char *p = reinterpret_cast<const unsigned char *>(&header);
+    uint64 hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < offsetof(MappedFstHeader, checksum); i++) {
+        hash ^= p[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+static void WritePadding(int64 offset, std::ostream &os) {
+    std::vector<char> zeros(offset - static_cast<int64>(os.tellp()), 0);
+    if (!zeros.empty()) os.write(&zeros[0], zeros.size());
+}
+
+void WriteMappedFst(const fst::ExpandedFst<fst::StdArc> &fst,
+                    const std::string &filename) {
+    typedef fst::StdArc Arc;
+    typedef Arc::StateId StateId;
+    int64 num_states = fst.NumStates(), num_arcs = 0;
+    std::vector<MappedFstState> states(num_states);
+    for (StateId s = 0; s < num_states; s++) {
+        MappedFstState &state = states[s];
+        state.final_cost = fst.Final(s).Value();
+        state.num_arcs = fst.NumArcs(s);
+        state.num_input_epsilons = fst.NumInputEpsilons(s);
+        state.num_output_epsilons = fst.NumOutputEpsilons(s);
+        state.first_arc = num_arcs;
+        num_arcs += state.num_arcs;
+    }
+
+    MappedFstHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, kMappedFstMagic, sizeof(header.magic));
+    header.version = kMappedFstVersion;
+    header.arc_size = sizeof(Arc);
+    header.num_states = num_states;
+    header.num_arcs = num_arcs;
+    header.start = fst.Start();
+    // all of them are known after the test
+    header.properties =
+        fst.Properties(fst::kTrinaryProperties, true) | fst::kExpanded;
+    header.states_offset = PageAlign(sizeof(header));
+    header.arcs_offset = PageAlign(header.states_offset +
+                                   num_states * sizeof(MappedFstState));
+    header.file_size = header.arcs_offset + num_arcs * sizeof(Arc);
+    header.checksum = HeaderChecksum(header);
+
+    std::ofstream os(filename.c_str(), std::ios::out | std::ios::binary);
+    if (!os.is_open())
+        KALDI_ERR << "Could not open " << filename << " for writing";
+    os.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    WritePadding(header.states_offset, os);
+    if (num_states > 0)
+        os.write(reinterpret_cast<const char *>(&states[0]),
+                 num_states * sizeof(MappedFstState));
+    WritePadding(header.arcs_offset, os);
+    for (StateId s = 0; s < num_states; s++) {
+        for (fst::ArcIterator<fst::ExpandedFst<Arc> > aiter(fst, s);
+             !aiter.Done(); aiter.Next()) {
+            const Arc &arc = aiter.Value();
+            os.write(reinterpret_cast<const char *>(&arc), sizeof(Arc));
+        }
+    }
+    os.close();
+    if (os.fail()) KALDI_ERR << "Error writing mapped fst " << filename;
+}
+
+bool MappedFst::IsMappedFile(const std::string &filename) {
+    std::ifstream is(filename.c_str(), std::ios::in | std::ios::binary);
+    char magic[sizeof(kMappedFstMagic)];
+    if (!is.read(magic, sizeof(magic))) return false;
+    return memcmp(magic, kMappedFstMagic, sizeof(magic)) == 0;
+}
+
+MappedFst *MappedFst::Map(const std::string &filename) {
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        KALDI_ERR << "Could not open " << filename << ": " << strerror(errno);
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        KALDI_ERR << "Could not stat " << filename << ": " << strerror(errno);
+    }
+    if (st.st_size < static_cast<off_t>(sizeof(MappedFstHeader))) {
+        close(fd);
+        KALDI_ERR << filename << " is too short for a mapped fst";
+    }
+    void *data = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);  // the mapping holds the file
+    if (data == MAP_FAILED) {
+        KALDI_ERR << "Could not mmap " << filename << ": " << strerror(errno);
+    }
+
+    // Only the header is checked, checking the arrays would read the whole
+    // graph at startup
+    const MappedFstHeader &header = *static_cast<const MappedFstHeader *>(data);
+    const char *error = NULL;
+    if (memcmp(header.magic, kMappedFstMagic, sizeof(header.magic)) != 0) {
+        error = "bad magic";
+    } else if (header.checksum != HeaderChecksum(header)) {
+        error = "bad header checksum";
+    } else if (header.version != kMappedFstVersion) {
+        error = "unsupported version";
+    } else if (header.arc_size != static_cast<int32>(sizeof(Arc))) {
+        error = "arc size mismatch";
+    } else if (header.file_size != static_cast<int64>(st.st_size)) {
+        error = "file size mismatch, the file may be truncated";
+    } else if (header.num_states < 0 || header.num_arcs < 0 ||
+               header.start < fst::kNoStateId ||
+               header.start >= header.num_states ||
+               header.states_offset % kMappedFstPageSize != 0 ||
+               header.arcs_offset % kMappedFstPageSize != 0 ||
+               header.states_offset + header.num_states *
+                   static_cast<int64>(sizeof(MappedFstState)) >
+                   header.arcs_offset ||
+               header.arcs_offset + header.num_arcs *
+                   static_cast<int64>(sizeof(Arc)) > header.file_size) {
+        error = "inconsistent header";
+    }
+    if (error != NULL) {
+        munmap(data, st.st_size);
+        KALDI_ERR << "Bad mapped fst " << filename << ": " << error;
+    }
+
+    Region *region = new Region;
+    region->data = data;
+    region->size = st.st_size;
+    region->ref_count = 1;
+    return new MappedFst(region);
+}
+
+MappedFst::MappedFst(Region *region): region_(region) {
+    const char *data = static_cast<const char *>(region_->data);
+    header_ = reinterpret_cast<const MappedFstHeader *>(data);
+    states_ = reinterpret_cast<const MappedFstState *>(
+        data + header_->states_offset);
+    arcs_ = reinterpret_cast<const Arc *>(data + header_->arcs_offset);
+}
+
+MappedFst::MappedFst(const MappedFst &other):
+        fst::ExpandedFst<Arc>(), region_(other.region_),
+        header_(other.header_), states_(other.states_), arcs_(other.arcs_) {
+    // the copies are made and deleted by the thread which owns the graph
+    region_->ref_count++;
+}
+
+MappedFst::~MappedFst() {
+    if (--region_->ref_count == 0) {
+        munmap(region_->data, region_->size);
+        delete region_;
+    }
+}
+
+const std::string &MappedFst::Type() const {
+    static const std::string type("aslp-mapped");
+    return type;
+}
+
+fst::Fst<fst::StdArc> *ReadDecodeFst(const std::string &filename) {
+    if (MappedFst::IsMappedFile(filename)) {
+        MappedFst *fst = MappedFst::Map(filename);
+        KALDI_LOG << "Mapped " << filename << ", " << fst->NumStates()
+                  << " states, " << fst->MappedBytes() / (1024 * 1024) << " MB";
+        return fst;
+    }
+    return fst::ReadFstKaldi(filename);
+}
+
+} // namespace aslp_online
+} // namespace kaldi
@@ -0,0 +1,138 @@
+// aslp-online/mapped-fst.h
+
+/* Decoding graph which is mmap'ed read only instead of read into the heap
+ *
+ * ReadFstKaldi() parses the whole HCLG into a VectorFst at every start of a
+ * server, which takes minutes for the multi-GB graphs, and every server
+ * process on a host keeps its own copy. The mapped format keeps the states
+ * and the arcs in two flat(CSR) arrays, page aligned in the file, so the
+ * file is mmap'ed as it is: the startup only checks the header, the pages
+ * are read on demand, and all the processes which map the same file share
+ * one copy in the page cache.
+ *
+ * File layout(native byte order, made by aslp-fst-to-mapped):
+ *   MappedFstHeader
+ *   MappedFstState[num_states]   at header.states_offset
+ *   fst::StdArc[num_arcs]        at header.arcs_offset
+ * the arcs of a state are contiguous, from its first_arc.
+ */
+
+#ifndef ASLP_ONLINE_MAPPED_FST_H_
+#define ASLP_ONLINE_MAPPED_FST_H_
+
+#include <string>
+
+#include "base/kaldi-common.h"
+#include "fstext/fstext-lib.h"
+
+namespace kaldi {
+namespace aslp_online {
+
+struct MappedFstHeader {
+    char magic[8];         // "ASLPMFST"
+    int32 version;
+    int32 arc_size;        // sizeof(fst::StdArc), the arcs are kept as they are
+    int64 num_states;
+    int64 num_arcs;
+    int64 start;
+    uint64 properties;
+    int64 states_offset;   // page aligned byte offsets in the file
+    int64 arcs_offset;
+    int64 file_size;
+    uint64 checksum;       // of all the fields above
+};
+
+struct MappedFstState {
+    BaseFloat final_cost;  // fst::TropicalWeight
+    int32 num_arcs;
+    int32 num_input_epsilons;
+    int32 num_output_epsilons;
+    int64 first_arc;
+};
+
+class MappedFst : public fst::ExpandedFst<fst::StdArc> {
+public:
+    typedef fst::StdArc Arc;
+    typedef Arc::StateId StateId;
+    typedef Arc::Weight Weight;
+
+    // Maps the file made by WriteMappedFst(), error if it is not a valid
+    // mapped fst
+    static MappedFst *Map(const std::string &filename);
+
+    // If the file begins with the magic of the mapped format
+    static bool IsMappedFile(const std::string &filename);
+
+    // The copy shares the mapping
+    MappedFst(const MappedFst &other);
+    virtual ~MappedFst();
+
+    virtual StateId Start() const { return header_->start; }
+    virtual Weight Final(StateId s) const {
+        return Weight(states_[s].final_cost);
+    }
+    virtual StateId NumStates() const { return header_->num_states; }
+    virtual size_t NumArcs(StateId s) const { return states_[s].num_arcs; }
+    virtual size_t NumInputEpsilons(StateId s) const {
+        return states_[s].num_input_epsilons;
+    }
+    virtual size_t NumOutputEpsilons(StateId s) const {
+        return states_[s].num_output_epsilons;
+    }
+    // All the properties are computed by Write(), no need to test
+    virtual uint64 Properties(uint64 mask, bool test) const {
+        return header_->properties & mask;
+    }
+    virtual const std::string &Type() const;
+    virtual MappedFst *Copy(bool safe = false) const {
+        return new MappedFst(*this);
+    }
+    virtual const fst::SymbolTable *InputSymbols() const { return NULL; }
+    virtual const fst::SymbolTable *OutputSymbols() const { return NULL; }
+
+    virtual void InitStateIterator(fst::StateIteratorData<Arc> *data) const {
+        data->base = NULL;
+        data->nstates = header_->num_states;
+    }
+    // The arc iterator walks the mapped arcs directly
+    virtual void InitArcIterator(StateId s,
+                                 fst::ArcIteratorData<Arc> *data) const {
+        data->base = NULL;
+        data->arcs = arcs_ + states_[s].first_arc;
+        data->narcs = states_[s].num_arcs;
+        data->ref_count = NULL;
+    }
+
+    // Bytes of the mapped file
+    int64 MappedBytes() const { return header_->file_size; }
+
+private:
+    // The mapping, shared by the copies
+    struct Region {
+        void *data;
+        size_t size;
+        int32 ref_count;
+    };
+
+    explicit MappedFst(Region *region);
+
+    Region *region_;
+    const MappedFstHeader *header_;
+    const MappedFstState *states_;
+    const Arc *arcs_;
+
+    MappedFst &operator = (const MappedFst &);
+};
+
+// Writes fst in the mapped format, the symbol tables are not kept
+void WriteMappedFst(const fst::ExpandedFst<fst::StdArc> &fst,
+                    const std::string &filename);
+
+// Reads the decoding graph of the servers, mapped if it is in the mapped
+// format(aslp-fst-to-mapped), otherwise by ReadFstKaldi()
+fst::Fst<fst::StdArc> *ReadDecodeFst(const std::string &filename);
+
+} // namespace aslp_online
+} // namespace kaldi
+
+#endif // ASLP_ONLINE_MAPPED_FST_H_
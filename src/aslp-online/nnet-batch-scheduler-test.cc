@@ -0,0 +1,60 @@
+// aslp-online/nnet-batch-scheduler-test.cc
+
+#include <unistd.h>
+
+#include "aslp-nnet/nnet-component.h"
+#include "aslp-nnet/nnet-io.h"
+#include "aslp-online/nnet-batch-scheduler.h"
+
+namespace kaldi {
+namespace aslp_online {
+
+using aslp_nnet::Component;
+using aslp_nnet::Nnet;
+
+struct ComputeArg {
+    NnetBatchStream *stream;
+    const CuMatrix<BaseFloat> *in;
+    CuMatrix<BaseFloat> *out;
+};
+
+static void *ComputeThread(void *arg) {
+    ComputeArg *compute = static_cast<ComputeArg *>(arg);
+    compute->stream->Feedforward(*compute->in, compute->out);
+    return NULL;
+}
+
+// The scheduler is destroyed while a Compute() waits for more streams, the
+// request is still forwarded and the call returns
+static void TestDestroyWhileComputing() {
+    Nnet nnet;
+    nnet.AppendComponent(new aslp_nnet::InputLayer(6, 6));
+    nnet.AppendComponent(Component::Init("<AffineTransform> <InputDim> 6 "
+                                         "<OutputDim> 4 <ParamStddev> 0.1"));
+    nnet.AppendComponent(new aslp_nnet::OutputLayer(4, 4));
+    CuMatrix<BaseFloat> in(5, 6), out, ref_out;
+    in.SetRandn();
+    nnet.Feedforward(in, &ref_out);
+
+    NnetBatchSchedulerOptions opts;
+    opts.max_batch_streams = 4;
+    opts.max_wait_ms = 60 * 1000; // never reached in the test
+    NnetBatchScheduler *scheduler = new NnetBatchScheduler(opts, &nnet);
+    NnetBatchStream stream(scheduler);
+    ComputeArg arg = { &stream, &in, &out };
+    pthread_t thread;
+    KALDI_ASSERT(pthread_create(&thread, NULL, ComputeThread, &arg) == 0);
+    usleep(200 * 1000); // the request is pending, 1 of 4 streams
+    delete scheduler;
+    pthread_join(thread, NULL);
+    AssertEqual(out, ref_out);
+}
+
+} // namespace aslp_online
+} // namespace kaldi
+
+int main() {
+    kaldi::aslp_online::TestDestroyWhileComputing();
+    std::cout << "Test OK.\n";
+    return 0;
+}
@@ -0,0 +1,314 @@
+// aslp-online/nnet-batch-scheduler.cc
+
+#include <errno.h>
+#include <sys/time.h>
+
+#include <algorithm>
+#include <sstream>
+
+#include "aslp-online/nnet-batch-scheduler.h"
+
+namespace kaldi {
+namespace aslp_online {
+
+static double NowInSeconds() {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec * 1.0e-6;
+}
+
+static struct timespec SecondsToTimespec(double seconds) {
+    struct timespec ts;
+    ts.tv_sec = static_cast<time_t>(seconds);
+    ts.tv_nsec = static_cast<long>((seconds - ts.tv_sec) * 1.0e9);
+    return ts;
+}
+
+NnetBatchStream::NnetBatchStream(NnetBatchScheduler *scheduler):
+        scheduler_(scheduler) {
+    KALDI_ASSERT(scheduler_ != NULL);
+    const std::vector<int32> &dims = scheduler_->StateDims();
+    state_.resize(dims.size());
+    for (int i = 0; i < dims.size(); i++) {
+        state_[i].Resize(1, dims[i], kSetZero);
+    }
+}
+
+int32 NnetBatchStream::OutputDim() const {
+    return scheduler_->OutputDim();
+}
+
+void NnetBatchStream::Feedforward(const CuMatrixBase<BaseFloat> &in,
+                                  CuMatrix<BaseFloat> *out) {
+    scheduler_->Compute(this, in, out);
+}
+
+void NnetBatchStream::ResetState() {
+    for (int i = 0; i < state_.size(); i++) {
+        state_[i].SetZero();
+    }
+}
+
+NnetBatchScheduler::NnetBatchScheduler(const NnetBatchSchedulerOptions &opts,
+                                       aslp_nnet::Nnet *nnet,
+                                       const std::string &name):
+        opts_(opts), nnet_(nnet), name_(name), stop_(false), num_computing_(0),
+        num_batches_(0), num_batch_streams_(0), num_batch_frames_(0),
+        forward_time_(0.0) {
+    KALDI_ASSERT(nnet_ != NULL);
+    KALDI_ASSERT(opts_.max_batch_streams > 0);
+    KALDI_ASSERT(opts_.max_wait_ms >= 0);
+    if (nnet_->NumInput() != 1 || nnet_->NumOutput() != 1) {
+        KALDI_ERR << "Batched forward only supports nnet with one input "
+                  << "and one output, the " << name_ << " nnet has not";
+    }
+    if (!IsFrameSynchronous(*nnet_)) {
+        KALDI_ERR << "The " << name_ << " nnet has components which use the "
+                  << "context of other frames, it can not be batched across "
+                  << "streams";
+    }
+    stream_histogram_.resize(opts_.max_batch_streams + 1, 0);
+    input_dim_ = nnet_->InputDim();
+    output_dim_ = nnet_->OutputDim();
+    nnet_->LstmStreamStateDims(&state_dims_);
+    batch_state_.resize(state_dims_.size());
+
+    if (pthread_mutex_init(&mutex_, NULL) != 0) {
+        KALDI_ERR << "mutex init error";
+    }
+    if (pthread_cond_init(&cond_, NULL) != 0 ||
+        pthread_cond_init(&done_cond_, NULL) != 0) {
+        KALDI_ERR << "cond init error";
+    }
+    if (pthread_create(&thread_, NULL,
+                       NnetBatchScheduler::SchedulerThread, (void *)this) != 0) {
+        KALDI_ERR << "pthread create error";
+    }
+}
+
+NnetBatchScheduler::~NnetBatchScheduler() {
+    pthread_mutex_lock(&mutex_);
+    stop_ = true;
+    pthread_cond_broadcast(&cond_);
+    // The scheduler thread forwards the pending requests before it exits,
+    // wait until their Compute() calls have all returned
+    while (num_computing_ > 0) {
+        pthread_cond_wait(&done_cond_, &mutex_);
+    }
+    pthread_mutex_unlock(&mutex_);
+    pthread_join(thread_, NULL);
+    KALDI_LOG << Info();
+
+    pthread_mutex_destroy(&mutex_);
+    pthread_cond_destroy(&cond_);
+    pthread_cond_destroy(&done_cond_);
+}
+
+bool NnetBatchScheduler::IsFrameSynchronous(const aslp_nnet::Nnet &nnet) {
+    for (int32 c = 0; c < nnet.NumComponents(); c++) {
+        switch (nnet.GetComponent(c).GetType()) {
+            case aslp_nnet::Component::kSplice:
+            case aslp_nnet::Component::kRowConvolution:
+            case aslp_nnet::Component::kCompactFsmn:
+            case aslp_nnet::Component::kBLstm:
+            case aslp_nnet::Component::kBLstmProjectedStreams:
+            case aslp_nnet::Component::kBLstmProjectedStreamsLC:
+            case aslp_nnet::Component::kSentenceAveragingComponent:
+            case aslp_nnet::Component::kSimpleSentenceAveragingComponent:
+            case aslp_nnet::Component::kFramePoolingComponent:
+                return false;
+            default:
+                break;
+        }
+    }
+    return true;
+}
+
+void NnetBatchScheduler::Compute(NnetBatchStream *stream,
+                                 const CuMatrixBase<BaseFloat> &in,
+                                 CuMatrix<BaseFloat> *out) {
+    KALDI_ASSERT(stream != NULL && stream->scheduler_ == this);
+    KALDI_ASSERT(in.NumCols() == input_dim_);
+    out->Resize(in.NumRows(), output_dim_, kUndefined);
+    if (in.NumRows() == 0) return;
+
+    Request request(stream, &in, out, NowInSeconds());
+    pthread_mutex_lock(&mutex_);
+    if (stop_) {
+        pthread_mutex_unlock(&mutex_);
+        KALDI_ERR << "The " << name_ << " nnet scheduler is being destroyed";
+    }
+    num_computing_++;
+    pending_.push_back(&request);
+    pthread_cond_signal(&cond_);
+    while (!request.done) {
+        pthread_cond_wait(&done_cond_, &mutex_);
+    }
+    num_computing_--;
+    // the destructor waits for the last one
+    if (stop_ && num_computing_ == 0) pthread_cond_broadcast(&done_cond_);
+    pthread_mutex_unlock(&mutex_);
+}
+
+void *NnetBatchScheduler::SchedulerThread(void *arg) {
+    NnetBatchScheduler *scheduler = static_cast<NnetBatchScheduler *>(arg);
+    scheduler->Run();
+    return NULL;
+}
+
+void NnetBatchScheduler::Run() {
+    std::vector<Request *> batch;
+    pthread_mutex_lock(&mutex_);
+    for (;;) {
+        while (!stop_ && pending_.empty()) {
+            pthread_cond_wait(&cond_, &mutex_);
+        }
+        // When stopped, the pending requests are still forwarded, their
+        // Compute() calls are waiting for them
+        if (pending_.empty()) break;
+        // Wait more streams, but no longer than the deadline of the
+        // oldest request
+        struct timespec deadline = SecondsToTimespec(
+                pending_.front()->submit_time + opts_.max_wait_ms * 1.0e-3);
+        while (!stop_ && pending_.size() < opts_.max_batch_streams) {
+            if (pthread_cond_timedwait(&cond_, &mutex_, &deadline) == ETIMEDOUT)
+                break;
+        }
+
+        batch.clear();
+        while (!pending_.empty() && batch.size() < opts_.max_batch_streams) {
+            batch.push_back(pending_.front());
+            pending_.pop_front();
+        }
+        pthread_mutex_unlock(&mutex_);
+
+        ForwardBatch(batch);
+
+        pthread_mutex_lock(&mutex_);
+        // Requests not finished(recurrent nnet) are served first next time
+        for (int b = static_cast<int>(batch.size()) - 1; b >= 0; b--) {
+            if (batch[b]->offset == batch[b]->in->NumRows()) {
+                batch[b]->done = true;
+            } else {
+                pending_.push_front(batch[b]);
+            }
+        }
+        pthread_cond_broadcast(&done_cond_);
+    }
+    pthread_mutex_unlock(&mutex_);
+}
+
+void NnetBatchScheduler::ForwardBatch(const std::vector<Request *> &batch) {
+    Timer timer;
+    int32 num_streams = batch.size();
+    KALDI_ASSERT(num_streams > 0);
+    int32 num_frames = 0;
+    if (state_dims_.size() > 0) {
+        // Recurrent nnet, every stream forwards the same number of frames,
+        // interleaved as multi-stream training
+        int32 T = batch[0]->in->NumRows() - batch[0]->offset;
+        for (int b = 1; b < num_streams; b++) {
+            T = std::min(T, batch[b]->in->NumRows() - batch[b]->offset);
+        }
+        KALDI_ASSERT(T > 0);
+        num_frames = T * num_streams;
+        batch_in_.Resize(num_frames, input_dim_, kUndefined);
+        for (int t = 0; t < T; t++) {
+            for (int b = 0; b < num_streams; b++) {
+                batch_in_.Row(t * num_streams + b).CopyFromVec(
+                        batch[b]->in->Row(batch[b]->offset + t));
+            }
+        }
+        // Swap in the state of the streams
+        for (int k = 0; k < state_dims_.size(); k++) {
+            batch_state_[k].Resize(num_streams, state_dims_[k], kUndefined);
+            for (int b = 0; b < num_streams; b++) {
+                batch_state_[k].Row(b).CopyFromVec(batch[b]->stream->state_[k].Row(0));
+            }
+        }
+        nnet_->SetLstmStreamState(batch_state_);
+        nnet_->Feedforward(batch_in_, &batch_out_);
+        // Swap out
+        nnet_->GetLstmStreamState(&batch_state_);
+        for (int k = 0; k < state_dims_.size(); k++) {
+            for (int b = 0; b < num_streams; b++) {
+                batch[b]->stream->state_[k].Row(0).CopyFromVec(batch_state_[k].Row(b));
+            }
+        }
+        for (int t = 0; t < T; t++) {
+            for (int b = 0; b < num_streams; b++) {
+                batch[b]->out->Row(batch[b]->offset + t).CopyFromVec(
+                        batch_out_.Row(t * num_streams + b));
+            }
+        }
+        for (int b = 0; b < num_streams; b++) {
+            batch[b]->offset += T;
+        }
+    } else {
+        // Feedforward nnet, every frame is independent, just concatenate
+        for (int b = 0; b < num_streams; b++) {
+            num_frames += batch[b]->in->NumRows() - batch[b]->offset;
+        }
+        batch_in_.Resize(num_frames, input_dim_, kUndefined);
+        int32 row = 0;
+        for (int b = 0; b < num_streams; b++) {
+            int32 len = batch[b]->in->NumRows() - batch[b]->offset;
+            batch_in_.RowRange(row, len).CopyFromMat(
+                    batch[b]->in->RowRange(batch[b]->offset, len));
+            row += len;
+        }
+        nnet_->Feedforward(batch_in_, &batch_out_);
+        row = 0;
+        for (int b = 0; b < num_streams; b++) {
+            int32 len = batch[b]->in->NumRows() - batch[b]->offset;
+            batch[b]->out->RowRange(batch[b]->offset, len).CopyFromMat(
+                    batch_out_.RowRange(row, len));
+            batch[b]->offset += len;
+            row += len;
+        }
+    }
+    // Statistics are also read by Info() in other threads
+    pthread_mutex_lock(&mutex_);
+    num_batches_++;
+    num_batch_streams_ += num_streams;
+    num_batch_frames_ += num_frames;
+    forward_time_ += timer.Elapsed();
+    stream_histogram_[num_streams]++;
+    int32 k = 0;
+    while ((1 << k) < num_frames) k++;
+    if (k >= frame_histogram_.size()) frame_histogram_.resize(k + 1, 0);
+    frame_histogram_[k]++;
+    pthread_mutex_unlock(&mutex_);
+    if (num_batches_ % 1000 == 0) {
+        KALDI_VLOG(1) << Info();
+    }
+}
+
+std::string NnetBatchScheduler::Info() const {
+    pthread_mutex_lock(&mutex_);
+    std::ostringstream os;
+    os << "Batched " << name_ << " nnet forward: " << num_batches_ << " batches";
+    if (num_batches_ > 0) {
+        os << ", average " << static_cast<double>(num_batch_streams_) / num_batches_
+           << " streams and " << static_cast<double>(num_batch_frames_) / num_batches_
+           << " frames per batch, " << forward_time_ * 1000.0 / num_batches_
+           << " ms per batch";
+        // streams:batches
+        os << "; streams per batch";
+        for (int n = 1; n < stream_histogram_.size(); n++) {
+            if (stream_histogram_[n] > 0) os << " " << n << ":" << stream_histogram_[n];
+        }
+        // <=frames:batches
+        os << "; frames per batch";
+        for (int k = 0; k < frame_histogram_.size(); k++) {
+            if (frame_histogram_[k] > 0) {
+                os << " <=" << (1 << k) << ":" << frame_histogram_[k];
+            }
+        }
+    }
+    pthread_mutex_unlock(&mutex_);
+    return os.str();
+}
+
+} // namespace aslp_online
+} // namespace kaldi
@@ -0,0 +1,164 @@
+// aslp-online/nnet-batch-scheduler.h
+
+/* Batched acoustic model forward across decoding streams
+ *
+ * Every decoding thread of the server only has a few frames (--forward-batch)
+ * to forward at a time, so forwarding them separately ends up in many small
+ * matrix multiplications. NnetBatchScheduler gathers the pending frames of
+ * all the streams into one matrix, runs one forward pass of the shared nnet
+ * and scatters the output rows back to the streams.
+ *
+ * For the recurrent models (Lstm, LstmProjectedStreams, GruStreams,
+ * LstmCifgProjectedStreams), the frames are interleaved as the multi-stream
+ * training does (row t * num_streams + s), and the recurrent state of every
+ * stream is kept in its NnetBatchStream, and swapped in and out of the shared
+ * nnet before and after every batch.
+ *
+ * The server runs one scheduler for the am nnet and may run another one for
+ * the vad nnet, which scores the new chunks of all the sessions
+ * (NnetVad::SetForward).
+ */
+
+#ifndef ASLP_ONLINE_NNET_BATCH_SCHEDULER_H_
+#define ASLP_ONLINE_NNET_BATCH_SCHEDULER_H_
+
+#include <pthread.h>
+
+#include <string>
+#include <vector>
+#include <deque>
+
+#include "base/kaldi-common.h"
+#include "itf/options-itf.h"
+
+#include "aslp-nnet/nnet-nnet.h"
+#include "aslp-nnet/nnet-decodable.h"
+
+namespace kaldi {
+namespace aslp_online {
+
+struct NnetBatchSchedulerOptions {
+    int32 max_batch_streams;
+    int32 max_wait_ms;
+
+    NnetBatchSchedulerOptions(): max_batch_streams(0), max_wait_ms(10) { }
+
+    void Register(OptionsItf *opts) {
+        opts->Register("batch-streams", &max_batch_streams,
+                "Max number of streams whose am nnet forward are batched into "
+                "one forward pass, 0 means no batching(every thread forwards "
+                "its own nnet copy)");
+        opts->Register("batch-max-wait-ms", &max_wait_ms,
+                "Max time(ms) the frames of a stream wait for other streams "
+                "before the batch is forwarded, it bounds the latency added "
+                "by batching");
+    }
+};
+
+class NnetBatchScheduler;
+
+// A decoding stream of the scheduler, it holds the recurrent state of
+// the stream, so one stream must be used by one decoder at a time
+class NnetBatchStream : public aslp_nnet::NnetForwardInterface {
+public:
+    explicit NnetBatchStream(NnetBatchScheduler *scheduler);
+
+    virtual int32 OutputDim() const;
+
+    // Blocks until the frames are forwarded in some batch
+    virtual void Feedforward(const CuMatrixBase<BaseFloat> &in,
+                             CuMatrix<BaseFloat> *out);
+
+    // Zero the recurrent state, like Nnet::ResetLstmStreams() does
+    void ResetState();
+
+private:
+    friend class NnetBatchScheduler;
+    NnetBatchScheduler *scheduler_;
+    // one row matrix for every recurrent component
+    std::vector<CuMatrix<BaseFloat> > state_;
+    KALDI_DISALLOW_COPY_AND_ASSIGN(NnetBatchStream);
+};
+
+class NnetBatchScheduler {
+public:
+    // The nnet is not owned and must be only used by the scheduler after
+    // here, name is the nnet in the logs, eg. "am", "vad"
+    NnetBatchScheduler(const NnetBatchSchedulerOptions &opts,
+                       aslp_nnet::Nnet *nnet,
+                       const std::string &name = "am");
+    // The pending Compute() calls are forwarded and return before the
+    // scheduler is destroyed, no Compute() may start after it
+    ~NnetBatchScheduler();
+
+    int32 OutputDim() const { return output_dim_; }
+
+    const std::vector<int32> &StateDims() const { return state_dims_; }
+
+    // Called by the decoding threads, blocks until all the rows of in are
+    // forwarded, the rows of out are the nnet output of the rows of in
+    void Compute(NnetBatchStream *stream,
+                 const CuMatrixBase<BaseFloat> &in,
+                 CuMatrix<BaseFloat> *out);
+
+    // Batch statistics, with the histograms of the streams and the frames
+    // of the batches
+    std::string Info() const;
+
+    // Return false if the nnet has components that use context of other
+    // frames (eg. Splice, RowConvolution, BLstm), whose output would mix
+    // the frames of different streams in a batch
+    static bool IsFrameSynchronous(const aslp_nnet::Nnet &nnet);
+
+private:
+    struct Request {
+        Request(NnetBatchStream *stream,
+                const CuMatrixBase<BaseFloat> *in,
+                CuMatrix<BaseFloat> *out,
+                double submit_time):
+            stream(stream), in(in), out(out), offset(0),
+            submit_time(submit_time), done(false) { }
+        NnetBatchStream *stream;
+        const CuMatrixBase<BaseFloat> *in;
+        CuMatrix<BaseFloat> *out;
+        int32 offset; // num of rows already forwarded
+        double submit_time;
+        bool done;
+    };
+
+    static void *SchedulerThread(void *arg);
+    void Run();
+    // Forward one batch, called without the lock held
+    void ForwardBatch(const std::vector<Request *> &batch);
+
+    NnetBatchSchedulerOptions opts_;
+    aslp_nnet::Nnet *nnet_;
+    std::string name_;
+    int32 input_dim_, output_dim_;
+    std::vector<int32> state_dims_;
+
+    bool stop_;
+    int32 num_computing_; // Compute() calls not returned yet
+    std::deque<Request *> pending_;
+    pthread_t thread_;
+    mutable pthread_mutex_t mutex_;
+    pthread_cond_t cond_;      // signaled when new request comes
+    pthread_cond_t done_cond_; // broadcast when a batch is finished
+
+    // batch buffers, only used by the scheduler thread
+    CuMatrix<BaseFloat> batch_in_, batch_out_;
+    std::vector<CuMatrix<BaseFloat> > batch_state_;
+
+    // statistics
+    int64 num_batches_, num_batch_streams_, num_batch_frames_;
+    double forward_time_;
+    // batches of n streams, and of up to 2^k frames
+    std::vector<int64> stream_histogram_, frame_histogram_;
+
+    KALDI_DISALLOW_COPY_AND_ASSIGN(NnetBatchScheduler);
+};
+
+} // namespace aslp_online
+} // namespace kaldi
+
+#endif
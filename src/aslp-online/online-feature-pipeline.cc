@@ -234,6 +234,20 @@ void OnlineFeaturePipeline::SetTransform(
 }
 
 
+void OnlineFeaturePipeline::DiscardFrames(int32 frame) {
+  // the left context of the splicing or the deltas
+  if (config_.splice_feats)
+    frame -= config_.splice_opts.left_context;
+  else if (config_.add_deltas)
+    frame -= config_.delta_opts.order * config_.delta_opts.window;
+  if (frame <= 0) return;
+  cmvn_->DiscardFrames(frame);
+  // the CMVN stats of a frame add up the cmn_window frames before it, starting
+  // from the stats cached up to modulus frames before
+  base_feature_->DiscardFrames(frame - config_.cmvn_opts.cmn_window -
+                               config_.cmvn_opts.modulus);
+}
+
 void OnlineFeaturePipeline::FreezeCmvn() {
   cmvn_->Freeze(cmvn_->NumFramesReady() - 1);
 }
@@ -193,6 +193,13 @@ class OnlineFeaturePipeline: public OnlineFeatureInterface {
   // (making them more accurate).
   virtual void InputFinished();
 
+  // DiscardFrames() tells the pipeline the frames before "frame" won't be
+  // asked for again: the base features and the CMVN stats older than the
+  // context those frames still read are freed, so a long-lived stream runs
+  // in bounded memory.  The pitch features are all kept.  GetCmvnState()
+  // can't be called after this.
+  void DiscardFrames(int32 frame);
+
   // This object is used to set the fMLLR transform.  Call it with
   // the empty matrix if you want to stop it using any transform.
   void SetTransform(const MatrixBase<BaseFloat> &transform);
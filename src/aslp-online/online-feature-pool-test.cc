@@ -0,0 +1,61 @@
+// aslp-online/online-feature-pool-test.cc
+
+#include "aslp-online/online-feature-pool.h"
+
+namespace kaldi {
+namespace aslp_online {
+
+// Frame t of the test features is all t
+static void AcceptFrames(int begin, int num_frames, OnlineFeaturePool *pool) {
+    Matrix<BaseFloat> feat(num_frames, pool->Dim());
+    for (int i = 0; i < num_frames; i++) feat.Row(i).Set(begin + i);
+    pool->AcceptFeature(feat);
+}
+
+static void AssertFrame(int frame, OnlineFeaturePool *pool) {
+    Vector<BaseFloat> feat(pool->Dim());
+    pool->GetFrame(frame, &feat);
+    KALDI_ASSERT(feat.Min() == frame && feat.Max() == frame);
+    // what the decodable reads in place
+    const MatrixBase<BaseFloat> &mat = pool->FeatureMatrix();
+    KALDI_ASSERT(mat(frame - pool->FeatureMatrixOffset(), 0) == frame);
+}
+
+// A long stream decoded as it comes keeps about the undecoded frames
+static void TestLongStream() {
+    OnlineFeaturePool pool(3);
+    int num_frames = 0, max_rows = 0;
+    for (int n = 0; n < 10000; n++) {
+        int chunk = 1 + n % 17;
+        AcceptFrames(num_frames, chunk, &pool);
+        num_frames += chunk;
+        KALDI_ASSERT(pool.NumFramesReady() == num_frames);
+        // the decoder lags by a few chunks
+        int decoded = std::max(0, num_frames - 50);
+        for (int t = decoded; t < num_frames; t++) AssertFrame(t, &pool);
+        pool.DiscardFrames(decoded);
+        max_rows = std::max(max_rows, pool.FeatureMatrix().NumRows());
+    }
+    KALDI_ASSERT(num_frames > 50000);
+    KALDI_ASSERT(max_rows <= 4 * (50 + 17));
+}
+
+// Nothing discarded, all the frames are kept as before
+static void TestNoDiscard() {
+    OnlineFeaturePool pool(2);
+    for (int n = 0; n < 100; n++) AcceptFrames(10 * n, 10, &pool);
+    pool.InputFinished();
+    KALDI_ASSERT(pool.FeatureMatrixOffset() == 0);
+    for (int t = 0; t < 1000; t++) AssertFrame(t, &pool);
+    KALDI_ASSERT(pool.IsLastFrame(999) && !pool.IsLastFrame(998));
+}
+
+} // namespace aslp_online
+} // namespace kaldi
+
+int main() {
+    kaldi::aslp_online::TestLongStream();
+    kaldi::aslp_online::TestNoDiscard();
+    std::cout << "Test OK.\n";
+    return 0;
+}
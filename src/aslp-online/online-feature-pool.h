@@ -10,21 +10,38 @@
 #include "base/kaldi-common.h"
 #include "matrix/matrix-lib.h"
 #include "itf/online-feature-itf.h"
+#include "aslp-nnet/nnet-decodable.h"
 
 namespace kaldi {
 namespace aslp_online {
 
-class OnlineFeaturePool : public OnlineFeatureInterface {
+// The features are kept in one matrix, the nnet decodable reads them in place.
+// The frames the decodable discards leave their rows to the new ones, so in a
+// long-lived stream the matrix stays about the size of the frames not yet
+// decoded. The kept rows are moved to the top instead of wrapping around, they
+// stay contiguous for the in place read.
+class OnlineFeaturePool : public aslp_nnet::OnlineMatrixFeatureInterface {
 public:
-    OnlineFeaturePool(int dim): dim_(dim), num_frames_(0),
-                                input_finished_(false) { }
+    OnlineFeaturePool(int dim): dim_(dim), num_frames_(0), offset_(0),
+                                first_frame_(0), input_finished_(false) { }
 
     virtual int32 Dim() const { return dim_; }
 
     virtual int32 NumFramesReady() const { return num_frames_; }
 
     virtual void GetFrame(int32 frame, VectorBase<BaseFloat> *feat) {
-        feat->CopyFromVec(feature_pool_.Row(frame));
+        KALDI_ASSERT(frame >= first_frame_ && frame < num_frames_);
+        feat->CopyFromVec(feature_pool_.Row(frame - offset_));
+    }
+
+    virtual const MatrixBase<BaseFloat> &FeatureMatrix() const {
+        return feature_pool_;
+    }
+
+    virtual int32 FeatureMatrixOffset() const { return offset_; }
+
+    virtual void DiscardFrames(int32 frame) {
+        first_frame_ = std::max(first_frame_, std::min(frame, num_frames_));
     }
 
     virtual bool IsLastFrame(int32 frame) const {
@@ -39,13 +56,23 @@ public:
         KALDI_ASSERT(feat.NumCols() == dim_);
         if (feat.NumRows() == 0) return;
         int new_num_frames = num_frames_ + feat.NumRows();
+        // At least half of the rows are discarded frames, move the kept
+        // ones to the top instead of expanding
+        if (new_num_frames - offset_ > feature_pool_.NumRows() &&
+                first_frame_ - offset_ >= feature_pool_.NumRows() / 2) {
+            for (int t = first_frame_; t < num_frames_; t++) {
+                feature_pool_.Row(t - first_frame_).CopyFromVec(
+                        feature_pool_.Row(t - offset_));
+            }
+            offset_ = first_frame_;
+        }
         // If the feature pool is not big enough, expand it
-        if (new_num_frames > feature_pool_.NumRows()) {
-            int32 new_num_rows = std::max<int32>(new_num_frames,
+        if (new_num_frames - offset_ > feature_pool_.NumRows()) {
+            int32 new_num_rows = std::max<int32>(new_num_frames - offset_,
                                                  feature_pool_.NumRows() * 2);
             feature_pool_.Resize(new_num_rows, Dim(), kCopyData);
         }
-        feature_pool_.Range(num_frames_, feat.NumRows(), 0, 
+        feature_pool_.Range(num_frames_ - offset_, feat.NumRows(), 0, 
                         Dim()).CopyFromMat(feat);
         num_frames_ = new_num_frames;
     }
@@ -53,6 +80,9 @@ public:
 private:
     int dim_;
     int num_frames_;
+    // row 0 of feature_pool_ is frame offset_, the frames before
+    // first_frame_ are discarded
+    int offset_, first_frame_;
     bool input_finished_;
     Matrix<BaseFloat> feature_pool_;
 };
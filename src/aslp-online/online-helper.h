@@ -3,6 +3,7 @@
 
 #include <string>
 #include <sstream>
+#include <fstream>
 #include <vector>
 
 #include "fstext/fstext-lib.h"
@@ -27,6 +28,21 @@ inline void WordsToString(const std::vector<kaldi::int32> words,
     *result = ss.str();
 }
 
+// Resident memory(VmRSS) of the process in KB, 0 if it is not available
+inline int64 GetResidentMemoryKb() {
+  std::ifstream is("/proc/self/status");
+  std::string line;
+  while (std::getline(is, line)) {
+    if (line.compare(0, 6, "VmRSS:") == 0) {
+      std::istringstream ss(line.substr(6));
+      int64 kb = 0;
+      ss >> kb;
+      return kb;
+    }
+  }
+  return 0;
+}
+
 } // namespace aslp_online
 }  // namespace kaldi
 
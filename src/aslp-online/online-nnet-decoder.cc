@@ -42,6 +42,21 @@ MultiUtteranceNnetDecoder::MultiUtteranceNnetDecoder(
         decoder_.InitDecoding();
 }
 
+MultiUtteranceNnetDecoder::MultiUtteranceNnetDecoder(
+        const OnlineNnetDecodingConfig &config,
+        const TransitionModel &tmodel,
+        aslp_nnet::NnetForwardInterface *forward,
+        const CuVector<BaseFloat> &log_prior,
+        const fst::Fst<fst::StdArc> &fst,
+        OnlineFeatureInterface *feature_interface):
+    config_(config),
+    feature_interface_(feature_interface),
+    tmodel_(tmodel),
+    decodable_(forward, log_prior, tmodel, config.decodable_opts, feature_interface_),
+    decoder_(fst, config.decoder_opts) {
+        decoder_.InitDecoding();
+}
+
 void MultiUtteranceNnetDecoder::AdvanceDecoding() {
     decoder_.AdvanceDecoding(&decodable_);
 }
@@ -74,6 +74,15 @@ public:
             const fst::Fst<fst::StdArc> &fst,
             OnlineFeatureInterface *feat_interface);
 
+    // The nnet computation is delegated to forward(eg. a NnetBatchStream
+    // of the batched forward scheduler), which is not owned here
+    MultiUtteranceNnetDecoder(const OnlineNnetDecodingConfig &config,
+            const TransitionModel &tmodel,
+            aslp_nnet::NnetForwardInterface *forward,
+            const CuVector<BaseFloat> &log_prior,
+            const fst::Fst<fst::StdArc> &fst,
+            OnlineFeatureInterface *feat_interface);
+
     ~MultiUtteranceNnetDecoder() { }
     /// advance the decoding as far as we can.
     void AdvanceDecoding();
@@ -81,6 +81,18 @@ void OnlineVadFeaturePipeline::Vad() {
     }
     KALDI_VLOG(1) << "Vad Total " << chunk_result.size() 
                   << " Silence " << num_sil;
+    CountFinalFrames();
+}
+
+void OnlineVadFeaturePipeline::CountFinalFrames() {
+    // the lookback of the following frames may still set them to speech
+    int end = NumVadFrames();
+    if (!input_finished_) end -= lookback_frames_;
+    for (; num_final_frames_ < end; num_final_frames_++) {
+        if (vad_result_[num_final_frames_ - get_vad_feat_offset_]) {
+            num_speech_frames_++;
+        }
+    }
 }
 
 int OnlineVadFeaturePipeline::GetVadFeature(int num_frames, 
@@ -96,34 +108,19 @@ int OnlineVadFeaturePipeline::GetVadFeature(int num_frames,
     vad_feats->Resize(num_valid_frames, AdaptedFeature()->Dim());
     int count = 0;
     while (count < num_valid_frames) {
-        if (vad_result_[get_vad_feat_offset_]) {
+        if (vad_result_.front()) {
             SubVector<BaseFloat> row(*vad_feats, count);
             AdaptedFeature()->GetFrame(get_vad_feat_offset_, &row);
             count++;
         }
+        vad_result_.pop_front();
         get_vad_feat_offset_++;
     }
+    num_speech_frames_ -= num_valid_frames;
+    DiscardFrames(get_vad_feat_offset_);
          
     return num_valid_frames;
 }
 
-int OnlineVadFeaturePipeline::NumSpeechFramesReady() const {
-    int count = 0; 
-    int lookback = input_finished_ ? 0 : lookback_frames_;
-    int stop = vad_result_.size() - lookback;
-    if (stop <= 0) return 0;
-    for (int i = get_vad_feat_offset_; i < stop; i++) {
-        if (vad_result_[i]) count++;
-    }
-    return count;
-}
-
-
-
-
-
-
-
-
 }
 }
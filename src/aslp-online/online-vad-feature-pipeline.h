@@ -6,6 +6,8 @@
 #ifndef ASLP_ONLINE_ONLINE_VAD_FEATURE_PIPELINE_H_
 #define ASLP_ONLINE_ONLINE_VAD_FEATURE_PIPELINE_H_
 
+#include <deque>
+
 #include "aslp-vad/nnet-vad.h"
 
 #include "aslp-online/wav-provider.h"
@@ -30,16 +32,21 @@ struct OnlineNnetVadOptions : public NnetVadOptions {
 class OnlineVadFeaturePipeline: public OnlineFeaturePipeline {
 public:
     typedef aslp_nnet::Nnet Nnet;
+    // Scored by vad_forward if not NULL, see NnetVad::SetForward()
     explicit OnlineVadFeaturePipeline(const Nnet &vad_nnet,
             const OnlineNnetVadOptions &online_vad_cfg, 
-            const OnlineFeaturePipelineConfig &cfg):
+            const OnlineFeaturePipelineConfig &cfg,
+            aslp_nnet::NnetForwardInterface *vad_forward = NULL,
+            bool reset_vad_forward = false):
         OnlineFeaturePipeline(cfg),
         get_raw_feat_offset_(0),
         get_vad_feat_offset_(0),
+        num_final_frames_(0),
+        num_speech_frames_(0),
         endpoint_detected_(false),
         input_finished_(false), 
         num_continuous_silence_(0),
-        nnet_vad_(vad_nnet, online_vad_cfg), 
+        nnet_vad_(vad_nnet, online_vad_cfg, vad_forward, reset_vad_forward), 
         online_vad_cfg_(online_vad_cfg) {
         //KALDI_LOG << vad_nnet.InputDim();
         endpoint_frames_ = online_vad_cfg_.endpoint_trigger_threshold_ms / 
@@ -54,31 +61,51 @@ public:
     virtual void InputFinished() {
         OnlineFeaturePipeline::InputFinished();
         input_finished_ = true;
+        // the lookback frames are final too
+        CountFinalFrames();
+    }
+
+    // Score by forward instead, eg. the stream of the session in the vad
+    // batch scheduler, see NnetVad::SetForward()
+    void SetVadForward(aslp_nnet::NnetForwardInterface *forward,
+                       bool reset_forward = false) {
+        nnet_vad_.SetForward(forward, reset_forward);
     }
 
+    // The features of the speech frames are taken in order, the frames
+    // before are discarded from the vad result and the feature pipeline,
+    // so a long-lived stream keeps only the frames not taken yet
     int GetVadFeature(int num_frames, 
             Matrix<BaseFloat> *vad_feats); 
 
-    int NumSpeechFramesReady() const;
+    // The speech frames not taken yet and out of the lookback of the
+    // following ones, counted as they are out of it
+    int NumSpeechFramesReady() const { return num_speech_frames_; }
     bool EndpointDetected() const {
         return endpoint_detected_;
     }
 
     float AudioReceived() const {
-        int num_frames = input_finished_ ? 
-            vad_result_.size() : vad_result_.size() - lookback_frames_;
+        int num_frames = NumVadFrames();
+        if (!input_finished_) num_frames -= lookback_frames_;
         return (online_vad_cfg_.frame_length_ms * num_frames) / 1000.0;
     }
 
 private:
     int GetRawFeature(Matrix<BaseFloat> *feats);
     void Vad();
+    void CountFinalFrames();
+    int NumVadFrames() const { return get_vad_feat_offset_ + vad_result_.size(); }
 
     int get_raw_feat_offset_, get_vad_feat_offset_;
+    // vad_result_[0] is frame get_vad_feat_offset_, the frames before
+    // num_final_frames_ are out of the lookback, num_speech_frames_ of them
+    // from get_vad_feat_offset_ are speech
+    int num_final_frames_, num_speech_frames_;
     bool endpoint_detected_;
     bool input_finished_;
     int num_continuous_silence_;
-    std::vector<bool> vad_result_;
+    std::deque<bool> vad_result_;
     int lookback_frames_, endpoint_frames_;
     NnetVad nnet_vad_;
     OnlineNnetVadOptions online_vad_cfg_;
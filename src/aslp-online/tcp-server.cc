@@ -30,7 +30,7 @@ bool TcpServer::Listen(int32 port) {
     return false;
   }
 
-  if (listen(server_desc_, 1) == -1) {
+  if (listen(server_desc_, SOMAXCONN) == -1) {
     KALDI_ERR << "Cannot listen on port!";
     return false;
   }
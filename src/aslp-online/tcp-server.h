@@ -25,6 +25,7 @@ class TcpServer {
   
   bool Listen(int32 port);  //start listening on a given port
   int32 Accept();  //accept a client and return its descriptor
+  int32 Descriptor() const { return server_desc_; }  //listening socket
 
  private:
   struct sockaddr_in h_addr_;
@@ -4,9 +4,21 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <time.h>
+
+#include <algorithm>
+#include <map>
+#include <queue>
+#include <stdexcept>
 
 #include "thread-pool.h"
 
+static double NowInSeconds() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1.0e-9;
+}
+
 class MyTask : public Threadable {
 public:
     MyTask(int id): id_(id) {}
@@ -15,7 +27,7 @@ public:
     }
     virtual void operator() (void *resource) {
         int num = rand() % 100000;
-        printf("thread %d num %d\n", id_, num);
+        //printf("thread %d num %d\n", id_, num);
         for (int i = 0; i < num; i++);
     }
 private:
@@ -30,11 +42,290 @@ void TestThreadPool() {
     }
 }
 
+// Record the resource, check every thread always gets the same resource
+class ResourceTask : public Threadable {
+public:
+    ResourceTask(int *count, void **resource): 
+        count_(count), resource_(resource) {}
+    virtual void operator() (void *resource) {
+        __sync_fetch_and_add(count_, 1);
+        *resource_ = resource;
+    }
+private:
+    int *count_;
+    void **resource_;
+};
 
-int main() {
-    TestThreadPool();
-    return 0;
+void TestThreadPoolResource() {
+    int num_thread = 4;
+    std::vector<int> resource(num_thread);
+    std::vector<void *> resource_pool(num_thread);
+    for (int i = 0; i < num_thread; i++) resource_pool[i] = &resource[i];
+    int count = 0, num_task = 1000;
+    std::vector<void *> got(num_task, NULL);
+    double start = NowInSeconds();
+    {
+        ThreadPool thread_pool(num_thread, &resource_pool);
+        for (int i = 0; i < num_task; i++) {
+            thread_pool.AddTask(new ResourceTask(&count, &got[i]));
+        }
+    }
+    // No startup waiting any more
+    assert(NowInSeconds() - start < 1.0);
+    // All the tasks are done when the pool is destructed
+    assert(count == num_task);
+    for (int i = 0; i < num_task; i++) {
+        assert(std::find(resource_pool.begin(), resource_pool.end(), got[i]) 
+               != resource_pool.end());
+    }
+}
+
+class ThrowTask : public Threadable {
+public:
+    virtual void operator() (void *resource) {
+        throw std::runtime_error("task error");
+    }
+};
+
+void TestTaskFuture() {
+    ThreadPool thread_pool(3);
+    int count = 0;
+    std::vector<void *> got(10, NULL);
+    std::vector<TaskFuture *> futures;
+    for (int i = 0; i < 10; i++) {
+        futures.push_back(new TaskFuture());
+        thread_pool.AddTask(new ResourceTask(&count, &got[i]), futures[i]);
+    }
+    for (int i = 0; i < 10; i++) {
+        bool ok = futures[i]->Wait();
+        assert(ok);
+        assert(futures[i]->IsDone());
+        delete futures[i];
+    }
+    assert(count == 10);
+
+    TaskFuture future;
+    thread_pool.AddTask(new ThrowTask(), &future);
+    bool ok = future.Wait();
+    assert(!ok);
+    assert(future.Error() == "task error");
+}
+
+// The pool before work stealing, one queue guarded by one mutex, for
+// benchmark comparison only. Its workers waited 3 s for the resource table,
+// here they wait for the constructor instead, so only the queue differs
+class MutexQueueThreadPool {
+public:
+    MutexQueueThreadPool(int num_thread = 5, std::vector<void *> *resource_pool = NULL): 
+            num_thread_(num_thread), 
+            stop_(false), constructed_(false) {
+        if (resource_pool != NULL && resource_pool->size() != num_thread_) {
+            ErrorExit("resource and num thread must equal");
+        }
+        if (pthread_mutex_init(&mutex_, NULL) != 0) {
+            ErrorExit("mutex init error");
+        }
+        if (pthread_cond_init(&cond_, NULL) != 0) {
+            ErrorExit("cond init error");
+        }
+        // Create num_thread thread at once
+        threads_.resize(num_thread_);
+        for (int i = 0; i < threads_.size(); i++) {
+            if (pthread_create(&threads_[i], NULL, 
+                               MutexQueueThreadPool::WorkerThread, (void *)this) != 0) {
+                ErrorExit("pthread create error");
+            }
+            if (resource_pool != NULL) {
+                resource_table_[threads_[i]] = (*resource_pool)[i];
+            } else {
+                resource_table_[threads_[i]] = NULL;
+            }
+        }
+        pthread_mutex_lock(&mutex_);
+        constructed_ = true;
+        pthread_mutex_unlock(&mutex_);
+        pthread_cond_broadcast(&cond_);
+    }
+
+    ~MutexQueueThreadPool() {
+        pthread_mutex_lock(&mutex_);
+        stop_ = true;
+        pthread_mutex_unlock(&mutex_);
+        // notify all thread to stop
+        pthread_cond_broadcast(&cond_);
+
+        for (int i = 0; i < threads_.size(); i++) {
+            pthread_join(threads_[i], NULL);
+        }
+
+        pthread_mutex_destroy(&mutex_);
+        pthread_cond_destroy(&cond_);
+    }
+
+    // Wait main thread to construct the resource_table_
+    void *GetResource(pthread_t tid) {
+        pthread_mutex_lock(&mutex_);
+        while (!constructed_) {
+            pthread_cond_wait(&cond_, &mutex_);
+        }
+        pthread_mutex_unlock(&mutex_);
+        assert(resource_table_.find(tid) != resource_table_.end());
+        return resource_table_[tid];
+    }
+
+    void AddTask(Threadable *task) {
+        pthread_mutex_lock(&mutex_);
+        task_queue_.push(task);
+        pthread_mutex_unlock(&mutex_);
+        pthread_cond_signal(&cond_);
+    }
+
+    // Wait a task to execute  
+    Threadable *WaitTask() {
+        Threadable *task = NULL;
+        pthread_mutex_lock(&mutex_);
+        while (!stop_ && task_queue_.empty()) {
+            pthread_cond_wait(&cond_, &mutex_);
+        }
+        if (task_queue_.size() > 0) {
+            task = task_queue_.front();
+            task_queue_.pop();
+        }
+        // else stop_ = true return NULL
+        pthread_mutex_unlock(&mutex_);
+        return task;
+    }
+
+    // PoolWorker thread
+    static void *WorkerThread(void *arg) {
+        MutexQueueThreadPool *pool = static_cast<MutexQueueThreadPool *>(arg);
+        void *resource = pool->GetResource(pthread_self());
+        for(;;) {
+            Threadable *task = pool->WaitTask();
+            // Stop
+            if (task == NULL) break;
+            else {
+                (*task)(resource); // Run the task
+                delete task;
+            }
+        }
+        return NULL;
+    }
+
+private:
+    int num_thread_;
+    bool stop_;
+    bool constructed_;
+    std::vector<pthread_t> threads_;
+    std::queue<Threadable *> task_queue_; //TaskQueue
+    std::map<pthread_t, void *> resource_table_;
+    pthread_cond_t cond_;
+    pthread_mutex_t mutex_;
+};
+
+// Record the dispatch latency, from AddTask to the start of the task
+class LatencyTask : public Threadable {
+public:
+    LatencyTask(double *latency, int work): 
+        submit_time_(NowInSeconds()), latency_(latency), work_(work) {}
+    virtual void operator() (void *resource) {
+        *latency_ = NowInSeconds() - submit_time_;
+        volatile int sum = 0;
+        for (int i = 0; i < work_; i++) sum += i;
+    }
+private:
+    double submit_time_;
+    double *latency_;
+    int work_;
+};
+
+// Occupies its worker until num_thread of them run, so every worker of the
+// pool has started
+class StartupTask : public Threadable {
+public:
+    StartupTask(int *num_started, int num_thread):
+        num_started_(num_started), num_thread_(num_thread) {}
+    virtual void operator() (void *resource) {
+        __sync_fetch_and_add(num_started_, 1);
+        double start = NowInSeconds();
+        while (*static_cast<volatile int *>(num_started_) < num_thread_ &&
+               NowInSeconds() - start < 10.0);
+    }
+private:
+    int *num_started_;
+    int num_thread_;
+};
+
+// Submit num_task tasks in bursts from num_submitter threads
+template <class Pool>
+struct SubmitArg {
+    Pool *pool;
+    double *latency;
+    int num_task;
+    int work;
+};
+
+template <class Pool>
+void *SubmitThread(void *arg) {
+    SubmitArg<Pool> *submit = static_cast<SubmitArg<Pool> *>(arg);
+    for (int i = 0; i < submit->num_task; i++) {
+        submit->pool->AddTask(new LatencyTask(&submit->latency[i], submit->work));
+        if (i % 64 == 63) usleep(100); // bursty
+    }
+    return NULL;
 }
 
+template <class Pool>
+void BenchmarkPool(const char *name, int num_thread, int num_submitter,
+                   int num_task, int work) {
+    std::vector<double> latency(num_task * num_submitter, 0.0);
+    double start = NowInSeconds();
+    Pool *pool = new Pool(num_thread);
+    // The clock starts once all the workers run
+    int num_started = 0;
+    for (int i = 0; i < num_thread; i++) {
+        pool->AddTask(new StartupTask(&num_started, num_thread));
+    }
+    while (*static_cast<volatile int *>(&num_started) < num_thread) usleep(100);
+    double ready = NowInSeconds();
+    std::vector<SubmitArg<Pool> > args(num_submitter);
+    std::vector<pthread_t> threads(num_submitter);
+    for (int i = 0; i < num_submitter; i++) {
+        args[i].pool = pool;
+        args[i].latency = &latency[i * num_task];
+        args[i].num_task = num_task;
+        args[i].work = work;
+        pthread_create(&threads[i], NULL, SubmitThread<Pool>, &args[i]);
+    }
+    for (int i = 0; i < num_submitter; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    delete pool; // wait all tasks done
+    double end = NowInSeconds();
+    std::sort(latency.begin(), latency.end());
+    double p50 = latency[latency.size() / 2],
+           p99 = latency[latency.size() * 99 / 100];
+    printf("%-22s threads %2d submitters %d: startup %.3f s, "
+           "%.0f tasks/sec, dispatch latency p50 %.1f us p99 %.1f us\n",
+           name, num_thread, num_submitter, ready - start,
+           latency.size() / (end - ready), p50 * 1e6, p99 * 1e6);
+}
 
+void BenchmarkThreadPool() {
+    int num_task = 20000, work = 2000;
+    int num_threads[] = { 4, 16 };
+    for (int i = 0; i < 2; i++) {
+        BenchmarkPool<MutexQueueThreadPool>("MutexQueueThreadPool",
+                                            num_threads[i], 4, num_task, work);
+        BenchmarkPool<ThreadPool>("ThreadPool", 
+                                  num_threads[i], 4, num_task, work);
+    }
+}
 
+int main() {
+    TestThreadPool();
+    TestThreadPoolResource();
+    TestTaskFuture();
+    BenchmarkThreadPool();
+    return 0;
+}
@@ -15,9 +15,10 @@
 #include <unistd.h>
 #include <pthread.h>
 
+#include <exception>
+#include <string>
 #include <vector>
-#include <queue>
-#include <map>
+#include <deque>
 
 static void ErrorExit(const char *msg) {
     perror(msg);
@@ -32,109 +33,253 @@ public:
     virtual ~Threadable() {}
 };
 
+// Completion of a task, owned by the caller of ThreadPool::AddTask
+class TaskFuture {
+public:
+    TaskFuture(): done_(false), failed_(false) {
+        if (pthread_mutex_init(&mutex_, NULL) != 0) {
+            ErrorExit("mutex init error");
+        }
+        if (pthread_cond_init(&cond_, NULL) != 0) {
+            ErrorExit("cond init error");
+        }
+    }
+
+    ~TaskFuture() {
+        pthread_mutex_destroy(&mutex_);
+        pthread_cond_destroy(&cond_);
+    }
+
+    // Block until the task is finished,
+    // return false if the task exits with an exception
+    bool Wait() {
+        pthread_mutex_lock(&mutex_);
+        while (!done_) {
+            pthread_cond_wait(&cond_, &mutex_);
+        }
+        bool ok = !failed_;
+        pthread_mutex_unlock(&mutex_);
+        return ok;
+    }
+
+    bool IsDone() {
+        pthread_mutex_lock(&mutex_);
+        bool done = done_;
+        pthread_mutex_unlock(&mutex_);
+        return done;
+    }
+
+    // The exception message if the task failed
+    std::string Error() {
+        pthread_mutex_lock(&mutex_);
+        std::string error = error_;
+        pthread_mutex_unlock(&mutex_);
+        return error;
+    }
+
+    // Called by the pool
+    void SetDone(bool failed, const std::string &error) {
+        pthread_mutex_lock(&mutex_);
+        done_ = true;
+        failed_ = failed;
+        error_ = error;
+        pthread_mutex_unlock(&mutex_);
+        pthread_cond_broadcast(&cond_);
+    }
+
+private:
+    bool done_, failed_;
+    std::string error_;
+    pthread_mutex_t mutex_;
+    pthread_cond_t cond_;
+    TaskFuture(const TaskFuture &);
+    TaskFuture &operator=(const TaskFuture &);
+};
+
 // ThreadPool
+// Every worker has its own task deque, AddTask() distributes the tasks to
+// the deques by round robin, a worker runs the tasks of its own deque first
+// (from the front), and steals from the back of the others' when it is empty,
+// so the submitting thread and the workers seldom contend on the same lock.
+// The number of pending tasks and sleeping workers are atomic counters, the
+// idle mutex is only taken when some worker is sleeping.
 class ThreadPool {
 public:
     //@param[in] resource_pool, optional resource pool for every thread
     //           here we just use the void * for polymorphism, for it is simple and stupid
     //           we can also use the template programming, like template <typename C> class ThreadPool
     //           but it is more complicated and requires specific init
+    //           the i-th worker thread always gets the i-th resource
     ThreadPool(int num_thread = 5, std::vector<void *> *resource_pool = NULL): 
             num_thread_(num_thread), 
-            stop_(false) {
+            stop_(false),
+            num_pending_(0),
+            num_sleeping_(0),
+            next_queue_(0) {
+        if (num_thread_ <= 0) {
+            ErrorExit("num thread must be positive");
+        }
         if (resource_pool != NULL && resource_pool->size() != num_thread_) {
             ErrorExit("resource and num thread must equal");
         }
-        if (pthread_mutex_init(&mutex_, NULL) != 0) {
+        if (pthread_mutex_init(&idle_mutex_, NULL) != 0) {
             ErrorExit("mutex init error");
         }
-        if (pthread_cond_init(&cond_, NULL) != 0) {
+        if (pthread_cond_init(&idle_cond_, NULL) != 0) {
             ErrorExit("cond init error");
         }
+        queues_.resize(num_thread_);
+        workers_.resize(num_thread_);
+        for (int i = 0; i < num_thread_; i++) {
+            if (pthread_mutex_init(&queues_[i].mutex, NULL) != 0) {
+                ErrorExit("mutex init error");
+            }
+            // Bind the resource before the thread starts, no waiting needed
+            workers_[i].pool = this;
+            workers_[i].id = i;
+            workers_[i].resource = 
+                (resource_pool != NULL) ? (*resource_pool)[i] : NULL;
+        }
         // Create num_thread thread at once
         threads_.resize(num_thread_);
         for (int i = 0; i < threads_.size(); i++) {
             if (pthread_create(&threads_[i], NULL, 
-                               ThreadPool::WorkerThread, (void *)this) != 0) {
+                               ThreadPool::WorkerThread, (void *)&workers_[i]) != 0) {
                 ErrorExit("pthread create error");
             }
-            if (resource_pool != NULL) {
-                resource_table_[threads_[i]] = (*resource_pool)[i];
-            } else {
-                resource_table_[threads_[i]] = NULL;
-            }
         }
     }
 
+    // All the added tasks are finished before it returns
     ~ThreadPool() {
-        pthread_mutex_lock(&mutex_);
+        pthread_mutex_lock(&idle_mutex_);
         stop_ = true;
-        pthread_mutex_unlock(&mutex_);
+        pthread_mutex_unlock(&idle_mutex_);
         // notify all thread to stop
-        pthread_cond_broadcast(&cond_);
+        pthread_cond_broadcast(&idle_cond_);
 
         for (int i = 0; i < threads_.size(); i++) {
             pthread_join(threads_[i], NULL);
         }
 
-        pthread_mutex_destroy(&mutex_);
-        pthread_cond_destroy(&cond_);
+        for (int i = 0; i < queues_.size(); i++) {
+            pthread_mutex_destroy(&queues_[i].mutex);
+        }
+        pthread_mutex_destroy(&idle_mutex_);
+        pthread_cond_destroy(&idle_cond_);
     }
 
-    void *GetResource(pthread_t tid) {
-        assert(resource_table_.find(tid) != resource_table_.end());
-        return resource_table_[tid];
-    }
+    int NumThreads() const { return num_thread_; }
 
-    void AddTask(Threadable *task) {
-        pthread_mutex_lock(&mutex_);
-        task_queue_.push(task);
-        pthread_mutex_unlock(&mutex_);
-        pthread_cond_signal(&cond_);
+    // The task is deleted by the pool after it runs,
+    // @future: optional, set done after the task is finished
+    void AddTask(Threadable *task, TaskFuture *future = NULL) {
+        int q = __sync_fetch_and_add(&next_queue_, 1) % num_thread_;
+        pthread_mutex_lock(&queues_[q].mutex);
+        queues_[q].tasks.push_back(TaskItem(task, future));
+        pthread_mutex_unlock(&queues_[q].mutex);
+        // Full barrier, pairs with the one in WaitTask, so either the
+        // sleeping worker sees the task or we see the worker
+        __sync_fetch_and_add(&num_pending_, 1);
+        if (__sync_fetch_and_add(&num_sleeping_, 0) > 0) {
+            pthread_mutex_lock(&idle_mutex_);
+            pthread_cond_signal(&idle_cond_);
+            pthread_mutex_unlock(&idle_mutex_);
+        }
     }
 
-    // Wait a task to execute  
-    Threadable *WaitTask() {
-        Threadable *task = NULL;
-        pthread_mutex_lock(&mutex_);
-        while (!stop_ && task_queue_.empty()) {
-            pthread_cond_wait(&cond_, &mutex_);
+private:
+    struct TaskItem {
+        TaskItem(Threadable *task, TaskFuture *future): 
+            task(task), future(future) {}
+        Threadable *task;
+        TaskFuture *future;
+    };
+
+    struct TaskQueue {
+        pthread_mutex_t mutex;
+        std::deque<TaskItem> tasks;
+    };
+
+    struct Worker {
+        ThreadPool *pool;
+        int id;
+        void *resource;
+    };
+
+    // Pop from the front of its own deque, or steal from the back of others
+    bool TryGetTask(int id, TaskItem *item) {
+        for (int k = 0; k < num_thread_; k++) {
+            int q = (id + k) % num_thread_;
+            TaskQueue &queue = queues_[q];
+            pthread_mutex_lock(&queue.mutex);
+            if (!queue.tasks.empty()) {
+                if (k == 0) {
+                    *item = queue.tasks.front();
+                    queue.tasks.pop_front();
+                } else {
+                    *item = queue.tasks.back();
+                    queue.tasks.pop_back();
+                }
+                pthread_mutex_unlock(&queue.mutex);
+                __sync_fetch_and_sub(&num_pending_, 1);
+                return true;
+            }
+            pthread_mutex_unlock(&queue.mutex);
         }
-        if (task_queue_.size() > 0) {
-            task = task_queue_.front();
-            task_queue_.pop();
+        return false;
+    }
+
+    // Wait a task to execute, return false when the pool stops and all
+    // the tasks are done
+    bool WaitTask(int id, TaskItem *item) {
+        for (;;) {
+            if (TryGetTask(id, item)) return true;
+            pthread_mutex_lock(&idle_mutex_);
+            __sync_fetch_and_add(&num_sleeping_, 1);
+            while (!stop_ && __sync_fetch_and_add(&num_pending_, 0) <= 0) {
+                pthread_cond_wait(&idle_cond_, &idle_mutex_);
+            }
+            __sync_fetch_and_sub(&num_sleeping_, 1);
+            bool stop = stop_ && __sync_fetch_and_add(&num_pending_, 0) <= 0;
+            pthread_mutex_unlock(&idle_mutex_);
+            if (stop) return false;
         }
-        // else stop_ = true return NULL
-        pthread_mutex_unlock(&mutex_);
-        return task;
     }
 
     // PoolWorker thread
     static void *WorkerThread(void *arg) {
-        sleep(3); // wait main thread to construct the resource_table_
-        ThreadPool *pool = static_cast<ThreadPool *>(arg);
-        void *resource = pool->GetResource(pthread_self());
-        for(;;) {
-            Threadable *task = pool->WaitTask();
-            // Stop
-            if (task == NULL) break;
-            else {
-                (*task)(resource); // Run the task
-                delete task;
+        Worker *worker = static_cast<Worker *>(arg);
+        ThreadPool *pool = worker->pool;
+        TaskItem item(NULL, NULL);
+        while (pool->WaitTask(worker->id, &item)) {
+            bool failed = false;
+            std::string error;
+            try {
+                (*item.task)(worker->resource); // Run the task
+            } catch (const std::exception &e) {
+                failed = true;
+                error = e.what();
+                if (item.future == NULL) fprintf(stderr, "%s\n", e.what());
             }
+            delete item.task;
+            if (item.future != NULL) item.future->SetDone(failed, error);
         }
         return NULL;
     }
 
-private:
     int num_thread_;
-    bool stop_;
+    bool stop_; // guarded by idle_mutex_
+    // atomic, tasks in the deques, it may be -1 for a moment when a task
+    // is taken before AddTask counts it
+    int num_pending_;
+    int num_sleeping_; // atomic, workers waiting on idle_cond_
+    unsigned int next_queue_; // atomic, round robin counter
     std::vector<pthread_t> threads_;
-    std::vector<void *> *resource_pool_;
-    std::queue<Threadable *> task_queue_; //TaskQueue
-    std::map<pthread_t, void *> resource_table_;
-    pthread_cond_t cond_;
-    pthread_mutex_t mutex_;
+    std::vector<Worker> workers_;
+    std::vector<TaskQueue> queues_;
+    pthread_mutex_t idle_mutex_;
+    pthread_cond_t idle_cond_;
 };
 
 #endif
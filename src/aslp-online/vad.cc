@@ -1,7 +1,10 @@
 // aslp-online/vad.cc
 // hcq
 
+#include <algorithm>
+
 #include "aslp-online/vad.h"
+#include "aslp-vad/frame-energy.h"
 
 namespace kaldi {
 namespace aslp_online {
@@ -9,19 +12,30 @@ namespace aslp_online {
 using namespace kaldi;
 using std::vector;
 
+// frames read from the audio provider at a time
+static const int32 kBlockFrames = 50;
+// of the energy threshold, the lowest energy of the unvoiced frames
+static const BaseFloat kUnvoicedEnergyRatio = 0.1;
+
 Vad::Vad(const VadOptions &config, WavProvider *audio_provider)
   : state_(kSilence), silence_frame_cnt_(0),
     config_(config), audio_provider_(audio_provider),
-    silence_detected_(false), audio_received_(0.0)
+    head_(0), tail_(0), silence_detected_(false), audio_received_(0.0)
 {
   npoints_per_frame_ = (config_.frame_length_ms * config_.samp_freq) / 1000;
   nframes_silence_trigger_ = config_.silence_trigger_threshold_ms / 
                              config_.frame_length_ms;
   nframes_left_context_ = config_.left_context_length_ms / 
                           config_.frame_length_ms;
-  npoints_left_context_ = nframes_left_context_ * npoints_per_frame_;
   nframes_endpoint_trigger_ = config_.endpoint_trigger_threshold_ms / 
                               config_.frame_length_ms;
+  nzero_crossings_ = config_.vad_zero_crossing_threshold * npoints_per_frame_;
+  // a block is read when at most the left context is kept
+  capacity_ = nframes_left_context_ + kBlockFrames;
+  pcm_.resize(capacity_ * npoints_per_frame_);
+  is_speech_.resize(capacity_);
+  energy_.resize(kBlockFrames);
+  zero_crossings_.resize(kBlockFrames);
 }
 
 int32 Vad::ReadSpeech(int32 required, vector<BaseFloat> *data)
@@ -37,93 +51,95 @@ int32 Vad::ReadSpeech(int32 required, vector<BaseFloat> *data)
       silence_detected_ = true;
       break;
     }
-    if (processed_data_.size() <= npoints_left_context_) {
+    if (tail_ - head_ <= nframes_left_context_) {
       ProcessOneBlock();
     }
-    if (processed_data_.size() > npoints_left_context_) {
-      while (is_speech_.size() > nframes_left_context_ && !is_speech_.front()) {
-        KALDI_ASSERT(is_speech_.size() * npoints_per_frame_ == 
-                     processed_data_.size());
+    if (tail_ - head_ > nframes_left_context_) {
+      while (tail_ - head_ > nframes_left_context_ && !IsSpeech(head_)) {
         silence_frames++;
-        is_speech_.pop_front();
-        processed_data_.erase(processed_data_.begin(), 
-                              processed_data_.begin() + npoints_per_frame_);
+        head_++;
       }
-      if (is_speech_.size() > nframes_left_context_) {
-        KALDI_ASSERT(is_speech_.front() == true);
+      if (tail_ - head_ > nframes_left_context_) {
         silence_detected_ = false;
         silence_frames = 0;
-        is_speech_.pop_front();
-        data->insert(data->end(), processed_data_.begin(),
-                     processed_data_.begin() + npoints_per_frame_);
-        processed_data_.erase(processed_data_.begin(),
-                              processed_data_.begin() + npoints_per_frame_);
+        PopFrame(data);
         required -= npoints_per_frame_;
-        KALDI_ASSERT(is_speech_.size() * npoints_per_frame_ ==
-                     processed_data_.size());
       }
     }
   } // while required > 0
   if (audio_provider_->Done()) {
     while (required > 0) {
-      if (processed_data_.empty()) 
+      if (head_ == tail_) 
         break;
-      while (!is_speech_.empty() && !is_speech_.front()) {
-        is_speech_.pop_front();
-        processed_data_.erase(processed_data_.begin(),
-                              processed_data_.begin() + npoints_per_frame_);
+      while (head_ < tail_ && !IsSpeech(head_)) {
+        head_++;
       }
-      if (!is_speech_.empty()) {
-        KALDI_ASSERT(is_speech_.front() == true);
-        is_speech_.pop_front();
-        data->insert(data->end(), processed_data_.begin(),
-                     processed_data_.begin() + npoints_per_frame_);
-        processed_data_.erase(processed_data_.begin(),
-                              processed_data_.begin() + npoints_per_frame_);
+      if (head_ < tail_) {
+        PopFrame(data);
         required -= npoints_per_frame_;
-        KALDI_ASSERT(is_speech_.size() * npoints_per_frame_ ==
-                     processed_data_.size());
       }
     }
   } // if audio_provider_->Done()
   return data->size();
 }
 
-void Vad::ProcessOneBlock()
+void Vad::PopFrame(vector<BaseFloat> *data)
 {
-  int audio_chunk = npoints_per_frame_ * 50;
-  int num = audio_provider_->ReadAudio(audio_chunk, &raw_audio_);
-  audio_received_ += num / config_.samp_freq;
+  KALDI_ASSERT(IsSpeech(head_));
+  const int16 *pcm = &pcm_[(head_ % capacity_) * npoints_per_frame_];
+  size_t size = data->size();
+  data->resize(size + npoints_per_frame_);
+  for (int i = 0; i < npoints_per_frame_; i++) {
+    (*data)[size + i] = pcm[i];
+  }
+  head_++;
+}
 
-  if (num < audio_chunk) {
-    raw_audio_.insert(raw_audio_.end(), audio_chunk - num, 0);
+void Vad::ProcessOneBlock()
+{
+  KALDI_ASSERT(tail_ - head_ + kBlockFrames <= capacity_);
+  int32 *zero_crossings = nzero_crossings_ > 0 ? &zero_crossings_[0] : NULL;
+  int num_read = 0;
+  // in two parts if the block wraps around the end of the rings
+  for (int32 i = 0; i < kBlockFrames; ) {
+    int32 slot = (tail_ + i) % capacity_;
+    int32 nframes = std::min(kBlockFrames - i, capacity_ - slot);
+    int32 npoints = nframes * npoints_per_frame_;
+    int16 *pcm = &pcm_[slot * npoints_per_frame_];
+    int num = audio_provider_->ReadAudio(npoints, pcm);
+    // zero padded at the end of the audio
+    std::fill(pcm + num, pcm + npoints, 0);
+    PcmFrameEnergy(pcm, npoints_per_frame_, nframes, &energy_[i],
+                   zero_crossings == NULL ? NULL : zero_crossings + i);
+    num_read += num;
+    i += nframes;
   }
-  KALDI_ASSERT(raw_audio_.size() == audio_chunk);
+  audio_received_ += num_read / config_.samp_freq;
 
-  processed_data_.insert(processed_data_.end(), 
-                         raw_audio_.begin(), 
-                         raw_audio_.end());
-  int nframes = audio_chunk / npoints_per_frame_;
-  for (int i = 0; i < nframes; i++) {
-    is_speech_.push_back(VadOneFrame(i));
+  for (int32 i = 0; i < kBlockFrames; i++) {
+    is_speech_[(tail_ + i) % capacity_] = VadOneFrame(i);
   }
-  KALDI_ASSERT(is_speech_.size() * npoints_per_frame_ == 
-               processed_data_.size());
-  ProcessLeftContext();
+  tail_ += kBlockFrames;
+  // with the transition from the last frame of the previous block
+  ProcessLeftContext(std::max(head_, tail_ - kBlockFrames - 1));
 }
 
 bool Vad::VadOneFrame(int32 frame)
 {
-  double energy = FrameEnergy(frame);
+  BaseFloat energy = energy_[frame];
+  bool voice = energy >= config_.vad_energy_threshold ||
+               (nzero_crossings_ > 0 &&
+                zero_crossings_[frame] >= nzero_crossings_ &&
+                energy >= kUnvoicedEnergyRatio * config_.vad_energy_threshold);
   switch (state_) {
   case kSpeech:
-    if (energy < config_.vad_energy_threshold) {
+    if (!voice) {
       state_ = kSpeech2Silence;
       silence_frame_cnt_ = 0;
     }
     break;
   case kSpeech2Silence:
-    if (energy < config_.vad_energy_threshold) {
+    if (!voice) {
       silence_frame_cnt_++;
       if (silence_frame_cnt_ >= nframes_silence_trigger_) {
         state_ = kSilence;
@@ -133,7 +149,7 @@ bool Vad::VadOneFrame(int32 frame)
     }
     break;
   case kSilence:
-    if (energy >= config_.vad_energy_threshold) {
+    if (voice) {
       state_ = kSpeech;
     }
     break;
@@ -143,22 +159,14 @@ bool Vad::VadOneFrame(int32 frame)
   return state_ != kSilence;
 }
 
-double Vad::FrameEnergy(int32 frame) const
-{
-  double energy = 0.0;
-  int32 index = frame * npoints_per_frame_;
-  for (int i = 0; i < npoints_per_frame_; i++, index++) {
-    energy += raw_audio_[index] * raw_audio_[index] / npoints_per_frame_;
-  }
-  return energy;
-}
-
-void Vad::ProcessLeftContext()
+void Vad::ProcessLeftContext(int64 begin)
 {
-  for (size_t i = 0; i+1 < is_speech_.size(); i++) {
-    if (is_speech_.at(i) == false && is_speech_.at(i+1) == true) {
-      for (size_t j = 0; j < npoints_left_context_ && i >= j; j++) {
-        is_speech_[i-j] = true;
+  // only the transitions of the new block, so a marked left context is not
+  // taken as another beginning
+  for (int64 t = begin; t + 1 < tail_; t++) {
+    if (!IsSpeech(t) && IsSpeech(t + 1)) {
+      for (int64 j = 0; j < nframes_left_context_ && t - j >= head_; j++) {
+        is_speech_[(t - j) % capacity_] = true;
       }
     }
   }
@@ -7,7 +7,6 @@
 #include <vector>
 #include <string>
 #include <sstream>
-#include <deque>
 
 #include "aslp-online/wav-provider.h"
 #include "itf/options-itf.h"
@@ -22,13 +21,15 @@ struct VadOptions {
   BaseFloat left_context_length_ms; // in milliseconds
   BaseFloat endpoint_trigger_threshold_ms; // in milliseconds
   BaseFloat vad_energy_threshold;
+  BaseFloat vad_zero_crossing_threshold;
 
   VadOptions() : samp_freq(16000),
                  frame_length_ms(10.0),
                  silence_trigger_threshold_ms(150.0),
                  left_context_length_ms(100.0),
                  endpoint_trigger_threshold_ms(1000.0),
-                 vad_energy_threshold(1500000.0)
+                 vad_energy_threshold(1500000.0),
+                 vad_zero_crossing_threshold(0.0)
   {
   }
   std::string Print() {
@@ -38,7 +39,8 @@ struct VadOptions {
     ss << "\nsilence_trigger_threshold_ms: " << silence_trigger_threshold_ms;
     ss << "\nleft_context_length_ms: " << left_context_length_ms;
     ss << "\nendpoint_trigger_threshold_ms: " << endpoint_trigger_threshold_ms;
-    ss << "\nvad_energy_threshold: " << vad_energy_threshold << "\n";
+    ss << "\nvad_energy_threshold: " << vad_energy_threshold;
+    ss << "\nvad_zero_crossing_threshold: " << vad_zero_crossing_threshold << "\n";
     return ss.str();
   }
   void Register(OptionsItf *po) {
@@ -54,6 +56,8 @@ struct VadOptions {
                  "Length of consecutive silence to regard as endpoint in speech. ReadSpeech() will return immediately when endpoint is detected.");
     po->Register("vad-energy-threshold", &vad_energy_threshold,
                  "Voice Active Detection energy threshold");
+    po->Register("vad-zero-crossing-threshold", &vad_zero_crossing_threshold,
+                 "If > 0, a frame below the energy threshold but above a tenth of it is also voice when its zero crossings per sample are at least this, for the unvoiced beginning phonemes. 0 disables it");
   }
 };
 
@@ -73,18 +77,24 @@ class Vad {
   double AudioReceived() const { return audio_received_; }
   
   bool Done() const {
-    return audio_provider_->Done() && processed_data_.empty();
+    return audio_provider_->Done() && head_ == tail_;
   }
  
  private:
   
   void ProcessOneBlock();
 
+  // frame of the block
   bool VadOneFrame(int32 frame);
 
-  void ProcessLeftContext();
+  // the frames before the speech beginnings in [begin, tail_)
+  void ProcessLeftContext(int64 begin);
 
-  double FrameEnergy(int32 frame) const;
+  bool IsSpeech(int64 frame) const {
+    return is_speech_[frame % capacity_];
+  }
+
+  void PopFrame(std::vector<BaseFloat> *data);
 
   // Finite State Machince states
   enum { kSilence         = 0x00,
@@ -97,15 +107,21 @@ class Vad {
   VadOptions config_;
   WavProvider *audio_provider_;
 
-  std::deque<BaseFloat> processed_data_;
-  std::deque<bool> is_speech_;
+  // The frames [head_, tail_) read and not returned yet, frame t at slot
+  // t % capacity_ of the rings, allocated once
+  std::vector<int16> pcm_;
+  std::vector<char> is_speech_;
+  int32 capacity_;
+  int64 head_, tail_;
 
-  std::vector<BaseFloat> raw_audio_;
+  // of the block
+  std::vector<BaseFloat> energy_;
+  std::vector<int32> zero_crossings_;
 
   int32 npoints_per_frame_;
   int32 nframes_silence_trigger_;
   int32 nframes_left_context_;
-  int32 npoints_left_context_;
+  int32 nzero_crossings_;
 
   int32 nframes_endpoint_trigger_;
 
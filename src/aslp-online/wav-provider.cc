@@ -3,12 +3,17 @@
  * Author: zhangbinbin 
  *         hechangqing
  */
+#include <string.h>
+
+#include <algorithm>
+
 #include "aslp-online/wav-provider.h"
 
 namespace kaldi {
 namespace aslp_online {
 
-WavProvider::WavProvider(int client_sid): client_sid_(client_sid), done_(false), connect_(true) {
+WavProvider::WavProvider(int client_sid): client_sid_(client_sid), done_(false), connect_(true),
+    data_begin_(0) {
 
 }
 
@@ -48,14 +53,15 @@ bool WavProvider::WriteFull(const char *buf, int to_send) const{
 }
 
 bool WavProvider::Done() const {
-  return (done_ && data_queue_.empty()) || (!connect_ && data_queue_.empty());
+  return (done_ || !connect_) && data_begin_ == data_.size();
 }
 
 void WavProvider::Reset() {
   client_sid_ = -1;
   done_ = false;
   connect_ = false;
-  while(!data_queue_.empty()) data_queue_.pop();
+  data_.clear();
+  data_begin_ = 0;
 }
 
 /* packet format 
@@ -71,23 +77,26 @@ bool WavProvider::ReadOnce() {
   }
   len = ntohl(len); //convert netword to host
   KALDI_VLOG(2) << "new package arrived, package size: " << len;
-  char *data = new char[len];  
+  packet_.resize(std::max(len, 1));
+  char *data = &packet_[0];
   if (!ReadFull(data, len)) {
-    delete [] data;
     return false;
   }
-  int cur = 0;
   switch (data[0]) {
     case 0x00:{
-        cur += 1;
         KALDI_ASSERT((len - 1) % sizeof(short) == 0); //2 byte
-        short value;
-        for (int i = 0; i < (len - 1) / sizeof(short) ; i++) {
-          //value = ntohs(*(short *)(data + cur));
-          value = (*(short *)(data + cur));
-          data_queue_.push(value);
-          cur += sizeof(short);
+        int num = (len - 1) / sizeof(short);
+        // the samples read before are dropped first
+        if (data_begin_ == data_.size()) {
+          data_.clear();
+          data_begin_ = 0;
+        } else if (data_begin_ > data_.size() / 2) {
+          data_.erase(data_.begin(), data_.begin() + data_begin_);
+          data_begin_ = 0;
         }
+        size_t old_size = data_.size();
+        data_.resize(old_size + num);
+        memcpy(&data_[old_size], data + 1, num * sizeof(short));
       }
       break;
     case 0x01:
@@ -95,21 +104,37 @@ bool WavProvider::ReadOnce() {
       done_ = true;
       break;
   }
-  delete [] data;
   return true;
 }
 
+int WavProvider::ReadAudio(int num, int16 *data) {
+  int num_read = 0;
+  while (num_read < num) {
+    if (Done()) break; // done and no more data Or connect break and no more data
+    if (!done_ && data_begin_ == data_.size()) //no data in buffer
+      ReadOnce(); 
+    int n = std::min<size_t>(num - num_read, data_.size() - data_begin_);
+    if (n > 0) {
+      memcpy(data + num_read, &data_[data_begin_], n * sizeof(int16));
+      data_begin_ += n;
+      num_read += n;
+    }
+  }
+  return num_read;
+}
+
 int WavProvider::ReadAudio(int num, std::vector<BaseFloat> *data) {
   data->clear();
   while (num > 0) {
     if (Done()) break; // done and no more data Or connect break and no more data
-    if (!done_ && data_queue_.empty()) //no data in queue
+    if (!done_ && data_begin_ == data_.size()) //no data in buffer
       ReadOnce(); 
-    if (!data_queue_.empty()) {
-      data->push_back(static_cast<BaseFloat>(data_queue_.front()));
-      data_queue_.pop();
-      num--;
+    int n = std::min<size_t>(num, data_.size() - data_begin_);
+    for (int i = 0; i < n; i++) {
+      data->push_back(static_cast<BaseFloat>(data_[data_begin_ + i]));
     }
+    data_begin_ += n;
+    num -= n;
   }
   return data->size();
 }
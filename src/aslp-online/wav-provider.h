@@ -16,7 +16,7 @@
 #include <netinet/in.h>
 #include <arpa/inet.h>
 
-#include <queue>
+#include <vector>
 
 #include "util/common-utils.h"
 
@@ -32,6 +32,8 @@ class WavProvider {
 
   bool IsConnected() const { return connect_; }
   int ReadAudio(int num, std::vector<BaseFloat> *data);
+  // The same as the raw 16 bits pcm, to the num samples at data
+  int ReadAudio(int num, int16 *data);
   void Reset();
   // This function returns true when there is no more data.
   // The calling of function ReadAudio() will return zero after 
@@ -66,7 +68,11 @@ class WavProvider {
   int client_sid_; //client socket id
   bool done_; //if the remote audio done
   bool connect_; // whether the remote client is connected
-  std::queue<short> data_queue_;
+  // the received samples not read yet are [data_begin_, data_.size()),
+  // the buffers are reused for the packets
+  std::vector<int16> data_;
+  size_t data_begin_;
+  std::vector<char> packet_;
 };
 
 } // namespace aslp_online
@@ -0,0 +1,80 @@
+// aslp-onlinebin/aslp-fst-to-mapped.cc
+
+#include "base/kaldi-common.h"
+#include "util/common-utils.h"
+#include "fstext/fstext-lib.h"
+#include "base/timer.h"
+
+#include "aslp-online/mapped-fst.h"
+
+int main(int argc, char *argv[]) {
+    try {
+        using namespace kaldi;
+        using namespace aslp_online;
+        typedef kaldi::int32 int32;
+
+        const char *usage =
+            "Convert a decoding graph to the mapped format, which the online\n"
+            "servers and aslp-latgen-faster-rtf mmap instead of reading it into\n"
+            "memory, so they start at once and share one copy of the graph\n"
+            "The output must be a plain file, the symbol tables are not kept\n"
+            "Usage: aslp-fst-to-mapped [options] <fst-in> <mapped-fst-out>\n"
+            "e.g.:\n"
+            " aslp-fst-to-mapped HCLG.fst HCLG.mapped.fst\n";
+
+        ParseOptions po(usage);
+        bool verify = true;
+        po.Register("verify", &verify,
+                "Map the output and compare it with the input graph");
+
+        po.Read(argc, argv);
+
+        if (po.NumArgs() != 2) {
+            po.PrintUsage();
+            exit(1);
+        }
+
+        std::string fst_rxfilename = po.GetArg(1),
+            mapped_filename = po.GetArg(2);
+
+        Timer timer;
+        fst::VectorFst<fst::StdArc> *fst = fst::ReadFstKaldi(fst_rxfilename);
+        KALDI_LOG << "Read " << fst_rxfilename << " in " << timer.Elapsed()
+                  << " s, " << fst->NumStates() << " states";
+
+        WriteMappedFst(*fst, mapped_filename);
+
+        timer.Reset();
+        MappedFst *mapped_fst = MappedFst::Map(mapped_filename);
+        KALDI_LOG << "Mapped " << mapped_filename << " in " << timer.Elapsed()
+                  << " s, " << mapped_fst->MappedBytes() << " bytes";
+
+        if (verify) {
+            typedef fst::StdArc Arc;
+            for (Arc::StateId s = 0; s < fst->NumStates(); s++) {
+                if (fst->Final(s) != mapped_fst->Final(s) ||
+                    fst->NumArcs(s) != mapped_fst->NumArcs(s))
+                    KALDI_ERR << "Mismatch of state " << s;
+                fst::ArcIterator<fst::VectorFst<Arc> > aiter(*fst, s);
+                fst::ArcIterator<MappedFst> miter(*mapped_fst, s);
+                for (; !aiter.Done(); aiter.Next(), miter.Next()) {
+                    const Arc &a = aiter.Value(), &m = miter.Value();
+                    if (a.ilabel != m.ilabel || a.olabel != m.olabel ||
+                        a.weight != m.weight || a.nextstate != m.nextstate)
+                        KALDI_ERR << "Mismatch of an arc of state " << s;
+                }
+            }
+            if (fst->NumStates() != mapped_fst->NumStates() ||
+                fst->Start() != mapped_fst->Start())
+                KALDI_ERR << "Mismatch of the start state or the states";
+            KALDI_LOG << "Verified " << mapped_filename;
+        }
+
+        delete mapped_fst;
+        delete fst;
+        return 0;
+    } catch(const std::exception &e) {
+        std::cerr << e.what();
+        return -1;
+    }
+}
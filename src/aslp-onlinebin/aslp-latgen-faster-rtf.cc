@@ -12,11 +12,32 @@
 #include "decoder/decoder-wrappers.h"
 #include "decoder/decodable-matrix.h"
 #include "base/timer.h"
+#include "util/edit-distance.h"
 
 #include "aslp-nnet/nnet-nnet.h"
 #include "aslp-nnet/nnet-pdf-prior.h"
 #include "aslp-nnet/nnet-decodable.h"
 
+#include "aslp-online/mapped-fst.h"
+
+namespace kaldi {
+
+// Words and log-likelihood of the best path of the last decoded utterance,
+// the same as DecodeUtteranceLatticeFaster() reports, like may be NULL
+static void GetBestPathWords(const LatticeFasterDecoder &decoder,
+                             std::vector<int32> *words, double *like) {
+    words->clear();
+    if (like != NULL) *like = 0.0;
+    Lattice best_path;
+    if (!decoder.GetBestPath(&best_path)) return;
+    std::vector<int32> alignment;
+    LatticeWeight weight;
+    fst::GetLinearSymbolSequence(best_path, &alignment, words, &weight);
+    if (like != NULL) *like = -(weight.Value1() + weight.Value2());
+}
+
+} // namespace kaldi
+
 int main(int argc, char *argv[]) {
     try {
         using namespace kaldi;
@@ -28,6 +49,12 @@ int main(int argc, char *argv[]) {
 
         const char *usage =
             "Decode with feature input and generate lattice and ouput rtf info\n"
+            "With --reference-nnet(e.g. the float model of an aslp-nnet-quantize output),\n"
+            "every utterance is decoded with it too, and the word difference of the\n"
+            "two best paths, the likelihood and the rtf of both are reported\n"
+            "The rtf is split into the nnet forward and the search, for low frame rate\n"
+            "decoding(--skip-type=lfr --skip-width=3) with a graph built by\n"
+            "aslp-make-h3-transducer --skip-width=3\n"
             "Usage: aslp-latgen-faster-rtf [options] nnet_in trans-model-in fst-in feature-rspecifier"
             " lattice-wspecifier [ words-wspecifier [alignments-wspecifier] ]\n";
         ParseOptions po(usage);
@@ -51,6 +78,10 @@ int main(int argc, char *argv[]) {
         double frames_per_second = 100;
         po.Register("frames-per-second", &frames_per_second, 
                     "for calcuate RTF, one second wav for frames-per-second feat");
+        std::string reference_nnet_rxfilename;
+        po.Register("reference-nnet", &reference_nnet_rxfilename,
+                    "Nnet to compare the accuracy and speed with, "
+                    "e.g. the float model of a quantized nnet_in");
 
         po.Read(argc, argv);
 
@@ -68,7 +99,7 @@ int main(int argc, char *argv[]) {
             alignment_wspecifier = po.GetOptArg(7);
 
         // Read decode fst file
-        VectorFst<StdArc> *decode_fst = fst::ReadFstKaldi(fst_in_str);
+        fst::Fst<StdArc> *decode_fst = aslp_online::ReadDecodeFst(fst_in_str);
         LatticeFasterDecoder decoder(*decode_fst, config);
         // Prior file for pdf prior
         KALDI_LOG << "Read prior file " << prior_config.class_frame_counts;
@@ -84,6 +115,14 @@ int main(int argc, char *argv[]) {
             Input ki(nnet_rxfilename, &binary);
             nnet.Read(ki.Stream(), binary);
         }
+        Nnet reference_nnet;
+        LatticeFasterDecoder *reference_decoder = NULL;
+        if (reference_nnet_rxfilename != "") {
+            bool binary;
+            Input ki(reference_nnet_rxfilename, &binary);
+            reference_nnet.Read(ki.Stream(), binary);
+            reference_decoder = new LatticeFasterDecoder(*decode_fst, config);
+        }
         // Read transition model
         TransitionModel trans_model;
         ReadKaldiObject(model_in_filename, &trans_model);
@@ -109,7 +148,10 @@ int main(int argc, char *argv[]) {
         double tot_like = 0.0;
         kaldi::int64 frame_count = 0;
         int num_success = 0, num_fail = 0;
-        double total_wav_time = 0, total_decode_time = 0;
+        double total_wav_time = 0, total_decode_time = 0, total_nnet_time = 0;
+        // accuracy delta against --reference-nnet
+        double reference_tot_like = 0.0, total_reference_decode_time = 0;
+        int64 reference_words = 0, word_diffs = 0;
 
         SequentialBaseFloatMatrixReader feature_reader(feature_rspecifier);
         for (; !feature_reader.Done(); feature_reader.Next()) {
@@ -126,22 +168,68 @@ int main(int argc, char *argv[]) {
                         &words_writer, &compact_lattice_writer, &lattice_writer,
                         &like)) {
                 tot_like += like;
-                frame_count += feat.NumRows();
+                // decoded frames, every skip-width-th frame in lfr mode
+                frame_count += decodable.NumFramesReady();
                 num_success++;
                 // For calcuate RTF
                 double decode_time = timer.Elapsed();
+                double nnet_time = decodable.NnetTime();
                 double wav_time = feat.NumRows() / frames_per_second; 
-                KALDI_LOG << utt << " RTF " << decode_time / wav_time;
+                KALDI_LOG << utt << " RTF " << decode_time / wav_time
+                          << " (nnet " << nnet_time / wav_time << ", search "
+                          << (decode_time - nnet_time) / wav_time << ")";
                 total_decode_time += decode_time;
+                total_nnet_time += nnet_time;
                 total_wav_time += wav_time;
+                if (reference_decoder != NULL) {
+                    std::vector<int32> words, reference_words_utt;
+                    double reference_like;
+                    GetBestPathWords(decoder, &words, NULL);
+                    timer.Reset();
+                    NnetDecodable reference_decodable(&reference_nnet, log_prior, trans_model,
+                                                      nnet_decoding_config, feat);
+                    reference_decoder->Decode(&reference_decodable);
+                    total_reference_decode_time += timer.Elapsed();
+                    GetBestPathWords(*reference_decoder, &reference_words_utt,
+                                     &reference_like);
+                    reference_tot_like += reference_like;
+                    int32 diff = LevenshteinEditDistance(reference_words_utt, words);
+                    KALDI_VLOG(1) << utt << " " << diff << " word differences against "
+                                  << reference_words_utt.size() << " reference words";
+                    reference_words += reference_words_utt.size();
+                    word_diffs += diff;
+                }
             } else {
                 num_fail++;
             }
         }
 
+        delete reference_decoder;
         delete decode_fst; // delete this only after decoder goes out of scope.
         
-        KALDI_LOG << "TOTAL RTF " << total_decode_time / total_wav_time;
+        KALDI_LOG << "TOTAL RTF " << total_decode_time / total_wav_time
+                  << ", nnet RTF " << total_nnet_time / total_wav_time
+                  << ", search RTF "
+                  << (total_decode_time - total_nnet_time) / total_wav_time;
+        // compare with --token-pool=false for the cost of new/delete
+        const MemoryPoolStats &token_stats = decoder.TokenPoolStats(),
+                              &link_stats = decoder.LinkPoolStats();
+        KALDI_LOG << "Decoder tokens allocated " << token_stats.num_allocated
+                  << ", reused " << 100.0 * token_stats.ReuseRate()
+                  << " %, peak " << token_stats.peak_bytes / 1024 << " KB";
+        KALDI_LOG << "Decoder forward links allocated " << link_stats.num_allocated
+                  << ", reused " << 100.0 * link_stats.ReuseRate()
+                  << " %, peak " << link_stats.peak_bytes / 1024 << " KB";
+        if (reference_nnet_rxfilename != "") {
+            KALDI_LOG << "Reference nnet TOTAL RTF "
+                      << total_reference_decode_time / total_wav_time;
+            KALDI_LOG << "Reference nnet log-likelihood per frame is "
+                      << (reference_tot_like/frame_count) << ", delta "
+                      << (tot_like - reference_tot_like)/frame_count;
+            KALDI_LOG << "Word difference against the reference nnet "
+                      << 100.0 * word_diffs / std::max<int64>(reference_words, 1)
+                      << " % (" << word_diffs << " / " << reference_words << ")";
+        }
         KALDI_LOG << "Done " << num_success << " utterances, failed for "
             << num_fail;
         KALDI_LOG << "Overall log-likelihood per frame is " << (tot_like/frame_count) << " over "
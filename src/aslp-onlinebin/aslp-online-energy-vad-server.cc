@@ -25,6 +25,7 @@
 #include "aslp-online/vad.h"
 #include "aslp-online/online-endpoint.h"
 #include "aslp-online/punctuation-processor.h"
+#include "aslp-online/mapped-fst.h"
 
 int main(int argc, char *argv[]) {
     try {
@@ -123,7 +124,8 @@ int main(int argc, char *argv[]) {
                           << word_syms_rxfilename;
         }
         KALDI_LOG << "Reading fst file " << fst_rxfilename;
-        fst::Fst<fst::StdArc> *decode_fst = ReadFstKaldi(fst_rxfilename);
+        // mapped instead of read if it is converted by aslp-fst-to-mapped
+        fst::Fst<fst::StdArc> *decode_fst = ReadDecodeFst(fst_rxfilename);
 
         KALDI_LOG << "Read all param files done!!!";
 
@@ -11,6 +11,7 @@
 #include "aslp-nnet/nnet-nnet.h"
 #include "aslp-nnet/nnet-pdf-prior.h"
 #include "aslp-nnet/nnet-decodable.h"
+#include "aslp-nnet/nnet-shared-forward.h"
 
 #include "aslp-online/online-helper.h"
 #include "aslp-online/online-nnet-decoder.h"
@@ -20,6 +21,9 @@
 #include "aslp-online/online-vad-feature-pipeline.h"
 #include "aslp-online/online-endpoint.h"
 #include "aslp-online/punctuation-processor.h"
+#include "aslp-online/nnet-batch-scheduler.h"
+#include "aslp-online/epoll-server.h"
+#include "aslp-online/mapped-fst.h"
 
 int main(int argc, char *argv[]) {
     try {
@@ -47,6 +51,12 @@ int main(int argc, char *argv[]) {
         vad_config.Register(&po);
         PdfPriorOptions prior_config;
         prior_config.Register(&po);
+        NnetBatchSchedulerOptions batch_config;
+        batch_config.Register(&po);
+        // --vad.batch-streams, --vad.batch-max-wait-ms
+        ParseOptions vad_po("vad", &po);
+        NnetBatchSchedulerOptions vad_batch_config;
+        vad_batch_config.Register(&vad_po);
 
         BaseFloat chunk_length_secs = 0.1;
         po.Register("chunk-length", &chunk_length_secs,
@@ -67,6 +77,17 @@ int main(int argc, char *argv[]) {
         int forward_batch = 12;
         po.Register("forward-batch", &forward_batch,
                 "forward batch size of the am nnet");
+        bool share_am_nnet = true;
+        po.Register("share-am-nnet", &share_am_nnet,
+                "If true, all threads share the parameters of one am nnet and "
+                "only keep their own buffers and recurrent states, otherwise "
+                "every thread makes a copy of the am nnet");
+        bool use_epoll = false;
+        po.Register("use-epoll", &use_epoll,
+                "If true, all the connections are read by one epoll thread "
+                "and a decoding thread only serves a connection when it has "
+                "new audio, so the connections are not limited by --num-thread "
+                "(the am nnet must be shared or batched)");
 
         po.Read(argc, argv);
         if (po.NumArgs() != 5) {
@@ -104,6 +125,12 @@ int main(int argc, char *argv[]) {
             Input ki(am_nnet_rxfilename, &binary);
             am_nnet.Read(ki.Stream(), binary);
         }
+        // before the shared forwards and the copies are made from it
+        if (nnet_decoding_config.decodable_opts.fsmn_streaming) {
+            am_nnet.SetFsmnStreaming(true);
+            KALDI_LOG << "Streaming FSMN, am nnet delay "
+                      << am_nnet.FsmnStreamingDelay() << " frames";
+        }
         KALDI_LOG << "Reading vad nnet file " << vad_nnet_rxfilename;
         // Nnet model for vad model
         Nnet vad_nnet;
@@ -129,7 +156,8 @@ int main(int argc, char *argv[]) {
                           << word_syms_rxfilename;
         }
         KALDI_LOG << "Reading fst file " << fst_rxfilename;
-        fst::Fst<fst::StdArc> *decode_fst = ReadFstKaldi(fst_rxfilename);
+        // mapped instead of read if it is converted by aslp-fst-to-mapped
+        fst::Fst<fst::StdArc> *decode_fst = ReadDecodeFst(fst_rxfilename);
 
         KALDI_LOG << "Read all param files done!!!";
 
@@ -142,23 +170,104 @@ int main(int argc, char *argv[]) {
             chunk_length = std::numeric_limits<int32>::max();
         }
 
+        // All threads share one am nnet by the batched forward scheduler
+        NnetBatchScheduler *am_scheduler = NULL;
+        if (batch_config.max_batch_streams > 0) {
+            KALDI_LOG << "Batched am nnet forward, max batch streams "
+                      << batch_config.max_batch_streams << " max wait "
+                      << batch_config.max_wait_ms << " ms";
+            am_scheduler = new NnetBatchScheduler(batch_config, &am_nnet);
+        }
+
+        // The new chunks of all the sessions are scored in batches, else
+        // every thread scores its chunks by a forward over the vad nnet
+        NnetBatchScheduler *vad_scheduler = NULL;
+        if (vad_batch_config.max_batch_streams > 0) {
+            KALDI_LOG << "Batched vad nnet forward, max batch streams "
+                      << vad_batch_config.max_batch_streams << " max wait "
+                      << vad_batch_config.max_wait_ms << " ms";
+            vad_scheduler = new NnetBatchScheduler(vad_batch_config,
+                                                   &vad_nnet, "vad");
+        }
+
+        if (use_epoll && am_scheduler == NULL && !share_am_nnet) {
+            KALDI_ERR << "--use-epoll requires --share-am-nnet=true or "
+                      << "--batch-streams > 0";
+        }
+
         // Nnet pool for thread pool, allocated enough at begin,
         // Avoid dynamic allocating in the running time
         KALDI_LOG << "Creating thread pool resource";
+        int64 rss_before = GetResidentMemoryKb();
         std::vector<void *> resource_pool(num_thread, NULL);
         for (int i = 0; i < num_thread; i++) {
-            Nnet *new_am_nnet = new Nnet(am_nnet);
-            Nnet *new_vad_nnet = new Nnet(vad_nnet);
+            Nnet *new_am_nnet = NULL;
+            NnetSharedForward *am_forward = NULL;
+            // With epoll, the am forward state belongs to the sessions
+            if (am_scheduler == NULL && !use_epoll) {
+                if (share_am_nnet) am_forward = new NnetSharedForward(am_nnet);
+                else new_am_nnet = new Nnet(am_nnet);
+            }
+            NnetSharedForward *vad_forward = NULL;
+            if (vad_scheduler == NULL) {
+                vad_forward = new NnetSharedForward(vad_nnet);
+            }
             NnetVadDecodeThreadResource *resource = 
-                new NnetVadDecodeThreadResource(new_am_nnet, new_vad_nnet);
+                new NnetVadDecodeThreadResource(new_am_nnet, &vad_nnet,
+                                                am_forward, vad_forward);
             resource_pool[i] = static_cast<void *>(resource);
         }
+        int64 rss_after = GetResidentMemoryKb();
         KALDI_LOG << "Creating thread pool resource Done!!!";
+        KALDI_LOG << "Resident memory " << rss_before << " KB before and "
+                  << rss_after << " KB after creating " << num_thread
+                  << " thread resources, "
+                  << (rss_after - rss_before) / std::max(num_thread, 1)
+                  << " KB per thread";
+        if (am_scheduler == NULL && share_am_nnet && !use_epoll &&
+            num_thread > 0) {
+            NnetVadDecodeThreadResource *resource = 
+                static_cast<NnetVadDecodeThreadResource *>(resource_pool[0]);
+            KALDI_LOG << "Am nnet parameters shared by all threads "
+                      << resource->am_forward->SharedParamBytes() / 1024
+                      << " KB, copied per thread "
+                      << resource->am_forward->PrivateParamBytes() / 1024
+                      << " KB";
+        }
+        if (vad_scheduler == NULL && num_thread > 0) {
+            NnetVadDecodeThreadResource *resource = 
+                static_cast<NnetVadDecodeThreadResource *>(resource_pool[0]);
+            KALDI_LOG << "Vad nnet parameters shared by all threads "
+                      << resource->vad_forward->SharedParamBytes() / 1024
+                      << " KB, copied per thread "
+                      << resource->vad_forward->PrivateParamBytes() / 1024
+                      << " KB";
+        }
 
         // Wait ThreadPool destruct then delete nnet in nnet_pool
         {
             ThreadPool thread_pool(num_thread, &resource_pool);
 
+            if (use_epoll) {
+                const Nnet *shared_am_nnet = 
+                    am_scheduler == NULL ? &am_nnet : NULL;
+                NnetVadDecodeSessionFactory factory(chunk_length,
+                                                    forward_batch,
+                                                    samp_freq,
+                                                    feature_config,
+                                                    nnet_decoding_config,
+                                                    vad_config, trans_model,
+                                                    log_prior, *decode_fst,
+                                                    punctuation_processor,
+                                                    word_syms,
+                                                    shared_am_nnet,
+                                                    am_scheduler,
+                                                    vad_scheduler);
+                // A session is scheduled when it has one chunk of new audio
+                EpollServer epoll_server(&factory, &thread_pool, chunk_length);
+                epoll_server.Run(tcp_server);
+            }
+
             while (true) {
                 // Wait for new connection
                 int32 client_socket = tcp_server.Accept();
@@ -171,7 +280,9 @@ int main(int argc, char *argv[]) {
                                                    vad_config, trans_model,
                                                    log_prior, *decode_fst,
                                                    punctuation_processor,
-                                                   word_syms);
+                                                   word_syms,
+                                                   am_scheduler,
+                                                   vad_scheduler);
                 // Add in thread pool
                 thread_pool.AddTask(task);
             }
@@ -181,9 +292,12 @@ int main(int argc, char *argv[]) {
             NnetVadDecodeThreadResource *resource = 
                 static_cast<NnetVadDecodeThreadResource *>(resource_pool[i]); 
             delete resource->am_nnet;
-            delete resource->vad_nnet;
+            delete resource->am_forward;
+            delete resource->vad_forward;
             delete resource;
         }
+        delete am_scheduler;
+        delete vad_scheduler;
         delete decode_fst;
         delete word_syms; // will delete if non-NULL.
         return 0;
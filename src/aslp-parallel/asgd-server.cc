@@ -9,16 +9,33 @@ namespace kaldi {
 
 void AsgdServer::InitParam(
         const std::vector<std::pair<BaseFloat *, int> > &params) {
+    shard_.Init(params, NumNodes());
+    tensors_ = shard_.Tensors(Rank());
     server_gpu_params_.resize(params.size());
-    worker_gpu_params_.resize(params.size());
-    cpu_params_.resize(params.size());
+    worker_gpu_params_.resize(params.size(), NULL);
+    cpu_params_.resize(params.size(), NULL);
 
     for (int i = 0; i < params.size(); i++) {
         server_gpu_params_[i] = new 
             CuSubVector<BaseFloat>(params[i].first, params[i].second); 
+    }
+    for (int k = 0; k < tensors_.size(); k++) {
+        int i = tensors_[k];
         worker_gpu_params_[i] = new CuVector<BaseFloat>(params[i].second);
         cpu_params_[i] = new Vector<BaseFloat>(params[i].second);
     }
+    if (!codec_.IsLossless()) {
+        // all the workers start from the same model as the server
+        worker_models_.resize(shard_.NumWorkers());
+        for (int j = 0; j < shard_.NumWorkers(); j++) {
+            worker_models_[j].resize(params.size(), NULL);
+            for (int k = 0; k < tensors_.size(); k++) {
+                int i = tensors_[k];
+                worker_models_[j][i] = new Vector<BaseFloat>(params[i].second);
+                worker_models_[j][i]->CopyFromVec(*server_gpu_params_[i]);
+            }
+        }
+    }
 }
 
 AsgdServer::~AsgdServer() {
@@ -29,17 +46,22 @@ AsgdServer::~AsgdServer() {
         delete worker_gpu_params_[i];
         delete cpu_params_[i];
     }
+    for (int j = 0; j < worker_models_.size(); j++) {
+        for (int i = 0; i < worker_models_[j].size(); i++) {
+            delete worker_models_[j][i];
+        }
+    }
 }
 
 void AsgdServer::Run() {
-    int num_running_workers = NumNodes() - 1;
+    int num_running_workers = shard_.NumWorkers();
     int synchronized_count = 0;
 	std::vector<int> waited_worker;
 	MPI_Status status;
     int msg_type, worker_rank;
     while (num_running_workers > 0) {
         // tag 0, msg type 
-        MPI_Recv(&msg_type, 1, MPI_INT, MPI_ANY_SOURCE, MPI_ANY_TAG, 
+        MPI_Recv(&msg_type, 1, MPI_INT, MPI_ANY_SOURCE, kTagMsg, 
             MPI_COMM_WORLD, &status);
         worker_rank = status.MPI_SOURCE;
         KALDI_VLOG(2) << "Worker rank " << worker_rank << " Msg " << msg_type;
@@ -63,11 +85,7 @@ void AsgdServer::Run() {
                 num_running_workers != 0) {
 			for (int j = 0; j < waited_worker.size(); j++) {
 				KALDI_LOG << "Worker " << waited_worker[j] << " synchronized!";
-				for (int i = 0; i < cpu_params_.size(); i++) {
-        		//KALDI_LOG << "send " << i << " size " << cpu_params_[i]->Dim();
-        			MPI_Send(cpu_params_[i]->Data(), cpu_params_[i]->Dim(), 
-            	    	 	 MPI_FLOAT, waited_worker[j], kTagModel, MPI_COMM_WORLD);
-    			}
+				SendModel(waited_worker[j]);
 			}
 			synchronized_count = synchronized_count - sync_period_;
 			waited_worker.clear();
@@ -75,30 +93,68 @@ void AsgdServer::Run() {
     }
 
     KALDI_LOG << "All worker finished";
+    if (!codec_.IsLossless()) {
+        KALDI_LOG << "Server sent " << send_stats_.Report();
+        KALDI_LOG << "Server received " << recv_stats_.Report();
+    }
+    // the main server gets the tensors of the others, to write the model
+    shard_.GatherModel(server_gpu_params_, Rank());
 }
 
 void AsgdServer::Update(int worker_rank, int synchronized_count) {
-    MPI_Status status;
-    // 1. receive gradient from worker
-    for (int i = 0; i < cpu_params_.size(); i++) {
-        //KALDI_LOG << "recv " << i << " size " << cpu_params_[i]->Dim();
-        MPI_Recv(cpu_params_[i]->Data(), cpu_params_[i]->Dim(),
-                 MPI_FLOAT, worker_rank, i, MPI_COMM_WORLD, &status);
+    // 1. receive gradient of the tensors of this server from worker
+    if (codec_.IsLossless()) {
+        requests_.resize(tensors_.size());
+        for (int k = 0; k < tensors_.size(); k++) {
+            int i = tensors_[k];
+            MPI_Irecv(cpu_params_[i]->Data(), cpu_params_[i]->Dim(),
+                      MPI_FLOAT, worker_rank, i, MPI_COMM_WORLD, &requests_[k]);
+        }
+        MPI_Waitall(requests_.size(), requests_.empty() ? NULL : &requests_[0],
+                    MPI_STATUSES_IGNORE);
+    } else {
+        for (int k = 0; k < tensors_.size(); k++) {
+            int i = tensors_[k];
+            codec_.Recv(worker_rank, i, cpu_params_[i], &recv_stats_);
+        }
+    }
+    for (int k = 0; k < tensors_.size(); k++) {
+        int i = tensors_[k];
         worker_gpu_params_[i]->CopyFromVec(*cpu_params_[i]);
     }
     // 2. update model
-    for (int i = 0; i < worker_gpu_params_.size(); i++) {
+    for (int k = 0; k < tensors_.size(); k++) {
+        int i = tensors_[k];
         server_gpu_params_[i]->AddVec(alpha_, *worker_gpu_params_[i], 1.0);
         cpu_params_[i]->CopyFromVec(*server_gpu_params_[i]);
     }
     // 3. send new model to worker
     if (synchronized_count < sync_period_ || sync_period_ <= 0) {
-		for (int i = 0; i < cpu_params_.size(); i++) {
-        	//KALDI_LOG << "send " << i << " size " << cpu_params_[i]->Dim();
-        	MPI_Send(cpu_params_[i]->Data(), cpu_params_[i]->Dim(), 
-            	     MPI_FLOAT, worker_rank, kTagModel, MPI_COMM_WORLD);
-    	}
+        SendModel(worker_rank);
 	}
 }
 
+void AsgdServer::SendModel(int worker_rank) {
+    if (codec_.IsLossless()) {
+        for (int k = 0; k < tensors_.size(); k++) {
+            int i = tensors_[k];
+            MPI_Send(cpu_params_[i]->Data(), cpu_params_[i]->Dim(), 
+                     MPI_FLOAT, worker_rank, kTagModel, MPI_COMM_WORLD);
+        }
+        return;
+    }
+    // the change since the model the worker has, the error of the codec
+    // stays in the difference and goes with the next one
+    for (int k = 0; k < tensors_.size(); k++) {
+        int i = tensors_[k];
+        Vector<BaseFloat> &worker_model =
+            *worker_models_[shard_.WorkerIndex(worker_rank)][i];
+        Vector<BaseFloat> diff(*cpu_params_[i]);
+        diff.AddVec(-1.0, worker_model);
+        decoded_.Resize(diff.Dim(), kUndefined);
+        codec_.Send(diff, worker_rank, kTagModel, &decoded_, &send_stats_);
+        worker_model.AddVec(1.0, decoded_);
+    }
+}
+
 } // namespace kaldi
@@ -12,6 +12,8 @@
 
 #include "aslp-parallel/mpi-node.h"
 #include "aslp-parallel/itf.h"
+#include "aslp-parallel/delta-codec.h"
+#include "aslp-parallel/param-shard.h"
 
 namespace kaldi {
 
@@ -20,8 +22,12 @@ namespace kaldi {
 
 class AsgdServer : public IServer {
 public:
-    AsgdServer(float alpha = 1.0, int sync_period = 1000): 
-				alpha_(alpha), sync_period_(sync_period) {}
+    // @num_servers: the tensors are sharded over the server ranks 0 .. num_servers - 1
+    AsgdServer(float alpha = 1.0, int sync_period = 1000,
+               const DeltaCodecOptions &codec_opts = DeltaCodecOptions(),
+               int num_servers = 1): 
+				alpha_(alpha), sync_period_(sync_period), codec_(codec_opts),
+				shard_(num_servers) {}
     ~AsgdServer();
     // @params type pair: first is to the gpu data points, 
     //                    second is the size of it
@@ -36,13 +42,25 @@ public:
     // Update server model with one worker
     void Update(int worker_rank, int count);
 private:
+    // Sends the model in cpu_params_ to the worker
+    void SendModel(int worker_rank);
     float alpha_;
     int32 sync_period_;
 	// Here we use CuSubVector for that the memory is hold and managed by train model,
     // CuSubVector only share and update this pointer, refer to CuSubVector for details
     std::vector<CuSubVector<BaseFloat> *> server_gpu_params_;
+    // of the tensors of this server only, NULL for the others
     std::vector<CuVector<BaseFloat> *> worker_gpu_params_;
     std::vector<Vector<BaseFloat> *> cpu_params_;
+    DeltaCodec codec_;
+    ParamShard shard_;
+    std::vector<int> tensors_;  // of this server
+    std::vector<MPI_Request> requests_;
+    // For a lossy codec: the model each worker has, the server sends the
+    // difference to it
+    std::vector<std::vector<Vector<BaseFloat> *> > worker_models_;
+    Vector<BaseFloat> decoded_;
+    CodecStats send_stats_, recv_stats_;
 };
 
 
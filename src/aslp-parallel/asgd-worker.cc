@@ -12,6 +12,8 @@ void AsgdWorker::InitParam(
     prev_worker_gpu_params_.resize(params.size());
     worker_gpu_params_.resize(params.size());
     worker_cpu_params_.resize(params.size());
+    grad_cpu_params_.resize(params.size());
+    shard_.Init(params, NumNodes());
 
     for (int i = 0; i < params.size(); i++) {
         worker_gpu_params_[i] = new 
@@ -19,6 +21,12 @@ void AsgdWorker::InitParam(
         prev_worker_gpu_params_[i] = new CuVector<BaseFloat>(params[i].second);
         prev_worker_gpu_params_[i]->CopyFromVec(*worker_gpu_params_[i]);
         worker_cpu_params_[i] = new Vector<BaseFloat>(params[i].second);
+        // the model the server sends is a delta to this
+        worker_cpu_params_[i]->CopyFromVec(*worker_gpu_params_[i]);
+        grad_cpu_params_[i] = new Vector<BaseFloat>(params[i].second);
+        if (!codec_.IsLossless()) {
+            residuals_.push_back(new Vector<BaseFloat>(params[i].second));
+        }
     }
 }
 
@@ -28,34 +36,41 @@ AsgdWorker::~AsgdWorker() {
         delete prev_worker_gpu_params_[i];
         delete worker_gpu_params_[i];
         delete worker_cpu_params_[i];
+        delete grad_cpu_params_[i];
+    }
+    for (int i = 0; i < residuals_.size(); i++) {
+        delete residuals_[i];
     }
 }
 
 bool AsgdWorker::Synchronize(int num_worker_samples) {
     (void)num_worker_samples;
     int msg_type = kMsgSynchronize;
-    // 1. send synchronize signal 
-    MPI_Send(&msg_type, 1, MPI_INT, MainNode(), kTagMsg, MPI_COMM_WORLD);
-    // 2.1 copy worker_gpu_params_ to worker_cpu_params_
+    // 1. send synchronize signal to all the servers
+    shard_.SendMsg(msg_type);
+    if (!codec_.IsLossless()) {
+        return SynchronizeEncoded();
+    }
+    // 2.1 copy worker_gpu_params_ to grad_cpu_params_
     for (int i = 0; i < worker_gpu_params_.size(); i++) {
         // get accumulated gradient
         worker_gpu_params_[i]->AddVec(-1.0, *prev_worker_gpu_params_[i], 1.0);
-        worker_cpu_params_[i]->CopyFromVec(*worker_gpu_params_[i]);
+        grad_cpu_params_[i]->CopyFromVec(*worker_gpu_params_[i]);
     }
 
-    // 2.2 send accumulated gradient woker_cpu_params_
-    for (int i = 0; i < worker_cpu_params_.size(); i++) {
-        //KALDI_LOG << "send " << i << " size " << worker_cpu_params_[i]->Dim();
-        MPI_Send(worker_cpu_params_[i]->Data(), worker_cpu_params_[i]->Dim(), 
-                 MPI_FLOAT, MainNode(), i, MPI_COMM_WORLD);
-    }
-    // 2.3 recive server_cpu_params_
-    MPI_Status status;
-    for (int i = 0; i < worker_cpu_params_.size(); i++) {
-        //KALDI_LOG << "recv " << i << " size " << worker_cpu_params_[i]->Dim();
-        MPI_Recv(worker_cpu_params_[i]->Data(), worker_cpu_params_[i]->Dim(),
-                 MPI_FLOAT, MainNode(), kTagModel, MPI_COMM_WORLD, &status);
+    // 2.2 send accumulated gradient grad_cpu_params_ and receive the model
+    // worker_cpu_params_, with all the servers at once. All the receives are
+    // posted before waiting, a server replying is never blocked by this worker
+    int n = worker_cpu_params_.size();
+    requests_.resize(2 * n);
+    for (int i = 0; i < n; i++) {
+        MPI_Isend(grad_cpu_params_[i]->Data(), grad_cpu_params_[i]->Dim(), 
+                  MPI_FLOAT, shard_.ServerOf(i), i, MPI_COMM_WORLD, &requests_[i]);
+        MPI_Irecv(worker_cpu_params_[i]->Data(), worker_cpu_params_[i]->Dim(),
+                  MPI_FLOAT, shard_.ServerOf(i), kTagModel, MPI_COMM_WORLD,
+                  &requests_[n + i]);
     }
+    MPI_Waitall(2 * n, requests_.empty() ? NULL : &requests_[0], MPI_STATUSES_IGNORE);
 
     // 2.3 copy worker_cpu_params_ to worker_gpu_params_ and prev_worker_gpu_params_ 
     for (int i = 0; i < worker_gpu_params_.size(); i++) {
@@ -67,11 +82,52 @@ bool AsgdWorker::Synchronize(int num_worker_samples) {
     return true;
 }
 
+// The gradient goes with error feedback, the server sends the change of its
+// model since the last synchronization, which is added to the model
+// worker_cpu_params_ the server knows this worker has
+bool AsgdWorker::SynchronizeEncoded() {
+    int n = worker_gpu_params_.size();
+    requests_.resize(n);
+    send_buffers_.resize(n);
+    for (int i = 0; i < n; i++) {
+        // accumulated gradient, plus what was not sent before
+        worker_gpu_params_[i]->AddVec(-1.0, *prev_worker_gpu_params_[i], 1.0);
+        Vector<BaseFloat> &residual = *residuals_[i];
+        Vector<BaseFloat> grad(worker_gpu_params_[i]->Dim(), kUndefined);
+        grad.CopyFromVec(*worker_gpu_params_[i]);
+        residual.AddVec(1.0, grad);
+        decoded_.Resize(residual.Dim(), kUndefined);
+        codec_.Isend(residual, shard_.ServerOf(i), i, &send_buffers_[i],
+                     &decoded_, &send_stats_, &requests_[i]);
+        residual.AddVec(-1.0, decoded_);
+    }
+    // the servers reply in any order, each in the order of its tensors
+    std::vector<int> num_received(shard_.NumServers(), 0);
+    for (int k = 0; k < n; k++) {
+        MPI_Status status;
+        MPI_Probe(MPI_ANY_SOURCE, kTagModel, MPI_COMM_WORLD, &status);
+        int server = status.MPI_SOURCE,
+            i = shard_.Tensors(server)[num_received[server]++];
+        decoded_.Resize(worker_cpu_params_[i]->Dim(), kUndefined);
+        codec_.Recv(server, kTagModel, &decoded_, &recv_stats_);
+        worker_cpu_params_[i]->AddVec(1.0, decoded_);
+    }
+    MPI_Waitall(n, requests_.empty() ? NULL : &requests_[0], MPI_STATUSES_IGNORE);
+    for (int i = 0; i < worker_gpu_params_.size(); i++) {
+        worker_gpu_params_[i]->CopyFromVec(*worker_cpu_params_[i]);
+        prev_worker_gpu_params_[i]->CopyFromVec(*worker_cpu_params_[i]);
+    }
+    return true;
+}
+
 void AsgdWorker::Stop() {
     // Send Stop signal
-    int msg_type = kMsgFinished;
-    MPI_Send(&msg_type, 1, MPI_INT, MainNode(), kTagMsg, MPI_COMM_WORLD);
+    shard_.SendMsg(kMsgFinished);
     KALDI_LOG << "Worker " << Rank() << " finished";
+    if (!codec_.IsLossless()) {
+        KALDI_LOG << "Worker " << Rank() << " sent " << send_stats_.Report();
+        KALDI_LOG << "Worker " << Rank() << " received " << recv_stats_.Report();
+    }
 }
 
 } // namespace kaldi
@@ -12,6 +12,8 @@
 
 #include "aslp-parallel/mpi-node.h"
 #include "aslp-parallel/itf.h"
+#include "aslp-parallel/delta-codec.h"
+#include "aslp-parallel/param-shard.h"
 
 namespace kaldi {
 
@@ -20,7 +22,10 @@ namespace kaldi {
 
 class AsgdWorker: public IWorker {
 public:
-    AsgdWorker() {};
+    // @num_servers: the tensors are sharded over the server ranks 0 .. num_servers - 1
+    AsgdWorker(const DeltaCodecOptions &codec_opts = DeltaCodecOptions(),
+               int num_servers = 1):
+        codec_(codec_opts), shard_(num_servers) {};
     ~AsgdWorker();
     // @params type pair: first is to the gpu data points, 
     //                    second is the size of it
@@ -31,11 +36,21 @@ public:
     
     void Stop();
 private:
+    bool SynchronizeEncoded();
     // Here we use CuSubVector for that the memory is hold and managed by train model,
     // CuSubVector only share and update this pointer, refer to CuSubVector for details
     std::vector<CuSubVector<BaseFloat> *> worker_gpu_params_;
     std::vector<CuVector<BaseFloat> *> prev_worker_gpu_params_;
-    std::vector<Vector<BaseFloat> *> worker_cpu_params_;
+    std::vector<Vector<BaseFloat> *> worker_cpu_params_, grad_cpu_params_;
+    DeltaCodec codec_;
+    ParamShard shard_;
+    std::vector<MPI_Request> requests_;
+    std::vector<std::vector<char> > send_buffers_;
+    // For a lossy codec: the gradient not sent yet(error feedback), and the
+    // decoded buffer
+    std::vector<Vector<BaseFloat> *> residuals_;
+    Vector<BaseFloat> decoded_;
+    CodecStats send_stats_, recv_stats_;
 };
 
 } // namespace kaldi
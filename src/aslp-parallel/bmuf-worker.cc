@@ -12,7 +12,8 @@ void BmufWorker::InitParam(
     prev_gpu_params_.resize(params.size());
     grad_gpu_params_.resize(params.size());
     prev_grad_gpu_params_.resize(params.size());
-    grad_cpu_params_.resize(params.size());
+    grad_tensors_.resize(params.size());
+    std::vector<int> sizes(params.size());
     for (int i = 0; i < params.size(); i++) {
         gpu_params_[i] = new 
             CuSubVector<BaseFloat>(params[i].first, params[i].second); 
@@ -20,8 +21,10 @@ void BmufWorker::InitParam(
         prev_gpu_params_[i]->CopyFromVec(*gpu_params_[i]);
         grad_gpu_params_[i] = new CuVector<BaseFloat>(params[i].second);
         prev_grad_gpu_params_[i] = new CuVector<BaseFloat>(params[i].second);
-        grad_cpu_params_[i] = new Vector<BaseFloat>(params[i].second);
+        grad_tensors_[i] = grad_gpu_params_[i];
+        sizes[i] = params[i].second;
     }
+    allreduce_ = new BucketAllReduce(sizes, bucket_size_, algorithm_);
 }
 
 BmufWorker::~BmufWorker() {
@@ -30,8 +33,8 @@ BmufWorker::~BmufWorker() {
         delete prev_gpu_params_[i];
         delete grad_gpu_params_[i];
         delete prev_grad_gpu_params_[i];
-        delete grad_cpu_params_[i];
     }
+    delete allreduce_;
 }
 
 bool BmufWorker::Synchronize(int num_worker_samples) {
@@ -44,15 +47,16 @@ bool BmufWorker::Synchronize(int num_worker_samples) {
     }
     
     // Do BMUF(Block Momentum Update Filtering)
+    // 1. calc grad w(t) - wg(t-1)
     for (int i = 0; i < gpu_params_.size(); i++) {
-        // 1. calc grad w(t) - wg(t-1)
         grad_gpu_params_[i]->CopyFromVec(*gpu_params_[i]);
         grad_gpu_params_[i]->AddVec(-1.0, *prev_gpu_params_[i]);
-        grad_cpu_params_[i]->CopyFromVec(*grad_gpu_params_[i]);
-        // 2. reduce
-        AllReduce(grad_cpu_params_[i]->Data(), grad_cpu_params_[i]->Dim());
-        // 3. copy to gpu
-        grad_gpu_params_[i]->CopyFromVec(*grad_cpu_params_[i]);
+    }
+    // 2. reduce, 3. copy to gpu, overlapped by the bucketed allreduce
+    allreduce_->AllReduce(grad_tensors_);
+    KALDI_VLOG(1) << "Worker " << Rank() << " synchronize, "
+                  << allreduce_->LastTiming().Report();
+    for (int i = 0; i < gpu_params_.size(); i++) {
         // 4. calc mometum grad:  d(t) = m * g(t-1) + (1 - m) * lr * g(t)
         float lr = (1.0 - momentum_) * learn_rate_;
         grad_gpu_params_[i]->AddVec(momentum_, *prev_grad_gpu_params_[i], lr);
@@ -72,6 +76,31 @@ void BmufWorker::Stop() {
     // it's own data, then loop to wait others 
     KALDI_LOG << "Worker " << Rank() << "finished, waitting for others";
     while (Synchronize(0)); 
+    KALDI_LOG << "Worker " << Rank() << " "
+              << allreduce_->TotalTiming().Report();
+}
+
+void BmufWorker::WriteState(std::ostream &os, bool binary) const {
+    WriteToken(os, binary, "<BlockMomentum>");
+    WriteBasicType(os, binary, static_cast<int32>(prev_grad_gpu_params_.size()));
+    for (int i = 0; i < prev_grad_gpu_params_.size(); i++) {
+        prev_grad_gpu_params_[i]->Write(os, binary);
+    }
+}
+
+void BmufWorker::ReadState(std::istream &is, bool binary) {
+    int32 num_params;
+    ExpectToken(is, binary, "<BlockMomentum>");
+    ReadBasicType(is, binary, &num_params);
+    if (num_params != prev_grad_gpu_params_.size()) {
+        KALDI_ERR << "Block momentum of " << num_params << " tensors, the model has "
+                  << prev_grad_gpu_params_.size();
+    }
+    for (int i = 0; i < prev_grad_gpu_params_.size(); i++) {
+        int dim = prev_grad_gpu_params_[i]->Dim();
+        prev_grad_gpu_params_[i]->Read(is, binary);
+        KALDI_ASSERT(prev_grad_gpu_params_[i]->Dim() == dim);
+    }
 }
 
 } // namespace kaldi
@@ -12,6 +12,7 @@
 
 #include "aslp-parallel/mpi-node.h"
 #include "aslp-parallel/itf.h"
+#include "aslp-parallel/bucket-allreduce.h"
 
 namespace kaldi {
 
@@ -28,8 +29,12 @@ namespace kaldi {
 
 class BmufWorker : public IWorker {
 public:
-    BmufWorker(float learn_rate = 1.0, float momentum = 0.9): 
-        learn_rate_(learn_rate), momentum_(momentum) {}
+    // @bucket_size: parameters reduced together, see BucketAllReduce
+    // @algorithm: allreduce algorithm, see BucketAllReduce
+    BmufWorker(float learn_rate = 1.0, float momentum = 0.9,
+               int bucket_size = 1 << 20, const std::string &algorithm = "mpi"):
+        learn_rate_(learn_rate), momentum_(momentum),
+        bucket_size_(bucket_size), algorithm_(algorithm), allreduce_(NULL) {}
     ~BmufWorker();
     // @params type pair: first is to the gpu data points, 
     //                    second is the size of it
@@ -40,6 +45,9 @@ public:
     bool Synchronize(int num_worker_samples); 
 
     void Stop();
+
+    void WriteState(std::ostream &os, bool binary) const;
+    void ReadState(std::istream &is, bool binary);
 private:
     // Here we use CuSubVector for that the memory is hold and managed by train model,
     // CuSubVector only share and update this pointer, refer to CuSubVector for details
@@ -47,10 +55,13 @@ private:
     std::vector<CuVector<BaseFloat > *> prev_gpu_params_;
     std::vector<CuVector<BaseFloat> *> grad_gpu_params_;
     std::vector<CuVector<BaseFloat> *> prev_grad_gpu_params_;
-    std::vector<Vector<BaseFloat> *> grad_cpu_params_;
+    std::vector<CuVectorBase<BaseFloat> *> grad_tensors_;
 
     float learn_rate_;
     float momentum_; // 
+    int bucket_size_;
+    std::string algorithm_;
+    BucketAllReduce *allreduce_;
 };
 
 //The block momentum and block learning rate are usually automatically set according to the number of workers used, i.e.,
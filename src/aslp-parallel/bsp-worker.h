@@ -12,13 +12,17 @@
 
 #include "aslp-parallel/mpi-node.h"
 #include "aslp-parallel/itf.h"
+#include "aslp-parallel/bucket-allreduce.h"
 
 namespace kaldi {
 
 // BspWorker: Do modle Averge
 class BspWorker : public IWorker {
 public:
-    BspWorker() {}
+    // @bucket_size: parameters reduced together, see BucketAllReduce
+    // @algorithm: allreduce algorithm, see BucketAllReduce
+    BspWorker(int bucket_size = 1 << 20, const std::string &algorithm = "mpi"):
+        bucket_size_(bucket_size), algorithm_(algorithm), allreduce_(NULL) {}
     ~BspWorker();
     // @params type pair: first is to the gpu data points, 
     //                    second is the size of it
@@ -33,7 +37,10 @@ private:
     // Here we use CuSubVector for that the memory is hold and managed by train model,
     // CuSubVector only share and update this pointer, refer to CuSubVector for details
     std::vector<CuSubVector<BaseFloat> *> gpu_params_;
-    std::vector<Vector<BaseFloat> *> cpu_params_;
+    std::vector<CuVectorBase<BaseFloat> *> tensors_;
+    int bucket_size_;
+    std::string algorithm_;
+    BucketAllReduce *allreduce_;
 };
 
 
@@ -0,0 +1,57 @@
+/* Test of BucketAllReduce, run it by mpirun with any number of processes
+ */
+
+#include "aslp-parallel/bucket-allreduce.h"
+
+namespace kaldi {
+
+void TestBucketAllReduce(MpiNode *node, const std::string &algorithm) {
+    int sizes_array[] = { 1, 300, 7, 1000, 0, 64, 2048, 5 };
+    std::vector<int> sizes(sizes_array, sizes_array + 8);
+    int bucket_sizes[] = { 0, 1, 100, 1500, 1 << 20 };
+    for (int k = 0; k < 5; k++) {
+        BucketAllReduce allreduce(sizes, bucket_sizes[k], algorithm);
+        std::vector<CuVector<BaseFloat> *> gpu(sizes.size());
+        std::vector<CuVectorBase<BaseFloat> *> tensors(sizes.size());
+        std::vector<Vector<BaseFloat> > expect(sizes.size());
+        for (int i = 0; i < sizes.size(); i++) {
+            gpu[i] = new CuVector<BaseFloat>(sizes[i]);
+            tensors[i] = gpu[i];
+            // integers, the sum is exact in any order
+            for (int j = 0; j < sizes[i]; j++) {
+                (*gpu[i])(j) = (node->Rank() + 1) * (j % 17) - i;
+            }
+            expect[i].Resize(sizes[i]);
+            expect[i].CopyFromVec(*gpu[i]);
+            node->AllReduce(expect[i].Data(), expect[i].Dim());
+        }
+        for (int n = 0; n < 2; n++) {
+            if (n > 0) {
+                for (int i = 0; i < sizes.size(); i++) {
+                    gpu[i]->CopyFromVec(expect[i]);
+                    gpu[i]->Scale(1.0 / node->NumNodes());
+                }
+            }
+            allreduce.AllReduce(tensors);
+            for (int i = 0; i < sizes.size(); i++) {
+                Vector<BaseFloat> result(sizes[i]);
+                result.CopyFromVec(*gpu[i]);
+                KALDI_ASSERT(result.ApproxEqual(expect[i], 1e-5));
+            }
+        }
+        KALDI_ASSERT(allreduce.TotalTiming().num_sync == 2);
+        for (int i = 0; i < sizes.size(); i++) delete gpu[i];
+    }
+}
+
+} // namespace kaldi
+
+int main() {
+    using namespace kaldi;
+    MpiNode node;
+    TestBucketAllReduce(&node, "mpi");
+    TestBucketAllReduce(&node, "ring");
+    TestBucketAllReduce(&node, "hierarchical");
+    if (node.IsMainNode()) std::cout << "Test OK.\n";
+    return 0;
+}
@@ -0,0 +1,156 @@
+/* Bucketed non-blocking allreduce for the synchronous workers
+ */
+
+#if HAVE_CUDA == 1
+#include <cuda_runtime_api.h>
+#endif
+
+#include <sstream>
+
+#include "base/timer.h"
+#include "cudamatrix/cu-device.h"
+#include "aslp-parallel/bucket-allreduce.h"
+
+namespace kaldi {
+
+std::string SyncTiming::Report() const {
+    std::ostringstream os;
+    os << num_sync << " synchronization, copy " << copy << " s, reduce "
+       << reduce << " s, wait " << wait << " s";
+    return os.str();
+}
+
+BucketAllReduce::BucketAllReduce(const std::vector<int> &sizes,
+                                 int bucket_size, const std::string &algorithm):
+        pinned_(false), ring_(NULL) {
+    KALDI_ASSERT(bucket_size >= 0);
+    if (algorithm == "ring" || algorithm == "hierarchical") {
+        ring_ = new RingAllReduce(algorithm == "hierarchical");
+    } else if (algorithm != "mpi") {
+        KALDI_ERR << "Unknown allreduce algorithm " << algorithm;
+    }
+    offset_.resize(sizes.size());
+    int total = 0, bucket_total = 0;
+    for (int i = 0; i < sizes.size(); i++) {
+        if (i == 0 || bucket_total >= bucket_size) {
+            bucket_begin_.push_back(i);
+            bucket_total = 0;
+        }
+        offset_[i] = total;
+        total += sizes[i];
+        bucket_total += sizes[i];
+    }
+    bucket_begin_.push_back(sizes.size());
+    host_.Resize(total, kUndefined);
+    requests_.resize(NumBuckets(), MPI_REQUEST_NULL);
+    done_index_.resize(NumBuckets());
+#if HAVE_CUDA == 1
+    // pinned, the copies are dma without a staging buffer
+    if (CuDevice::Instantiate().Enabled() && total > 0) {
+        pinned_ = (cudaHostRegister(host_.Data(), total * sizeof(BaseFloat),
+                                    cudaHostRegisterDefault) == cudaSuccess);
+        if (!pinned_) KALDI_WARN << "Could not pin the host buffer";
+    }
+#endif
+    KALDI_LOG << "Allreduce " << total << " parameters of " << sizes.size()
+              << " tensors in " << NumBuckets() << " buckets by " << algorithm;
+}
+
+BucketAllReduce::~BucketAllReduce() {
+    delete ring_;
+#if HAVE_CUDA == 1
+    if (pinned_) cudaHostUnregister(host_.Data());
+#endif
+}
+
+void BucketAllReduce::CopyToTensors(int b,
+        const std::vector<CuVectorBase<BaseFloat> *> &tensors) {
+    for (int i = bucket_begin_[b]; i < bucket_begin_[b + 1]; i++) {
+        tensors[i]->CopyFromVec(host_.Range(offset_[i], tensors[i]->Dim()));
+    }
+}
+
+void BucketAllReduce::AllReduce(
+        const std::vector<CuVectorBase<BaseFloat> *> &tensors) {
+    KALDI_ASSERT(tensors.size() == offset_.size());
+    SyncTiming timing;
+    timing.num_sync = 1;
+    if (ring_ != NULL) {
+        RingAllReduceBuckets(tensors, &timing);
+        last_timing_ = timing;
+        total_timing_.Add(timing);
+        return;
+    }
+    Timer timer;
+    int num_done = 0, num_buckets = NumBuckets();
+    for (int b = 0; b < num_buckets; b++) {
+        // 1. copy the bucket to the host
+        timer.Reset();
+        int begin = bucket_begin_[b], end = bucket_begin_[b + 1];
+        for (int i = begin; i < end; i++) {
+            host_.Range(offset_[i], tensors[i]->Dim()).CopyFromVec(*tensors[i]);
+        }
+        timing.copy += timer.Elapsed();
+        // 2. start reducing it, and look for the finished ones
+        timer.Reset();
+        int bucket_begin = offset_[begin],
+            bucket_end = (end < offset_.size()) ? offset_[end] : host_.Dim();
+        MPI_Iallreduce(MPI_IN_PLACE, host_.Data() + bucket_begin,
+                       bucket_end - bucket_begin,
+                       MpiNode::GetDataType(host_.Data()), MPI_SUM,
+                       MPI_COMM_WORLD, &requests_[b]);
+        int num_out = 0;
+        MPI_Testsome(b + 1, &requests_[0], &num_out, &done_index_[0],
+                     MPI_STATUSES_IGNORE);
+        timing.reduce += timer.Elapsed();
+        // 3. copy the reduced ones back, while the others are in flight
+        if (num_out != MPI_UNDEFINED) {
+            timer.Reset();
+            for (int k = 0; k < num_out; k++) {
+                CopyToTensors(done_index_[k], tensors);
+            }
+            num_done += num_out;
+            timing.copy += timer.Elapsed();
+        }
+    }
+    while (num_done < num_buckets) {
+        timer.Reset();
+        int num_out = 0;
+        MPI_Waitsome(num_buckets, &requests_[0], &num_out, &done_index_[0],
+                     MPI_STATUSES_IGNORE);
+        timing.wait += timer.Elapsed();
+        KALDI_ASSERT(num_out != MPI_UNDEFINED);
+        timer.Reset();
+        for (int k = 0; k < num_out; k++) {
+            CopyToTensors(done_index_[k], tensors);
+        }
+        num_done += num_out;
+        timing.copy += timer.Elapsed();
+    }
+    last_timing_ = timing;
+    total_timing_.Add(timing);
+}
+
+void BucketAllReduce::RingAllReduceBuckets(
+        const std::vector<CuVectorBase<BaseFloat> *> &tensors,
+        SyncTiming *timing) {
+    Timer timer;
+    for (int b = 0; b < NumBuckets(); b++) {
+        timer.Reset();
+        int begin = bucket_begin_[b], end = bucket_begin_[b + 1];
+        for (int i = begin; i < end; i++) {
+            host_.Range(offset_[i], tensors[i]->Dim()).CopyFromVec(*tensors[i]);
+        }
+        timing->copy += timer.Elapsed();
+        timer.Reset();
+        int bucket_begin = offset_[begin],
+            bucket_end = (end < offset_.size()) ? offset_[end] : host_.Dim();
+        ring_->AllReduce(host_.Data() + bucket_begin, bucket_end - bucket_begin);
+        timing->reduce += timer.Elapsed();
+        timer.Reset();
+        CopyToTensors(b, tensors);
+        timing->copy += timer.Elapsed();
+    }
+}
+
+} // namespace kaldi
@@ -0,0 +1,76 @@
+/* Bucketed non-blocking allreduce for the synchronous workers
+ */
+
+#ifndef ASLP_PARALLEL_BUCKET_ALLREDUCE_H_
+#define ASLP_PARALLEL_BUCKET_ALLREDUCE_H_
+
+#include "base/kaldi-common.h"
+#include "matrix/matrix-lib.h"
+#include "cudamatrix/cu-matrix.h"
+#include "cudamatrix/cu-vector.h"
+
+#include "aslp-parallel/mpi-node.h"
+#include "aslp-parallel/ring-allreduce.h"
+
+namespace kaldi {
+
+// Time of the synchronizations, in seconds
+struct SyncTiming {
+    double copy;    // gpu to host and host to gpu copies
+    double reduce;  // starting and testing the reductions
+    double wait;    // waiting for the reductions after all were started
+    int num_sync;
+    SyncTiming(): copy(0.0), reduce(0.0), wait(0.0), num_sync(0) {}
+    void Add(const SyncTiming &other) {
+        copy += other.copy; reduce += other.reduce; wait += other.wait;
+        num_sync += other.num_sync;
+    }
+    std::string Report() const;
+};
+
+// Sums the parameter tensors of all the nodes, in place.
+// The tensors are packed into buckets of about bucket_size values, each
+// bucket is one contiguous(pinned when CUDA is used) host buffer and one
+// MPI_Iallreduce, so small tensors do not pay the latency of a collective
+// each. A bucket starts reducing once its tensors are copied to the host,
+// while the next buckets are still copied, and the reduced buckets are
+// copied back while the others are in flight.
+// With the ring or hierarchical algorithm(see RingAllReduce) the buckets are
+// reduced one after another as they are copied, without the overlap.
+class BucketAllReduce {
+public:
+    // @sizes: sizes of the tensors, in the order they are reduced
+    // @bucket_size: values in one bucket, 0 for one bucket per tensor
+    // @algorithm: mpi(MPI_Iallreduce) | ring | hierarchical
+    BucketAllReduce(const std::vector<int> &sizes, int bucket_size,
+                    const std::string &algorithm = "mpi");
+    ~BucketAllReduce();
+
+    void AllReduce(const std::vector<CuVectorBase<BaseFloat> *> &tensors);
+
+    int NumBuckets() const { return bucket_begin_.size() - 1; }
+    // of the last AllReduce()
+    const SyncTiming &LastTiming() const { return last_timing_; }
+    // of all the AllReduce() calls
+    const SyncTiming &TotalTiming() const { return total_timing_; }
+
+private:
+    void CopyToTensors(int b, const std::vector<CuVectorBase<BaseFloat> *> &tensors);
+    void RingAllReduceBuckets(const std::vector<CuVectorBase<BaseFloat> *> &tensors,
+                              SyncTiming *timing);
+
+    std::vector<int> offset_;       // of the tensors in host_
+    std::vector<int> bucket_begin_; // first tensor of the buckets, and the end
+    Vector<BaseFloat> host_;
+    bool pinned_;
+    RingAllReduce *ring_;  // NULL for mpi
+    std::vector<MPI_Request> requests_;
+    std::vector<int> done_index_;
+    SyncTiming last_timing_, total_timing_;
+
+    KALDI_DISALLOW_COPY_AND_ASSIGN(BucketAllReduce);
+};
+
+} // namespace kaldi
+
+#endif
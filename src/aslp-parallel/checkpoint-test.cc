@@ -0,0 +1,114 @@
+/* Test of the checkpoints and of the worker state they keep, run it by
+ * mpirun with any number of processes in a directory they all share
+ */
+
+#include <stdio.h>
+#include <sys/stat.h>
+
+#include <fstream>
+#include <sstream>
+
+#include "aslp-parallel/checkpoint.h"
+#include "aslp-parallel/bmuf-worker.h"
+#include "aslp-parallel/optimizer.h"
+
+namespace kaldi {
+
+std::string ReadFile(const std::string &filename) {
+    std::ifstream is(filename.c_str(), std::ios::binary);
+    std::ostringstream os;
+    os << is.rdbuf();
+    return os.str();
+}
+
+void TestCheckpointer(MpiNode *node) {
+    CheckpointOptions opts;
+    opts.dir = "checkpoint-test.dir";
+    opts.period = 2;
+    if (node->IsMainNode()) {
+        mkdir(opts.dir.c_str(), 0755);
+        remove((opts.dir + "/checkpoint").c_str());
+    }
+    node->Barrier();
+    {
+        Checkpointer checkpointer(opts, node);
+        KALDI_ASSERT(!checkpointer.Resume());
+        for (int n = 1; n <= 5; n++) {
+            if (checkpointer.Due()) {
+                std::ostringstream model;
+                model << "model " << n;
+                checkpointer.Save(model.str(), "state", 10 * node->Rank() + n, true);
+            }
+        }
+    }
+    node->Barrier();
+    Checkpointer checkpointer(opts, node);
+    KALDI_ASSERT(checkpointer.Resume());
+    KALDI_ASSERT(checkpointer.NumSync() == 4);
+    KALDI_ASSERT(ReadFile(checkpointer.ModelFilename()) == "model 4");
+    KALDI_ASSERT(ReadFile(checkpointer.StateFilename()) == "state");
+    // the lowest position, rank 0
+    KALDI_ASSERT(checkpointer.Skip(true) == 4);
+    // the previous one is removed
+    KALDI_ASSERT(ReadFile(opts.dir + "/model.2").empty());
+    node->Barrier();
+}
+
+void TestOptimizerState() {
+    int size = 1001;
+    OptimizerOption option;
+    option.solver = "adam";
+    Optimizer *optimizer = option.NewInstance(size);
+    CuVector<BaseFloat> grad(size), param(size);
+    CuSubVector<BaseFloat> sub_param(param.Data(), size);
+    for (int n = 0; n < 3; n++) {
+        grad.SetRandn();
+        optimizer->Optimize(grad, &sub_param);
+    }
+    std::ostringstream os;
+    optimizer->Write(os, true);
+    Optimizer *resumed = option.NewInstance(size);
+    std::istringstream is(os.str());
+    resumed->Read(is, true);
+    // the same step from the same state
+    CuVector<BaseFloat> resumed_param(param);
+    CuSubVector<BaseFloat> sub_resumed(resumed_param.Data(), size);
+    grad.SetRandn();
+    optimizer->Optimize(grad, &sub_param);
+    resumed->Optimize(grad, &sub_resumed);
+    resumed_param.AddVec(-1.0, param);
+    KALDI_ASSERT(resumed_param.Norm(2.0) == 0.0);
+    delete optimizer;
+    delete resumed;
+}
+
+void TestBmufState(MpiNode *node) {
+    CuVector<BaseFloat> model(100);
+    model.SetRandn();
+    std::vector<std::pair<BaseFloat *, int> > params(1, std::make_pair(model.Data(), 100));
+    BmufWorker worker;
+    worker.InitParam(params);
+    model.Add(node->Rank() + 1);
+    worker.Synchronize(1);
+    std::ostringstream os;
+    worker.WriteState(os, false);
+    BmufWorker resumed;
+    resumed.InitParam(params);
+    std::istringstream is(os.str());
+    resumed.ReadState(is, false);
+    std::ostringstream resumed_os;
+    resumed.WriteState(resumed_os, false);
+    KALDI_ASSERT(resumed_os.str() == os.str());
+}
+
+} // namespace kaldi
+
+int main() {
+    using namespace kaldi;
+    MpiNode node;
+    TestCheckpointer(&node);
+    TestOptimizerState();
+    TestBmufState(&node);
+    if (node.IsMainNode()) std::cout << "Test OK.\n";
+    return 0;
+}
@@ -0,0 +1,164 @@
+/* Checkpoints of the synchronous training, written in the background
+ */
+
+#include <stdio.h>
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+#include "base/timer.h"
+#include "aslp-parallel/checkpoint.h"
+
+namespace kaldi {
+
+static std::string CheckpointFile(const std::string &dir, const std::string &name,
+                                  int64 num_sync) {
+    std::ostringstream os;
+    os << dir << "/" << name;
+    if (num_sync >= 0) os << "." << num_sync;
+    return os.str();
+}
+
+// Writes to a temporary file, renamed to the file when it is complete. In
+// the checkpoint thread, a failure only warns, the training goes on.
+static bool WriteFileAtomic(const std::string &filename, const std::string &data) {
+    std::string tmp = filename + ".tmp";
+    {
+        std::ofstream os(tmp.c_str(), std::ios::binary);
+        os.write(data.data(), data.size());
+        os.flush();
+        if (!os.good()) {
+            KALDI_WARN << "Failed to write " << tmp;
+            return false;
+        }
+    }
+    if (rename(tmp.c_str(), filename.c_str()) != 0) {
+        KALDI_WARN << "Failed to rename " << tmp << " to " << filename;
+        return false;
+    }
+    return true;
+}
+
+Checkpointer::Checkpointer(const CheckpointOptions &opts, const MpiNode *node):
+        opts_(opts), node_(node), num_sync_(0), sharded_(false), writing_(false),
+        write_sync_(-1), prev_sync_(-1) {
+    KALDI_ASSERT(opts_.period > 0);
+}
+
+Checkpointer::~Checkpointer() {
+    Wait();
+}
+
+bool Checkpointer::Resume() {
+    if (!Enabled()) return false;
+    std::ifstream is(CheckpointFile(opts_.dir, "checkpoint", -1).c_str());
+    if (!is.good()) return false;
+    int32 num_workers;
+    ExpectToken(is, false, "<NumSync>");
+    ReadBasicType(is, false, &num_sync_);
+    ExpectToken(is, false, "<Sharded>");
+    ReadBasicType(is, false, &sharded_);
+    ExpectToken(is, false, "<Positions>");
+    ReadBasicType(is, false, &num_workers);
+    positions_.resize(num_workers);
+    for (int i = 0; i < num_workers; i++) {
+        ReadBasicType(is, false, &positions_[i]);
+    }
+    prev_sync_ = num_sync_;
+    KALDI_LOG << "Resume from the checkpoint after " << num_sync_
+              << " synchronizations of " << num_workers << " workers";
+    return true;
+}
+
+std::string Checkpointer::ModelFilename() const {
+    return CheckpointFile(opts_.dir, "model", num_sync_);
+}
+
+std::string Checkpointer::StateFilename() const {
+    return CheckpointFile(opts_.dir, "state", num_sync_);
+}
+
+int64 Checkpointer::Skip(bool sharded) const {
+    if (positions_.empty()) return 0;
+    if (sharded) {
+        if (!sharded_) {
+            KALDI_ERR << "The checkpoint is of the workers reading their own "
+                      << "feature lists, it can not be resumed sharded";
+        }
+        return *std::min_element(positions_.begin(), positions_.end());
+    }
+    if (sharded_) {
+        KALDI_ERR << "The checkpoint is of the workers reading sharded, "
+                  << "resume it sharded too";
+    }
+    if (positions_.size() != node_->NumNodes()) {
+        KALDI_ERR << "The checkpoint of " << positions_.size() << " workers "
+                  << "reading their own feature lists can not be resumed by "
+                  << node_->NumNodes() << " workers, only the sharded ones can";
+    }
+    return positions_[node_->Rank()];
+}
+
+bool Checkpointer::Due() {
+    num_sync_++;
+    return Enabled() && num_sync_ % opts_.period == 0;
+}
+
+void Checkpointer::Save(const std::string &model, const std::string &state,
+                        int64 position, bool sharded) {
+    std::vector<int64> positions(node_->NumNodes());
+    MPI_Gather(&position, 1, MPI_LONG_LONG_INT, &positions[0], 1,
+               MPI_LONG_LONG_INT, node_->MainNode(), MPI_COMM_WORLD);
+    if (!node_->IsMainNode()) return;
+    // one write at a time, the previous one is done long ago usually
+    Wait();
+    std::ostringstream os;
+    WriteToken(os, false, "<NumSync>");
+    WriteBasicType(os, false, num_sync_);
+    WriteToken(os, false, "<Sharded>");
+    WriteBasicType(os, false, sharded);
+    WriteToken(os, false, "<Positions>");
+    WriteBasicType(os, false, static_cast<int32>(positions.size()));
+    for (int i = 0; i < positions.size(); i++) {
+        WriteBasicType(os, false, positions[i]);
+    }
+    os << "\n";
+    model_ = model;
+    state_ = state;
+    index_ = os.str();
+    write_sync_ = num_sync_;
+    if (pthread_create(&thread_, NULL, Checkpointer::Write, this) != 0) {
+        KALDI_ERR << "Failed to create the checkpoint thread";
+    }
+    writing_ = true;
+}
+
+void Checkpointer::Wait() {
+    if (!writing_) return;
+    pthread_join(thread_, NULL);
+    writing_ = false;
+}
+
+void *Checkpointer::Write(void *arg) {
+    Checkpointer *self = static_cast<Checkpointer *>(arg);
+    const std::string &dir = self->opts_.dir;
+    Timer timer;
+    if (!WriteFileAtomic(CheckpointFile(dir, "model", self->write_sync_), self->model_) ||
+        !WriteFileAtomic(CheckpointFile(dir, "state", self->write_sync_), self->state_) ||
+        !WriteFileAtomic(CheckpointFile(dir, "checkpoint", -1), self->index_)) {
+        KALDI_WARN << "Checkpoint after " << self->write_sync_
+                   << " synchronizations failed, the previous one stays";
+        return NULL;
+    }
+    if (self->prev_sync_ >= 0) {
+        remove(CheckpointFile(dir, "model", self->prev_sync_).c_str());
+        remove(CheckpointFile(dir, "state", self->prev_sync_).c_str());
+    }
+    self->prev_sync_ = self->write_sync_;
+    KALDI_LOG << "Checkpoint after " << self->write_sync_ << " synchronizations, "
+              << "written in " << timer.Elapsed() << " s";
+    return NULL;
+}
+
+} // namespace kaldi
@@ -0,0 +1,89 @@
+/* Checkpoints of the synchronous training, written in the background
+ */
+
+#ifndef ASLP_PARALLEL_CHECKPOINT_H_
+#define ASLP_PARALLEL_CHECKPOINT_H_
+
+#include <pthread.h>
+
+#include <string>
+#include <vector>
+
+#include "base/kaldi-common.h"
+#include "itf/options-itf.h"
+
+#include "aslp-parallel/mpi-node.h"
+
+namespace kaldi {
+
+struct CheckpointOptions {
+    std::string dir;
+    int period;
+    CheckpointOptions(): period(100) {}
+    void Register(OptionsItf *opts) {
+        opts->Register("checkpoint-dir", &dir, "Directory of the checkpoints "
+                       "of the synchronous workers(bsp | bmuf | sod), on a file "
+                       "system all the hosts share, the training resumes from "
+                       "the last one in it (empty, no checkpoints)");
+        opts->Register("checkpoint-period", &period, "Number of "
+                       "synchronizations from one checkpoint to the next");
+    }
+};
+
+// A checkpoint is taken right after a synchronization, when the model and
+// the worker state are the same on all the workers: the main worker writes
+// them with the data positions(FrameDataReader::Position) of all the workers
+// as <dir>/model.<n>, <dir>/state.<n> and the index <dir>/checkpoint,
+// n the number of synchronizations. The files are written by a thread while
+// the training goes on, the index last, so a crash in between leaves the
+// previous checkpoint. All the ranks are the workers.
+//
+// To resume with another number of workers the feature list must be read
+// sharded(DataShard), all the utterances before the lowest position of the
+// workers are trained; the others later on, a few are trained twice.
+class Checkpointer {
+public:
+    Checkpointer(const CheckpointOptions &opts, const MpiNode *node);
+    // waits for the last write
+    ~Checkpointer();
+
+    bool Enabled() const { return !opts_.dir.empty(); }
+
+    // Reads the index of the last checkpoint in the directory, on all the
+    // workers, false if there is none
+    bool Resume();
+    // Of the checkpoint Resume() found
+    std::string ModelFilename() const;
+    std::string StateFilename() const;
+    int64 NumSync() const { return num_sync_; }
+    // DataShard::skip of this worker, @sharded: how the data is read now
+    int64 Skip(bool sharded) const;
+
+    // Collective, after each synchronization on all the workers, true at
+    // every period-th one
+    bool Due();
+    // Collective, gathers the positions of the workers, the main worker
+    // writes the model and the worker state it serialized in the background
+    void Save(const std::string &model, const std::string &state,
+              int64 position, bool sharded);
+
+private:
+    void Wait();
+    static void *Write(void *arg);
+
+    const CheckpointOptions &opts_;
+    const MpiNode *node_;
+    int64 num_sync_;
+    // the one resumed from
+    bool sharded_;
+    std::vector<int64> positions_;
+    // the one being written
+    bool writing_;
+    pthread_t thread_;
+    std::string model_, state_, index_;
+    int64 write_sync_, prev_sync_;
+};
+
+} // namespace kaldi
+
+#endif
@@ -0,0 +1,73 @@
+/* Test of DeltaCodec encoding and decoding
+ */
+
+#include "aslp-parallel/delta-codec.h"
+
+namespace kaldi {
+
+void TestDeltaCodecRoundTrip(const std::string &codec) {
+    DeltaCodecOptions opts;
+    opts.codec = codec;
+    opts.topk_ratio = 0.1;
+    DeltaCodec delta_codec(opts);
+    int dims[] = { 0, 1, 7, 1024, 2500 };
+    for (int k = 0; k < 5; k++) {
+        Vector<BaseFloat> x(dims[k]), decoded(dims[k]), y(dims[k]);
+        x.SetRandn();
+        std::vector<char> buf;
+        delta_codec.Encode(x, &buf, &decoded);
+        delta_codec.Decode(buf, &y);
+        // the receiver decodes exactly what the sender expects
+        KALDI_ASSERT(y.ApproxEqual(decoded, 1e-6));
+        if (codec == "none") {
+            KALDI_ASSERT(buf.size() == x.Dim() * sizeof(BaseFloat));
+            KALDI_ASSERT(y.ApproxEqual(x, 0.0));
+        } else if (x.Dim() > 0) {
+            KALDI_ASSERT(buf.size() < x.Dim() * sizeof(BaseFloat) + 16);
+        }
+        if (codec == "8bit" && x.Dim() > 0) {
+            Vector<BaseFloat> diff(x);
+            diff.AddVec(-1.0, y);
+            // at most half a step, of a range of a few units
+            KALDI_ASSERT(diff.Max() < 0.1 && diff.Min() > -0.1);
+        }
+    }
+}
+
+// With error feedback, what is received sums to what was sent
+void TestDeltaCodecErrorFeedback(const std::string &codec) {
+    DeltaCodecOptions opts;
+    opts.codec = codec;
+    opts.topk_ratio = 0.05;
+    DeltaCodec delta_codec(opts);
+    int dim = 3000, num_rounds = 200;
+    Vector<BaseFloat> residual(dim), decoded(dim), x(dim),
+                      sent_sum(dim), received_sum(dim);
+    std::vector<char> buf;
+    for (int n = 0; n < num_rounds; n++) {
+        x.SetRandn();
+        sent_sum.AddVec(1.0, x);
+        residual.AddVec(1.0, x);
+        delta_codec.Encode(residual, &buf, &decoded);
+        residual.AddVec(-1.0, decoded);
+        received_sum.AddVec(1.0, decoded);
+    }
+    // the difference is the residual, which stays bounded while the sum grows
+    Vector<BaseFloat> diff(sent_sum);
+    diff.AddVec(-1.0, received_sum);
+    KALDI_ASSERT(diff.ApproxEqual(residual, 1e-3));
+    KALDI_ASSERT(residual.Norm(2.0) < 0.5 * sent_sum.Norm(2.0));
+}
+
+} // namespace kaldi
+
+int main() {
+    using namespace kaldi;
+    const char *codecs[] = { "none", "8bit", "1bit", "topk" };
+    for (int i = 0; i < 4; i++) {
+        TestDeltaCodecRoundTrip(codecs[i]);
+        TestDeltaCodecErrorFeedback(codecs[i]);
+    }
+    std::cout << "Test OK.\n";
+    return 0;
+}
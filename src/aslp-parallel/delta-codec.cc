@@ -0,0 +1,228 @@
+/* Compression of the parameter exchange between the workers and the server
+ */
+
+#include <string.h>
+
+#include <algorithm>
+#include <sstream>
+
+#include "aslp-parallel/delta-codec.h"
+
+namespace kaldi {
+
+std::string CodecStats::Report() const {
+    std::ostringstream os;
+    os << "raw " << raw_bytes / (1 << 20) << " MB, wire "
+       << wire_bytes / (1 << 20) << " MB, ratio "
+       << (wire_bytes > 0 ? raw_bytes / wire_bytes : 0.0);
+    // only the sender knows the error
+    if (norm2 > 0) os << ", relative error " << sqrt(error2 / norm2);
+    return os.str();
+}
+
+DeltaCodec::DeltaCodec(const DeltaCodecOptions &opts):
+        topk_ratio_(opts.topk_ratio) {
+    if (opts.codec == "none") type_ = kNone;
+    else if (opts.codec == "8bit") type_ = k8Bit;
+    else if (opts.codec == "1bit") type_ = k1Bit;
+    else if (opts.codec == "topk") type_ = kTopK;
+    else KALDI_ERR << "Unknown codec " << opts.codec;
+    if (type_ == kTopK && !(topk_ratio_ > 0.0 && topk_ratio_ <= 1.0)) {
+        KALDI_ERR << "Bad topk ratio " << topk_ratio_;
+    }
+}
+
+template<class T>
+static void Put(const T &value, std::vector<char> *buf) {
+    size_t pos = buf->size();
+    buf->resize(pos + sizeof(T));
+    memcpy(&(*buf)[pos], &value, sizeof(T));
+}
+
+template<class T>
+static T Get(const std::vector<char> &buf, size_t *pos) {
+    if (*pos + sizeof(T) > buf.size()) KALDI_ERR << "Truncated codec message";
+    T value;
+    memcpy(&value, &buf[*pos], sizeof(T));
+    *pos += sizeof(T);
+    return value;
+}
+
+// For the topk selection, the largest magnitude first
+struct MagnitudeGreater {
+    const BaseFloat *data;
+    explicit MagnitudeGreater(const BaseFloat *d): data(d) {}
+    bool operator () (int32 a, int32 b) const {
+        return std::abs(data[a]) > std::abs(data[b]);
+    }
+};
+
+void DeltaCodec::Encode(const VectorBase<BaseFloat> &x, std::vector<char> *buf,
+                        VectorBase<BaseFloat> *decoded) const {
+    KALDI_ASSERT(decoded->Dim() == x.Dim());
+    int32 dim = x.Dim();
+    const BaseFloat *data = x.Data();
+    BaseFloat *out = decoded->Data();
+    buf->clear();
+    switch (type_) {
+        case kNone:
+            buf->resize(dim * sizeof(BaseFloat));
+            if (dim > 0) memcpy(&(*buf)[0], data, dim * sizeof(BaseFloat));
+            decoded->CopyFromVec(x);
+            break;
+        case k8Bit:
+            for (int32 begin = 0; begin < dim; begin += kBlockSize) {
+                int32 end = std::min(dim, begin + kBlockSize);
+                BaseFloat lo = data[begin], hi = data[begin];
+                for (int32 i = begin; i < end; i++) {
+                    lo = std::min(lo, data[i]);
+                    hi = std::max(hi, data[i]);
+                }
+                BaseFloat step = (hi - lo) / 255;
+                Put(lo, buf);
+                Put(step, buf);
+                for (int32 i = begin; i < end; i++) {
+                    unsigned char q = (step > 0) ?
+                        static_cast<unsigned char>((data[i] - lo) / step + 0.5) : 0;
+                    buf->push_back(static_cast<char>(q));
+                    out[i] = lo + q * step;
+                }
+            }
+            break;
+        case k1Bit:
+            for (int32 begin = 0; begin < dim; begin += kBlockSize) {
+                int32 end = std::min(dim, begin + kBlockSize);
+                double pos_sum = 0, neg_sum = 0;
+                int32 num_pos = 0;
+                for (int32 i = begin; i < end; i++) {
+                    if (data[i] >= 0) { pos_sum += data[i]; num_pos++; }
+                    else neg_sum += data[i];
+                }
+                BaseFloat pos = num_pos > 0 ? pos_sum / num_pos : 0,
+                          neg = num_pos < end - begin ?
+                              neg_sum / (end - begin - num_pos) : 0;
+                Put(pos, buf);
+                Put(neg, buf);
+                unsigned char bits = 0;
+                for (int32 i = begin; i < end; i++) {
+                    if (data[i] >= 0) bits |= 1 << ((i - begin) % 8);
+                    out[i] = data[i] >= 0 ? pos : neg;
+                    if ((i - begin) % 8 == 7 || i == end - 1) {
+                        buf->push_back(static_cast<char>(bits));
+                        bits = 0;
+                    }
+                }
+            }
+            break;
+        case kTopK: {
+            int32 k = std::min(dim, static_cast<int32>(ceil(topk_ratio_ * dim)));
+            std::vector<int32> index(dim);
+            for (int32 i = 0; i < dim; i++) index[i] = i;
+            std::nth_element(index.begin(), index.begin() + k, index.end(),
+                             MagnitudeGreater(data));
+            std::sort(index.begin(), index.begin() + k);
+            decoded->SetZero();
+            Put(k, buf);
+            for (int32 j = 0; j < k; j++) {
+                Put(index[j], buf);
+                Put(data[index[j]], buf);
+                out[index[j]] = data[index[j]];
+            }
+            break;
+        }
+    }
+}
+
+void DeltaCodec::Decode(const std::vector<char> &buf,
+                        VectorBase<BaseFloat> *x) const {
+    int32 dim = x->Dim();
+    BaseFloat *out = x->Data();
+    size_t pos = 0;
+    switch (type_) {
+        case kNone:
+            if (buf.size() != dim * sizeof(BaseFloat))
+                KALDI_ERR << "Codec message size mismatch";
+            if (dim > 0) memcpy(out, &buf[0], buf.size());
+            pos = buf.size();
+            break;
+        case k8Bit:
+            for (int32 begin = 0; begin < dim; begin += kBlockSize) {
+                int32 end = std::min(dim, begin + kBlockSize);
+                BaseFloat lo = Get<BaseFloat>(buf, &pos),
+                          step = Get<BaseFloat>(buf, &pos);
+                for (int32 i = begin; i < end; i++) {
+                    out[i] = lo + Get<unsigned char>(buf, &pos) * step;
+                }
+            }
+            break;
+        case k1Bit:
+            for (int32 begin = 0; begin < dim; begin += kBlockSize) {
+                int32 end = std::min(dim, begin + kBlockSize);
+                BaseFloat pos_value = Get<BaseFloat>(buf, &pos),
+                          neg_value = Get<BaseFloat>(buf, &pos);
+                unsigned char bits = 0;
+                for (int32 i = begin; i < end; i++) {
+                    if ((i - begin) % 8 == 0) bits = Get<unsigned char>(buf, &pos);
+                    out[i] = (bits >> ((i - begin) % 8)) & 1 ? pos_value : neg_value;
+                }
+            }
+            break;
+        case kTopK: {
+            x->SetZero();
+            int32 k = Get<int32>(buf, &pos);
+            for (int32 j = 0; j < k; j++) {
+                int32 i = Get<int32>(buf, &pos);
+                if (i < 0 || i >= dim) KALDI_ERR << "Bad topk index " << i;
+                out[i] = Get<BaseFloat>(buf, &pos);
+            }
+            break;
+        }
+    }
+    if (pos != buf.size()) KALDI_ERR << "Codec message size mismatch";
+}
+
+static void AddStats(const VectorBase<BaseFloat> &x,
+                     const VectorBase<BaseFloat> &decoded,
+                     size_t wire_bytes, CodecStats *stats) {
+    stats->raw_bytes += x.Dim() * sizeof(BaseFloat);
+    stats->wire_bytes += wire_bytes;
+    for (int32 i = 0; i < x.Dim(); i++) {
+        BaseFloat diff = x(i) - decoded(i);
+        stats->error2 += diff * diff;
+        stats->norm2 += x(i) * x(i);
+    }
+}
+
+void DeltaCodec::Send(const VectorBase<BaseFloat> &x, int dest, int tag,
+                      VectorBase<BaseFloat> *decoded, CodecStats *stats) const {
+    std::vector<char> buf;
+    Encode(x, &buf, decoded);
+    MPI_Send(buf.empty() ? NULL : &buf[0], buf.size(), MPI_BYTE, dest, tag,
+             MPI_COMM_WORLD);
+    AddStats(x, *decoded, buf.size(), stats);
+}
+
+void DeltaCodec::Isend(const VectorBase<BaseFloat> &x, int dest, int tag,
+                       std::vector<char> *buf, VectorBase<BaseFloat> *decoded,
+                       CodecStats *stats, MPI_Request *request) const {
+    Encode(x, buf, decoded);
+    MPI_Isend(buf->empty() ? NULL : &(*buf)[0], buf->size(), MPI_BYTE, dest, tag,
+              MPI_COMM_WORLD, request);
+    AddStats(x, *decoded, buf->size(), stats);
+}
+
+void DeltaCodec::Recv(int source, int tag, VectorBase<BaseFloat> *x,
+                      CodecStats *stats) const {
+    MPI_Status status;
+    MPI_Probe(source, tag, MPI_COMM_WORLD, &status);
+    int size = 0;
+    MPI_Get_count(&status, MPI_BYTE, &size);
+    std::vector<char> buf(size);
+    MPI_Recv(buf.empty() ? NULL : &buf[0], size, MPI_BYTE, source, tag,
+             MPI_COMM_WORLD, &status);
+    Decode(buf, x);
+    stats->raw_bytes += x->Dim() * sizeof(BaseFloat);
+    stats->wire_bytes += size;
+}
+
+} // namespace kaldi
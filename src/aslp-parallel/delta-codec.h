@@ -0,0 +1,78 @@
+/* Compression of the parameter exchange between the workers and the server
+ */
+
+#ifndef ASLP_PARALLEL_DELTA_CODEC_H_
+#define ASLP_PARALLEL_DELTA_CODEC_H_
+
+#include <string>
+#include <vector>
+
+#include "base/kaldi-common.h"
+#include "matrix/matrix-lib.h"
+#include "itf/options-itf.h"
+
+#include "aslp-parallel/mpi-node.h"
+
+namespace kaldi {
+
+struct DeltaCodecOptions {
+    std::string codec;
+    float topk_ratio;
+    DeltaCodecOptions(): codec("none"), topk_ratio(0.01) {}
+    void Register(OptionsItf *opts) {
+        opts->Register("codec", &codec, "Codec of the worker and server exchange"
+                "(none | 8bit | 1bit | topk), the workers and the server must use the same one");
+        opts->Register("codec-topk-ratio", &topk_ratio, "Ratio of the values sent by the topk codec");
+    }
+};
+
+// Bytes and error of the encoded messages
+struct CodecStats {
+    double raw_bytes, wire_bytes;
+    double error2, norm2;  // squared norm of the encoding error and of the input
+    CodecStats(): raw_bytes(0), wire_bytes(0), error2(0), norm2(0) {}
+    std::string Report() const;
+};
+
+// Encodes float vectors for the wire. The codecs are lossy except none:
+//   8bit: 8 bits per value, linear between the min and the max of a block
+//   1bit: the sign per value, decoded to the mean of the positive or the
+//         negative values of a block(1-bit SGD)
+//   topk: the topk_ratio of the values with the largest magnitude, as
+//         index/value pairs
+// The error is not dropped by the callers, they either keep it as a
+// residual added to the next message(error feedback), or send the
+// difference to a mirror of what the receiver already has.
+class DeltaCodec {
+public:
+    explicit DeltaCodec(const DeltaCodecOptions &opts);
+
+    bool IsLossless() const { return type_ == kNone; }
+
+    // Encodes x into buf, decoded is what the receiver will decode
+    void Encode(const VectorBase<BaseFloat> &x, std::vector<char> *buf,
+                VectorBase<BaseFloat> *decoded) const;
+    void Decode(const std::vector<char> &buf, VectorBase<BaseFloat> *x) const;
+
+    // Encodes and sends x, x - decoded is the error
+    void Send(const VectorBase<BaseFloat> &x, int dest, int tag,
+              VectorBase<BaseFloat> *decoded, CodecStats *stats) const;
+    // Encodes x into buf and starts sending it, buf is kept until the
+    // request is done
+    void Isend(const VectorBase<BaseFloat> &x, int dest, int tag,
+               std::vector<char> *buf, VectorBase<BaseFloat> *decoded,
+               CodecStats *stats, MPI_Request *request) const;
+    // Receives and decodes into x, of the size of the sent vector
+    void Recv(int source, int tag, VectorBase<BaseFloat> *x,
+              CodecStats *stats) const;
+
+private:
+    enum CodecType { kNone, k8Bit, k1Bit, kTopK };
+    static const int kBlockSize = 1024;
+    CodecType type_;
+    float topk_ratio_;
+};
+
+} // namespace kaldi
+
+#endif
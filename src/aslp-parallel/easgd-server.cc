@@ -9,18 +9,38 @@ namespace kaldi {
 
 void EasgdServer::InitParam(
         const std::vector<std::pair<BaseFloat *, int> > &params) {
+    shard_.Init(params, NumNodes());
+    tensors_ = shard_.Tensors(Rank());
     server_gpu_params_.resize(params.size());
-    server_cpu_params_.resize(params.size());
-    worker_gpu_params_.resize(params.size());
-    worker_cpu_params_.resize(params.size());
+    server_cpu_params_.resize(params.size(), NULL);
+    worker_gpu_params_.resize(params.size(), NULL);
+    worker_cpu_params_.resize(params.size(), NULL);
 
     for (int i = 0; i < params.size(); i++) {
         server_gpu_params_[i] = new 
             CuSubVector<BaseFloat>(params[i].first, params[i].second); 
+    }
+    for (int k = 0; k < tensors_.size(); k++) {
+        int i = tensors_[k];
         server_cpu_params_[i] = new Vector<BaseFloat>(params[i].second);
         worker_gpu_params_[i] = new CuVector<BaseFloat>(params[i].second);
         worker_cpu_params_[i] = new Vector<BaseFloat>(params[i].second);
     }
+    if (!codec_.IsLossless()) {
+        // all the workers start from the same model as the server
+        worker_mirror_.resize(shard_.NumWorkers());
+        server_mirror_.resize(shard_.NumWorkers());
+        for (int j = 0; j < shard_.NumWorkers(); j++) {
+            worker_mirror_[j].resize(params.size(), NULL);
+            server_mirror_[j].resize(params.size(), NULL);
+            for (int k = 0; k < tensors_.size(); k++) {
+                int i = tensors_[k];
+                worker_mirror_[j][i] = new Vector<BaseFloat>(params[i].second);
+                worker_mirror_[j][i]->CopyFromVec(*server_gpu_params_[i]);
+                server_mirror_[j][i] = new Vector<BaseFloat>(*worker_mirror_[j][i]);
+            }
+        }
+    }
 }
 
 EasgdServer::~EasgdServer() {
@@ -32,15 +52,21 @@ EasgdServer::~EasgdServer() {
         delete worker_gpu_params_[i];
         delete worker_cpu_params_[i];
     }
+    for (int j = 0; j < worker_mirror_.size(); j++) {
+        for (int i = 0; i < worker_mirror_[j].size(); i++) {
+            delete worker_mirror_[j][i];
+            delete server_mirror_[j][i];
+        }
+    }
 }
 
 void EasgdServer::Run() {
-    int num_running_workers = NumNodes() - 1;
+    int num_running_workers = shard_.NumWorkers();
     MPI_Status status;
     int msg_type, worker_rank;
     while (num_running_workers > 0) {
         // tag 0, msg type 
-        MPI_Recv(&msg_type, 1, MPI_INT, MPI_ANY_SOURCE, MPI_ANY_TAG, 
+        MPI_Recv(&msg_type, 1, MPI_INT, MPI_ANY_SOURCE, kTagMsg, 
             MPI_COMM_WORLD, &status);
         worker_rank = status.MPI_SOURCE;
         KALDI_VLOG(2) << "Worker rank " << worker_rank << " Msg " << msg_type;
@@ -58,33 +84,72 @@ void EasgdServer::Run() {
     }
 
     KALDI_LOG << "All worker finished";
+    if (!codec_.IsLossless()) {
+        KALDI_LOG << "Server sent " << send_stats_.Report();
+        KALDI_LOG << "Server received " << recv_stats_.Report();
+    }
+    // the main server gets the tensors of the others, to write the model
+    shard_.GatherModel(server_gpu_params_, Rank());
 }
 
 void EasgdServer::Update(int worker_rank) {
-    // 1. copy server_gpu_params_ to server_cpu_params_ 
-    for (int i = 0; i < server_cpu_params_.size(); i++) {
+    // 1. copy server_gpu_params_ to server_cpu_params_, of the tensors of
+    // this server
+    for (int k = 0; k < tensors_.size(); k++) {
+        int i = tensors_[k];
         server_cpu_params_[i]->CopyFromVec(*server_gpu_params_[i]);
     }
     // 2. send server_cpu_params_ and recv worker_cpu_params_
-    MPI_Status status;
-    for (int i = 0; i < server_cpu_params_.size(); i++) {
-        MPI_Sendrecv(server_cpu_params_[i]->Data(), server_cpu_params_[i]->Dim(), 
-                     MPI_FLOAT, worker_rank, i,
-                     worker_cpu_params_[i]->Data(), worker_cpu_params_[i]->Dim(),
-                     MPI_FLOAT, worker_rank, i,
-                     MPI_COMM_WORLD, &status);
+    if (codec_.IsLossless()) {
+        int n = tensors_.size();
+        requests_.resize(2 * n);
+        for (int k = 0; k < n; k++) {
+            int i = tensors_[k];
+            MPI_Isend(server_cpu_params_[i]->Data(), server_cpu_params_[i]->Dim(), 
+                      MPI_FLOAT, worker_rank, i, MPI_COMM_WORLD, &requests_[k]);
+            MPI_Irecv(worker_cpu_params_[i]->Data(), worker_cpu_params_[i]->Dim(),
+                      MPI_FLOAT, worker_rank, i, MPI_COMM_WORLD, &requests_[n + k]);
+        }
+        MPI_Waitall(2 * n, requests_.empty() ? NULL : &requests_[0],
+                    MPI_STATUSES_IGNORE);
+    } else {
+        UpdateEncoded(worker_rank);
     }
     // 3. copy worker_cpu_params_ to worker_gpu_params_
-    for (int i = 0; i < worker_gpu_params_.size(); i++) {
+    for (int k = 0; k < tensors_.size(); k++) {
+        int i = tensors_[k];
         worker_gpu_params_[i]->CopyFromVec(*worker_cpu_params_[i]);
     }   
     // 4. update server gpu model
-    for (int i = 0; i < server_gpu_params_.size(); i++) {
+    for (int k = 0; k < tensors_.size(); k++) {
+        int i = tensors_[k];
         //x_server = x_server + alpha(x_worker - x_server)
         //         = (1 - alpha) * x_server + alpha * x_worker
         server_gpu_params_[i]->AddVec(alpha_, *worker_gpu_params_[i], 1 - alpha_);
     }
 }
 
+void EasgdServer::UpdateEncoded(int worker_rank) {
+    int j = shard_.WorkerIndex(worker_rank);
+    std::vector<Vector<BaseFloat> *> &worker_mirror = worker_mirror_[j],
+                                     &server_mirror = server_mirror_[j];
+    // the worker sends all before receiving
+    for (int k = 0; k < tensors_.size(); k++) {
+        int i = tensors_[k];
+        decoded_.Resize(worker_cpu_params_[i]->Dim(), kUndefined);
+        codec_.Recv(worker_rank, i, &decoded_, &recv_stats_);
+        worker_mirror[i]->AddVec(1.0, decoded_);
+        worker_cpu_params_[i]->CopyFromVec(*worker_mirror[i]);
+    }
+    for (int k = 0; k < tensors_.size(); k++) {
+        int i = tensors_[k];
+        Vector<BaseFloat> diff(*server_cpu_params_[i]);
+        diff.AddVec(-1.0, *server_mirror[i]);
+        decoded_.Resize(diff.Dim(), kUndefined);
+        codec_.Send(diff, worker_rank, i, &decoded_, &send_stats_);
+        server_mirror[i]->AddVec(1.0, decoded_);
+    }
+}
+
 
 } // namespace kaldi
@@ -12,6 +12,8 @@
 
 #include "aslp-parallel/mpi-node.h"
 #include "aslp-parallel/itf.h"
+#include "aslp-parallel/delta-codec.h"
+#include "aslp-parallel/param-shard.h"
 
 namespace kaldi {
 
@@ -20,7 +22,11 @@ namespace kaldi {
 
 class EasgdServer : public IServer {
 public:
-    EasgdServer(float alpha = 0.5): alpha_(alpha) {}
+    // @num_servers: the tensors are sharded over the server ranks 0 .. num_servers - 1
+    EasgdServer(float alpha = 0.5,
+                const DeltaCodecOptions &codec_opts = DeltaCodecOptions(),
+                int num_servers = 1):
+        alpha_(alpha), codec_(codec_opts), shard_(num_servers) {}
     ~EasgdServer();
     // @params type pair: first is to the gpu data points, 
     //                    second is the size of it
@@ -35,12 +41,24 @@ public:
     // Update server model with one worker
     void Update(int worker_rank);
 private:
+    // Exchanges the models as differences to the mirrors by a lossy codec
+    void UpdateEncoded(int worker_rank);
     float alpha_;
     // Here we use CuSubVector for that the memory is hold and managed by train model,
     // CuSubVector only share and update this pointer, refer to CuSubVector for details
     std::vector<CuSubVector<BaseFloat> *> server_gpu_params_;
+    // of the tensors of this server only, NULL for the others
     std::vector<CuVector<BaseFloat> *> worker_gpu_params_;
     std::vector<Vector<BaseFloat> *> server_cpu_params_, worker_cpu_params_;
+    DeltaCodec codec_;
+    ParamShard shard_;
+    std::vector<int> tensors_;  // of this server
+    std::vector<MPI_Request> requests_;
+    // For a lossy codec, of each worker: the worker model the server has,
+    // and the server model the worker has
+    std::vector<std::vector<Vector<BaseFloat> *> > worker_mirror_, server_mirror_;
+    Vector<BaseFloat> decoded_;
+    CodecStats send_stats_, recv_stats_;
 };
 
 
@@ -13,6 +13,7 @@ void EasgdWorker::InitParam(
     server_cpu_params_.resize(params.size());
     worker_gpu_params_.resize(params.size());
     worker_cpu_params_.resize(params.size());
+    shard_.Init(params, NumNodes());
 
     for (int i = 0; i < params.size(); i++) {
         worker_gpu_params_[i] = new 
@@ -21,6 +22,15 @@ void EasgdWorker::InitParam(
         server_gpu_params_[i] = new CuVector<BaseFloat>(params[i].second);
         server_cpu_params_[i] = new Vector<BaseFloat>(params[i].second);
     }
+    if (!codec_.IsLossless()) {
+        // the worker and the server start from the same model
+        worker_mirror_.resize(params.size());
+        for (int i = 0; i < params.size(); i++) {
+            server_cpu_params_[i]->CopyFromVec(*worker_gpu_params_[i]);
+            worker_mirror_[i] = new Vector<BaseFloat>(params[i].second);
+            worker_mirror_[i]->CopyFromVec(*worker_gpu_params_[i]);
+        }
+    }
 }
 
 EasgdWorker::~EasgdWorker() {
@@ -32,25 +42,36 @@ EasgdWorker::~EasgdWorker() {
         delete worker_gpu_params_[i];
         delete worker_cpu_params_[i];
     }
+    for (int i = 0; i < worker_mirror_.size(); i++) {
+        delete worker_mirror_[i];
+    }
 }
 
 bool EasgdWorker::Synchronize(int num_worker_samples) {
     (void)num_worker_samples;
     int msg_type = kMsgSynchronize;
-    // 1. send synchronize signal 
-    MPI_Send(&msg_type, 1, MPI_INT, MainNode(), kTagMsg, MPI_COMM_WORLD);
+    // 1. send synchronize signal to all the servers
+    shard_.SendMsg(msg_type);
     // 2.1 copy worker_gpu_params_ to worker_cpu_params_
     for (int i = 0; i < worker_gpu_params_.size(); i++) {
         worker_cpu_params_[i]->CopyFromVec(*worker_gpu_params_[i]);
     }
-    // 2.2 send woker_cpu_params_ and recv server_cpu_params_
-    MPI_Status status;
-    for (int i = 0; i < server_cpu_params_.size(); i++) {
-        MPI_Sendrecv(worker_cpu_params_[i]->Data(), worker_cpu_params_[i]->Dim(), 
-                     MPI_FLOAT, MainNode(), i,
-                     server_cpu_params_[i]->Data(), server_cpu_params_[i]->Dim(),
-                     MPI_FLOAT, MainNode(), i,
-                     MPI_COMM_WORLD, &status);
+    // 2.2 send woker_cpu_params_ and recv server_cpu_params_, with all the
+    // servers at once
+    if (codec_.IsLossless()) {
+        int n = server_cpu_params_.size();
+        requests_.resize(2 * n);
+        for (int i = 0; i < n; i++) {
+            MPI_Isend(worker_cpu_params_[i]->Data(), worker_cpu_params_[i]->Dim(), 
+                      MPI_FLOAT, shard_.ServerOf(i), i, MPI_COMM_WORLD, &requests_[i]);
+            MPI_Irecv(server_cpu_params_[i]->Data(), server_cpu_params_[i]->Dim(),
+                      MPI_FLOAT, shard_.ServerOf(i), i, MPI_COMM_WORLD,
+                      &requests_[n + i]);
+        }
+        MPI_Waitall(2 * n, requests_.empty() ? NULL : &requests_[0],
+                    MPI_STATUSES_IGNORE);
+    } else {
+        SynchronizeEncoded();
     }
 
     // 2.3 copy server_gpu_params_ to server_cpu_params_ 
@@ -66,10 +87,39 @@ bool EasgdWorker::Synchronize(int num_worker_samples) {
     return true;
 }
 
+void EasgdWorker::SynchronizeEncoded() {
+    // send all the differences first, the servers receive all before sending
+    int n = worker_cpu_params_.size();
+    requests_.resize(n);
+    send_buffers_.resize(n);
+    for (int i = 0; i < n; i++) {
+        Vector<BaseFloat> diff(*worker_cpu_params_[i]);
+        diff.AddVec(-1.0, *worker_mirror_[i]);
+        decoded_.Resize(diff.Dim(), kUndefined);
+        codec_.Isend(diff, shard_.ServerOf(i), i, &send_buffers_[i], &decoded_,
+                     &send_stats_, &requests_[i]);
+        worker_mirror_[i]->AddVec(1.0, decoded_);
+    }
+    // the servers reply in any order, the tag is the tensor
+    for (int k = 0; k < n; k++) {
+        MPI_Status status;
+        MPI_Probe(MPI_ANY_SOURCE, MPI_ANY_TAG, MPI_COMM_WORLD, &status);
+        int i = status.MPI_TAG;
+        KALDI_ASSERT(i >= 0 && i < n && shard_.ServerOf(i) == status.MPI_SOURCE);
+        decoded_.Resize(server_cpu_params_[i]->Dim(), kUndefined);
+        codec_.Recv(status.MPI_SOURCE, i, &decoded_, &recv_stats_);
+        server_cpu_params_[i]->AddVec(1.0, decoded_);
+    }
+    MPI_Waitall(n, requests_.empty() ? NULL : &requests_[0], MPI_STATUSES_IGNORE);
+}
+
 void EasgdWorker::Stop() {
     // Send Stop signal
-    int msg_type = kMsgFinished;
-    MPI_Send(&msg_type, 1, MPI_INT, MainNode(), kTagMsg, MPI_COMM_WORLD);
+    shard_.SendMsg(kMsgFinished);
+    if (!codec_.IsLossless()) {
+        KALDI_LOG << "Worker " << Rank() << " sent " << send_stats_.Report();
+        KALDI_LOG << "Worker " << Rank() << " received " << recv_stats_.Report();
+    }
     KALDI_LOG << "Worker " << Rank() << " finished";
 }
 
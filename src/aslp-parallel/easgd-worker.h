@@ -12,6 +12,8 @@
 
 #include "aslp-parallel/mpi-node.h"
 #include "aslp-parallel/itf.h"
+#include "aslp-parallel/delta-codec.h"
+#include "aslp-parallel/param-shard.h"
 
 namespace kaldi {
 
@@ -20,7 +22,11 @@ namespace kaldi {
 
 class EasgdWorker: public IWorker {
 public:
-    EasgdWorker(float alpha = 0.5): alpha_(alpha) {}
+    // @num_servers: the tensors are sharded over the server ranks 0 .. num_servers - 1
+    EasgdWorker(float alpha = 0.5,
+                const DeltaCodecOptions &codec_opts = DeltaCodecOptions(),
+                int num_servers = 1):
+        alpha_(alpha), codec_(codec_opts), shard_(num_servers) {}
     ~EasgdWorker();
     // @params type pair: first is to the gpu data points, 
     //                    second is the size of it
@@ -34,12 +40,23 @@ public:
     bool Synchronize(int num_worker_samples); 
     void Stop();
 private:
+    // Exchanges the models as differences to the mirrors by a lossy codec
+    void SynchronizeEncoded();
     float alpha_;
     // Here we use CuSubVector for that the memory is hold and managed by train model,
     // CuSubVector only share and update this pointer, refer to CuSubVector for details
     std::vector<CuVector<BaseFloat> *> server_gpu_params_;
     std::vector<CuSubVector<BaseFloat> *> worker_gpu_params_;
     std::vector<Vector<BaseFloat> *> server_cpu_params_, worker_cpu_params_;
+    DeltaCodec codec_;
+    ParamShard shard_;
+    std::vector<MPI_Request> requests_;
+    std::vector<std::vector<char> > send_buffers_;
+    // For a lossy codec: the worker model the server has, and
+    // server_cpu_params_ is the server model the worker has
+    std::vector<Vector<BaseFloat> *> worker_mirror_;
+    Vector<BaseFloat> decoded_;
+    CodecStats send_stats_, recv_stats_;
 };
 
 } // namespace kaldi
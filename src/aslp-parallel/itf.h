@@ -31,6 +31,11 @@ public:
     virtual bool Synchronize(int num_worker_samples) = 0;
     // Wait other workers
     virtual void Stop() = 0;
+    // The state besides the model for the checkpoints of the synchronous
+    // workers(the bmuf block momentum, the sod optimizer), the same on all
+    // the workers after a synchronization, read after InitParam
+    virtual void WriteState(std::ostream &os, bool binary) const {}
+    virtual void ReadState(std::istream &is, bool binary) {}
 };
 
 class IServer : public MpiNode {
@@ -12,6 +12,8 @@
 
 #include "aslp-parallel/mpi-node.h"
 #include "aslp-parallel/itf.h"
+#include "aslp-parallel/delta-codec.h"
+#include "aslp-parallel/param-shard.h"
 
 namespace kaldi {
 
@@ -24,8 +26,12 @@ namespace kaldi {
 
 class MasgdServer : public IServer {
 public:
-    MasgdServer(int sync_period = 1000, float momentum = 0.9): 
-				  sync_period_(sync_period), momentum_(momentum) {}
+    // @num_servers: the tensors are sharded over the server ranks 0 .. num_servers - 1
+    MasgdServer(int sync_period = 1000, float momentum = 0.9,
+                const DeltaCodecOptions &codec_opts = DeltaCodecOptions(),
+                int num_servers = 1): 
+				  sync_period_(sync_period), momentum_(momentum), codec_(codec_opts),
+				  shard_(num_servers) {}
     ~MasgdServer();
     // @params type pair: first is to the gpu data points, 
     //                    second is the size of it
@@ -35,13 +41,25 @@ public:
     // Update server model with one worker
     void Update(int worker_rank, int count);
 private:
+    // Sends the model in cpu_params_ to the worker
+    void SendModel(int worker_rank);
     int32 sync_period_;
     float momentum_;
 	// Here we use CuSubVector for that the memory is hold and managed by train model,
     // CuSubVector only share and update this pointer, refer to CuSubVector for details
     std::vector<CuSubVector<BaseFloat> *> server_gpu_params_;
+    // of the tensors of this server only, NULL for the others
     std::vector<CuVector<BaseFloat> *> worker_gpu_params_;
     std::vector<Vector<BaseFloat> *> cpu_params_;
+    DeltaCodec codec_;
+    ParamShard shard_;
+    std::vector<int> tensors_;  // of this server
+    std::vector<MPI_Request> requests_;
+    // For a lossy codec: the model each worker has, the server sends the
+    // difference to it
+    std::vector<std::vector<Vector<BaseFloat> *> > worker_models_;
+    Vector<BaseFloat> decoded_;
+    CodecStats send_stats_, recv_stats_;
 #if MASGD_TYPE == GMASGD
     std::vector<CuVector<BaseFloat> * > diffs_;
 #elif MASGD_TYPE == LMASGD
@@ -17,16 +17,23 @@ namespace kaldi {
 // mpi wrapper
 class MpiNode {
 public:
-    MpiNode() {
-        int argc = 0;
-        char **argv = NULL;
-        MPI_Init(&argc, &argv);
+    // Only the first node initializes and finalizes mpi, the others in the
+    // same process share it
+    MpiNode(): owner_(false) {
+        int initialized = 0;
+        MPI_Initialized(&initialized);
+        if (!initialized) {
+            int argc = 0;
+            char **argv = NULL;
+            MPI_Init(&argc, &argv);
+            owner_ = true;
+        }
         MPI_Comm_rank(MPI_COMM_WORLD, &rank_);
         MPI_Comm_size(MPI_COMM_WORLD, &num_nodes_);
     }
 
     virtual ~MpiNode() {
-        MPI_Finalize();
+        if (owner_) MPI_Finalize();
     }
 
     int Rank() const {
@@ -94,6 +101,7 @@ public:
 
 protected:
     int rank_, num_nodes_;
+    bool owner_;
 };
 
 } // namespace kaldi
@@ -0,0 +1,163 @@
+/* Test of the fused optimizer updates against the CuVector ops they replace,
+ * per tensor and over several tensors with one optimizer, and the time of
+ * both on a large tensor
+ */
+
+#include <stdio.h>
+
+#include "base/timer.h"
+#include "aslp-parallel/optimizer.h"
+
+namespace kaldi {
+
+// The updates by whole vector ops, the math before fusing
+class ReferenceOptimizer {
+public:
+    ReferenceOptimizer(const std::string &solver, int size): solver_(solver),
+        t_(1), acc_(size), acc2_(size), tmp_(size), tmp2_(size) {}
+    void Optimize(const CuVectorBase<BaseFloat> &grad, CuVectorBase<BaseFloat> *param) {
+        if (solver_ == "momentum") {
+            acc_.AddVec(0.1, grad, 0.9);
+            param->AddVec(-1.0, acc_);
+        } else if (solver_ == "adagrad" || solver_ == "rmsprop") {
+            if (solver_ == "adagrad") acc_.AddVecVec(1.0, grad, grad, 1.0);
+            else acc_.AddVecVec(0.1, grad, grad, 0.9);
+            tmp_.CopyFromVec(acc_);
+            tmp_.ApplyFloor(1e-8);
+            tmp_.ApplyPow(0.5);
+            tmp_.InvertElements();
+            tmp_.MulElements(grad);
+            param->AddVec(solver_ == "adagrad" ? -0.01 : -0.001, tmp_);
+        } else if (solver_ == "adadelta") {
+            BaseFloat gamma = 0.95;
+            acc_.AddVecVec(1 - gamma, grad, grad, gamma);
+            tmp_.CopyFromVec(acc_);
+            tmp_.ApplyFloor(1e-8);
+            tmp_.ApplyPow(0.5);
+            tmp_.InvertElements();
+            tmp2_.CopyFromVec(acc2_);
+            tmp2_.ApplyFloor(1e-8);
+            tmp2_.ApplyPow(0.5);
+            tmp_.MulElements(tmp2_);
+            tmp_.MulElements(grad);
+            param->AddVec(-1.0, tmp_);
+            acc2_.AddVecVec(1 - gamma, tmp_, tmp_, gamma);
+        } else if (solver_ == "adam") {
+            BaseFloat beta1 = 0.9, beta2 = 0.999;
+            acc_.AddVec(1 - beta1, grad, beta1);
+            acc2_.AddVecVec(1 - beta2, grad, grad, beta2);
+            BaseFloat s1 = 1.0 / (1 - pow(beta1, t_));
+            BaseFloat s2 = 1.0 / (1 - pow(beta2, t_));
+            tmp_.CopyFromVec(acc2_);
+            tmp_.Scale(s2);
+            tmp_.ApplyFloor(1e-8);
+            tmp_.ApplyPow(0.5);
+            tmp_.InvertElements();
+            tmp_.MulElements(acc_);
+            param->AddVec(-0.001 * s1, tmp_);
+            t_++;
+        } else {
+            param->AddVec(-0.1, grad);
+        }
+    }
+private:
+    std::string solver_;
+    int t_;
+    CuVector<BaseFloat> acc_, acc2_, tmp_, tmp2_;
+};
+
+Optimizer *NewOptimizer(const std::string &solver, int size) {
+    OptimizerOption option;
+    option.solver = solver;
+    option.lr = 0.1;
+    option.momentum = 0.9;
+    return option.NewInstance(size);
+}
+
+void AssertClose(CuVectorBase<BaseFloat> &a, const CuVectorBase<BaseFloat> &b) {
+    CuVector<BaseFloat> diff(a);
+    diff.AddVec(-1.0, b);
+    // relative to the parameters, the fused math rounds a bit differently
+    KALDI_ASSERT(diff.Norm(2.0) <= 1e-5 * std::max<BaseFloat>(a.Norm(2.0), 1.0));
+}
+
+void TestOptimizer(const std::string &solver) {
+    // the odd sizes take the tails of the simd loops
+    int sizes[] = { 1, 7, 8, 1000, 33 };
+    int num = 5, total = 0;
+    for (int i = 0; i < num; i++) total += sizes[i];
+    std::vector<CuVector<BaseFloat> *> params(num), ref_params(num), flat_params(num);
+    std::vector<CuSubVector<BaseFloat> *> sub_params(num), sub_flat_params(num);
+    std::vector<Optimizer *> optimizers(num);
+    std::vector<ReferenceOptimizer *> references(num);
+    for (int i = 0; i < num; i++) {
+        params[i] = new CuVector<BaseFloat>(sizes[i]);
+        params[i]->SetRandn();
+        ref_params[i] = new CuVector<BaseFloat>(*params[i]);
+        flat_params[i] = new CuVector<BaseFloat>(*params[i]);
+        sub_params[i] = new CuSubVector<BaseFloat>(params[i]->Data(), sizes[i]);
+        sub_flat_params[i] = new CuSubVector<BaseFloat>(flat_params[i]->Data(), sizes[i]);
+        optimizers[i] = NewOptimizer(solver, sizes[i]);
+        references[i] = new ReferenceOptimizer(solver, sizes[i]);
+    }
+    Optimizer *flat_optimizer = NewOptimizer(solver, total);
+    for (int n = 0; n < 10; n++) {
+        CuVector<BaseFloat> flat_grad(total);
+        flat_grad.SetRandn();
+        int offset = 0;
+        for (int i = 0; i < num; i++) {
+            CuVector<BaseFloat> grad(flat_grad.Range(offset, sizes[i]));
+            optimizers[i]->Optimize(grad, sub_params[i]);
+            references[i]->Optimize(grad, ref_params[i]);
+            offset += sizes[i];
+        }
+        flat_optimizer->Optimize(flat_grad, sub_flat_params);
+        for (int i = 0; i < num; i++) {
+            AssertClose(*params[i], *ref_params[i]);
+            // the same kernels on the same data
+            AssertClose(*flat_params[i], *params[i]);
+        }
+    }
+    for (int i = 0; i < num; i++) {
+        delete params[i];
+        delete ref_params[i];
+        delete flat_params[i];
+        delete sub_params[i];
+        delete sub_flat_params[i];
+        delete optimizers[i];
+        delete references[i];
+    }
+    delete flat_optimizer;
+}
+
+void BenchmarkOptimizer(const std::string &solver) {
+    int size = 1 << 22, num_iter = 20;
+    CuVector<BaseFloat> grad(size), param(size);
+    grad.SetRandn();
+    CuSubVector<BaseFloat> sub_param(param.Data(), size);
+    Optimizer *optimizer = NewOptimizer(solver, size);
+    ReferenceOptimizer reference(solver, size);
+    Timer timer;
+    for (int n = 0; n < num_iter; n++) reference.Optimize(grad, &param);
+    double ref_seconds = timer.Elapsed() / num_iter;
+    timer.Reset();
+    for (int n = 0; n < num_iter; n++) optimizer->Optimize(grad, &sub_param);
+    double seconds = timer.Elapsed() / num_iter;
+    printf("%-10s %10.2f ms %10.2f ms %8.2fx\n", solver.c_str(),
+           ref_seconds * 1e3, seconds * 1e3, ref_seconds / seconds);
+    delete optimizer;
+}
+
+} // namespace kaldi
+
+int main() {
+    using namespace kaldi;
+    const char *solvers[] = { "sgd", "momentum", "adagrad", "rmsprop",
+                              "adadelta", "adam" };
+    for (int k = 0; k < 6; k++) TestOptimizer(solvers[k]);
+    printf("%-10s %13s %13s %9s   (%d parameters)\n", "solver", "vector ops",
+           "fused", "speedup", 1 << 22);
+    for (int k = 0; k < 6; k++) BenchmarkOptimizer(solvers[k]);
+    std::cout << "Test OK.\n";
+    return 0;
+}
@@ -0,0 +1,317 @@
+/* Fused updates of the optimizers, the CUDA kernels are in
+ * aslp-cudamatrix/cu-optimizer.cu, the CPU ones here with an AVX2 path
+ */
+
+#include <algorithm>
+#include <cmath>
+
+#include "base/kaldi-simd.h"
+#include "aslp-parallel/optimizer.h"
+
+#if HAVE_CUDA == 1
+#include "cudamatrix/cu-device.h"
+#include "aslp-cudamatrix/cu-optimizer.h"
+#endif
+
+namespace kaldi {
+
+static const BaseFloat kAccFloor = 1e-8;
+
+template<typename Real>
+static void CpuMomentumUpdate(const Real *grad, Real *mom, Real *param, int num,
+                              Real lr, Real momentum) {
+    for (int i = 0; i < num; i++) {
+        Real m = momentum * mom[i] + lr * grad[i];
+        mom[i] = m;
+        param[i] -= m;
+    }
+}
+
+template<typename Real>
+static void CpuRmsUpdate(const Real *grad, Real *acc, Real *param, int num,
+                         Real decay, Real scale, Real lr, Real floor) {
+    for (int i = 0; i < num; i++) {
+        Real g = grad[i];
+        Real a = decay * acc[i] + scale * g * g;
+        acc[i] = a;
+        param[i] -= lr * g / std::sqrt(std::max(a, floor));
+    }
+}
+
+template<typename Real>
+static void CpuAdaDeltaUpdate(const Real *grad, Real *acc_grad, Real *acc_delta,
+                              Real *param, int num, Real gamma, Real floor) {
+    for (int i = 0; i < num; i++) {
+        Real g = grad[i];
+        Real a = gamma * acc_grad[i] + (1 - gamma) * g * g;
+        Real d = acc_delta[i];
+        Real delta = std::sqrt(std::max(d, floor)) / std::sqrt(std::max(a, floor)) * g;
+        acc_grad[i] = a;
+        param[i] -= delta;
+        acc_delta[i] = gamma * d + (1 - gamma) * delta * delta;
+    }
+}
+
+template<typename Real>
+static void CpuAdamUpdate(const Real *grad, Real *m, Real *v, Real *param, int num,
+                          Real beta1, Real beta2, Real lr_s1, Real s2, Real floor) {
+    for (int i = 0; i < num; i++) {
+        Real g = grad[i];
+        Real mi = beta1 * m[i] + (1 - beta1) * g;
+        Real vi = beta2 * v[i] + (1 - beta2) * g * g;
+        m[i] = mi;
+        v[i] = vi;
+        param[i] -= lr_s1 * mi / std::sqrt(std::max(vi * s2, floor));
+    }
+}
+
+#ifdef KALDI_HAVE_AVX2
+// Same as the scalar loops 8 floats at a time, the tail by the scalar ones
+
+KALDI_TARGET_AVX2
+static void Avx2RmsUpdate(const float *grad, float *acc, float *param, int num,
+                          float decay, float scale, float lr, float floor) {
+    const __m256 vdecay = _mm256_set1_ps(decay), vscale = _mm256_set1_ps(scale),
+                 vlr = _mm256_set1_ps(lr), vfloor = _mm256_set1_ps(floor);
+    int i = 0;
+    for (; i + 8 <= num; i += 8) {
+        __m256 g = _mm256_loadu_ps(grad + i);
+        __m256 a = _mm256_add_ps(_mm256_mul_ps(vdecay, _mm256_loadu_ps(acc + i)),
+                                 _mm256_mul_ps(_mm256_mul_ps(vscale, g), g));
+        _mm256_storeu_ps(acc + i, a);
+        __m256 step = _mm256_div_ps(_mm256_mul_ps(vlr, g),
+                                    _mm256_sqrt_ps(_mm256_max_ps(a, vfloor)));
+        _mm256_storeu_ps(param + i, _mm256_sub_ps(_mm256_loadu_ps(param + i), step));
+    }
+    CpuRmsUpdate(grad + i, acc + i, param + i, num - i, decay, scale, lr, floor);
+}
+
+KALDI_TARGET_AVX2
+static void Avx2AdaDeltaUpdate(const float *grad, float *acc_grad, float *acc_delta,
+                               float *param, int num, float gamma, float floor) {
+    const __m256 vgamma = _mm256_set1_ps(gamma), vrest = _mm256_set1_ps(1 - gamma),
+                 vfloor = _mm256_set1_ps(floor);
+    int i = 0;
+    for (; i + 8 <= num; i += 8) {
+        __m256 g = _mm256_loadu_ps(grad + i);
+        __m256 a = _mm256_add_ps(_mm256_mul_ps(vgamma, _mm256_loadu_ps(acc_grad + i)),
+                                 _mm256_mul_ps(_mm256_mul_ps(vrest, g), g));
+        __m256 d = _mm256_loadu_ps(acc_delta + i);
+        __m256 delta = _mm256_mul_ps(
+            _mm256_div_ps(_mm256_sqrt_ps(_mm256_max_ps(d, vfloor)),
+                          _mm256_sqrt_ps(_mm256_max_ps(a, vfloor))), g);
+        _mm256_storeu_ps(acc_grad + i, a);
+        _mm256_storeu_ps(param + i, _mm256_sub_ps(_mm256_loadu_ps(param + i), delta));
+        _mm256_storeu_ps(acc_delta + i, _mm256_add_ps(_mm256_mul_ps(vgamma, d),
+            _mm256_mul_ps(_mm256_mul_ps(vrest, delta), delta)));
+    }
+    CpuAdaDeltaUpdate(grad + i, acc_grad + i, acc_delta + i, param + i, num - i,
+                      gamma, floor);
+}
+
+KALDI_TARGET_AVX2
+static void Avx2AdamUpdate(const float *grad, float *m, float *v, float *param, int num,
+                           float beta1, float beta2, float lr_s1, float s2, float floor) {
+    const __m256 vb1 = _mm256_set1_ps(beta1), vr1 = _mm256_set1_ps(1 - beta1),
+                 vb2 = _mm256_set1_ps(beta2), vr2 = _mm256_set1_ps(1 - beta2),
+                 vlr = _mm256_set1_ps(lr_s1), vs2 = _mm256_set1_ps(s2),
+                 vfloor = _mm256_set1_ps(floor);
+    int i = 0;
+    for (; i + 8 <= num; i += 8) {
+        __m256 g = _mm256_loadu_ps(grad + i);
+        __m256 mi = _mm256_add_ps(_mm256_mul_ps(vb1, _mm256_loadu_ps(m + i)),
+                                  _mm256_mul_ps(vr1, g));
+        __m256 vi = _mm256_add_ps(_mm256_mul_ps(vb2, _mm256_loadu_ps(v + i)),
+                                  _mm256_mul_ps(_mm256_mul_ps(vr2, g), g));
+        _mm256_storeu_ps(m + i, mi);
+        _mm256_storeu_ps(v + i, vi);
+        __m256 step = _mm256_div_ps(_mm256_mul_ps(vlr, mi),
+            _mm256_sqrt_ps(_mm256_max_ps(_mm256_mul_ps(vi, vs2), vfloor)));
+        _mm256_storeu_ps(param + i, _mm256_sub_ps(_mm256_loadu_ps(param + i), step));
+    }
+    CpuAdamUpdate(grad + i, m + i, v + i, param + i, num - i,
+                  beta1, beta2, lr_s1, s2, floor);
+}
+#endif
+
+// The CPU dispatch, AVX2 only for float, double runs the scalar loops
+
+static void CpuRmsUpdate(const BaseFloat *grad, BaseFloat *acc, BaseFloat *param,
+                         int num, BaseFloat decay, BaseFloat scale, BaseFloat lr) {
+#ifdef KALDI_HAVE_AVX2
+    if (sizeof(BaseFloat) == sizeof(float) && CpuHasAvx2()) {
+        Avx2RmsUpdate(reinterpret_cast<const float *>(grad),
+                      reinterpret_cast<float *>(acc), reinterpret_cast<float *>(param),
+                      num, decay, scale, lr, kAccFloor);
+        return;
+    }
+#endif
+    CpuRmsUpdate<BaseFloat>(grad, acc, param, num, decay, scale, lr, kAccFloor);
+}
+
+static void CpuAdaDeltaUpdate(const BaseFloat *grad, BaseFloat *acc_grad,
+                              BaseFloat *acc_delta, BaseFloat *param, int num,
+                              BaseFloat gamma) {
+#ifdef KALDI_HAVE_AVX2
+    if (sizeof(BaseFloat) == sizeof(float) && CpuHasAvx2()) {
+        Avx2AdaDeltaUpdate(reinterpret_cast<const float *>(grad),
+                           reinterpret_cast<float *>(acc_grad),
+                           reinterpret_cast<float *>(acc_delta),
+                           reinterpret_cast<float *>(param), num, gamma, kAccFloor);
+        return;
+    }
+#endif
+    CpuAdaDeltaUpdate<BaseFloat>(grad, acc_grad, acc_delta, param, num, gamma,
+                                 kAccFloor);
+}
+
+static void CpuAdamUpdate(const BaseFloat *grad, BaseFloat *m, BaseFloat *v,
+                          BaseFloat *param, int num, BaseFloat beta1,
+                          BaseFloat beta2, BaseFloat lr_s1, BaseFloat s2) {
+#ifdef KALDI_HAVE_AVX2
+    if (sizeof(BaseFloat) == sizeof(float) && CpuHasAvx2()) {
+        Avx2AdamUpdate(reinterpret_cast<const float *>(grad),
+                       reinterpret_cast<float *>(m), reinterpret_cast<float *>(v),
+                       reinterpret_cast<float *>(param), num,
+                       beta1, beta2, lr_s1, s2, kAccFloor);
+        return;
+    }
+#endif
+    CpuAdamUpdate<BaseFloat>(grad, m, v, param, num, beta1, beta2, lr_s1, s2,
+                             kAccFloor);
+}
+
+// the CuVector data is on the device if it is enabled, on the host otherwise
+#if HAVE_CUDA == 1
+#define ASLP_ON_DEVICE CuDevice::Instantiate().Enabled()
+#else
+#define ASLP_ON_DEVICE false
+#endif
+
+static void RmsUpdate(const CuVectorBase<BaseFloat> &grad, BaseFloat decay,
+                      BaseFloat scale, BaseFloat lr, BaseFloat *acc,
+                      CuVectorBase<BaseFloat> *param) {
+    int num = grad.Dim();
+    if (num == 0) return;
+    if (ASLP_ON_DEVICE) {
+#if HAVE_CUDA == 1
+        cuda_rms_update(grad.Data(), acc, param->Data(), num, decay, scale, lr,
+                        kAccFloor);
+        CU_SAFE_CALL(cudaGetLastError());
+#endif
+    } else {
+        CpuRmsUpdate(grad.Data(), acc, param->Data(), num, decay, scale, lr);
+    }
+}
+
+void Optimizer::Optimize(const CuVectorBase<BaseFloat> &grad,
+        const std::vector<CuSubVector<BaseFloat> *> &params) {
+    KALDI_ASSERT(size_ == grad.Dim());
+    int offset = 0;
+    for (int i = 0; i < params.size(); i++) {
+        int dim = params[i]->Dim();
+        Solve(grad.Range(offset, dim), offset, params[i]);
+        offset += dim;
+    }
+    KALDI_ASSERT(offset == size_);
+    Advance();
+}
+
+void Optimizer::Write(std::ostream &os, bool binary) const {
+    std::vector<CuVector<BaseFloat> *> state;
+    Optimizer *self = const_cast<Optimizer *>(this);
+    self->GetState(&state);
+    WriteToken(os, binary, "<Optimizer>");
+    WriteBasicType(os, binary, size_);
+    WriteBasicType(os, binary, static_cast<int32>(state.size()));
+    int *step = self->Step();
+    WriteBasicType(os, binary, step != NULL ? *step : 0);
+    for (int i = 0; i < state.size(); i++) {
+        state[i]->Write(os, binary);
+    }
+}
+
+void Optimizer::Read(std::istream &is, bool binary) {
+    std::vector<CuVector<BaseFloat> *> state;
+    GetState(&state);
+    int32 size, num_state, step;
+    ExpectToken(is, binary, "<Optimizer>");
+    ReadBasicType(is, binary, &size);
+    ReadBasicType(is, binary, &num_state);
+    ReadBasicType(is, binary, &step);
+    if (size != size_ || num_state != state.size()) {
+        KALDI_ERR << "Optimizer state of size " << size << " with " << num_state
+                  << " vectors, expect " << size_ << " with " << state.size()
+                  << ", not the same solver or model";
+    }
+    if (Step() != NULL) *Step() = step;
+    for (int i = 0; i < state.size(); i++) {
+        state[i]->Read(is, binary);
+        KALDI_ASSERT(state[i]->Dim() == size_);
+    }
+}
+
+void Momentum::Solve(const CuVectorBase<BaseFloat> &grad, int offset,
+        CuVectorBase<BaseFloat> *param) {
+    int num = grad.Dim();
+    if (num == 0) return;
+    BaseFloat *mom = grad_.Data() + offset;
+    if (ASLP_ON_DEVICE) {
+#if HAVE_CUDA == 1
+        cuda_momentum_update(grad.Data(), mom, param->Data(), num, lr_, momentum_);
+        CU_SAFE_CALL(cudaGetLastError());
+#endif
+    } else {
+        CpuMomentumUpdate<BaseFloat>(grad.Data(), mom, param->Data(), num,
+                                     lr_, momentum_);
+    }
+}
+
+void AdaGrad::Solve(const CuVectorBase<BaseFloat> &grad, int offset,
+        CuVectorBase<BaseFloat> *param) {
+    RmsUpdate(grad, 1.0, 1.0, lr_, acc_grad_.Data() + offset, param);
+}
+
+void RMSprop::Solve(const CuVectorBase<BaseFloat> &grad, int offset,
+        CuVectorBase<BaseFloat> *param) {
+    RmsUpdate(grad, 0.9, 0.1, lr_, acc_grad_.Data() + offset, param);
+}
+
+void AdaDelta::Solve(const CuVectorBase<BaseFloat> &grad, int offset,
+        CuVectorBase<BaseFloat> *param) {
+    int num = grad.Dim();
+    if (num == 0) return;
+    BaseFloat *acc_grad = acc_grad_.Data() + offset,
+              *acc_delta = acc_delta_.Data() + offset;
+    if (ASLP_ON_DEVICE) {
+#if HAVE_CUDA == 1
+        cuda_adadelta_update(grad.Data(), acc_grad, acc_delta, param->Data(), num,
+                             gamma_, kAccFloor);
+        CU_SAFE_CALL(cudaGetLastError());
+#endif
+    } else {
+        CpuAdaDeltaUpdate(grad.Data(), acc_grad, acc_delta, param->Data(), num,
+                          gamma_);
+    }
+}
+
+void Adam::Solve(const CuVectorBase<BaseFloat> &grad, int offset,
+        CuVectorBase<BaseFloat> *param) {
+    int num = grad.Dim();
+    if (num == 0) return;
+    BaseFloat s1 = 1.0 / (1 - pow(beta1_, t_));
+    BaseFloat s2 = 1.0 / (1 - pow(beta2_, t_));
+    BaseFloat *m = grad_.Data() + offset, *v = delta_.Data() + offset;
+    if (ASLP_ON_DEVICE) {
+#if HAVE_CUDA == 1
+        cuda_adam_update(grad.Data(), m, v, param->Data(), num,
+                         beta1_, beta2_, lr_ * s1, s2, kAccFloor);
+        CU_SAFE_CALL(cudaGetLastError());
+#endif
+    } else {
+        CpuAdamUpdate(grad.Data(), m, v, param->Data(), num,
+                      beta1_, beta2_, lr_ * s1, s2);
+    }
+}
+
+} // namespace kaldi
@@ -11,27 +11,47 @@
 #include "util/common-utils.h"
 #include "cudamatrix/cu-matrix.h"
 #include "cudamatrix/cu-vector.h"
-#
 
 namespace kaldi {
 /* 
  * Please refer "An overview of gradient descent optimization algorithms" for details
+ *
+ * The adaptive solvers floor the accumulators at 1e-8 before the square
+ * root, each update is one fused kernel(CUDA, or AVX2 on the CPU) which
+ * reads the gradient and the state and writes the parameter once.
  */
 
 class Optimizer {
 public:
     Optimizer(int size): size_(size) {}
     virtual ~Optimizer() {}
-    virtual void Optimize(const CuVector<BaseFloat> &grad, 
+    virtual void Optimize(const CuVectorBase<BaseFloat> &grad, 
             CuSubVector<BaseFloat> *param) {
         KALDI_ASSERT(param != NULL);
         KALDI_ASSERT(size_ == grad.Dim()); 
         KALDI_ASSERT(size_ == param->Dim()); 
-        Solve(grad, param);
+        Solve(grad, 0, param);
+        Advance();
     }
+    // Multi tensor version, one optimizer for all the tensors, size_ is their
+    // total size, grad and the optimizer state hold them one after another.
+    // One step of the optimizer, one fused kernel per tensor.
+    void Optimize(const CuVectorBase<BaseFloat> &grad,
+            const std::vector<CuSubVector<BaseFloat> *> &params);
+    // The state of the solver(the accumulators, the moments) for the
+    // checkpoints, Read checks it is of the same solver and size
+    void Write(std::ostream &os, bool binary) const;
+    void Read(std::istream &is, bool binary);
 protected:
-    virtual void Solve(const CuVector<BaseFloat> &grad, 
-            CuSubVector<BaseFloat> *param) = 0;
+    // Update param with its gradient and the state at offset, all the math
+    // in one pass over the memory (optimizer.cc)
+    virtual void Solve(const CuVectorBase<BaseFloat> &grad, int offset,
+            CuVectorBase<BaseFloat> *param) = 0;
+    // called once per step after all the tensors
+    virtual void Advance() {}
+    // the vectors of the state, and the step count if any
+    virtual void GetState(std::vector<CuVector<BaseFloat> *> *state) {}
+    virtual int *Step() { return NULL; }
     int size_; // tensor size
 };
 
@@ -39,8 +59,8 @@ protected:
 class SGD: public Optimizer {
 public:
     SGD(int size, float lr = 0.1): Optimizer(size), lr_(lr) {}
-    virtual void Solve(const CuVector<BaseFloat> &grad, 
-            CuSubVector<BaseFloat> *param) {
+    virtual void Solve(const CuVectorBase<BaseFloat> &grad, int offset,
+            CuVectorBase<BaseFloat> *param) {
         param->AddVec(-lr_, grad);
     }
 private:
@@ -53,10 +73,11 @@ public:
     Momentum(int size, float lr = 0.1, float momentum = 0.9): 
         Optimizer(size), lr_(lr), momentum_(momentum), 
         grad_(size) {}
-    virtual void Solve(const CuVector<BaseFloat> &grad, 
-            CuSubVector<BaseFloat> *param) {
-        grad_.AddVec(lr_, grad, momentum_);
-        param->AddVec(-1.0, grad_);
+    virtual void Solve(const CuVectorBase<BaseFloat> &grad, int offset,
+            CuVectorBase<BaseFloat> *param);
+protected:
+    virtual void GetState(std::vector<CuVector<BaseFloat> *> *state) {
+        state->push_back(&grad_);
     }
 private:
     float lr_, momentum_;
@@ -68,21 +89,16 @@ class AdaGrad: public Optimizer {
 public:
     AdaGrad(int size, float lr = 0.01): 
         Optimizer(size), lr_(lr), 
-        acc_grad_(size), grad_(size) {}
-    virtual void Solve(const CuVector<BaseFloat> &grad, 
-            CuSubVector<BaseFloat> *param) {
-        acc_grad_.AddVecVec(1.0, grad, grad, 1.0);
-        grad_.CopyFromVec(acc_grad_);
-        grad_.ApplyFloor(1e-8);
-        grad_.ApplyPow(0.5);
-        grad_.InvertElements();
-        grad_.MulElements(grad);
-        param->AddVec(-lr_, grad_);
+        acc_grad_(size) {}
+    virtual void Solve(const CuVectorBase<BaseFloat> &grad, int offset,
+            CuVectorBase<BaseFloat> *param);
+protected:
+    virtual void GetState(std::vector<CuVector<BaseFloat> *> *state) {
+        state->push_back(&acc_grad_);
     }
 private:
     float lr_;
     CuVector<BaseFloat> acc_grad_; // Gt
-    CuVector<BaseFloat> grad_;  
 };
 
 
@@ -90,21 +106,16 @@ class RMSprop: public Optimizer {
 public:
     RMSprop(int size, float lr = 0.001): 
         Optimizer(size), lr_(lr), 
-        acc_grad_(size), grad_(size) {}
-    virtual void Solve(const CuVector<BaseFloat> &grad, 
-            CuSubVector<BaseFloat> *param) {
-        acc_grad_.AddVecVec(0.1, grad, grad, 0.9);
-        grad_.CopyFromVec(acc_grad_);
-        grad_.ApplyFloor(1e-8);
-        grad_.ApplyPow(0.5);
-        grad_.InvertElements();
-        grad_.MulElements(grad);
-        param->AddVec(-lr_, grad_);
+        acc_grad_(size) {}
+    virtual void Solve(const CuVectorBase<BaseFloat> &grad, int offset,
+            CuVectorBase<BaseFloat> *param);
+protected:
+    virtual void GetState(std::vector<CuVector<BaseFloat> *> *state) {
+        state->push_back(&acc_grad_);
     }
 private:
     float lr_;
     CuVector<BaseFloat> acc_grad_; // Gt
-    CuVector<BaseFloat> grad_;  
 };
 
 
@@ -112,29 +123,18 @@ class AdaDelta: public Optimizer {
 public:
     AdaDelta(int size, float gamma = 0.95): 
         Optimizer(size), gamma_(gamma), 
-        acc_grad_(size), acc_delta_(size), 
-        grad_(size), delta_(size) {}
-    virtual void Solve(const CuVector<BaseFloat> &grad, 
-            CuSubVector<BaseFloat> *param) {
-        acc_grad_.AddVecVec(1 - gamma_, grad, grad, gamma_);
-        grad_.CopyFromVec(acc_grad_);
-        grad_.ApplyFloor(1e-8);
-        grad_.ApplyPow(0.5);
-        grad_.InvertElements();
-        delta_.CopyFromVec(acc_delta_);
-        delta_.ApplyFloor(1e-8);
-        delta_.ApplyPow(0.5);
-        grad_.MulElements(delta_);
-        grad_.MulElements(grad);
-        param->AddVec(-1.0, grad_);
-        acc_delta_.AddVecVec(1 - gamma_, grad_, grad_, gamma_);
+        acc_grad_(size), acc_delta_(size) {}
+    virtual void Solve(const CuVectorBase<BaseFloat> &grad, int offset,
+            CuVectorBase<BaseFloat> *param);
+protected:
+    virtual void GetState(std::vector<CuVector<BaseFloat> *> *state) {
+        state->push_back(&acc_grad_);
+        state->push_back(&acc_delta_);
     }
 private:
     float gamma_;
     CuVector<BaseFloat> acc_grad_; // Gt
     CuVector<BaseFloat> acc_delta_; // delta t
-    CuVector<BaseFloat> grad_;  
-    CuVector<BaseFloat> delta_;  
 };
 
 
@@ -144,29 +144,22 @@ public:
         Optimizer(size), lr_(lr), 
         beta1_(beta1), beta2_(beta2), 
         t_(1),
-        grad_(size), delta_(size), diff_(size) {}
-    virtual void Solve(const CuVector<BaseFloat> &grad, 
-            CuSubVector<BaseFloat> *param) {
-        grad_.AddVec(1 - beta1_, grad, beta1_);
-        delta_.AddVecVec(1 - beta2_, grad, grad, beta2_);
-        float s1 = 1.0 / (1 - pow(beta1_, t_));
-        float s2 = 1.0 / (1 - pow(beta2_, t_));
-        diff_.CopyFromVec(delta_);
-        diff_.Scale(s2);
-        diff_.ApplyFloor(1e-8);
-        diff_.ApplyPow(0.5);
-        diff_.InvertElements();
-        diff_.MulElements(grad_);
-        param->AddVec(-lr_ * s1, diff_);
-        t_++;
+        grad_(size), delta_(size) {}
+    virtual void Solve(const CuVectorBase<BaseFloat> &grad, int offset,
+            CuVectorBase<BaseFloat> *param);
+    virtual void Advance() { t_++; }
+protected:
+    virtual void GetState(std::vector<CuVector<BaseFloat> *> *state) {
+        state->push_back(&grad_);
+        state->push_back(&delta_);
     }
+    virtual int *Step() { return &t_; }
 private:
     float lr_;
     float beta1_, beta2_;
     int t_;
     CuVector<BaseFloat> grad_; // m(t)
     CuVector<BaseFloat> delta_; // v(t)
-    CuVector<BaseFloat> diff_;  
 };
 
 struct OptimizerOption {
@@ -176,10 +169,11 @@ struct OptimizerOption {
     float adagrad_lr, rmsprop_lr, adam_lr;
     float adadelta_gamma;
     float adam_beta1, adam_beta2;
+    bool multi_tensor;
     OptimizerOption() : solver("momentum"), lr(0.01), momentum(0.9),
         adagrad_lr(0.01), rmsprop_lr(0.001), adam_lr(0.001),
         adadelta_gamma(0.95),
-        adam_beta1(0.9), adam_beta2(0.999) {}
+        adam_beta1(0.9), adam_beta2(0.999), multi_tensor(true) {}
     void Register(OptionsItf *opts) {
         opts->Register("solver", &solver,
                         "Optimizer solver(sgd | momentum | adagrad | adadelta | rmsprop | adam)");
@@ -199,6 +193,9 @@ struct OptimizerOption {
                         "update mean factor for (adam) optimizer");
         opts->Register("adam-beta2", &adam_beta2, 
                         "update variance factor for (adam) optimizer");
+        opts->Register("optimizer-multi-tensor", &multi_tensor,
+                        "One optimizer and one allreduce over all the tensors "
+                        "as a flat buffer, instead of one per tensor");
     }
 
     Optimizer *NewInstance(int size) const {
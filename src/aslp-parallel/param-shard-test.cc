@@ -0,0 +1,113 @@
+/* Test of ParamShard and benchmark of the sharded asynchronous servers,
+ * run it by mpirun with at least num_servers + 1 processes:
+ *   mpirun -np 9 param-shard-test [num_servers]
+ * the first num_servers ranks serve, the others are the workers
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "base/timer.h"
+#include "aslp-parallel/param-shard.h"
+#include "aslp-parallel/asgd-server.h"
+#include "aslp-parallel/asgd-worker.h"
+#include "aslp-parallel/easgd-server.h"
+#include "aslp-parallel/easgd-worker.h"
+
+namespace kaldi {
+
+void TestParamShardPartition() {
+    int sizes[] = { 100, 5000, 3, 5000, 700, 1 };
+    std::vector<std::pair<BaseFloat *, int> > params;
+    for (int i = 0; i < 6; i++) params.push_back(std::make_pair((BaseFloat *)NULL, sizes[i]));
+    ParamShard one(1);
+    one.Init(params, 3);
+    KALDI_ASSERT(one.NumWorkers() == 2 && one.Tensors(0).size() == 6);
+    ParamShard three(3);
+    three.Init(params, 5);
+    KALDI_ASSERT(three.NumWorkers() == 2 && three.WorkerIndex(3) == 0);
+    // the two large ones apart, the rest on the third one
+    KALDI_ASSERT(three.ServerOf(1) == 0 && three.ServerOf(3) == 1);
+    KALDI_ASSERT(three.ServerOf(4) == 2 && three.ServerOf(0) == 2);
+    int num_tensors = 0;
+    for (int s = 0; s < 3; s++) {
+        for (int k = 0; k < three.Tensors(s).size(); k++) {
+            KALDI_ASSERT(three.ServerOf(three.Tensors(s)[k]) == s);
+            num_tensors++;
+        }
+    }
+    KALDI_ASSERT(num_tensors == 6);
+}
+
+// Each worker adds one to all the parameters before each synchronization,
+// the asgd server with alpha 1 sums the gradients, so it ends with the total
+// number of synchronizations everywhere
+void TestShardedServer(MpiNode *node, int num_servers, const std::string &type) {
+    int sizes[] = { 1 << 20, 300, 1 << 18, 7, 1 << 16, 2048, 1 };
+    int num_sync = 20;
+    std::vector<CuVector<BaseFloat> *> gpu(7);
+    std::vector<std::pair<BaseFloat *, int> > params;
+    int64 total_size = 0;
+    for (int i = 0; i < 7; i++) {
+        gpu[i] = new CuVector<BaseFloat>(sizes[i]);
+        params.push_back(std::make_pair(gpu[i]->Data(), sizes[i]));
+        total_size += sizes[i];
+    }
+    int num_workers = node->NumNodes() - num_servers;
+    node->Barrier();
+    Timer timer;
+    if (node->Rank() < num_servers) {
+        IServer *server = NULL;
+        if (type == "asgd") server = new AsgdServer(1.0, 0, DeltaCodecOptions(), num_servers);
+        else server = new EasgdServer(0.5, DeltaCodecOptions(), num_servers);
+        server->InitParam(params);
+        server->Run();
+        delete server;
+    } else {
+        IWorker *worker = NULL;
+        if (type == "asgd") worker = new AsgdWorker(DeltaCodecOptions(), num_servers);
+        else worker = new EasgdWorker(0.5, DeltaCodecOptions(), num_servers);
+        worker->InitParam(params);
+        for (int n = 0; n < num_sync; n++) {
+            for (int i = 0; i < 7; i++) gpu[i]->Add(1.0);
+            worker->Synchronize(0);
+        }
+        worker->Stop();
+        delete worker;
+    }
+    node->Barrier();
+    double seconds = timer.Elapsed();
+    if (node->IsMainNode()) {
+        BaseFloat expect = static_cast<BaseFloat>(num_workers * num_sync);
+        for (int i = 0; i < 7; i++) {
+            Vector<BaseFloat> result(sizes[i]);
+            result.CopyFromVec(*gpu[i]);
+            if (type == "asgd") {
+                KALDI_ASSERT(result.Min() == expect && result.Max() == expect);
+            } else {
+                KALDI_ASSERT(result.Min() >= 0 && result.Max() <= num_sync);
+            }
+        }
+        // one update pushes and pulls the whole model
+        int num_updates = num_workers * num_sync;
+        printf("%s %d servers %d workers: %.1f updates/s, %.1f MB/s\n",
+               type.c_str(), num_servers, num_workers, num_updates / seconds,
+               2.0 * num_updates * total_size * sizeof(BaseFloat) / seconds / 1e6);
+    }
+    for (int i = 0; i < 7; i++) delete gpu[i];
+}
+
+} // namespace kaldi
+
+int main(int argc, char *argv[]) {
+    using namespace kaldi;
+    MpiNode node;
+    TestParamShardPartition();
+    int num_servers = argc > 1 ? atoi(argv[1]) : 1;
+    if (node.NumNodes() > num_servers) {
+        TestShardedServer(&node, num_servers, "asgd");
+        TestShardedServer(&node, num_servers, "easgd");
+    }
+    if (node.IsMainNode()) std::cout << "Test OK.\n";
+    return 0;
+}
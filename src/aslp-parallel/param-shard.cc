@@ -0,0 +1,78 @@
+/* Partition of the parameter tensors over the server ranks
+ */
+
+#include <algorithm>
+#include <sstream>
+
+#include "aslp-parallel/itf.h"
+#include "aslp-parallel/param-shard.h"
+
+namespace kaldi {
+
+// Larger tensor first, then lower index
+struct TensorSizeGreater {
+    const std::vector<std::pair<BaseFloat *, int> > &params;
+    explicit TensorSizeGreater(const std::vector<std::pair<BaseFloat *, int> > &p):
+        params(p) {}
+    bool operator () (int a, int b) const {
+        if (params[a].second != params[b].second)
+            return params[a].second > params[b].second;
+        return a < b;
+    }
+};
+
+void ParamShard::Init(const std::vector<std::pair<BaseFloat *, int> > &params,
+                      int num_nodes) {
+    if (num_servers_ >= num_nodes) {
+        KALDI_ERR << num_servers_ << " servers need more than " << num_nodes
+                  << " ranks, the rest are the workers";
+    }
+    num_workers_ = num_nodes - num_servers_;
+    std::vector<int> order(params.size());
+    for (int i = 0; i < params.size(); i++) order[i] = i;
+    std::sort(order.begin(), order.end(), TensorSizeGreater(params));
+    std::vector<int64> load(num_servers_, 0);
+    server_.resize(params.size());
+    tensors_.assign(num_servers_, std::vector<int>());
+    for (int k = 0; k < order.size(); k++) {
+        int s = std::min_element(load.begin(), load.end()) - load.begin();
+        server_[order[k]] = s;
+        load[s] += params[order[k]].second;
+    }
+    // in the tensor order, which the messages follow
+    for (int i = 0; i < params.size(); i++) {
+        tensors_[server_[i]].push_back(i);
+    }
+    if (num_servers_ > 1) {
+        std::ostringstream os;
+        for (int s = 0; s < num_servers_; s++) os << " " << load[s];
+        KALDI_LOG << "Parameters of the " << num_servers_ << " servers" << os.str();
+    }
+}
+
+void ParamShard::SendMsg(int msg_type) const {
+    for (int s = 0; s < num_servers_; s++) {
+        MPI_Send(&msg_type, 1, MPI_INT, s, kTagMsg, MPI_COMM_WORLD);
+    }
+}
+
+void ParamShard::GatherModel(const std::vector<CuSubVector<BaseFloat> *> &params,
+                             int rank) const {
+    if (num_servers_ == 1) return;
+    for (int i = 0; i < params.size(); i++) {
+        if (server_[i] == 0) continue;
+        if (rank == 0) {
+            Vector<BaseFloat> cpu_param(params[i]->Dim(), kUndefined);
+            MPI_Recv(cpu_param.Data(), cpu_param.Dim(), MPI_FLOAT, server_[i],
+                     kTagModel, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+            params[i]->CopyFromVec(cpu_param);
+        } else if (rank == server_[i]) {
+            Vector<BaseFloat> cpu_param(params[i]->Dim(), kUndefined);
+            cpu_param.CopyFromVec(*params[i]);
+            MPI_Send(cpu_param.Data(), cpu_param.Dim(), MPI_FLOAT, 0,
+                     kTagModel, MPI_COMM_WORLD);
+        }
+    }
+}
+
+} // namespace kaldi
@@ -0,0 +1,60 @@
+/* Partition of the parameter tensors over the server ranks
+ */
+
+#ifndef ASLP_PARALLEL_PARAM_SHARD_H_
+#define ASLP_PARALLEL_PARAM_SHARD_H_
+
+#include <vector>
+
+#include "base/kaldi-common.h"
+#include "cudamatrix/cu-vector.h"
+
+#include "aslp-parallel/mpi-node.h"
+
+namespace kaldi {
+
+// The asynchronous servers are ranks 0 .. num_servers - 1, the workers are
+// the others. Each tensor is served by one server, the tensors are assigned
+// largest first to the server with the least parameters so far, the same on
+// the servers and the workers. With one server it is the original layout,
+// rank 0 serves everything.
+class ParamShard {
+public:
+    explicit ParamShard(int num_servers = 1): num_servers_(num_servers) {
+        KALDI_ASSERT(num_servers_ >= 1);
+    }
+    // @params: the second of the pairs is the size of the tensors
+    void Init(const std::vector<std::pair<BaseFloat *, int> > &params,
+              int num_nodes);
+
+    int NumServers() const { return num_servers_; }
+    int NumWorkers() const { return num_workers_; }
+    // rank of the server of tensor i
+    int ServerOf(int i) const { return server_[i]; }
+    // tensors of the server rank
+    const std::vector<int> &Tensors(int server) const {
+        KALDI_ASSERT(server >= 0 && server < num_servers_);
+        return tensors_[server];
+    }
+    // 0 .. NumWorkers() - 1 of a worker rank
+    int WorkerIndex(int rank) const {
+        KALDI_ASSERT(rank >= num_servers_);
+        return rank - num_servers_;
+    }
+
+    // Worker side, sends the message to all the servers
+    void SendMsg(int msg_type) const;
+    // Server side after training, rank 0 receives the tensors of the other
+    // servers into its params, all the servers call it
+    void GatherModel(const std::vector<CuSubVector<BaseFloat> *> &params,
+                     int rank) const;
+
+private:
+    int num_servers_, num_workers_;
+    std::vector<int> server_;
+    std::vector<std::vector<int> > tensors_;
+};
+
+} // namespace kaldi
+
+#endif
@@ -0,0 +1,83 @@
+/* Test and benchmark of RingAllReduce, run it by mpirun with any number of
+ * processes, on one or more hosts
+ */
+
+#include <stdio.h>
+
+#include "base/timer.h"
+#include "aslp-parallel/ring-allreduce.h"
+
+namespace kaldi {
+
+void TestRingAllReduce(MpiNode *node, bool hierarchical, int segment_size) {
+    RingAllReduce allreduce(hierarchical, segment_size);
+    int sizes[] = { 0, 1, 2, 3, 5, 17, 1000, 100003 };
+    for (int k = 0; k < 8; k++) {
+        // integers, the sum is exact in any order
+        std::vector<float> data(sizes[k] + 1), expect(sizes[k] + 1);
+        for (int i = 0; i < sizes[k]; i++) {
+            data[i] = expect[i] = (node->Rank() + 1) * (i % 13) - i % 5;
+        }
+        node->AllReduce(&expect[0], sizes[k]);
+        allreduce.AllReduce(&data[0], sizes[k]);
+        for (int i = 0; i < sizes[k]; i++) {
+            KALDI_ASSERT(data[i] == expect[i]);
+        }
+        std::vector<double> ddata(sizes[k] + 1, node->Rank());
+        allreduce.AllReduce(&ddata[0], sizes[k]);
+        double dexpect = node->NumNodes() * (node->NumNodes() - 1) / 2.0;
+        for (int i = 0; i < sizes[k]; i++) {
+            KALDI_ASSERT(ddata[i] == dexpect);
+        }
+    }
+}
+
+// Bus bandwidth is algbw * 2(n-1)/n, what each rank sends and receives in
+// an optimal allreduce, comparable over the numbers of ranks. It is 0 with
+// one rank, nothing is sent, so there is no table then.
+void BenchmarkAllReduce(MpiNode *node) {
+    int n = node->NumNodes();
+    if (n == 1) return;
+    RingAllReduce ring(false), hierarchical(true);
+    if (node->IsMainNode()) {
+        printf("%10s %14s %14s %14s   (busbw GB/s, %d ranks%s)\n", "bytes",
+               "mpi", "ring", "hierarchical", n,
+               hierarchical.IsHierarchical() ? "" : ", hierarchical is ring");
+    }
+    for (int size = 1 << 8; size <= 1 << 24; size <<= 2) {
+        std::vector<float> data(size, 1.0);
+        int num_iter = std::max(3, (1 << 26) / size);
+        double busbw[3];
+        for (int a = 0; a < 3; a++) {
+            node->Barrier();
+            Timer timer;
+            for (int j = 0; j < num_iter; j++) {
+                if (a == 0) node->AllReduce(&data[0], size);
+                else if (a == 1) ring.AllReduce(&data[0], size);
+                else hierarchical.AllReduce(&data[0], size);
+            }
+            node->Barrier();
+            double seconds = timer.Elapsed() / num_iter,
+                   algbw = size * sizeof(float) / seconds / 1e9;
+            busbw[a] = algbw * 2 * (n - 1) / n;
+        }
+        if (node->IsMainNode()) {
+            printf("%10d %14.3f %14.3f %14.3f\n", static_cast<int>(size * sizeof(float)),
+                   busbw[0], busbw[1], busbw[2]);
+        }
+    }
+}
+
+} // namespace kaldi
+
+int main(int argc, char *argv[]) {
+    using namespace kaldi;
+    MpiNode node;
+    for (int h = 0; h < 2; h++) {
+        TestRingAllReduce(&node, h == 1, 7);
+        TestRingAllReduce(&node, h == 1, 1 << 18);
+    }
+    BenchmarkAllReduce(&node);
+    if (node.IsMainNode()) std::cout << "Test OK.\n";
+    return 0;
+}
@@ -0,0 +1,145 @@
+/* Ring and hierarchical allreduce on point-to-point MPI
+ */
+
+#include <algorithm>
+
+#include "aslp-parallel/ring-allreduce.h"
+
+namespace kaldi {
+
+// Chunk k of n of size values, the chunks differ in size by at most one
+static inline int ChunkBegin(int size, int n, int k) {
+    return static_cast<int>(static_cast<int64>(size) * k / n);
+}
+
+RingAllReduce::RingAllReduce(bool hierarchical, int segment_size):
+        hierarchical_(hierarchical), segment_size_(segment_size),
+        local_comm_(MPI_COMM_NULL), cross_comm_(MPI_COMM_NULL) {
+    KALDI_ASSERT(segment_size_ > 0);
+    // of its own, the messages never match the ones of other protocols
+    MPI_Comm_dup(MPI_COMM_WORLD, &comm_);
+    if (!hierarchical_) return;
+    int rank, local_rank, local_size;
+    MPI_Comm_rank(comm_, &rank);
+    MPI_Comm_split_type(comm_, MPI_COMM_TYPE_SHARED, rank, MPI_INFO_NULL,
+                        &local_comm_);
+    MPI_Comm_rank(local_comm_, &local_rank);
+    MPI_Comm_size(local_comm_, &local_size);
+    MPI_Comm_split(comm_, local_rank, rank, &cross_comm_);
+    int min_size = local_size, max_size = local_size;
+    MPI_Allreduce(MPI_IN_PLACE, &min_size, 1, MPI_INT, MPI_MIN, comm_);
+    MPI_Allreduce(MPI_IN_PLACE, &max_size, 1, MPI_INT, MPI_MAX, comm_);
+    if (min_size != max_size) {
+        KALDI_WARN << "Hosts have " << min_size << " to " << max_size
+                   << " ranks, using the plain ring allreduce";
+        MPI_Comm_free(&local_comm_);
+        MPI_Comm_free(&cross_comm_);
+        hierarchical_ = false;
+        return;
+    }
+    int num_hosts;
+    MPI_Comm_size(cross_comm_, &num_hosts);
+    KALDI_VLOG(1) << "Hierarchical allreduce of " << num_hosts << " hosts, "
+                  << local_size << " ranks each";
+}
+
+RingAllReduce::~RingAllReduce() {
+    if (local_comm_ != MPI_COMM_NULL) MPI_Comm_free(&local_comm_);
+    if (cross_comm_ != MPI_COMM_NULL) MPI_Comm_free(&cross_comm_);
+    MPI_Comm_free(&comm_);
+}
+
+template<class ElemType>
+void RingAllReduce::AllReduce(ElemType *data, int size) {
+    if (size == 0) return;
+    if (!hierarchical_) {
+        ReduceScatter(data, size, comm_);
+        AllGather(data, size, comm_);
+        return;
+    }
+    int local_rank, local_size;
+    MPI_Comm_rank(local_comm_, &local_rank);
+    MPI_Comm_size(local_comm_, &local_size);
+    // 1. sum the chunks in the host, this rank has the sum of one
+    ReduceScatter(data, size, local_comm_);
+    // 2. sum that chunk over the hosts
+    int c = (local_rank + 1) % local_size,
+        begin = ChunkBegin(size, local_size, c),
+        end = ChunkBegin(size, local_size, c + 1);
+    ReduceScatter(data + begin, end - begin, cross_comm_);
+    AllGather(data + begin, end - begin, cross_comm_);
+    // 3. and gather the summed chunks in the host
+    AllGather(data, size, local_comm_);
+}
+
+template<class ElemType>
+void RingAllReduce::SendRecv(ElemType *send, int send_size,
+                             ElemType *recv, int recv_size, MPI_Comm comm) {
+    int rank, n;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &n);
+    MPI_Sendrecv(send, send_size, MpiNode::GetDataType(send), (rank + 1) % n, 0,
+                 recv, recv_size, MpiNode::GetDataType(recv), (rank + n - 1) % n, 0,
+                 comm, MPI_STATUS_IGNORE);
+}
+
+// After it, rank r has the sum of chunk (r + 1) % n
+template<class ElemType>
+void RingAllReduce::ReduceScatter(ElemType *data, int size, MPI_Comm comm) {
+    int rank, n;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &n);
+    if (n == 1) return;
+    buffer_.resize(segment_size_ * sizeof(ElemType));
+    ElemType *recv = reinterpret_cast<ElemType *>(&buffer_[0]);
+    // the same on all the ranks, which send and receive them in lockstep
+    int max_chunk = (size + n - 1) / n,
+        num_segments = (max_chunk + segment_size_ - 1) / segment_size_;
+    for (int s = 0; s < n - 1; s++) {
+        int send_chunk = (rank - s + n) % n, recv_chunk = (rank - s - 1 + n) % n;
+        int send_begin = ChunkBegin(size, n, send_chunk),
+            send_end = ChunkBegin(size, n, send_chunk + 1),
+            recv_begin = ChunkBegin(size, n, recv_chunk),
+            recv_end = ChunkBegin(size, n, recv_chunk + 1);
+        for (int j = 0; j < num_segments; j++) {
+            int send_offset = std::min(send_begin + j * segment_size_, send_end),
+                recv_offset = std::min(recv_begin + j * segment_size_, recv_end),
+                send_size = std::min(segment_size_, send_end - send_offset),
+                recv_size = std::min(segment_size_, recv_end - recv_offset);
+            SendRecv(data + send_offset, send_size, recv, recv_size, comm);
+            ElemType *out = data + recv_offset;
+            for (int i = 0; i < recv_size; i++) out[i] += recv[i];
+        }
+    }
+}
+
+// Before it, rank r has the sum of chunk (r + 1) % n
+template<class ElemType>
+void RingAllReduce::AllGather(ElemType *data, int size, MPI_Comm comm) {
+    int rank, n;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &n);
+    if (n == 1) return;
+    int max_chunk = (size + n - 1) / n,
+        num_segments = (max_chunk + segment_size_ - 1) / segment_size_;
+    for (int s = 0; s < n - 1; s++) {
+        int send_chunk = (rank + 1 - s + n) % n, recv_chunk = (rank - s + n) % n;
+        int send_begin = ChunkBegin(size, n, send_chunk),
+            send_end = ChunkBegin(size, n, send_chunk + 1),
+            recv_begin = ChunkBegin(size, n, recv_chunk),
+            recv_end = ChunkBegin(size, n, recv_chunk + 1);
+        for (int j = 0; j < num_segments; j++) {
+            int send_offset = std::min(send_begin + j * segment_size_, send_end),
+                recv_offset = std::min(recv_begin + j * segment_size_, recv_end);
+            SendRecv(data + send_offset,
+                     std::min(segment_size_, send_end - send_offset),
+                     data + recv_offset,
+                     std::min(segment_size_, recv_end - recv_offset), comm);
+        }
+    }
+}
+
+template void RingAllReduce::AllReduce<float>(float *data, int size);
+template void RingAllReduce::AllReduce<double>(double *data, int size);
+
+} // namespace kaldi
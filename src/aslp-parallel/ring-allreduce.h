@@ -0,0 +1,58 @@
+/* Ring and hierarchical allreduce on point-to-point MPI
+ */
+
+#ifndef ASLP_PARALLEL_RING_ALLREDUCE_H_
+#define ASLP_PARALLEL_RING_ALLREDUCE_H_
+
+#include <vector>
+
+#include "base/kaldi-common.h"
+
+#include "aslp-parallel/mpi-node.h"
+
+namespace kaldi {
+
+// Sums the data of all the ranks of MPI_COMM_WORLD, in place, without
+// MPI_Allreduce.
+// ring: the data is split into one chunk per rank, a reduce-scatter passes
+//   the chunks around the ring adding them up, then an allgather passes the
+//   summed chunks around. Every rank sends and receives 2(n-1)/n of the
+//   data, which is bandwidth optimal. The chunks go in segments of at most
+//   segment_size values, so the receive buffer stays small.
+// hierarchical: the ranks on the same host(sharing memory) reduce-scatter
+//   among them, rank k of every host then rings its chunk with the rank k
+//   of the other hosts, and the hosts allgather, so only 1/local_size of the
+//   data crosses the network from each rank. It needs the same number of
+//   ranks on every host, else the plain ring is used.
+class RingAllReduce {
+public:
+    RingAllReduce(bool hierarchical, int segment_size = 1 << 18);
+    ~RingAllReduce();
+
+    template<class ElemType>
+    void AllReduce(ElemType *data, int size);
+
+    bool IsHierarchical() const { return hierarchical_; }
+
+private:
+    template<class ElemType>
+    void ReduceScatter(ElemType *data, int size, MPI_Comm comm);
+    template<class ElemType>
+    void AllGather(ElemType *data, int size, MPI_Comm comm);
+    template<class ElemType>
+    void SendRecv(ElemType *send, int send_size, ElemType *recv, int recv_size,
+                  MPI_Comm comm);
+
+    bool hierarchical_;
+    int segment_size_;
+    MPI_Comm comm_,        // all the ranks
+             local_comm_,  // the ranks on this host
+             cross_comm_;  // the ranks of the same local rank on all hosts
+    std::vector<char> buffer_;
+
+    KALDI_DISALLOW_COPY_AND_ASSIGN(RingAllReduce);
+};
+
+} // namespace kaldi
+
+#endif
@@ -10,14 +10,24 @@ void SodWorker::InitParam(
         const std::vector<std::pair<BaseFloat *, int> > &params) {
     gpu_params_.resize(params.size());
     prev_gpu_params_.resize(params.size());
-    grad_gpu_params_.resize(params.size());
-    grad_cpu_params_.resize(params.size());
-    optimizers_.resize(params.size());
+    int total_size = 0;
     for (int i = 0; i < params.size(); i++) {
         gpu_params_[i] = new 
             CuSubVector<BaseFloat>(params[i].first, params[i].second); 
         prev_gpu_params_[i] = new CuVector<BaseFloat>(params[i].second);
         prev_gpu_params_[i]->CopyFromVec(*gpu_params_[i]);
+        total_size += params[i].second;
+    }
+    if (config_.multi_tensor) {
+        flat_grad_gpu_.Resize(total_size);
+        flat_grad_cpu_.Resize(total_size);
+        optimizers_.push_back(config_.NewInstance(total_size));
+        return;
+    }
+    grad_gpu_params_.resize(params.size());
+    grad_cpu_params_.resize(params.size());
+    optimizers_.resize(params.size());
+    for (int i = 0; i < params.size(); i++) {
         grad_gpu_params_[i] = new CuVector<BaseFloat>(params[i].second);
         grad_cpu_params_[i] = new Vector<BaseFloat>(params[i].second);
         optimizers_[i] = config_.NewInstance(params[i].second);
@@ -28,8 +38,12 @@ SodWorker::~SodWorker() {
     for (int i = 0; i < gpu_params_.size(); i++) {
         delete gpu_params_[i];
         delete prev_gpu_params_[i];
+    }
+    for (int i = 0; i < grad_gpu_params_.size(); i++) {
         delete grad_gpu_params_[i];
         delete grad_cpu_params_[i];
+    }
+    for (int i = 0; i < optimizers_.size(); i++) {
         delete optimizers_[i];
     }
 }
@@ -42,6 +56,27 @@ bool SodWorker::Synchronize(int num_worker_samples) {
         KALDI_LOG << "All worker finished their data";
         return false;
     }
+
+    if (config_.multi_tensor) {
+        // 1. calc all the grads into the flat buffer
+        int offset = 0;
+        for (int i = 0; i < gpu_params_.size(); i++) {
+            CuSubVector<BaseFloat> grad(flat_grad_gpu_, offset, gpu_params_[i]->Dim());
+            grad.CopyFromVec(*prev_gpu_params_[i]);
+            grad.AddVec(-1.0, *gpu_params_[i]);
+            offset += gpu_params_[i]->Dim();
+        }
+        // 2. reduce and copy back at once
+        flat_grad_cpu_.CopyFromVec(flat_grad_gpu_);
+        AllReduce(flat_grad_cpu_.Data(), flat_grad_cpu_.Dim());
+        flat_grad_gpu_.CopyFromVec(flat_grad_cpu_);
+        // 3. one step of the solver over all the tensors
+        optimizers_[0]->Optimize(flat_grad_gpu_, gpu_params_);
+        for (int i = 0; i < gpu_params_.size(); i++) {
+            prev_gpu_params_[i]->CopyFromVec(*gpu_params_[i]);
+        }
+        return true;
+    }
    
     for (int i = 0; i < gpu_params_.size(); i++) {
         // 1. calc grad of wg(t), wg(t-1) - w(t) 
@@ -67,4 +102,26 @@ void SodWorker::Stop() {
     while (Synchronize(0)); 
 }
 
+void SodWorker::WriteState(std::ostream &os, bool binary) const {
+    WriteToken(os, binary, "<SodOptimizers>");
+    WriteBasicType(os, binary, static_cast<int32>(optimizers_.size()));
+    for (int i = 0; i < optimizers_.size(); i++) {
+        optimizers_[i]->Write(os, binary);
+    }
+}
+
+void SodWorker::ReadState(std::istream &is, bool binary) {
+    int32 num_optimizers;
+    ExpectToken(is, binary, "<SodOptimizers>");
+    ReadBasicType(is, binary, &num_optimizers);
+    if (num_optimizers != optimizers_.size()) {
+        KALDI_ERR << num_optimizers << " optimizers in the state, expect "
+                  << optimizers_.size() << ", the same --optimizer-multi-tensor "
+                  << "is needed to resume";
+    }
+    for (int i = 0; i < optimizers_.size(); i++) {
+        optimizers_[i]->Read(is, binary);
+    }
+}
+
 }
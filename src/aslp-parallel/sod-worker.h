@@ -32,6 +32,9 @@ public:
     bool Synchronize(int num_worker_samples); 
 
     void Stop();
+
+    void WriteState(std::ostream &os, bool binary) const;
+    void ReadState(std::istream &is, bool binary);
 private:
     // Here we use CuSubVector for that the memory is hold and managed by train model,
     // CuSubVector only share and update this pointer, refer to CuSubVector for details
@@ -40,6 +43,10 @@ private:
     std::vector<CuVector<BaseFloat> *> grad_gpu_params_;
     std::vector<Vector<BaseFloat> *> grad_cpu_params_;
     std::vector<Optimizer *> optimizers_;
+    // config_.multi_tensor, the gradients of all the tensors one after
+    // another, one allreduce and one optimizer instead of grad_*_params_
+    CuVector<BaseFloat> flat_grad_gpu_;
+    Vector<BaseFloat> flat_grad_cpu_;
     const OptimizerOption &config_; 
 };
 
@@ -20,6 +20,26 @@
 #include "aslp-parallel/bmuf-worker.h"
 #include "aslp-parallel/asgd-worker.h"
 #include "aslp-parallel/sod-worker.h"
+#include "aslp-parallel/checkpoint.h"
+
+namespace kaldi {
+
+// Right after a synchronization, the main worker serializes the model and
+// its state, the files are written in the background
+static void SaveCheckpoint(const aslp_nnet::Nnet &nnet, const IWorker &worker,
+                           aslp_nnet::FrameDataReader *reader, bool sharded,
+                           bool binary, Checkpointer *checkpointer) {
+    std::ostringstream model, state;
+    if (worker.IsMainNode()) {
+        InitKaldiOutputStream(model, binary);
+        nnet.Write(model, binary);
+        InitKaldiOutputStream(state, binary);
+        worker.WriteState(state, binary);
+    }
+    checkpointer->Save(model.str(), state.str(), reader->Position(), sharded);
+}
+
+} // namespace kaldi
 
 
 int main(int argc, char *argv[]) {
@@ -70,8 +90,23 @@ int main(int argc, char *argv[]) {
         po.Register("bmuf-learn-rate", &bmuf_learn_rate, "learn rate for bmuf worker");
         int sync_period = 25600;
         po.Register("sync-period", &sync_period, "number frames for every synchronization");
+        int sync_bucket_size = 1 << 20;
+        po.Register("sync-bucket-size", &sync_bucket_size, "number of parameters reduced in one bucket by the bsp and bmuf workers "
+                    "(0, one bucket per tensor)");
+        std::string sync_allreduce = "mpi";
+        po.Register("sync-allreduce", &sync_allreduce, "allreduce of the bsp and bmuf workers(mpi | ring | hierarchical)");
+        DeltaCodecOptions codec_opts;
+        codec_opts.Register(&po);
+        int num_servers = 1;
+        po.Register("num-servers", &num_servers, "Number of server ranks of the easgd, asgd and masgd workers, the same as the servers");
         int gpu_id = -1;
         po.Register("gpu-id", &gpu_id, "selected gpu id, if negative then select automaticly");
+        CheckpointOptions checkpoint_opts;
+        checkpoint_opts.Register(&po);
+        bool shard_data = false;
+        po.Register("shard-data", &shard_data, "All the workers read the same feature list, "
+                    "each one every n-th utterance of it, so a checkpoint can be resumed "
+                    "by another number of workers");
         
         po.Read(argc, argv);
 
@@ -92,14 +127,6 @@ int main(int argc, char *argv[]) {
             CuDevice::Instantiate().SelectGpuId(use_gpu);
         }
 #endif
-        Nnet nnet;
-        nnet.Read(model_filename);
-        nnet.SetTrainOptions(trn_opts);
-
-        if (dropout_retention > 0.0) {
-            nnet.SetDropoutRetention(dropout_retention);
-        }
-
         LossItf *loss = NULL;
         if (objective_function == "xent") {
             loss = new Xent;
@@ -112,22 +139,43 @@ int main(int argc, char *argv[]) {
         // Init Worker
         IWorker *worker = NULL;
         if (worker_type == "bsp") {
-            worker = new BspWorker();
+            worker = new BspWorker(sync_bucket_size, sync_allreduce);
         } else if (worker_type == "easgd") {
-            worker = new EasgdWorker(alpha);
+            worker = new EasgdWorker(alpha, codec_opts, num_servers);
         } else if (worker_type == "bmuf") {
-            worker = new BmufWorker(bmuf_learn_rate, bmuf_momentum);
+            worker = new BmufWorker(bmuf_learn_rate, bmuf_momentum, sync_bucket_size, sync_allreduce);
         } else if (worker_type == "asgd" || worker_type == "masgd") {
-            worker = new AsgdWorker();
+            worker = new AsgdWorker(codec_opts, num_servers);
         } else if (worker_type == "sod") {
             worker = new SodWorker(optimizer_opts);
         } else {
             KALDI_ERR << "Unsupported worker type: " << worker_type;
         }
+        bool synchronous = (worker_type == "bsp" || worker_type == "bmuf" ||
+                            worker_type == "sod");
+
+        // Resume from the last checkpoint if there is one
+        Checkpointer checkpointer(checkpoint_opts, worker);
+        if (checkpointer.Enabled() && !synchronous) {
+            KALDI_ERR << "Checkpoints are for the synchronous workers(bsp | bmuf | sod)";
+        }
+        bool resume = checkpointer.Resume();
+        Nnet nnet;
+        nnet.Read(resume ? checkpointer.ModelFilename() : model_filename);
+        nnet.SetTrainOptions(trn_opts);
+
+        if (dropout_retention > 0.0) {
+            nnet.SetDropoutRetention(dropout_retention);
+        }
 
         std::vector<std::pair<BaseFloat *, int> > params;
         nnet.GetGpuParams(&params);
         worker->InitParam(params);
+        if (resume) {
+            bool state_binary;
+            Input ki(checkpointer.StateFilename(), &state_binary);
+            worker->ReadState(ki.Stream(), state_binary);
+        }
         KALDI_LOG << "Mpi cluster info total " << worker->NumNodes() 
                   << " worker rank " << worker->Rank();
         
@@ -136,7 +184,17 @@ int main(int argc, char *argv[]) {
         int num_frames_since_last_sync = 0;
         KALDI_LOG << "TRAINING STARTED";
 
-        FrameDataReader reader(feature_rspecifier, targets_rspecifier, rnd_opts);
+        // the workers after the servers of the asynchronous training
+        int num_workers = worker->NumNodes(), worker_index = worker->Rank();
+        if (!synchronous) {
+            num_workers -= num_servers;
+            worker_index -= num_servers;
+        }
+        int64 skip = checkpointer.Skip(shard_data);
+        DataShard shard = shard_data ? DataShard(worker_index, num_workers, skip) :
+                                       DataShard(0, 1, skip);
+        if (skip > 0) KALDI_LOG << "Skip " << skip << " utterances trained before";
+        FrameDataReader reader(feature_rspecifier, targets_rspecifier, rnd_opts, shard);
 
         const CuMatrixBase<BaseFloat> *nnet_in;
         CuMatrix<BaseFloat> nnet_out, obj_diff;
@@ -144,7 +202,8 @@ int main(int argc, char *argv[]) {
 
 
         while (!reader.Done()) {
-            reader.ReadData(&nnet_in, &nnet_tgt); 
+            // false if the last utterances are less than one minibatch
+            if (!reader.ReadData(&nnet_in, &nnet_tgt)) break;
             // Forward pass
             nnet.Propagate(*nnet_in, &nnet_out);
             // Eval loss
@@ -160,6 +219,9 @@ int main(int argc, char *argv[]) {
                 KALDI_VLOG(2) << "Worker " << worker->Rank() << " synchronize once";
                 worker->Synchronize(num_frames_since_last_sync);
                 num_frames_since_last_sync = 0;
+                if (checkpointer.Due()) {
+                    SaveCheckpoint(nnet, *worker, &reader, shard_data, binary, &checkpointer);
+                }
             }
             // Report
             if (report_period > 0 && report_frames >= report_period) {
@@ -168,6 +230,15 @@ int main(int argc, char *argv[]) {
             }
         }
 
+        // The others may still train, the checkpoints go on with them, all
+        // the workers count the same synchronizations
+        if (checkpointer.Enabled()) {
+            while (worker->Synchronize(0)) {
+                if (checkpointer.Due()) {
+                    SaveCheckpoint(nnet, *worker, &reader, shard_data, binary, &checkpointer);
+                }
+            }
+        }
         // Stop worker
         worker->Stop();
 
@@ -186,6 +257,8 @@ int main(int argc, char *argv[]) {
             << ", " << (randomize?"RANDOMIZED":"NOT-RANDOMIZED") 
             << ", " << time.Elapsed()/60 << " min, fps" << total_frames/time.Elapsed()
             << "]";  
+        KALDI_LOG << "Data reader stalled " << reader.StallTime()
+                  << " s, the reading not hidden behind the training";
 
         if (loss != NULL) delete loss;
         if (worker != NULL) delete worker;
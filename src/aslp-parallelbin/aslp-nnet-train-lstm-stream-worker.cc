@@ -79,6 +79,15 @@ int main(int argc, char *argv[]) {
 	po.Register("bmuf-learn-rate", &bmuf_learn_rate, "learn rate for bmuf worker");
 	int sync_period = 25600;
 	po.Register("sync-period", &sync_period, "number frames for every synchronization");
+	int sync_bucket_size = 1 << 20;
+	po.Register("sync-bucket-size", &sync_bucket_size, "number of parameters reduced in one bucket by the bsp and bmuf workers "
+	            "(0, one bucket per tensor)");
+	std::string sync_allreduce = "mpi";
+	po.Register("sync-allreduce", &sync_allreduce, "allreduce of the bsp and bmuf workers(mpi | ring | hierarchical)");
+	DeltaCodecOptions codec_opts;
+	codec_opts.Register(&po);
+	int num_servers = 1;
+	po.Register("num-servers", &num_servers, "Number of server ranks of the easgd, asgd and masgd workers, the same as the servers");
 
 	po.Read(argc, argv);
 
@@ -125,13 +134,13 @@ int main(int argc, char *argv[]) {
 	// Init Worker
 	IWorker *worker = NULL;
 	if (worker_type == "bsp") {
-		worker = new BspWorker();
+		worker = new BspWorker(sync_bucket_size, sync_allreduce);
 	} else if (worker_type == "easgd") {
-		worker = new EasgdWorker(alpha);
+		worker = new EasgdWorker(alpha, codec_opts, num_servers);
 	} else if (worker_type == "bmuf") {
-		worker = new BmufWorker(bmuf_learn_rate, bmuf_momentum);
+		worker = new BmufWorker(bmuf_learn_rate, bmuf_momentum, sync_bucket_size, sync_allreduce);
     } else if (worker_type == "asgd" || worker_type == "masgd") {
-        worker = new AsgdWorker();
+        worker = new AsgdWorker(codec_opts, num_servers);
     } else if (worker_type == "sod") {
         worker = new SodWorker(optimizer_opts);
 	} else {
@@ -262,6 +271,10 @@ int main(int argc, char *argv[]) {
               << ", " << (randomize?"RANDOMIZED":"NOT-RANDOMIZED") 
               << ", " << time.Elapsed()/60 << " min, fps" << total_frames/time.Elapsed()
               << "]";  
+    KALDI_LOG << "Data reader stalled " << reader.StallTime()
+              << " s, the reading not hidden behind the training";
+    KALDI_LOG << "Padding efficiency " << reader.PaddingEfficiency()
+              << " (valid frames / computed frames)";
 	loss->Report();
 	if (loss != NULL) delete loss;
 	if (worker != NULL) delete worker;
@@ -17,6 +17,7 @@
 #include "aslp-parallel/itf.h"
 #include "aslp-parallel/easgd-server.h"
 #include "aslp-parallel/asgd-server.h"
+#include "aslp-parallel/masgd-server.h"
 
 
 int main(int argc, char *argv[]) {
@@ -39,7 +40,7 @@ int main(int argc, char *argv[]) {
         po.Register("use-gpu", &use_gpu, "yes|no|optional, only has effect if compiled with CUDA");
 
         std::string server_type = "easgd";
-        po.Register("server-type", &server_type, "Server type(easgd | asgd)");
+        po.Register("server-type", &server_type, "Server type(easgd | asgd | masgd)");
         float alpha = 0.5;
         po.Register("alpha", &alpha, "Moving rate alpha for easgd server");
         int sync_period = 1000;
@@ -48,6 +49,10 @@ int main(int argc, char *argv[]) {
         po.Register("gpu-id", &gpu_id, "selected gpu id, if negative then select automaticly");
         float masgd_momentum = 0.9;
         po.Register("masgd-momentum", &masgd_momentum, "momentum for masgd");
+        DeltaCodecOptions codec_opts;
+        codec_opts.Register(&po);
+        int num_servers = 1;
+        po.Register("num-servers", &num_servers, "Number of server ranks(the first ranks), the parameters are sharded over them");
         
         po.Read(argc, argv);
 
@@ -72,11 +77,11 @@ int main(int argc, char *argv[]) {
         // Init Server
         IServer *server = NULL;
         if (server_type == "easgd") {
-            server = new EasgdServer(alpha);
+            server = new EasgdServer(alpha, codec_opts, num_servers);
         } else if (server_type == "asgd") {
-            server = new AsgdServer(alpha, sync_period);
+            server = new AsgdServer(alpha, sync_period, codec_opts, num_servers);
         } else if (server_type == "masgd") {
-            server = new MasgdServer(sync_period, masgd_momentum);
+            server = new MasgdServer(sync_period, masgd_momentum, codec_opts, num_servers);
         }
         else {
             KALDI_ERR << "Unsupported server type: " << server_type;
@@ -96,7 +101,10 @@ int main(int argc, char *argv[]) {
         nnet.GetAccStats(&acc_params, &data_params);
         server->ReduceAccStat(acc_params, data_params);
 
-        nnet.Write(target_model_filename, binary);
+        // the main server has the whole model
+        if (server->IsMainNode()) {
+            nnet.Write(target_model_filename, binary);
+        }
         if (server != NULL) delete server;
 
 #if HAVE_CUDA==1
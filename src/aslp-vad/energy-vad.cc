@@ -2,7 +2,10 @@
  * Author: Binbin Zhang
  */
 
+#include <algorithm>
+
 #include "aslp-vad/energy-vad.h"
+#include "aslp-vad/frame-energy.h"
 
 namespace kaldi {
 
@@ -16,14 +19,11 @@ bool EnergyVad::IsSilence(int frame) const {
 }
 
 BaseFloat EnergyVad::FrameEnergy(const VectorBase<BaseFloat> &raw_wav, int32 frame) const {
-    BaseFloat energy = 0.0;
     int32 index = frame * num_points_per_frame_;
-    int i = 0;
-    for (i = 0; i < num_points_per_frame_ && index < raw_wav.Dim(); i++, index++) {
-        energy += raw_wav(index) * raw_wav(index);
-    }
-    KALDI_ASSERT(i > 0);
-    return energy / i;
+    // the last frame may be partial
+    int32 num = std::min(num_points_per_frame_, raw_wav.Dim() - index);
+    KALDI_ASSERT(num > 0);
+    return SumSquares(raw_wav.Data() + index, num) / num;
 }
 
 std::vector<BaseFloat> EnergyVad::GetScore(
@@ -37,10 +37,11 @@ std::vector<BaseFloat> EnergyVad::GetScore(
 }
 
 void EnergyVad::CalculateEnergy(const VectorBase<BaseFloat> &raw_wav) {
-    int32 num_points = raw_wav.Dim();
-    energy_vec_.resize(0);
-    for (int i = 0; i * num_points_per_frame_ < num_points; i++) {
-        energy_vec_.push_back(FrameEnergy(raw_wav, i));
+    int32 num_frames = (raw_wav.Dim() + num_points_per_frame_ - 1) /
+                       num_points_per_frame_;
+    energy_vec_.resize(num_frames);
+    for (int i = 0; i < num_frames; i++) {
+        energy_vec_[i] = FrameEnergy(raw_wav, i);
     }
 }
 
@@ -0,0 +1,115 @@
+/* Test of the frame energy and zero crossings against the plain loops, and
+ * the throughput of the energy vad front in samples per second of one core
+ */
+
+#include <stdio.h>
+
+#include "base/timer.h"
+#include "matrix/kaldi-vector.h"
+#include "aslp-vad/frame-energy.h"
+
+namespace kaldi {
+
+static void RandPcm(int32 n, std::vector<int16> *pcm) {
+    pcm->resize(n);
+    for (int32 i = 0; i < n; i++) {
+        // the extremes too, -32768^2 twice overflows a signed int32
+        if (RandInt(0, 9) == 0) (*pcm)[i] = RandInt(0, 1) ? 32767 : -32768;
+        else (*pcm)[i] = RandInt(-32768, 32767);
+        if (RandInt(0, 9) == 0) (*pcm)[i] = 0;
+    }
+}
+
+void TestPcm() {
+    for (int32 n = 0; n < 600; n += 1 + n / 8) {
+        std::vector<int16> pcm;
+        RandPcm(n + 1, &pcm);
+        const int16 *x = &pcm[0];
+        int64 sum = 0;
+        int32 num = 0;
+        for (int32 i = 0; i < n; i++) {
+            sum += int64(x[i]) * x[i];
+            if (i > 0 && (x[i] < 0) != (x[i - 1] < 0)) num++;
+        }
+        KALDI_ASSERT(PcmSumSquares(x, n) == sum);
+        KALDI_ASSERT(PcmZeroCrossings(x, n) == num);
+    }
+    // all -32768, and more crossings than a 16 bits count holds
+    int32 n = 1 << 20;
+    std::vector<int16> pcm(n, -32768);
+    KALDI_ASSERT(PcmSumSquares(&pcm[0], n) == int64(n) << 30);
+    for (int32 i = 0; i < n; i += 2) pcm[i] = 1;
+    KALDI_ASSERT(PcmZeroCrossings(&pcm[0], n) == n - 1);
+}
+
+void TestFloat() {
+    for (int32 n = 1; n < 600; n += 1 + n / 8) {
+        Vector<BaseFloat> x(n);
+        x.SetRandn();
+        x.Scale(1000.0);
+        double sum = 0.0;
+        for (int32 i = 0; i < n; i++) sum += x(i) * x(i);
+        KALDI_ASSERT(fabs(SumSquares(x.Data(), n) - sum) <= 1e-5 * sum);
+    }
+}
+
+void TestFrameEnergy() {
+    int32 frame_length = 160, num_frames = 7;
+    std::vector<int16> pcm;
+    RandPcm(frame_length * num_frames, &pcm);
+    std::vector<BaseFloat> energy(num_frames);
+    std::vector<int32> zero_crossings(num_frames);
+    PcmFrameEnergy(&pcm[0], frame_length, num_frames, &energy[0], &zero_crossings[0]);
+    for (int32 f = 0; f < num_frames; f++) {
+        const int16 *x = &pcm[f * frame_length];
+        // the loop of the online vad before
+        double e = 0.0;
+        for (int32 i = 0; i < frame_length; i++) {
+            e += BaseFloat(x[i]) * BaseFloat(x[i]) / frame_length;
+        }
+        KALDI_ASSERT(fabs(energy[f] - e) <= 1e-5 * e);
+        KALDI_ASSERT(zero_crossings[f] == PcmZeroCrossings(x, frame_length));
+    }
+}
+
+void BenchmarkFrameEnergy() {
+    // 10 minutes of 16k audio in 10 ms frames
+    int32 frame_length = 160, num_frames = 60000, n = frame_length * num_frames;
+    std::vector<int16> pcm;
+    RandPcm(n, &pcm);
+    std::vector<BaseFloat> wav(pcm.begin(), pcm.end()), energy(num_frames);
+    std::vector<int32> zero_crossings(num_frames);
+    Timer timer;
+    double check = 0.0;
+    for (int32 f = 0; f < num_frames; f++) {
+        double e = 0.0;
+        for (int32 i = f * frame_length; i < (f + 1) * frame_length; i++) {
+            e += wav[i] * wav[i] / frame_length;
+        }
+        check += e;
+    }
+    double ref_seconds = timer.Elapsed();
+    timer.Reset();
+    PcmFrameEnergy(&pcm[0], frame_length, num_frames, &energy[0], NULL);
+    double seconds = timer.Elapsed();
+    timer.Reset();
+    PcmFrameEnergy(&pcm[0], frame_length, num_frames, &energy[0], &zero_crossings[0]);
+    double zc_seconds = timer.Elapsed();
+    printf("%-28s %10.1f M samples/s\n", "float loop", n / ref_seconds / 1e6);
+    printf("%-28s %10.1f M samples/s\n", "pcm energy", n / seconds / 1e6);
+    printf("%-28s %10.1f M samples/s\n", "pcm energy, zero crossings",
+           n / zc_seconds / 1e6);
+    KALDI_ASSERT(check > 0.0);
+}
+
+} // namespace kaldi
+
+int main() {
+    using namespace kaldi;
+    TestPcm();
+    TestFloat();
+    TestFrameEnergy();
+    BenchmarkFrameEnergy();
+    std::cout << "Test OK.\n";
+    return 0;
+}
@@ -0,0 +1,148 @@
+/* Frame energy and zero crossings of the raw pcm, AVX2 16 samples at a time
+ */
+
+#include "base/kaldi-simd.h"
+#include "aslp-vad/frame-energy.h"
+
+namespace kaldi {
+
+static int64 ScalarPcmSumSquares(const int16 *x, int32 n) {
+    int64 sum = 0;
+    for (int32 i = 0; i < n; i++) sum += int32(x[i]) * x[i];
+    return sum;
+}
+
+static int32 ScalarPcmZeroCrossings(const int16 *x, int32 n) {
+    int32 num = 0;
+    for (int32 i = 1; i < n; i++) num += (x[i] ^ x[i - 1]) < 0;
+    return num;
+}
+
+static BaseFloat ScalarSumSquares(const BaseFloat *x, int32 n) {
+    BaseFloat sum = 0.0;
+    for (int32 i = 0; i < n; i++) sum += x[i] * x[i];
+    return sum;
+}
+
+#ifdef KALDI_HAVE_AVX2
+// The tails by the scalar loops. These run once per frame, the upper halves
+// are cleared before the scalar code, gcc does not do it below -O2
+
+KALDI_TARGET_AVX2
+static int64 Avx2PcmSumSquares(const int16 *x, int32 n) {
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i acc = zero;
+    int32 i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(x + i));
+        // up to 2 * 32768^2, unsigned 32 bits, added as 64 bits
+        __m256i sq = _mm256_madd_epi16(v, v);
+        acc = _mm256_add_epi64(acc, _mm256_unpacklo_epi32(sq, zero));
+        acc = _mm256_add_epi64(acc, _mm256_unpackhi_epi32(sq, zero));
+    }
+    int64 sum[4];
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(sum), acc);
+    _mm256_zeroupper();
+    return sum[0] + sum[1] + sum[2] + sum[3] + ScalarPcmSumSquares(x + i, n - i);
+}
+
+KALDI_TARGET_AVX2
+static int32 Avx2PcmZeroCrossings(const int16 *x, int32 n) {
+    const __m256i ones = _mm256_set1_epi16(1);
+    __m256i acc = _mm256_setzero_si256();
+    int32 i = 1;
+    while (i + 16 <= n) {
+        // 16 bits counts, widened before they can overflow
+        __m256i cnt = _mm256_setzero_si256();
+        for (int32 k = 0; k < 4096 && i + 16 <= n; k++, i += 16) {
+            __m256i cur = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(x + i));
+            __m256i prev = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(x + i - 1));
+            // -1 where the signs differ
+            cnt = _mm256_sub_epi16(cnt, _mm256_srai_epi16(_mm256_xor_si256(cur, prev), 15));
+        }
+        acc = _mm256_add_epi32(acc, _mm256_madd_epi16(cnt, ones));
+    }
+    int32 num[8];
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(num), acc);
+    _mm256_zeroupper();
+    int32 sum = 0;
+    for (int k = 0; k < 8; k++) sum += num[k];
+    return sum + ScalarPcmZeroCrossings(x + i - 1, n - i + 1);
+}
+
+KALDI_TARGET_AVX2
+static float Avx2SumSquares(const float *x, int32 n) {
+    __m256 acc0 = _mm256_setzero_ps(), acc1 = _mm256_setzero_ps();
+    int32 i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m256 a = _mm256_loadu_ps(x + i), b = _mm256_loadu_ps(x + i + 8);
+        acc0 = _mm256_fmadd_ps(a, a, acc0);
+        acc1 = _mm256_fmadd_ps(b, b, acc1);
+    }
+    if (i + 8 <= n) {
+        __m256 a = _mm256_loadu_ps(x + i);
+        acc0 = _mm256_fmadd_ps(a, a, acc0);
+        i += 8;
+    }
+    float sum[8];
+    _mm256_storeu_ps(sum, _mm256_add_ps(acc0, acc1));
+    _mm256_zeroupper();
+    return sum[0] + sum[1] + sum[2] + sum[3] + sum[4] + sum[5] + sum[6] + sum[7] +
+           ScalarSumSquares(x + i, n - i);
+}
+
+// the conversions of the energy are encoded as AVX too here, the plain SSE
+// ones after the AVX code are several times slower than the energy itself
+KALDI_TARGET_AVX2
+static void Avx2PcmFrameEnergy(const int16 *pcm, int32 frame_length, int32 num_frames,
+                               BaseFloat *energy, int32 *zero_crossings) {
+    for (int32 f = 0; f < num_frames; f++, pcm += frame_length) {
+        energy[f] = static_cast<double>(Avx2PcmSumSquares(pcm, frame_length)) / frame_length;
+        if (zero_crossings != NULL) {
+            zero_crossings[f] = Avx2PcmZeroCrossings(pcm, frame_length);
+        }
+    }
+}
+#endif
+
+int64 PcmSumSquares(const int16 *x, int32 n) {
+#ifdef KALDI_HAVE_AVX2
+    if (CpuHasAvx2()) return Avx2PcmSumSquares(x, n);
+#endif
+    return ScalarPcmSumSquares(x, n);
+}
+
+int32 PcmZeroCrossings(const int16 *x, int32 n) {
+#ifdef KALDI_HAVE_AVX2
+    if (CpuHasAvx2()) return Avx2PcmZeroCrossings(x, n);
+#endif
+    return ScalarPcmZeroCrossings(x, n);
+}
+
+BaseFloat SumSquares(const BaseFloat *x, int32 n) {
+#ifdef KALDI_HAVE_AVX2
+    if (sizeof(BaseFloat) == sizeof(float) && CpuHasAvx2()) {
+        return Avx2SumSquares(reinterpret_cast<const float *>(x), n);
+    }
+#endif
+    return ScalarSumSquares(x, n);
+}
+
+void PcmFrameEnergy(const int16 *pcm, int32 frame_length, int32 num_frames,
+                    BaseFloat *energy, int32 *zero_crossings) {
+    KALDI_ASSERT(frame_length > 0);
+#ifdef KALDI_HAVE_AVX2
+    if (CpuHasAvx2()) {
+        Avx2PcmFrameEnergy(pcm, frame_length, num_frames, energy, zero_crossings);
+        return;
+    }
+#endif
+    for (int32 f = 0; f < num_frames; f++, pcm += frame_length) {
+        energy[f] = static_cast<double>(PcmSumSquares(pcm, frame_length)) / frame_length;
+        if (zero_crossings != NULL) {
+            zero_crossings[f] = PcmZeroCrossings(pcm, frame_length);
+        }
+    }
+}
+
+} // namespace kaldi
@@ -0,0 +1,31 @@
+/* Frame energy and zero crossings of the raw pcm for the energy vads
+ * (aslp-online/vad.cc, energy-vad.cc), AVX2 with the scalar loops as the
+ * fallback
+ */
+
+#ifndef ASLP_VAD_FRAME_ENERGY_H_
+#define ASLP_VAD_FRAME_ENERGY_H_
+
+#include "base/kaldi-common.h"
+
+namespace kaldi {
+
+// Sum of the squares of the n samples, exact
+int64 PcmSumSquares(const int16 *x, int32 n);
+
+// Number of the sign changes between the neighbouring samples of the n,
+// 0 counts as positive
+int32 PcmZeroCrossings(const int16 *x, int32 n);
+
+// Sum of the squares of the n samples, in float, the AVX2 one adds them in
+// a different order, so it agrees with the plain loop within float rounding
+BaseFloat SumSquares(const BaseFloat *x, int32 n);
+
+// Mean energy of each of the num_frames frames of frame_length samples of
+// pcm, and its zero crossings if zero_crossings is not NULL
+void PcmFrameEnergy(const int16 *pcm, int32 frame_length, int32 num_frames,
+                    BaseFloat *energy, int32 *zero_crossings);
+
+} // namespace kaldi
+
+#endif
@@ -3,6 +3,7 @@
  */
 
 #include "aslp-vad/nnet-vad.h"
+#include "aslp-nnet/nnet-decodable.h"
 
 namespace kaldi {
 
@@ -13,20 +14,30 @@ bool NnetVad::IsSilence(int frame) const {
     else return false;
 }
 
-// TODO optimize the feedfroward option
 void NnetVad::GetScore(const Matrix<BaseFloat> &feat) {
-    KALDI_ASSERT(feat.NumCols() == nnet_.InputDim());
-    // Set nnet stream for recurrent component
-    std::vector<int> frame_num_utt;
-    frame_num_utt.push_back(feat.NumRows());
-    const_cast<Nnet &>(nnet_).SetSeqLengths(frame_num_utt);
-
-    CuMatrix<BaseFloat> cu_nnet_out;
-    Matrix<BaseFloat> nnet_out_host;
-    // Get likelyhood
-    const_cast<Nnet &>(nnet_).Feedforward(CuMatrix<BaseFloat>(feat), &cu_nnet_out);
-    cu_nnet_out.Swap(&nnet_out_host);
-    for (int i = 0; i < nnet_out_host.NumRows(); i++) 
+    KALDI_ASSERT(feat.NumCols() == nnet_->InputDim());
+    cu_feat_.Resize(feat.NumRows(), feat.NumCols(), kUndefined);
+    cu_feat_.CopyFromMat(feat);
+    if (forward_ != NULL) {
+        if (reset_forward_) forward_->ResetStream();
+        forward_->Feedforward(cu_feat_, &cu_nnet_out_);
+    } else {
+        // Set nnet stream for recurrent component
+        std::vector<int> frame_num_utt;
+        frame_num_utt.push_back(feat.NumRows());
+        const_cast<Nnet *>(nnet_)->SetSeqLengths(frame_num_utt);
+        // Get likelyhood
+        const_cast<Nnet *>(nnet_)->Feedforward(cu_feat_, &cu_nnet_out_);
+    }
+    // the host buffer only grows, the chunk is copied to its top rows
+    int32 num_rows = cu_nnet_out_.NumRows(), num_cols = cu_nnet_out_.NumCols();
+    if (nnet_out_host_.NumRows() < num_rows ||
+        nnet_out_host_.NumCols() != num_cols) {
+        nnet_out_host_.Resize(num_rows, num_cols, kUndefined);
+    }
+    SubMatrix<BaseFloat> nnet_out_host(nnet_out_host_, 0, num_rows, 0, num_cols);
+    cu_nnet_out_.CopyToMat(&nnet_out_host);
+    for (int i = 0; i < num_rows; i++) 
         sil_score_[i] = nnet_out_host(i, 0);
 }
 
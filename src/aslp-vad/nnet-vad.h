@@ -14,6 +14,10 @@
 
 namespace kaldi {
 
+namespace aslp_nnet {
+class NnetForwardInterface;
+}
+
 struct NnetVadOptions : public VadOptions {
     float sil_thresh; // 
     NnetVadOptions(): sil_thresh(0.5) {}
@@ -26,15 +30,34 @@ struct NnetVadOptions : public VadOptions {
 class NnetVad : public Vad {
 public:
     typedef aslp_nnet::Nnet Nnet;
-    NnetVad(const Nnet &nnet, const NnetVadOptions &nnet_vad_config): 
+    // Scored by forward if not NULL, see SetForward(), the nnet is then
+    // only read and may be shared with other threads
+    NnetVad(const Nnet &nnet, const NnetVadOptions &nnet_vad_config,
+            aslp_nnet::NnetForwardInterface *forward = NULL,
+            bool reset_forward = false): 
             Vad(nnet_vad_config),
-            nnet_(nnet), 
+            nnet_(&nnet), 
+            forward_(forward),
+            reset_forward_(reset_forward),
             nnet_vad_config_(nnet_vad_config) {
         // Reset lstm state for lstm model
-        std::vector<int> flags(1, 1);
-        const_cast<Nnet &>(nnet_).ResetLstmStreams(flags);
+        if (forward_ == NULL) {
+            std::vector<int> flags(1, 1);
+            const_cast<Nnet *>(nnet_)->ResetLstmStreams(flags);
+        }
     } 
 
+    // Score by forward from now on instead of the nnet, eg. a stream of a
+    // batch scheduler shared with the other sessions, not owned here. Its
+    // recurrent state goes on over the chunks, unless reset_forward, then it
+    // is reset for every chunk as the nnet state is, so it can be switched
+    // between chunks, eg. to the forward of the thread which runs the vad now
+    void SetForward(aslp_nnet::NnetForwardInterface *forward,
+                    bool reset_forward = false) {
+        forward_ = forward;
+        reset_forward_ = reset_forward;
+    }
+
     virtual bool IsSilence(int frame) const; 
     void GetScore(const Matrix<BaseFloat> &feat); 
     // DoVad input:wav, feat already prepared out:wav
@@ -55,8 +78,13 @@ public:
     }
 protected:
     std::vector<float> sil_score_;
-    const Nnet &nnet_;
+    const Nnet *nnet_;
+    aslp_nnet::NnetForwardInterface *forward_;
+    bool reset_forward_;
     const NnetVadOptions &nnet_vad_config_;
+    // reused by the chunks
+    CuMatrix<BaseFloat> cu_feat_, cu_nnet_out_;
+    Matrix<BaseFloat> nnet_out_host_;
 };
 
 } // namespace kaldi
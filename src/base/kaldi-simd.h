@@ -0,0 +1,46 @@
+// base/kaldi-simd.h
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//  http://www.apache.org/licenses/LICENSE-2.0
+
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+#ifndef KALDI_BASE_KALDI_SIMD_H_
+#define KALDI_BASE_KALDI_SIMD_H_
+
+// Runtime dispatch of the AVX2 code paths. The binaries are built for the
+// baseline x86-64, a function marked KALDI_TARGET_AVX2 is compiled with AVX2
+// and FMA and must only be called when CpuHasAvx2() is true.
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define KALDI_HAVE_AVX2 1
+#include <immintrin.h>
+#endif
+
+#ifdef KALDI_HAVE_AVX2
+#define KALDI_TARGET_AVX2 __attribute__((target("avx2,fma")))
+// the helpers must be inlined even with -O1, passing __m256 around in
+// function calls is several times slower than the scalar code
+#define KALDI_INLINE_AVX2 __attribute__((target("avx2,fma"), always_inline))
+
+namespace kaldi {
+
+static inline bool CpuHasAvx2() {
+  static bool has_avx2 = __builtin_cpu_supports("avx2") &&
+                         __builtin_cpu_supports("fma");
+  return has_avx2;
+}
+
+}  // namespace kaldi
+#endif
+
+#endif  // KALDI_BASE_KALDI_SIMD_H_
@@ -29,6 +29,7 @@
 
 #include "util/stl-utils.h"
 #include "util/hash-list.h"
+#include "util/memory-pool.h"
 #include "fst/fstlib.h"
 #include "itf/decodable-itf.h"
 #include "fstext/fstext-lib.h"
@@ -47,6 +48,7 @@ struct LatticeFasterDecoderConfig {
                             // command-line program.
   BaseFloat beam_delta; // has nothing to do with beam_ratio
   BaseFloat hash_ratio;
+  bool token_pool;  // only used when the decoder is constructed
   BaseFloat prune_scale;   // Note: we don't make this configurable on the command line,
                            // it's not a very important parameter.  It affects the
                            // algorithm that prunes the tokens as we go.
@@ -63,6 +65,7 @@ struct LatticeFasterDecoderConfig {
                                 determinize_lattice(true),
                                 beam_delta(0.5),
                                 hash_ratio(2.0),
+                                token_pool(true),
                                 prune_scale(0.1) { }
   void Register(OptionsItf *opts) {
     det_opts.Register(opts);
@@ -80,6 +83,10 @@ struct LatticeFasterDecoderConfig {
                    "max-active constraint is applied.  Larger is more accurate.");
     opts->Register("hash-ratio", &hash_ratio, "Setting used in decoder to control"
                    " hash behavior");
+    opts->Register("token-pool", &token_pool, "If true, the decoder allocates "
+                   "its tokens and forward links from its own memory pool "
+                   "instead of new/delete (faster, esp. with many decoding "
+                   "threads)");
   }
   void Check() const {
     KALDI_ASSERT(beam > 0.0 && max_active > 1 && lattice_beam > 0.0
@@ -204,6 +211,11 @@ class LatticeFasterDecoder {
   // whenever we call ProcessEmitting().
   inline int32 NumFramesDecoded() const { return active_toks_.size() - 1; }
 
+  /// Allocation stats of the tokens and the forward links since the decoder
+  /// was made, see config option --token-pool.
+  const MemoryPoolStats &TokenPoolStats() const { return token_pool_.Stats(); }
+  const MemoryPoolStats &LinkPoolStats() const { return link_pool_.Stats(); }
+
  private:
   // ForwardLinks are the links from a token to a token on the next frame.
   // or sometimes on the current frame (for input-epsilon links).
@@ -244,15 +256,6 @@ class LatticeFasterDecoder {
     inline Token(BaseFloat tot_cost, BaseFloat extra_cost, ForwardLink *links,
                  Token *next):
         tot_cost(tot_cost), extra_cost(extra_cost), links(links), next(next) { }
-    inline void DeleteForwardLinks() {
-      ForwardLink *l = links, *m;
-      while (l != NULL) {
-        m = l->next;
-        delete l;
-        l = m;
-      }
-      links = NULL;
-    }
   };
 
   // head of per-frame list of Tokens (list is in topological order),
@@ -267,6 +270,17 @@ class LatticeFasterDecoder {
 
   typedef HashList<StateId, Token*>::Elem Elem;
 
+  // Gives the forward links of tok back to link_pool_.
+  inline void DeleteForwardLinks(Token *tok) {
+    ForwardLink *l = tok->links, *m;
+    while (l != NULL) {
+      m = l->next;
+      link_pool_.Free(l);
+      l = m;
+    }
+    tok->links = NULL;
+  }
+
   void PossiblyResizeHash(size_t num_toks);
 
   // FindOrAddToken either locates a token in hash of toks_, or if necessary
@@ -369,6 +383,10 @@ class LatticeFasterDecoder {
   // frame in order to keep everything in a nice dynamic range.
   LatticeFasterDecoderConfig config_;
   int32 num_toks_; // current total #toks allocated...
+  // The tokens and links are allocated from these, which are per decoder and
+  // recycle their memory, instead of the global new/delete.
+  MemoryPool<Token> token_pool_;
+  MemoryPool<ForwardLink> link_pool_;
   bool warned_;
 
   /// decoding_finalized_ is true if someone called FinalizeDecoding().  [note,
@@ -28,6 +28,7 @@
 
 #include "util/stl-utils.h"
 #include "util/hash-list.h"
+#include "util/memory-pool.h"
 #include "fst/fstlib.h"
 #include "itf/decodable-itf.h"
 #include "fstext/fstext-lib.h"
@@ -193,6 +194,11 @@ class LatticeFasterOnlineDecoder {
   // whenever we call ProcessEmitting().
   inline int32 NumFramesDecoded() const { return active_toks_.size() - 1; }
 
+  /// Allocation stats of the tokens and the forward links since the decoder
+  /// was made, see config option --token-pool.
+  const MemoryPoolStats &TokenPoolStats() const { return token_pool_.Stats(); }
+  const MemoryPoolStats &LinkPoolStats() const { return link_pool_.Stats(); }
+
  private:
   // ForwardLinks are the links from a token to a token on the next frame.
   // or sometimes on the current frame (for input-epsilon links).
@@ -240,15 +246,6 @@ class LatticeFasterOnlineDecoder {
                  Token *next, Token *backpointer):
         tot_cost(tot_cost), extra_cost(extra_cost), links(links), next(next),
         backpointer(backpointer) { }
-    inline void DeleteForwardLinks() {
-      ForwardLink *l = links, *m;
-      while (l != NULL) {
-        m = l->next;
-        delete l;
-        l = m;
-      }
-      links = NULL;
-    }
   };
 
   // head of per-frame list of Tokens (list is in topological order),
@@ -263,6 +260,17 @@ class LatticeFasterOnlineDecoder {
 
   typedef HashList<StateId, Token*>::Elem Elem;
 
+  // Gives the forward links of tok back to link_pool_.
+  inline void DeleteForwardLinks(Token *tok) {
+    ForwardLink *l = tok->links, *m;
+    while (l != NULL) {
+      m = l->next;
+      link_pool_.Free(l);
+      l = m;
+    }
+    tok->links = NULL;
+  }
+
   void PossiblyResizeHash(size_t num_toks);
 
   // FindOrAddToken either locates a token in hash of toks_, or if necessary
@@ -366,6 +374,10 @@ class LatticeFasterOnlineDecoder {
   // frame in order to keep everything in a nice dynamic range.
   LatticeFasterDecoderConfig config_;
   int32 num_toks_; // current total #toks allocated...
+  // The tokens and links are allocated from these, which are per decoder and
+  // recycle their memory, instead of the global new/delete.
+  MemoryPool<Token> token_pool_;
+  MemoryPool<ForwardLink> link_pool_;
   bool warned_;
 
   /// decoding_finalized_ is true if someone called FinalizeDecoding().  [note,
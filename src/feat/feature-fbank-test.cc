@@ -24,6 +24,7 @@
 #include "base/kaldi-math.h"
 #include "matrix/kaldi-matrix-inl.h"
 #include "feat/wave-reader.h"
+#include "base/timer.h"
 
 using namespace kaldi;
 
@@ -442,6 +443,151 @@ static void UnitTestHTKCompare4() {
 
 
 
+// The frame by frame fbank, as Fbank computed it before the batched
+// MelBatchComputer, for the comparisons below.
+static void ReferenceFbank(const FbankOptions &opts,
+                           const VectorBase<BaseFloat> &wave,
+                           Matrix<BaseFloat> *output) {
+  MelBanks mel_banks(opts.mel_opts, opts.frame_opts, 1.0);
+  FeatureWindowFunction window_function(opts.frame_opts);
+  int32 padded_window_size = opts.frame_opts.PaddedWindowSize();
+  SplitRadixRealFft<BaseFloat> *srfft = NULL;
+  if ((padded_window_size & (padded_window_size-1)) == 0)
+    srfft = new SplitRadixRealFft<BaseFloat>(padded_window_size);
+  int32 rows_out = NumFrames(wave.Dim(), opts.frame_opts),
+      num_bins = opts.mel_opts.num_bins;
+  output->Resize(rows_out, num_bins + opts.use_energy);
+  Vector<BaseFloat> window, mel_energies;
+  std::vector<BaseFloat> temp_buffer;
+  for (int32 r = 0; r < rows_out; r++) {
+    BaseFloat log_energy;
+    ExtractWindow(wave, r, opts.frame_opts, window_function, &window,
+                  (opts.use_energy && opts.raw_energy ? &log_energy : NULL));
+    if (opts.use_energy && !opts.raw_energy)
+      log_energy = Log(std::max(VecVec(window, window),
+                                std::numeric_limits<BaseFloat>::min()));
+    if (srfft != NULL)
+      srfft->Compute(window.Data(), true, &temp_buffer);
+    else
+      RealFft(&window, true);
+    ComputePowerSpectrum(&window);
+    SubVector<BaseFloat> power_spectrum(window, 0, window.Dim()/2 + 1);
+    mel_banks.Compute(power_spectrum, &mel_energies);
+    if (opts.use_log_fbank) {
+      mel_energies.ApplyFloor(std::numeric_limits<BaseFloat>::min());
+      mel_energies.ApplyLog();
+    }
+    SubVector<BaseFloat> this_output(output->Row(r));
+    this_output.Range(opts.use_energy ? 1 : 0, num_bins).CopyFromVec(
+        mel_energies);
+    if (opts.use_energy) {
+      if (opts.energy_floor > 0.0 && log_energy < Log(opts.energy_floor))
+        log_energy = Log(opts.energy_floor);
+      this_output(0) = log_energy;
+    }
+    if (opts.htk_compat && opts.use_energy) {
+      BaseFloat energy = this_output(0);
+      for (int32 i = 0; i < num_bins; i++)
+        this_output(i) = this_output(i+1);
+      this_output(num_bins) = energy;
+    }
+  }
+  delete srfft;
+}
+
+static void RandomFbankOptions(FbankOptions *op) {
+  const char *windows[] = { "hamming", "hanning", "povey", "rectangular" };
+  op->frame_opts.dither = 0.0;
+  op->frame_opts.window_type = windows[Rand() % 4];
+  op->frame_opts.preemph_coeff = (Rand() % 2 ? 0.97 : 0.0);
+  op->frame_opts.remove_dc_offset = (Rand() % 2 == 0);
+  op->frame_opts.snip_edges = (Rand() % 2 == 0);
+  // 400 samples pad to 512, or to 400 for the non-power-of-two FFT.
+  op->frame_opts.round_to_power_of_two = (Rand() % 3 != 0);
+  if (Rand() % 3 == 0)
+    op->frame_opts.frame_length_ms = 32.0;
+  op->mel_opts.num_bins = 20 + Rand() % 21;
+  op->mel_opts.htk_mode = (Rand() % 2 == 0);
+  op->use_energy = (Rand() % 2 == 0);
+  op->raw_energy = (Rand() % 2 == 0);
+  op->htk_compat = (Rand() % 2 == 0);
+  op->use_log_fbank = (Rand() % 4 != 0);
+  op->energy_floor = (Rand() % 2 ? 1.0 : 0.0);
+}
+
+static void UnitTestBatchCompare() {
+  std::cout << "=== UnitTestBatchCompare() ===\n";
+  std::ifstream is("test_data/test.wav", std::ios_base::binary);
+  WaveData wave;
+  wave.Read(is);
+  SubVector<BaseFloat> waveform(wave.Data(), 0);
+
+  for (int32 i = 0; i < 10; i++) {
+    FbankOptions op;
+    RandomFbankOptions(&op);
+    // A random length, so the last block and the last FFT lanes are partial.
+    int32 length = RandInt(0, waveform.Dim());
+    SubVector<BaseFloat> wave_part(waveform, 0, length);
+
+    Matrix<BaseFloat> ref_features, features;
+    ReferenceFbank(op, wave_part, &ref_features);
+    Fbank fbank(op);
+    fbank.Compute(wave_part, 1.0, &features, NULL);
+    KALDI_ASSERT(features.NumRows() == ref_features.NumRows());
+    if (features.NumRows() == 0) continue;
+    KALDI_ASSERT(features.NumCols() == ref_features.NumCols());
+    for (int32 r = 0; r < features.NumRows(); r++) {
+      for (int32 c = 0; c < features.NumCols(); c++) {
+        BaseFloat a = features(r, c), b = ref_features(r, c);
+        // 1.0e-03 of the log, or relative of the plain energies, the weak
+        // bins of a frame carry the float rounding of its strong ones.
+        BaseFloat tolerance = (op.use_log_fbank || (op.use_energy &&
+            c == (op.htk_compat ? features.NumCols() - 1 : 0)) ?
+            1.0e-03 : 1.0e-03 * std::abs(b) + 1.0e-03);
+        if (std::abs(a - b) > tolerance)
+          KALDI_ERR << "Batched fbank differs at [" << r << ", " << c
+                    << "]: " << a << " vs. " << b;
+      }
+    }
+    // The non-const Compute() reuses its buffers, the results do not change.
+    Matrix<BaseFloat> features2;
+    fbank.Compute(wave_part, 1.0, &features2, NULL);
+    AssertEqual(features, features2);
+  }
+  std::cout << "Test passed :)\n\n";
+}
+
+// Prints the frames per second of the frame by frame fbank and of the
+// batched one, of one core.
+static void BenchmarkFbank() {
+  std::cout << "=== BenchmarkFbank() ===\n";
+  std::ifstream is("test_data/test.wav", std::ios_base::binary);
+  WaveData wave;
+  wave.Read(is);
+  SubVector<BaseFloat> waveform(wave.Data(), 0);
+  for (int32 dither = 0; dither <= 1; dither++) {
+    FbankOptions op;
+    op.frame_opts.dither = dither;
+    Fbank fbank(op);
+    Matrix<BaseFloat> features;
+    int32 num_frames = 0, num_repeats = 20;
+    Timer timer;
+    for (int32 i = 0; i < num_repeats; i++) {
+      ReferenceFbank(op, waveform, &features);
+      num_frames += features.NumRows();
+    }
+    double ref_seconds = timer.Elapsed();
+    timer.Reset();
+    for (int32 i = 0; i < num_repeats; i++)
+      fbank.Compute(waveform, 1.0, &features, NULL);
+    double seconds = timer.Elapsed();
+    std::cout << "dither " << dither << ": frame by frame "
+              << num_frames / ref_seconds << " frames/s, batched "
+              << num_frames / seconds << " frames/s\n";
+  }
+  std::cout << "\n";
+}
+
 
 static void UnitTestFeat() {
   UnitTestReadWave();
@@ -450,6 +596,7 @@ static void UnitTestFeat() {
   UnitTestHTKCompare2();
   UnitTestHTKCompare3();
   UnitTestHTKCompare4();
+  UnitTestBatchCompare();
 }
 
 
@@ -459,6 +606,7 @@ int main() {
   try {
     for (int i = 0; i < 5; i++)
       UnitTestFeat();
+    BenchmarkFbank();
     std::cout << "Tests succeeded.\n";
     return 0;
   } catch (const std::exception &e) {
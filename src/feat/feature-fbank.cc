@@ -24,14 +24,10 @@
 namespace kaldi {
 
 Fbank::Fbank(const FbankOptions &opts)
-    : opts_(opts), feature_window_function_(opts.frame_opts), srfft_(NULL) {
+    : opts_(opts), mel_computer_(opts.frame_opts) {
   if (opts.energy_floor > 0.0)
     log_energy_floor_ = Log(opts.energy_floor);
 
-  int32 padded_window_size = opts.frame_opts.PaddedWindowSize();
-  if ((padded_window_size & (padded_window_size-1)) == 0)  // Is a power of two...
-    srfft_ = new SplitRadixRealFft<BaseFloat>(padded_window_size);
-
   // We'll definitely need the filterbanks info for VTLN warping factor 1.0.
   // [note: this call caches it.]  The reason we call this here is to
   // improve the efficiency of the "const" version of Compute().
@@ -43,7 +39,6 @@ Fbank::~Fbank() {
       iter != mel_banks_.end();
       ++iter)
     delete iter->second;
-    delete srfft_;
 }
 
 const MelBanks *Fbank::GetMelBanks(BaseFloat vtln_warp) {
@@ -82,7 +77,7 @@ void Fbank::Compute(const VectorBase<BaseFloat> &wave,
                     Matrix<BaseFloat> *output,
                     Vector<BaseFloat> *wave_remainder) {
   const MelBanks *this_mel_banks = GetMelBanks(vtln_warp);
-  ComputeInternal(wave, *this_mel_banks, output, wave_remainder);  
+  ComputeInternal(wave, *this_mel_banks, &buffers_, output, wave_remainder);
 }
 
 void Fbank::Compute(const VectorBase<BaseFloat> &wave,
@@ -92,8 +87,8 @@ void Fbank::Compute(const VectorBase<BaseFloat> &wave,
   bool must_delete_mel_banks;
   const MelBanks *mel_banks = GetMelBanks(vtln_warp,
                                           &must_delete_mel_banks);
-  
-  ComputeInternal(wave, *mel_banks, output, wave_remainder);
+  MelBatchBuffers buffers;
+  ComputeInternal(wave, *mel_banks, &buffers, output, wave_remainder);
   
   if (must_delete_mel_banks)
     delete mel_banks;
@@ -102,6 +97,7 @@ void Fbank::Compute(const VectorBase<BaseFloat> &wave,
 
 void Fbank::ComputeInternal(const VectorBase<BaseFloat> &wave,
                             const MelBanks &mel_banks,
+                            MelBatchBuffers *buffers,
                             Matrix<BaseFloat> *output,
                             Vector<BaseFloat> *wave_remainder) const {
   KALDI_ASSERT(output != NULL);
@@ -122,62 +118,38 @@ void Fbank::ComputeInternal(const VectorBase<BaseFloat> &wave,
   if (wave_remainder != NULL)
     ExtractWaveformRemainder(wave, opts_.frame_opts, wave_remainder);
 
-  // Buffers
-  Vector<BaseFloat> window;  // windowed waveform.
-  Vector<BaseFloat> mel_energies;
-  std::vector<BaseFloat> temp_buffer;  // used by srfft.  
-  BaseFloat log_energy;
+  // Filterbanks of all the frames, in batches
+  int32 num_bins = opts_.mel_opts.num_bins;
+  SubMatrix<BaseFloat> fbank(*output, 0, rows_out,
+                             (opts_.use_energy ? 1 : 0), num_bins);
+  Vector<BaseFloat> &log_energy = buffers->log_energy;
+  if (log_energy.Dim() < rows_out)
+    log_energy.Resize(rows_out, kUndefined);
+  SubVector<BaseFloat> this_log_energy(log_energy, 0, rows_out);
+  mel_computer_.Compute(wave, 0, mel_banks, opts_.raw_energy, buffers, &fbank,
+                        (opts_.use_energy ? &this_log_energy : NULL));
+  if (opts_.use_log_fbank) {
+    // avoid log of zero (which should be prevented anyway by dithering).
+    fbank.ApplyFloor(std::numeric_limits<BaseFloat>::min());
+    fbank.ApplyLog();  // take the log.
+  }
+  if (!opts_.use_energy) return;
 
-  // Compute all the freames, r is frame index..
   for (int32 r = 0; r < rows_out; r++) {
-    // Cut the window, apply window function
-    ExtractWindow(wave, r, opts_.frame_opts, feature_window_function_, &window,
-                  (opts_.use_energy && opts_.raw_energy ? &log_energy : NULL));
-
-    // Compute energy after window function (not the raw one)
-    if (opts_.use_energy && !opts_.raw_energy)
-      log_energy = Log(std::max(VecVec(window, window),
-                                std::numeric_limits<BaseFloat>::min()));
-
-    if (srfft_ != NULL)  // Compute FFT using split-radix algorithm.
-      srfft_->Compute(window.Data(), true, &temp_buffer);
-    else  // An alternative algorithm that works for non-powers-of-two.
-      RealFft(&window, true);
-
-    // Convert the FFT into a power spectrum.
-    ComputePowerSpectrum(&window);
-    SubVector<BaseFloat> power_spectrum(window, 0, window.Dim()/2 + 1);
-
-    // Sum with MelFiterbank over power spectrum
-    mel_banks.Compute(power_spectrum, &mel_energies);
-    if (opts_.use_log_fbank) {
-      // avoid log of zero (which should be prevented anyway by dithering).
-      mel_energies.ApplyFloor(std::numeric_limits<BaseFloat>::min());
-      mel_energies.ApplyLog();  // take the log.
-    }
-
-    // Output buffers
     SubVector<BaseFloat> this_output(output->Row(r));
-    SubVector<BaseFloat> this_fbank(this_output.Range((opts_.use_energy? 1 : 0),
-                                                      opts_.mel_opts.num_bins));
-
-    // Copy to output
-    this_fbank.CopyFromVec(mel_energies);
-    // Copy energy as first value
-    if (opts_.use_energy) {
-      if (opts_.energy_floor > 0.0 && log_energy < log_energy_floor_) {
-        log_energy = log_energy_floor_;
-      }
-      this_output(0) = log_energy;
+    BaseFloat energy = this_log_energy(r);
+    if (opts_.energy_floor > 0.0 && energy < log_energy_floor_) {
+      energy = log_energy_floor_;
     }
-
     // HTK compat: Shift features, so energy is last value
-    if (opts_.htk_compat && opts_.use_energy) {
-      BaseFloat energy = this_output(0);
-      for (int32 i = 0; i < opts_.mel_opts.num_bins; i++) {
+    if (opts_.htk_compat) {
+      for (int32 i = 0; i < num_bins; i++) {
         this_output(i) = this_output(i+1);
       }
-      this_output(opts_.mel_opts.num_bins) = energy;
+      this_output(num_bins) = energy;
+    } else {
+      // Copy energy as first value
+      this_output(0) = energy;
     }
   }
 }
@@ -24,6 +24,7 @@
 #include <string>
 
 #include "feat/feature-functions.h"
+#include "feat/mel-batch.h"
 
 namespace kaldi {
 /// @addtogroup  feat FeatureExtraction
@@ -102,6 +103,7 @@ class Fbank {
  private:
   void ComputeInternal(const VectorBase<BaseFloat> &wave,
                        const MelBanks &mel_banks,
+                       MelBatchBuffers *buffers,
                        Matrix<BaseFloat> *output,
                        Vector<BaseFloat> *wave_remainder = NULL) const;
 
@@ -113,8 +115,8 @@ class Fbank {
   FbankOptions opts_;
   BaseFloat log_energy_floor_;
   std::map<BaseFloat, MelBanks*> mel_banks_;  // BaseFloat is VTLN coefficient.
-  FeatureWindowFunction feature_window_function_;
-  SplitRadixRealFft<BaseFloat> *srfft_;
+  MelBatchComputer mel_computer_;
+  MelBatchBuffers buffers_;  // of the non-const Compute().
   KALDI_DISALLOW_COPY_AND_ASSIGN(Fbank);
 };
 
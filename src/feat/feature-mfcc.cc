@@ -24,7 +24,7 @@
 namespace kaldi {
 
 Mfcc::Mfcc(const MfccOptions &opts)
-    : opts_(opts), feature_window_function_(opts.frame_opts), srfft_(NULL) {
+    : opts_(opts), mel_computer_(opts.frame_opts) {
   int32 num_bins = opts.mel_opts.num_bins;
   Matrix<BaseFloat> dct_matrix(num_bins, num_bins);
   ComputeDctMatrix(&dct_matrix);
@@ -41,10 +41,6 @@ Mfcc::Mfcc(const MfccOptions &opts)
   if (opts.energy_floor > 0.0)
     log_energy_floor_ = Log(opts.energy_floor);
 
-  int32 padded_window_size = opts.frame_opts.PaddedWindowSize();
-  if ((padded_window_size & (padded_window_size-1)) == 0)  // Is a power of two...
-    srfft_ = new SplitRadixRealFft<BaseFloat>(padded_window_size);
-  
   // We'll definitely need the filterbanks info for VTLN warping factor 1.0.
   // [note: this call caches it.]  The reason we call this here is to
   // improve the efficiency of the "const" version of Compute().
@@ -56,7 +52,6 @@ Mfcc::~Mfcc() {
       iter != mel_banks_.end();
       ++iter)
     delete iter->second;
-  delete srfft_;
 }
 
 const MelBanks *Mfcc::GetMelBanks(BaseFloat vtln_warp) {
@@ -96,7 +91,7 @@ void Mfcc::Compute(const VectorBase<BaseFloat> &wave,
                    Matrix<BaseFloat> *output,
                    Vector<BaseFloat> *wave_remainder) {
   const MelBanks *this_mel_banks = GetMelBanks(vtln_warp);
-  ComputeInternal(wave, *this_mel_banks, output, wave_remainder);  
+  ComputeInternal(wave, *this_mel_banks, &buffers_, output, wave_remainder);
 }
 
 void Mfcc::Compute(const VectorBase<BaseFloat> &wave,
@@ -106,8 +101,8 @@ void Mfcc::Compute(const VectorBase<BaseFloat> &wave,
   bool must_delete_mel_banks;
   const MelBanks *mel_banks = GetMelBanks(vtln_warp,
                                                &must_delete_mel_banks);
-  
-  ComputeInternal(wave, *mel_banks, output, wave_remainder);
+  MelBatchBuffers buffers;
+  ComputeInternal(wave, *mel_banks, &buffers, output, wave_remainder);
   
   if (must_delete_mel_banks)
     delete mel_banks;
@@ -115,6 +110,7 @@ void Mfcc::Compute(const VectorBase<BaseFloat> &wave,
 
 void Mfcc::ComputeInternal(const VectorBase<BaseFloat> &wave,
                            const MelBanks &mel_banks,
+                           MelBatchBuffers *buffers,
                            Matrix<BaseFloat> *output,
                            Vector<BaseFloat> *wave_remainder) const {
   KALDI_ASSERT(output != NULL);
@@ -129,42 +125,35 @@ void Mfcc::ComputeInternal(const VectorBase<BaseFloat> &wave,
   output->Resize(rows_out, cols_out);
   if (wave_remainder != NULL)
     ExtractWaveformRemainder(wave, opts_.frame_opts, wave_remainder);
-  Vector<BaseFloat> window;  // windowed waveform.
-  Vector<BaseFloat> mel_energies;
-  std::vector<BaseFloat> temp_buffer;  // used by srfft.
-  for (int32 r = 0; r < rows_out; r++) {  // r is frame index..
-    BaseFloat log_energy;
-    ExtractWindow(wave, r, opts_.frame_opts, feature_window_function_, &window,
-                  (opts_.use_energy && opts_.raw_energy ? &log_energy : NULL));
-
-    if (opts_.use_energy && !opts_.raw_energy)
-      log_energy = Log(std::max(VecVec(window, window),
-                                std::numeric_limits<BaseFloat>::min()));
-
-    if (srfft_ != NULL)  // Compute FFT using the split-radix algorithm.
-      srfft_->Compute(window.Data(), true, &temp_buffer);
-    else  // An alternative algorithm that works for non-powers-of-two.
-      RealFft(&window, true);
-
-    // Convert the FFT into a power spectrum.
-    ComputePowerSpectrum(&window);
-    SubVector<BaseFloat> power_spectrum(window, 0, window.Dim()/2 + 1);
-
-    mel_banks.Compute(power_spectrum, &mel_energies);
-
-    // avoid log of zero (which should be prevented anyway by dithering).
-    mel_energies.ApplyFloor(std::numeric_limits<BaseFloat>::min());
-    mel_energies.ApplyLog();  // take the log.
+  // Mel energies of all the frames, in batches
+  int32 num_bins = opts_.mel_opts.num_bins;
+  Matrix<BaseFloat> &mel_buffer = buffers->mel_energies;
+  if (mel_buffer.NumRows() < rows_out || mel_buffer.NumCols() != num_bins)
+    mel_buffer.Resize(rows_out, num_bins, kUndefined);
+  SubMatrix<BaseFloat> mel_energies(mel_buffer, 0, rows_out, 0, num_bins);
+  Vector<BaseFloat> &log_energy = buffers->log_energy;
+  if (log_energy.Dim() < rows_out)
+    log_energy.Resize(rows_out, kUndefined);
+  SubVector<BaseFloat> this_log_energy(log_energy, 0, rows_out);
+  mel_computer_.Compute(wave, 0, mel_banks, opts_.raw_energy, buffers,
+                        &mel_energies,
+                        (opts_.use_energy ? &this_log_energy : NULL));
+
+  // avoid log of zero (which should be prevented anyway by dithering).
+  mel_energies.ApplyFloor(std::numeric_limits<BaseFloat>::min());
+  mel_energies.ApplyLog();  // take the log.
+
+  // mfcc = mel_energies [which now have log] * dct_matrix_^T
+  output->AddMatMat(1.0, mel_energies, kNoTrans, dct_matrix_, kTrans, 0.0);
 
+  for (int32 r = 0; r < rows_out; r++) {  // r is frame index..
     SubVector<BaseFloat> this_mfcc(output->Row(r));
 
-    // this_mfcc = dct_matrix_ * mel_energies [which now have log]
-    this_mfcc.AddMatVec(1.0, dct_matrix_, kNoTrans, mel_energies, 0.0);
-
     if (opts_.cepstral_lifter != 0.0)
       this_mfcc.MulElements(lifter_coeffs_);
 
     if (opts_.use_energy) {
+      BaseFloat log_energy = this_log_energy(r);
       if (opts_.energy_floor > 0.0 && log_energy < log_energy_floor_)
         log_energy = log_energy_floor_;
       this_mfcc(0) = log_energy;
@@ -183,9 +172,4 @@ void Mfcc::ComputeInternal(const VectorBase<BaseFloat> &wave,
   }
 }
 
-
-
-
-
-
 }  // namespace kaldi
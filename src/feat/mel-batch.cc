@@ -0,0 +1,291 @@
+// feat/mel-batch.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+
+#include "feat/mel-batch.h"
+#include "base/kaldi-simd.h"
+
+namespace kaldi {
+
+// out[i] = (x[i] - coeff * x[i-1]) * w[i], the pre-emphasis as Preemphasize()
+// and the window function in one pass.
+static void PreemphasizeAndWindow(const BaseFloat *x, const BaseFloat *w,
+                                  BaseFloat coeff, int32 n, BaseFloat *out) {
+  out[0] = (x[0] - coeff * x[0]) * w[0];
+  for (int32 i = 1; i < n; i++)
+    out[i] = (x[i] - coeff * x[i - 1]) * w[i];
+}
+
+#ifdef KALDI_HAVE_AVX2
+KALDI_TARGET_AVX2
+static void Avx2PreemphasizeAndWindow(const float *x, const float *w,
+                                      float coeff, int32 n, float *out) {
+  const __m256 c = _mm256_set1_ps(coeff);
+  out[0] = (x[0] - coeff * x[0]) * w[0];
+  int32 i = 1;
+  for (; i + 8 <= n; i += 8) {
+    __m256 cur = _mm256_loadu_ps(x + i), prev = _mm256_loadu_ps(x + i - 1);
+    _mm256_storeu_ps(out + i, _mm256_mul_ps(_mm256_sub_ps(cur, _mm256_mul_ps(c, prev)),
+                                            _mm256_loadu_ps(w + i)));
+  }
+  _mm256_zeroupper();
+  for (; i < n; i++)
+    out[i] = (x[i] - coeff * x[i - 1]) * w[i];
+}
+
+// The power spectra of num_lanes <= 8 windows of n points.  The n / 2 complex
+// points z[k] = x[2k] + i x[2k+1] of the windows are transformed together, one
+// window in each lane, by radix-2 butterflies; the real FFT is split from
+// them as in SplitRadixRealFft.  z[k] of lane l is at fft[16 * k + l] and its
+// imaginary part at fft[16 * k + 8 + l].
+KALDI_TARGET_AVX2
+static void Avx2PowerSpectra(const float *windows, int32 stride,
+                             int32 num_lanes, int32 n,
+                             const int32 *bit_reverse,
+                             const float *cos_tab, const float *sin_tab,
+                             float *fft, float *power, int32 power_stride) {
+  int32 m = n / 2;
+  // in the bit reversed order, the output is in the natural one
+  for (int32 l = 0; l < 8; l++) {
+    if (l < num_lanes) {
+      const float *x = windows + l * stride;
+      for (int32 k = 0; k < m; k++) {
+        float *z = fft + 16 * bit_reverse[k] + l;
+        z[0] = x[2 * k];
+        z[8] = x[2 * k + 1];
+      }
+    } else {
+      for (int32 k = 0; k < m; k++)
+        fft[16 * k + l] = fft[16 * k + 8 + l] = 0.0f;
+    }
+  }
+  for (int32 h = 1; h < m; h *= 2) {
+    int32 step = n / (2 * h);  // exp(-2 pi i j / 2h) is cos_tab[j * step].
+    for (int32 j = 0; j < h; j++) {
+      __m256 wr = _mm256_set1_ps(cos_tab[j * step]),
+          wi = _mm256_set1_ps(sin_tab[j * step]);
+      for (int32 s = j; s < m; s += 2 * h) {
+        float *a = fft + 16 * s, *b = fft + 16 * (s + h);
+        __m256 ar = _mm256_loadu_ps(a), ai = _mm256_loadu_ps(a + 8),
+            br = _mm256_loadu_ps(b), bi = _mm256_loadu_ps(b + 8);
+        __m256 tr = _mm256_sub_ps(_mm256_mul_ps(br, wr), _mm256_mul_ps(bi, wi)),
+            ti = _mm256_add_ps(_mm256_mul_ps(br, wi), _mm256_mul_ps(bi, wr));
+        _mm256_storeu_ps(a, _mm256_add_ps(ar, tr));
+        _mm256_storeu_ps(a + 8, _mm256_add_ps(ai, ti));
+        _mm256_storeu_ps(b, _mm256_sub_ps(ar, tr));
+        _mm256_storeu_ps(b + 8, _mm256_sub_ps(ai, ti));
+      }
+    }
+  }
+  // X[k] = (Z[k] + conj(Z[m-k])) / 2 + exp(-2 pi i k / n) (Z[k] - conj(Z[m-k])) / 2i
+  const __m256 half = _mm256_set1_ps(0.5f);
+  float p[8];
+  for (int32 k = 0; k <= m; k++) {
+    const float *a = fft + 16 * (k == m ? 0 : k), *c = fft + 16 * (k == 0 ? 0 : m - k);
+    __m256 ar = _mm256_loadu_ps(a), ai = _mm256_loadu_ps(a + 8),
+        cr = _mm256_loadu_ps(c), ci = _mm256_loadu_ps(c + 8);
+    __m256 er = _mm256_mul_ps(half, _mm256_add_ps(ar, cr)),
+        ei = _mm256_mul_ps(half, _mm256_sub_ps(ai, ci)),
+        or_ = _mm256_mul_ps(half, _mm256_add_ps(ai, ci)),
+        oi = _mm256_mul_ps(half, _mm256_sub_ps(cr, ar));
+    __m256 wr = _mm256_set1_ps(cos_tab[k]), wi = _mm256_set1_ps(sin_tab[k]);
+    __m256 xr = _mm256_add_ps(er, _mm256_sub_ps(_mm256_mul_ps(wr, or_),
+                                                _mm256_mul_ps(wi, oi))),
+        xi = _mm256_add_ps(ei, _mm256_add_ps(_mm256_mul_ps(wr, oi),
+                                             _mm256_mul_ps(wi, or_)));
+    _mm256_storeu_ps(p, _mm256_add_ps(_mm256_mul_ps(xr, xr),
+                                      _mm256_mul_ps(xi, xi)));
+    for (int32 l = 0; l < num_lanes; l++)
+      power[l * power_stride + k] = p[l];
+  }
+  _mm256_zeroupper();
+}
+#endif
+
+MelBatchComputer::MelBatchComputer(const FrameExtractionOptions &opts)
+    : opts_(opts), window_function_(opts),
+      padded_size_(opts.PaddedWindowSize()), use_simd_(false), srfft_(NULL) {
+  bool power_of_two = (padded_size_ & (padded_size_ - 1)) == 0;
+  if (power_of_two)
+    srfft_ = new SplitRadixRealFft<BaseFloat>(padded_size_);
+#ifdef KALDI_HAVE_AVX2
+  use_simd_ = power_of_two && padded_size_ >= 4 &&
+      sizeof(BaseFloat) == sizeof(float) && CpuHasAvx2();
+#endif
+  if (use_simd_) {
+    int32 m = padded_size_ / 2, log_m = 0;
+    while ((1 << log_m) < m) log_m++;
+    bit_reverse_.resize(m);
+    for (int32 k = 0; k < m; k++) {
+      int32 r = 0;
+      for (int32 b = 0; b < log_m; b++)
+        if (k & (1 << b)) r |= 1 << (log_m - 1 - b);
+      bit_reverse_[k] = r;
+    }
+    cos_.resize(m + 1);
+    sin_.resize(m + 1);
+    for (int32 k = 0; k <= m; k++) {
+      double angle = -M_2PI * k / padded_size_;
+      cos_[k] = cos(angle);
+      sin_[k] = sin(angle);
+    }
+  }
+}
+
+MelBatchComputer::~MelBatchComputer() {
+  delete srfft_;
+}
+
+void MelBatchComputer::ExtractWindow(const VectorBase<BaseFloat> &wave,
+                                     int32 f,
+                                     MelBatchBuffers *buffers,
+                                     BaseFloat *window,
+                                     BaseFloat *log_energy_pre_window) const {
+  int32 frame_shift = opts_.WindowShift();
+  int32 frame_length = opts_.WindowSize();
+  Vector<BaseFloat> &frame = buffers->frame;
+  if (frame.Dim() != frame_length)
+    frame.Resize(frame_length, kUndefined);
+
+  if (opts_.snip_edges) {
+    int32 start = frame_shift * f;
+    KALDI_ASSERT(start >= 0 && start + frame_length <= wave.Dim());
+    frame.CopyFromVec(wave.Range(start, frame_length));
+  } else {
+    // As ExtractWindow(), extended by reflection over the edges.
+    int32 mid = frame_shift * (f + 0.5),
+        begin = mid - frame_length / 2,
+        end = begin + frame_length,
+        begin_limited = std::max<int32>(0, begin),
+        end_limited = std::min(end, wave.Dim()),
+        length_limited = end_limited - begin_limited;
+    frame.Range(begin_limited - begin, length_limited).
+        CopyFromVec(wave.Range(begin_limited, length_limited));
+    for (int32 t = begin; t < 0; t++)
+      frame(t - begin) = wave((-t) % wave.Dim());
+    for (int32 t = wave.Dim(); t < end; t++)
+      frame(t - begin) = wave(wave.Dim() - 1 - (t - wave.Dim()) % wave.Dim());
+  }
+
+  BaseFloat *x = frame.Data();
+  if (opts_.dither != 0.0) {
+    // Two per Box-Muller transform, from the own random state.
+    int32 i = 0;
+    for (; i + 1 < frame_length; i += 2) {
+      BaseFloat a, b;
+      RandGauss2(&a, &b, &buffers->rand);
+      x[i] += a * opts_.dither;
+      x[i + 1] += b * opts_.dither;
+    }
+    if (i < frame_length)
+      x[i] += RandGauss(&buffers->rand) * opts_.dither;
+  }
+
+  if (opts_.remove_dc_offset)
+    frame.Add(-frame.Sum() / frame_length);
+
+  if (log_energy_pre_window != NULL) {
+    BaseFloat energy = std::max(VecVec(frame, frame),
+                                std::numeric_limits<BaseFloat>::min());
+    *log_energy_pre_window = Log(energy);
+  }
+
+  const BaseFloat *w = window_function_.window.Data();
+#ifdef KALDI_HAVE_AVX2
+  if (use_simd_) {
+    Avx2PreemphasizeAndWindow(reinterpret_cast<const float *>(x),
+                              reinterpret_cast<const float *>(w),
+                              opts_.preemph_coeff, frame_length,
+                              reinterpret_cast<float *>(window));
+  } else
+#endif
+  PreemphasizeAndWindow(x, w, opts_.preemph_coeff, frame_length, window);
+
+  std::fill(window + frame_length, window + padded_size_, 0.0);
+}
+
+void MelBatchComputer::ComputePowerSpectra(int32 num_frames,
+                                           MelBatchBuffers *buffers,
+                                           int32 row,
+                                           MatrixBase<BaseFloat> *power) const {
+  Matrix<BaseFloat> &windows = buffers->windows;
+#ifdef KALDI_HAVE_AVX2
+  if (use_simd_) {
+    buffers->fft.resize(8 * padded_size_);
+    Avx2PowerSpectra(reinterpret_cast<const float *>(windows.Data()),
+                     windows.Stride(), num_frames, padded_size_,
+                     &bit_reverse_[0], &cos_[0], &sin_[0], &buffers->fft[0],
+                     reinterpret_cast<float *>(power->RowData(row)),
+                     power->Stride());
+    return;
+  }
+#endif
+  for (int32 i = 0; i < num_frames; i++) {
+    SubVector<BaseFloat> window(windows, i);
+    if (srfft_ != NULL)  // Compute FFT using split-radix algorithm.
+      srfft_->Compute(window.Data(), true, &buffers->srfft_buffer);
+    else  // An alternative algorithm that works for non-powers-of-two.
+      RealFft(&window, true);
+    ComputePowerSpectrum(&window);
+    power->Row(row + i).CopyFromVec(window.Range(0, padded_size_ / 2 + 1));
+  }
+}
+
+void MelBatchComputer::Compute(const VectorBase<BaseFloat> &wave,
+                               int32 first_frame,
+                               const MelBanks &mel_banks,
+                               bool raw_energy,
+                               MelBatchBuffers *buffers,
+                               MatrixBase<BaseFloat> *mel_energies,
+                               VectorBase<BaseFloat> *log_energy) const {
+  int32 num_frames = mel_energies->NumRows();
+  KALDI_ASSERT(mel_energies->NumCols() == mel_banks.NumBins());
+  KALDI_ASSERT(log_energy == NULL || log_energy->Dim() == num_frames);
+  if (buffers->windows.NumRows() != kLanes ||
+      buffers->windows.NumCols() != padded_size_)
+    buffers->windows.Resize(kLanes, padded_size_, kUndefined);
+  if (buffers->power.NumRows() != kBlockFrames ||
+      buffers->power.NumCols() != padded_size_ / 2 + 1)
+    buffers->power.Resize(kBlockFrames, padded_size_ / 2 + 1, kUndefined);
+
+  for (int32 r = 0; r < num_frames; r += kBlockFrames) {
+    int32 block_frames = std::min(kBlockFrames, num_frames - r);
+    for (int32 l = 0; l < block_frames; l += kLanes) {
+      int32 num_lanes = std::min(kLanes, block_frames - l);
+      for (int32 i = 0; i < num_lanes; i++) {
+        int32 t = r + l + i;
+        BaseFloat *window = buffers->windows.RowData(i);
+        ExtractWindow(wave, first_frame + t, buffers, window,
+                      (log_energy != NULL && raw_energy ?
+                       log_energy->Data() + t : NULL));
+        // Energy after window function (not the raw one)
+        if (log_energy != NULL && !raw_energy) {
+          SubVector<BaseFloat> this_window(window, padded_size_);
+          (*log_energy)(t) = Log(std::max(VecVec(this_window, this_window),
+                                          std::numeric_limits<BaseFloat>::min()));
+        }
+      }
+      ComputePowerSpectra(num_lanes, buffers, l, &buffers->power);
+    }
+    SubMatrix<BaseFloat> this_mel(*mel_energies, r, block_frames,
+                                  0, mel_energies->NumCols());
+    mel_banks.ComputeBatch(buffers->power.RowRange(0, block_frames), &this_mel);
+  }
+}
+
+}  // namespace kaldi
@@ -0,0 +1,98 @@
+// feat/mel-batch.h
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_FEAT_MEL_BATCH_H_
+#define KALDI_FEAT_MEL_BATCH_H_
+
+#include <vector>
+
+#include "feat/feature-functions.h"
+#include "feat/mel-computations.h"
+
+namespace kaldi {
+/// @addtogroup  feat FeatureExtraction
+/// @{
+
+/// The temporaries of MelBatchComputer::Compute() and of its callers.  The
+/// callers keep them for the next calls, so nothing is allocated once they
+/// have grown to the largest call.
+struct MelBatchBuffers {
+  Vector<BaseFloat> frame;  // one frame of the waveform, before windowing.
+  Matrix<BaseFloat> windows;  // the windowed frames of one FFT.
+  Matrix<BaseFloat> power;  // the power spectra of a block of frames.
+  std::vector<float> fft;  // the complex points of the frames, interleaved.
+  std::vector<BaseFloat> srfft_buffer;  // used by srfft.
+  Matrix<BaseFloat> mel_energies;  // for the callers.
+  Vector<BaseFloat> log_energy;  // for the callers.
+  RandomState rand;  // for the dithering, so it does not take the Rand() lock.
+};
+
+/// MelBatchComputer computes the mel energies of many frames at a time, for
+/// Fbank and Mfcc.  It does what ExtractWindow(), the FFT,
+/// ComputePowerSpectrum() and MelBanks::Compute() do frame by frame, but
+/// with the windowing vectorized, the FFT of 8 frames at a time in the AVX2
+/// lanes and the mel banks as dense blocks over a block of frames (see
+/// MelBanks::ComputeBatch()).  Without AVX2, or if the padded window is not
+/// a power of two, the FFT is the split-radix one of each frame.  The results
+/// agree with the frame by frame ones within float rounding.
+class MelBatchComputer {
+ public:
+  explicit MelBatchComputer(const FrameExtractionOptions &opts);
+  ~MelBatchComputer();
+
+  /// Computes the mel energies (not log) of the frames
+  /// [first_frame, first_frame + mel_energies->NumRows()) of "wave".  If
+  /// "log_energy" is not NULL, it gets the log energy of each frame, before
+  /// pre-emphasis and windowing if "raw_energy", after them otherwise.
+  void Compute(const VectorBase<BaseFloat> &wave,
+               int32 first_frame,
+               const MelBanks &mel_banks,
+               bool raw_energy,
+               MelBatchBuffers *buffers,
+               MatrixBase<BaseFloat> *mel_energies,
+               VectorBase<BaseFloat> *log_energy) const;
+
+  static const int32 kLanes = 8;  // frames of one FFT.
+  static const int32 kBlockFrames = 64;  // frames of one mel projection.
+
+ private:
+  // Windows frame f of "wave" to "window", as ExtractWindow() does.
+  void ExtractWindow(const VectorBase<BaseFloat> &wave, int32 f,
+                     MelBatchBuffers *buffers, BaseFloat *window,
+                     BaseFloat *log_energy_pre_window) const;
+
+  // The power spectra of the first num_frames rows of buffers->windows, to
+  // the rows of "power" from "row".
+  void ComputePowerSpectra(int32 num_frames, MelBatchBuffers *buffers,
+                           int32 row, MatrixBase<BaseFloat> *power) const;
+
+  FrameExtractionOptions opts_;
+  FeatureWindowFunction window_function_;
+  int32 padded_size_;
+  bool use_simd_;
+  SplitRadixRealFft<BaseFloat> *srfft_;  // NULL if not a power of two.
+  // Of the AVX2 FFT of padded_size_ / 2 complex points: the bit reversed
+  // indexes, and exp(-2 pi i k / padded_size_) for k <= padded_size_ / 2.
+  std::vector<int32> bit_reverse_;
+  std::vector<float> cos_, sin_;
+  KALDI_DISALLOW_COPY_AND_ASSIGN(MelBatchComputer);
+};
+
+/// @} End of "addtogroup feat"
+}  // namespace kaldi
+
+#endif  // KALDI_FEAT_MEL_BATCH_H_
@@ -139,6 +139,24 @@ MelBanks::MelBanks(const MelBanksOptions &opts,
                 << ", vec = " << bins_[i].second;
     }
   }
+
+  // The dense blocks of ComputeBatch().
+  for (int32 begin = 0; begin < num_bins; begin += kBinsPerBlock) {
+    int32 end = std::min(begin + kBinsPerBlock, num_bins),
+        first = bins_[begin].first, last = 0;
+    for (int32 bin = begin; bin < end; bin++) {
+      first = std::min(first, bins_[bin].first);
+      last = std::max(last, bins_[bin].first + bins_[bin].second.Dim());
+    }
+    Matrix<BaseFloat> block(last - first, end - begin);
+    for (int32 bin = begin; bin < end; bin++) {
+      const Vector<BaseFloat> &v = bins_[bin].second;
+      for (int32 i = 0; i < v.Dim(); i++)
+        block(bins_[bin].first - first + i, bin - begin) = v(i);
+    }
+    block_offsets_.push_back(first);
+    blocks_.push_back(block);
+  }
 }
 
 BaseFloat MelBanks::VtlnWarpFreq(BaseFloat vtln_low_cutoff,  // upper+lower frequency cutoffs for VTLN.
@@ -245,6 +263,26 @@ void MelBanks::Compute(const VectorBase<BaseFloat> &power_spectrum,
   }
 }
 
+void MelBanks::ComputeBatch(const MatrixBase<BaseFloat> &power_spectra,
+                            MatrixBase<BaseFloat> *mel_energies) const {
+  int32 num_frames = power_spectra.NumRows();
+  KALDI_ASSERT(mel_energies->NumRows() == num_frames &&
+               mel_energies->NumCols() == NumBins());
+  if (num_frames == 0) return;
+  for (size_t b = 0; b < blocks_.size(); b++) {
+    const Matrix<BaseFloat> &block = blocks_[b];
+    SubMatrix<BaseFloat> this_mel(*mel_energies, 0, num_frames,
+                                  b * kBinsPerBlock, block.NumCols());
+    this_mel.AddMatMat(1.0, power_spectra.ColRange(block_offsets_[b],
+                                                   block.NumRows()),
+                       kNoTrans, block, kNoTrans, 0.0);
+  }
+  // HTK-like flooring- for testing purposes (we prefer dither)
+  if (htk_mode_) mel_energies->ApplyFloor(1.0);
+  // As in Compute(), to detect the OpenBlas problem early.
+  KALDI_ASSERT(!KALDI_ISNAN(mel_energies->Sum()));
+}
+
 void ComputeLifterCoeffs(BaseFloat Q, VectorBase<BaseFloat> *coeffs) {
   // Compute liftering coefficients (scaling on cepstral coeffs)
   // coeffs are numbered slightly differently from HTK: the zeroth
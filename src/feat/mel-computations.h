@@ -76,6 +76,13 @@ class MelBanks {
   void Compute(const VectorBase<BaseFloat> &fft_energies,
                Vector<BaseFloat> *mel_energies_out) const;
 
+  /// Computes the mel energies of all the rows of "power_spectra" at once,
+  /// the same as Compute() on each row.  The bins are in blocks of
+  /// consecutive ones, each a dense matrix over the fft bins it covers, so
+  /// this is a few matrix multiplications.
+  void ComputeBatch(const MatrixBase<BaseFloat> &power_spectra,
+                    MatrixBase<BaseFloat> *mel_energies) const;
+
   int32 NumBins() const { return bins_.size(); }
 
   // returns vector of central freq of each bin; needed by plp code.
@@ -90,6 +97,13 @@ class MelBanks {
   // (the first nonzero fft-bin), (the vector of weights).
   std::vector<std::pair<int32, Vector<BaseFloat> > > bins_;
 
+  // The weights of bins_ for ComputeBatch(), block b has the bins from
+  // b * kBinsPerBlock and the fft bins from block_offsets_[b], as
+  // (fft bins) x (bins).
+  static const int32 kBinsPerBlock = 8;
+  std::vector<int32> block_offsets_;
+  std::vector<Matrix<BaseFloat> > blocks_;
+
   bool debug_;
   bool htk_mode_;
   KALDI_DISALLOW_COPY_AND_ASSIGN(MelBanks);
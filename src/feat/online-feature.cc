@@ -28,11 +28,16 @@ namespace kaldi {
 template<class C>
 void OnlineGenericBaseFeature<C>::GetFrame(int32 frame,
                                            VectorBase<BaseFloat> *feat) {
-  KALDI_ASSERT(frame >= 0 && frame < num_frames_);
+  KALDI_ASSERT(frame >= first_frame_ && frame < num_frames_);
   KALDI_ASSERT(feat->Dim() == Dim());
-  feat->CopyFromVec(features_.Row(frame));
+  feat->CopyFromVec(features_.Row(frame - offset_));
 };
 
+template<class C>
+void OnlineGenericBaseFeature<C>::DiscardFrames(int32 frame) {
+  first_frame_ = std::max(first_frame_, std::min(frame, num_frames_));
+}
+
 template<class C>
 bool OnlineGenericBaseFeature<C>::IsLastFrame(int32 frame) const {
   return (frame == num_frames_ - 1 && input_finished_);
@@ -41,7 +46,8 @@ bool OnlineGenericBaseFeature<C>::IsLastFrame(int32 frame) const {
 template<class C>
 OnlineGenericBaseFeature<C>::OnlineGenericBaseFeature(
     const typename C::Options &opts)
-    :mfcc_or_plp_(opts), input_finished_(false), num_frames_(0),
+    :mfcc_or_plp_(opts), offset_(0), first_frame_(0),
+    input_finished_(false), num_frames_(0),
     sampling_frequency_(opts.frame_opts.samp_freq) { }
 
 template<class C>
@@ -85,14 +91,23 @@ void OnlineGenericBaseFeature<C>::AcceptWaveform(BaseFloat sampling_rate,
   BaseFloat increase_ratio = 1.5;  // This is a tradeoff between memory and
                                    // compute; it's the factor by which we
                                    // increase the memory used each time.
-  if (new_num_frames > features_.NumRows()) {
-    int32 new_num_rows = std::max<int32>(new_num_frames,
+  if (new_num_frames - offset_ > features_.NumRows() &&
+      first_frame_ - offset_ >= features_.NumRows() / 2) {
+    // At least half of the rows are discarded frames; move the kept ones to
+    // the top instead of growing.
+    for (int32 t = first_frame_; t < num_frames_; t++)
+      features_.Row(t - first_frame_).CopyFromVec(features_.Row(t - offset_));
+    offset_ = first_frame_;
+  }
+  if (new_num_frames - offset_ > features_.NumRows()) {
+    int32 new_num_rows = std::max<int32>(new_num_frames - offset_,
                                          features_.NumRows() * increase_ratio);
     // Increase the size of the features_ matrix and copy over any existing
     // data.
     features_.Resize(new_num_rows, Dim(), kCopyData);
   }
-  features_.Range(num_frames_, feats.NumRows(), 0, Dim()).CopyFromMat(feats);
+  features_.Range(num_frames_ - offset_, feats.NumRows(),
+                  0, Dim()).CopyFromMat(feats);
   num_frames_ = new_num_frames;
 }
 
@@ -219,6 +234,17 @@ void OnlineCmvn::CacheFrame(int32 frame, const Matrix<double> &stats) {
   }
 }
 
+void OnlineCmvn::DiscardFrames(int32 frame) {
+  // The stats of a frame start from the cached ones of its modulus.  The
+  // older ones are freed back to the first one already freed.
+  int32 n = std::min<int32>(frame / opts_.modulus,
+                            cached_stats_modulo_.size()) - 1;
+  for (; n >= 0 && cached_stats_modulo_[n] != NULL; n--) {
+    delete cached_stats_modulo_[n];
+    cached_stats_modulo_[n] = NULL;
+  }
+}
+
 OnlineCmvn::~OnlineCmvn() {
   for (size_t i = 0; i < cached_stats_modulo_.size(); i++)
     delete cached_stats_modulo_[i];
@@ -76,12 +76,19 @@ class OnlineGenericBaseFeature: public OnlineBaseFeature {
   // of delta or LDA features.
   virtual void InputFinished() { input_finished_= true; }
 
+  // The rows of the discarded frames are reused for the new ones, so
+  // features_ stays about the size of the frames still kept.
+  virtual void DiscardFrames(int32 frame);
 
  private:
   C mfcc_or_plp_;  // class that does the MFCC or PLP computation
 
-  // features_ is the Mfcc or Plp or Fbank features that we have already computed.
+  // features_ is the Mfcc or Plp or Fbank features that we have already computed,
+  // row 0 is frame offset_.
   Matrix<BaseFloat> features_;
+  int32 offset_;
+  // The frames before first_frame_ were discarded.
+  int32 first_frame_;
 
   // True if the user has called "InputFinished()"
   bool input_finished_;
@@ -324,6 +331,11 @@ class OnlineCmvn: public OnlineFeatureInterface {
   // utterance's CMVN object.
   void Freeze(int32 cur_frame);
 
+  // Frees the cached stats the frames from "frame" on don't need, if the
+  // frames before it won't be asked for again.  GetState() can't be called
+  // after this, it reads all the frames.
+  void DiscardFrames(int32 frame);
+
   virtual ~OnlineCmvn();
  private:
 
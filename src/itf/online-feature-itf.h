@@ -96,6 +96,11 @@ class OnlineBaseFeature: public OnlineFeatureInterface {
   /// of delta or LDA features (it will typically affect the return value
   /// of IsLastFrame.
   virtual void InputFinished() = 0;
+
+  /// DiscardFrames() tells the class the frames before "frame" won't be
+  /// asked for again, so it may free them; for long-lived streams.  By
+  /// default they are all kept.
+  virtual void DiscardFrames(int32 frame) { }
 };
 
 
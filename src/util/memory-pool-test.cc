@@ -0,0 +1,95 @@
+// util/memory-pool-test.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "util/memory-pool.h"
+#include <set>
+#include <cstdlib>
+#include <iostream>
+
+namespace kaldi {
+
+// Like the decoder tokens
+struct TestObject {
+  float cost;
+  int32 id;
+  TestObject *next;
+  TestObject(float cost, int32 id, TestObject *next):
+      cost(cost), id(id), next(next) { }
+};
+
+void TestMemoryPool(bool use_pool) {
+  MemoryPool<TestObject> pool(use_pool);
+  std::vector<TestObject*> live;
+  std::set<TestObject*> addresses;
+  int32 num_new = 0;
+  for (int32 epoch = 0; epoch < 3; epoch++) {
+    for (int32 i = 0; i < 5000; i++) {
+      if (!live.empty() && Rand() % 3 == 0) {
+        // free a random one
+        size_t j = Rand() % live.size();
+        KALDI_ASSERT(addresses.erase(live[j]) == 1);
+        pool.Free(live[j]);
+        live[j] = live.back();
+        live.pop_back();
+      } else {
+        TestObject *obj = new (pool.Allocate()) TestObject(0.5 * num_new,
+                                                           num_new, NULL);
+        num_new++;
+        // no object is given out twice
+        KALDI_ASSERT(addresses.insert(obj).second);
+        live.push_back(obj);
+      }
+    }
+    // the live objects are not overwritten by the others
+    for (size_t j = 0; j < live.size(); j++)
+      KALDI_ASSERT(live[j]->cost == 0.5 * live[j]->id);
+    KALDI_ASSERT(pool.Stats().num_in_use == static_cast<int64>(live.size()));
+    if (use_pool) {
+      pool.FreeAll();
+    } else {
+      for (size_t j = 0; j < live.size(); j++)
+        pool.Free(live[j]);
+    }
+    live.clear();
+    addresses.clear();
+    KALDI_ASSERT(pool.Stats().num_in_use == 0);
+  }
+  const MemoryPoolStats &stats = pool.Stats();
+  KALDI_ASSERT(stats.num_allocated == num_new);
+  KALDI_ASSERT(stats.peak_in_use > 0 && stats.peak_in_use <= num_new);
+  KALDI_ASSERT(stats.peak_bytes >=
+               stats.peak_in_use * static_cast<int64>(sizeof(TestObject)));
+  if (use_pool) {
+    // the freed objects and the blocks kept by FreeAll() are reused
+    KALDI_ASSERT(stats.ReuseRate() > 0.5 && stats.ReuseRate() <= 1.0);
+  } else {
+    KALDI_ASSERT(stats.num_reused == 0);
+  }
+}
+
+} // end namespace kaldi
+
+
+int main() {
+  using namespace kaldi;
+  for (size_t i = 0; i < 3; i++) {
+    TestMemoryPool(true);
+    TestMemoryPool(false);
+  }
+  std::cout << "Test OK.\n";
+}
@@ -0,0 +1,166 @@
+// util/memory-pool.h
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef KALDI_UTIL_MEMORY_POOL_H_
+#define KALDI_UTIL_MEMORY_POOL_H_
+#include <new>
+#include <vector>
+#include "base/kaldi-common.h"
+
+
+/* This header provides a slab allocator for the small objects a decoder makes
+   and frees in huge numbers (the Tokens and ForwardLinks of the lattice
+   decoders).  Like the Elems of HashList, the objects are carved from blocks
+   of allocate_block_size_ objects and the freed ones are kept in a free list
+   for reuse, so there is no malloc() for most of them, which matters when many
+   decoder threads share the global allocator.  The pool belongs to one
+   decoder, it is not thread safe.  FreeAll() releases every object at once
+   (e.g. at the end of an utterance) and keeps the blocks for the next one.
+
+   See memory-pool-test.cc for an example of how to use this object.
+*/
+
+
+namespace kaldi {
+
+struct MemoryPoolStats {
+  int64 num_allocated;  // objects allocated so far
+  int64 num_reused;  // of them, the ones given back memory of a freed object
+  int64 num_in_use;  // objects allocated and not freed yet
+  int64 peak_in_use;
+  int64 peak_bytes;  // peak memory of the objects, the blocks if pooled
+
+  MemoryPoolStats(): num_allocated(0), num_reused(0), num_in_use(0),
+                     peak_in_use(0), peak_bytes(0) { }
+
+  /// Fraction of the allocations which did not need new memory
+  double ReuseRate() const {
+    return num_allocated == 0 ? 0.0 :
+        static_cast<double>(num_reused) / num_allocated;
+  }
+
+  /// Sums the stats of another pool, eg. of other decoders
+  void Add(const MemoryPoolStats &other) {
+    num_allocated += other.num_allocated;
+    num_reused += other.num_reused;
+    num_in_use += other.num_in_use;
+    peak_in_use += other.peak_in_use;
+    peak_bytes += other.peak_bytes;
+  }
+};
+
+template<class T> class MemoryPool {
+ public:
+  /// If use_pool is false every object is a plain new/delete, only the stats
+  /// are kept (to compare with the pool).
+  explicit MemoryPool(bool use_pool = true):
+      use_pool_(use_pool), freed_head_(NULL), cur_block_(0), cur_pos_(0),
+      num_slots_used_(0) { }
+
+  /// Memory for one T, construct it with placement new, eg.
+  /// Token *tok = new (pool.Allocate()) Token(...);
+  inline void *Allocate() {
+    stats_.num_allocated++;
+    stats_.num_in_use++;
+    if (stats_.num_in_use > stats_.peak_in_use) {
+      stats_.peak_in_use = stats_.num_in_use;
+      if (!use_pool_) stats_.peak_bytes = stats_.peak_in_use * sizeof(T);
+    }
+    if (!use_pool_) return ::operator new(sizeof(T));
+    if (freed_head_ != NULL) {
+      FreeSlot *ans = freed_head_;
+      freed_head_ = freed_head_->next;
+      stats_.num_reused++;
+      return ans;
+    }
+    // Blocks kept by FreeAll() are used before new ones are allocated
+    if (cur_pos_ == allocate_block_size_) {
+      cur_block_++;
+      cur_pos_ = 0;
+    }
+    if (cur_block_ == allocated_.size()) {
+      allocated_.push_back(static_cast<char*>(
+          ::operator new(allocate_block_size_ * kSlotSize)));
+      stats_.peak_bytes = allocated_.size() * allocate_block_size_ * kSlotSize;
+    }
+    size_t slot = cur_block_ * allocate_block_size_ + cur_pos_;
+    if (slot < num_slots_used_) stats_.num_reused++;
+    else num_slots_used_ = slot + 1;
+    return allocated_[cur_block_] + kSlotSize * cur_pos_++;
+  }
+
+  /// Gives back the memory of an object from Allocate(), its destructor is
+  /// not called (the objects are meant to be trivially destructible).
+  inline void Free(T *p) {
+    KALDI_PARANOID_ASSERT(stats_.num_in_use > 0);
+    stats_.num_in_use--;
+    if (!use_pool_) {
+      ::operator delete(p);
+      return;
+    }
+    FreeSlot *slot = reinterpret_cast<FreeSlot*>(p);
+    slot->next = freed_head_;
+    freed_head_ = slot;
+  }
+
+  /// Frees all the objects at once, the blocks are kept for reuse.  Only
+  /// valid if UsePool(), otherwise the objects have to be Free()'d one by one.
+  void FreeAll() {
+    KALDI_ASSERT(use_pool_);
+    freed_head_ = NULL;
+    cur_block_ = 0;
+    cur_pos_ = 0;
+    stats_.num_in_use = 0;
+  }
+
+  bool UsePool() const { return use_pool_; }
+
+  const MemoryPoolStats &Stats() const { return stats_; }
+
+  ~MemoryPool() {
+    for (size_t i = 0; i < allocated_.size(); i++)
+      ::operator delete(allocated_[i]);
+  }
+
+ private:
+  struct FreeSlot {
+    FreeSlot *next;
+  };
+  // Size of one object in the blocks, rounded up to keep the pointers aligned
+  static const size_t kSlotSize =
+      ((sizeof(T) > sizeof(FreeSlot) ? sizeof(T) : sizeof(FreeSlot)) +
+       sizeof(void*) - 1) / sizeof(void*) * sizeof(void*);
+
+  bool use_pool_;
+  FreeSlot *freed_head_;  // head of the list of freed objects
+  std::vector<char*> allocated_;  // list of allocated blocks
+  size_t cur_block_;  // objects from cur_pos_ of allocated_[cur_block_] on
+  size_t cur_pos_;    // were never allocated since the last FreeAll()
+  size_t num_slots_used_;  // objects of the blocks ever allocated
+  MemoryPoolStats stats_;
+
+  static const size_t allocate_block_size_ = 1024;  // Number of objects to
+  // allocate in one block.
+
+  KALDI_DISALLOW_COPY_AND_ASSIGN(MemoryPool);
+};
+
+
+} // end namespace kaldi
+
+#endif